@@ -1,5 +1,15 @@
 #include "ast.h"
 
+/* Node allocations on this thread, reported by --stats and SYSTAT */
+static _Thread_local unsigned long long ast_nodes_allocated = 0;
+static _Thread_local unsigned long long ast_bytes_allocated = 0;
+
+void ast_get_alloc_stats(unsigned long long *nodes, unsigned long long *bytes)
+{
+    *nodes = ast_nodes_allocated;
+    *bytes = ast_bytes_allocated;
+}
+
 /*
  * Expression creation
  */
@@ -7,6 +17,8 @@
 ASTExpr *ast_expr_create(ExprType type)
 {
     ASTExpr *expr = xcalloc(1, sizeof(ASTExpr));
+    ast_nodes_allocated++;
+    ast_bytes_allocated += sizeof(ASTExpr);
     expr->type = type;
     expr->line_number = 0;
     expr->column_number = 0;
@@ -14,6 +26,7 @@ ASTExpr *ast_expr_create(ExprType type)
     expr->num_value = 0.0;
     expr->str_value = NULL;
     expr->var_name = NULL;
+    expr->slot = -1;
     expr->op = OP_NONE;
     expr->children = NULL;
     expr->num_children = 0;
@@ -28,6 +41,8 @@ ASTExpr *ast_expr_create(ExprType type)
 ASTStmt *ast_stmt_create(StmtType type)
 {
     ASTStmt *stmt = xcalloc(1, sizeof(ASTStmt));
+    ast_nodes_allocated++;
+    ast_bytes_allocated += sizeof(ASTStmt);
     stmt->type = type;
     stmt->line_number = 0;
     stmt->exprs = NULL;
@@ -110,6 +125,7 @@ ASTExpr *ast_expr_copy(ASTExpr *expr)
     copy->column_number = expr->column_number;
     copy->inferred_type = expr->inferred_type;
     copy->num_value = expr->num_value;
+    copy->slot = expr->slot;
     copy->op = expr->op;
 
     /* Copy string fields */
@@ -198,9 +214,24 @@ void ast_stmt_free(ASTStmt *stmt)
         free(stmt->call_args);
     }
 
+    ast_case_table_free(stmt->case_table);
+
     free(stmt);
 }
 
+void ast_case_table_free(CaseTable *table)
+{
+    if (table == NULL)
+    {
+        return;
+    }
+    free(table->arms);
+    free(table->kind);
+    free(table->dense);
+    free(table->buckets);
+    free(table);
+}
+
 /*
  * Program destruction
  */
@@ -419,6 +450,10 @@ const char *stmt_type_name(StmtType type)
         return "DEFDBL";
     case STMT_DEFSTR:
         return "DEFSTR";
+    case STMT_CASE:
+        return "CASE";
+    case STMT_BLOCK:
+        return "BLOCK";
     case STMT_STOP:
         return "STOP";
     case STMT_CONT:
@@ -429,6 +464,66 @@ const char *stmt_type_name(StmtType type)
         return "PROCEDURE_DEF";
     case STMT_PROCEDURE_CALL:
         return "PROCEDURE_CALL";
+    case STMT_PRINT_AT:
+        return "PRINT_AT";
+    case STMT_PRINT_USING:
+        return "PRINT_USING";
+    case STMT_LINE_INPUT:
+        return "LINE_INPUT";
+    case STMT_ON_GOTO:
+        return "ON_GOTO";
+    case STMT_RESTORE:
+        return "RESTORE";
+    case STMT_OPEN:
+        return "OPEN";
+    case STMT_CLOSE:
+        return "CLOSE";
+    case STMT_WRITE:
+        return "WRITE";
+    case STMT_GET:
+        return "GET";
+    case STMT_PUT:
+        return "PUT";
+    case STMT_SLEEP:
+        return "SLEEP";
+    case STMT_BEEP:
+        return "BEEP";
+    case STMT_CLS:
+        return "CLS";
+    case STMT_RANDOMIZE:
+        return "RANDOMIZE";
+    case STMT_POKE:
+        return "POKE";
+    case STMT_CALL:
+        return "CALL";
+    case STMT_DEF_FN:
+        return "DEF_FN";
+    case STMT_TRON:
+        return "TRON";
+    case STMT_TROFF:
+        return "TROFF";
+    case STMT_SYSTAT:
+        return "SYSTAT";
+    case STMT_MAT:
+        return "MAT";
+    case STMT_WHILE:
+        return "WHILE";
+    case STMT_WEND:
+        return "WEND";
+    case STMT_DO_LOOP:
+        return "DO_LOOP";
+    case STMT_EXIT:
+        return "EXIT";
+    case STMT_SAVE:
+        return "SAVE";
+    case STMT_DELETE:
+        return "DELETE";
+    case STMT_MERGE:
+        return "MERGE";
+    case STMT_CLEAR:
+        return "CLEAR";
+    case STMT_CLASS_DEF:
+        return "CLASS_DEF";
     default:
         return "UNKNOWN";
     }
@@ -53,6 +53,8 @@ typedef enum
     STMT_DEF_FN,
     STMT_TRON,
     STMT_TROFF,
+    STMT_SYSTAT,
+    STMT_MAT,
     STMT_WHILE,
     STMT_WEND,
     STMT_DO_LOOP,
@@ -71,6 +73,39 @@ typedef enum
     STMT_UNKNOWN
 } StmtType;
 
+/*
+ * MAT statement operation, kept in the statement's mode. exprs[0] is the
+ * target array (an EXPR_ARRAY without subscripts), operands follow.
+ */
+typedef enum
+{
+    MAT_COPY,  /* MAT C = A */
+    MAT_ADD,   /* MAT C = A + B */
+    MAT_SUB,   /* MAT C = A - B */
+    MAT_MUL,   /* MAT C = A * B, the matrix product */
+    MAT_SCALE, /* MAT C = (k) * A; exprs[1] is k */
+    MAT_TRN,   /* MAT C = TRN(A) */
+    MAT_INV,   /* MAT C = INV(A) */
+    MAT_ZER,   /* MAT C = ZER [(bounds)]; any bounds follow the target */
+    MAT_CON,   /* MAT C = CON [(bounds)] */
+    MAT_IDN    /* MAT C = IDN [(bounds)] */
+} MatOp;
+
+/*
+ * FOR statement kind, kept in the statement's mode. A PARALLEL FOR keeps
+ * its REDUCE variables in call_args, each an EXPR_VAR whose op is the
+ * combining operator: OP_ADD, OP_MUL, OP_LT (MIN) or OP_GT (MAX). FOR
+ * EACH var IN map has just two exprs, the variable and the map, both
+ * EXPR_VAR. (In DIM, likewise, a map is an EXPR_VAR and an array an
+ * EXPR_ARRAY with its bounds.)
+ */
+typedef enum
+{
+    FOR_SEQUENTIAL,
+    FOR_PARALLEL,
+    FOR_EACH
+} ForMode;
+
 /*
  * Expression type enumeration
  */
@@ -168,6 +203,7 @@ struct ASTExpr
     double num_value; /* For EXPR_NUMBER */
     char *str_value;  /* For EXPR_STRING */
     char *var_name;   /* For EXPR_VAR, EXPR_ARRAY, EXPR_FUNC_CALL */
+    int slot;         /* Runtime storage slot set by symtable, -1 = unresolved */
     OpType op;        /* For EXPR_BINARY_OP, EXPR_UNARY_OP */
 
     /* Child expressions */
@@ -180,6 +216,39 @@ struct ASTExpr
     char *member_name;   /* Member name (e.g., 'field' in 'obj.field') */
 };
 
+/*
+ * CASE dispatch table, built from a STMT_CASE node's constant WHEN values
+ * the first time the statement runs. Arms are numbered from 0 in source
+ * order; exprs[arm + 1] is the arm's WHEN value.
+ */
+typedef enum
+{
+    CASE_ARM_INT,    /* Integral numeric literal: dense table or hash */
+    CASE_ARM_STRING, /* String literal: hash */
+    CASE_ARM_EXPR    /* Anything else: compared in order */
+} CaseArmKind;
+
+typedef struct
+{
+    int arm;          /* -1 = empty bucket */
+    const char *sval; /* Points into the WHEN literal; NULL for integer keys */
+    long ival;
+} CaseBucket;
+
+typedef struct
+{
+    int num_arms;
+    ASTStmt **arms;      /* Arm bodies, indexed by arm */
+    unsigned char *kind; /* CaseArmKind per arm */
+    int num_string_arms;
+    int num_expr_arms;
+    int dense_min; /* dense[v - dense_min] = first arm for integer v, or -1 */
+    int dense_size;
+    int *dense;
+    int num_buckets; /* Power of two; sparse integers and strings */
+    CaseBucket *buckets;
+} CaseTable;
+
 /*
  * Statement Node
  */
@@ -193,12 +262,12 @@ struct ASTStmt
     int num_exprs;
     int capacity_exprs;
 
-    ASTStmt *body;      /* Body statement (for IF, FOR, PROCEDURE, etc.) */
+    ASTStmt *body;      /* Body statement (for IF, FOR, PROCEDURE, etc.; CASE arm blocks) */
     ASTStmt *else_body; /* ELSE branch for IF */
     ASTStmt *next;      /* Next statement in same line (colon-separated) */
     int target_line;    /* Target line number (for GOTO, GOSUB) */
     int file_handle;    /* File handle for file I/O statements */
-    int mode;           /* File open mode or flags */
+    int mode;           /* File open mode, flags, MatOp for MAT, ForMode for FOR */
     char *comment;      /* Comment text (for REM) */
     char *var_name;     /* Variable name (for LET, FOR, DIM, INPUT, PROCEDURE_DEF, PROCEDURE_CALL) */
 
@@ -220,6 +289,8 @@ struct ASTStmt
     {
         int condition_type; /* 0=none, 1=pre-test WHILE, 2=post-test WHILE, 3=post-test UNTIL */
     } data;
+
+    CaseTable *case_table; /* STMT_CASE dispatch, built on first execution */
 };
 
 /*
@@ -229,6 +300,8 @@ typedef struct
 {
     int line_number;
     ASTStmt *stmt;
+    int src_line;   /* Source position of the first token (top-level units) */
+    int src_column;
 } ProgramLine;
 
 /*
@@ -239,6 +312,7 @@ typedef struct
     ProgramLine **lines;
     int num_lines;
     int capacity;
+    int modified; /* Lines replaced at run time (MERGE) */
 } Program;
 
 /* AST creation and manipulation functions */
@@ -247,9 +321,13 @@ ASTExpr *ast_expr_create(ExprType type);
 ASTStmt *ast_stmt_create(StmtType type);
 Program *ast_program_create(void);
 
+/* Statements and expressions created so far on this thread (for --stats) */
+void ast_get_alloc_stats(unsigned long long *nodes, unsigned long long *bytes);
+
 void ast_expr_free(ASTExpr *expr);
 ASTExpr *ast_expr_copy(ASTExpr *expr);
 void ast_stmt_free(ASTStmt *stmt);
+void ast_case_table_free(CaseTable *table);
 void ast_program_free(Program *prog);
 
 void ast_expr_print(ASTExpr *expr);
@@ -272,12 +350,4 @@ const char *stmt_type_name(StmtType type);
 const char *expr_type_name(ExprType type);
 const char *op_type_name(OpType type);
 
-/* CASE statement helper structure (internal use)*/
-typedef struct
-{
-    ASTExpr *value;  /* Value to match */
-    ASTStmt **stmts; /* Statements in this branch */
-    int stmt_count;
-} CaseBranch;
-
 #endif /* AST_H */
@@ -0,0 +1,89 @@
+#ifndef BASICPP_H
+#define BASICPP_H
+
+#include <stddef.h>
+
+/*
+ * libbasicpp: the Basic++ interpreter as an embeddable library
+ *
+ * A Basicpp instance holds one loaded program and its console callbacks.
+ * Every basicpp_run starts from a fresh runtime, as RUN does in the REPL.
+ * Instances share no state, so different threads may each drive their own
+ * instance at the same time; a single instance is used by one thread at a
+ * time, except for basicpp_interrupt.
+ *
+ * Still process-wide: INKEY$ (which polls the terminal), the CLI's
+ * --max-time and --max-memory limits, and running out of memory, which
+ * ends the process as in the CLI.
+ */
+
+typedef struct Basicpp Basicpp;
+
+/* A compiled program that several instances can run at once */
+typedef struct BasicppProgram BasicppProgram;
+
+/* Console of an instance. write gets program output (not NUL-terminated);
+ * read_line fills buf with one line of input without its newline and
+ * returns the length, or -1 at end of input; error gets reports such as
+ * "?Division by zero IN 12\n". NULL write discards output, NULL read_line
+ * reads as end of input, NULL error writes to stderr. */
+typedef struct
+{
+    void (*write)(void *user, const char *text, size_t len);
+    int (*read_line)(void *user, char *buf, int size);
+    void (*error)(void *user, const char *text);
+    void *user;
+} BasicppIO;
+
+typedef enum
+{
+    BASICPP_OK = 0,
+    BASICPP_ERROR,       /* The program did not load, or stopped on an error */
+    BASICPP_INTERRUPTED, /* basicpp_interrupt stopped the run */
+    BASICPP_LIMIT        /* The statement budget ran out */
+} BasicppStatus;
+
+/* io is copied; NULL uses stdin, stdout and stderr */
+Basicpp *basicpp_create(const BasicppIO *io);
+void basicpp_free(Basicpp *bp);
+
+/* Parse, optimize and resolve a program, replacing the loaded one. The
+ * source is in the format of a .bas file: optional leading line numbers
+ * are dropped, blank lines and lines starting with ! are skipped. */
+BasicppStatus basicpp_load(Basicpp *bp, const char *source);
+BasicppStatus basicpp_load_file(Basicpp *bp, const char *path);
+
+/* Compile a program without an instance, NULL with the reason in error on
+ * failure. The source format is that of basicpp_load. */
+BasicppProgram *basicpp_compile(const char *source, char *error, size_t error_size);
+BasicppProgram *basicpp_compile_file(const char *path, char *error, size_t error_size);
+void basicpp_program_free(BasicppProgram *prog);
+
+/* Whether instances on different threads may run prog at the same time:
+ * a program that MERGEs rewrites itself, so each run needs its own copy */
+int basicpp_program_shareable(const BasicppProgram *prog);
+
+/* Run prog in place of a loaded program; it is borrowed and must outlive
+ * the instance's use of it */
+void basicpp_use(Basicpp *bp, BasicppProgram *prog);
+
+/* Directory relative file names in OPEN, MERGE and friends resolve
+ * against, NULL (the default) for the current directory */
+void basicpp_set_directory(Basicpp *bp, const char *dir);
+
+/* Run the loaded program to completion on the calling thread */
+BasicppStatus basicpp_run(Basicpp *bp);
+
+/* Statements a run may execute, 0 (the default) for no limit */
+void basicpp_set_max_statements(Basicpp *bp, unsigned long long limit);
+
+/* Stop the current run as Ctrl-C does; safe from any thread */
+void basicpp_interrupt(Basicpp *bp);
+
+/* Why the last load or run failed ("" if it did not) */
+const char *basicpp_error(const Basicpp *bp);
+
+/* Statements executed by the last run */
+unsigned long long basicpp_statements(const Basicpp *bp);
+
+#endif /* BASICPP_H */
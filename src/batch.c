@@ -0,0 +1,494 @@
+#include "batch.h"
+#include "basicpp.h"
+#include "bpc.h"
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+/* One distinct program text; jobs that list the same source share it */
+typedef struct
+{
+    char *text;
+    uint64_t hash;
+    pthread_mutex_t lock; /* Held by the job compiling it */
+    int compiled;
+    BasicppProgram *program; /* NULL if it did not compile */
+    char error[256];
+} BatchSource;
+
+typedef struct
+{
+    char *data;
+    size_t len;
+    size_t cap;
+} BatchBuffer;
+
+typedef struct
+{
+    char *path;
+    char *output_path; /* NULL for stdout */
+    char *directory;
+    BatchSource *source; /* NULL if the file could not be read */
+    char error[256];     /* Why source is NULL */
+
+    Basicpp *bp;
+    unsigned long long max_output;
+    int output_exceeded;
+    BatchBuffer out;
+    BatchBuffer err;
+    int failed;
+    int done; /* Under Batch.lock */
+} BatchJob;
+
+typedef struct
+{
+    BatchJob *jobs;
+    int num_jobs;
+    const ExecLimits *limits;
+
+    pthread_mutex_t lock;
+    pthread_cond_t job_done;
+    int next_job;
+} Batch;
+
+static void buffer_append(BatchBuffer *buf, const char *text, size_t len)
+{
+    if (buf->len + len + 1 > buf->cap)
+    {
+        size_t cap = buf->cap ? buf->cap : 256;
+        while (buf->len + len + 1 > cap)
+        {
+            cap *= 2;
+        }
+        buf->data = xrealloc(buf->data, cap);
+        buf->cap = cap;
+    }
+    memcpy(buf->data + buf->len, text, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+}
+
+/* Error lines carry the program name, since jobs share stderr */
+static void job_report(BatchJob *job, const char *text)
+{
+    buffer_append(&job->err, job->path, strlen(job->path));
+    buffer_append(&job->err, ": ", 2);
+    buffer_append(&job->err, text, strlen(text));
+    if (*text == '\0' || text[strlen(text) - 1] != '\n')
+    {
+        buffer_append(&job->err, "\n", 1);
+    }
+}
+
+static void job_write(void *user, const char *text, size_t len)
+{
+    BatchJob *job = user;
+    if (job->output_exceeded)
+    {
+        return;
+    }
+    if (job->max_output != 0 && job->out.len + len > job->max_output)
+    {
+        buffer_append(&job->out, text, (size_t)(job->max_output - job->out.len));
+        job->output_exceeded = 1;
+        basicpp_interrupt(job->bp);
+        return;
+    }
+    buffer_append(&job->out, text, len);
+}
+
+static void job_error(void *user, const char *text)
+{
+    job_report(user, text);
+}
+
+static char *read_file(const char *path, char *error, size_t error_size)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        snprintf(error, error_size, "Cannot open %s: %s", path, strerror(errno));
+        return NULL;
+    }
+
+    size_t cap = 4096;
+    size_t len = 0;
+    char *text = xmalloc(cap);
+    size_t got;
+    while ((got = fread(text + len, 1, cap - len - 1, fp)) > 0)
+    {
+        len += got;
+        if (len == cap - 1)
+        {
+            cap *= 2;
+            text = xrealloc(text, cap);
+        }
+    }
+    text[len] = '\0';
+    fclose(fp);
+    return text;
+}
+
+/* The first job to need a source compiles it; the others wait for it */
+static BasicppProgram *source_program(BatchSource *src)
+{
+    pthread_mutex_lock(&src->lock);
+    if (!src->compiled)
+    {
+        src->program = basicpp_compile(src->text, src->error, sizeof(src->error));
+        src->compiled = 1;
+    }
+    pthread_mutex_unlock(&src->lock);
+    return src->program;
+}
+
+static void run_job(Batch *batch, BatchJob *job)
+{
+    if (job->source == NULL)
+    {
+        job_report(job, job->error);
+        job->failed = 1;
+        return;
+    }
+
+    BasicppProgram *program = source_program(job->source);
+    if (program == NULL)
+    {
+        job_report(job, job->source->error);
+        job->failed = 1;
+        return;
+    }
+
+    BasicppIO io = {job_write, NULL, job_error, job};
+    job->bp = basicpp_create(&io);
+    job->max_output = batch->limits->output;
+    basicpp_set_directory(job->bp, job->directory);
+    basicpp_set_max_statements(job->bp, batch->limits->statements);
+
+    /* MERGE edits the program it runs in, so such a job gets its own copy */
+    BasicppStatus status = BASICPP_OK;
+    if (basicpp_program_shareable(program))
+    {
+        basicpp_use(job->bp, program);
+    }
+    else
+    {
+        status = basicpp_load(job->bp, job->source->text);
+    }
+    if (status == BASICPP_OK)
+    {
+        status = basicpp_run(job->bp);
+    }
+
+    if (job->output_exceeded)
+    {
+        char message[96];
+        snprintf(message, sizeof(message), "Output limit exceeded (%llu bytes)", job->max_output);
+        job_report(job, message);
+    }
+    else if (status == BASICPP_LIMIT || (status == BASICPP_ERROR && job->err.len == 0))
+    {
+        job_report(job, basicpp_error(job->bp));
+    }
+    job->failed = status != BASICPP_OK;
+    basicpp_free(job->bp);
+    job->bp = NULL;
+
+    if (job->output_path)
+    {
+        FILE *fp = fopen(job->output_path, "wb");
+        if (fp == NULL || fwrite(job->out.data ? job->out.data : "", 1, job->out.len, fp) != job->out.len)
+        {
+            char message[PATH_MAX + 64];
+            snprintf(message, sizeof(message), "Cannot write %s: %s", job->output_path, strerror(errno));
+            job_report(job, message);
+            job->failed = 1;
+        }
+        if (fp && fclose(fp) != 0 && !job->failed)
+        {
+            job_report(job, "Cannot write output file");
+            job->failed = 1;
+        }
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    Batch *batch = arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&batch->lock);
+        int index = batch->next_job++;
+        pthread_mutex_unlock(&batch->lock);
+        if (index >= batch->num_jobs)
+        {
+            return NULL;
+        }
+
+        run_job(batch, &batch->jobs[index]);
+
+        pthread_mutex_lock(&batch->lock);
+        batch->jobs[index].done = 1;
+        pthread_cond_broadcast(&batch->job_done);
+        pthread_mutex_unlock(&batch->lock);
+    }
+}
+
+/* A relative program name is looked up under BASIC_CWD, as on the command
+ * line; its directory is the job's working directory */
+static void resolve_job_path(BatchJob *job, const char *name)
+{
+    const char *basic_cwd = getenv("BASIC_CWD");
+    if (name[0] != '/' && basic_cwd && *basic_cwd)
+    {
+        size_t size = strlen(basic_cwd) + strlen(name) + 2;
+        job->path = xmalloc(size);
+        snprintf(job->path, size, "%s/%s", basic_cwd, name);
+    }
+    else
+    {
+        job->path = xstrdup(name);
+    }
+
+    const char *last_slash = strrchr(job->path, '/');
+    if (last_slash == NULL)
+    {
+        job->directory = xstrdup(".");
+    }
+    else if (last_slash == job->path)
+    {
+        job->directory = xstrdup("/");
+    }
+    else
+    {
+        size_t len = (size_t)(last_slash - job->path);
+        job->directory = xmalloc(len + 1);
+        memcpy(job->directory, job->path, len);
+        job->directory[len] = '\0';
+    }
+}
+
+static int parse_jobs(const char *jobs_path, BatchJob **jobs_out, int *count_out)
+{
+    FILE *fp = fopen(jobs_path, "r");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Cannot open %s: %s\n", jobs_path, strerror(errno));
+        return -1;
+    }
+
+    BatchJob *jobs = NULL;
+    int count = 0;
+    int cap = 0;
+    char line[2 * PATH_MAX];
+    int line_number = 0;
+    int result = 0;
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        line_number++;
+        char *fields[3] = {NULL, NULL, NULL};
+        int num_fields = 0;
+        char *p = line;
+        while (*p && num_fields < 3)
+        {
+            while (isspace((unsigned char)*p))
+            {
+                p++;
+            }
+            if (*p == '\0' || (num_fields == 0 && *p == '#'))
+            {
+                break;
+            }
+            fields[num_fields++] = p;
+            while (*p && !isspace((unsigned char)*p))
+            {
+                p++;
+            }
+            if (*p)
+            {
+                *p++ = '\0';
+            }
+        }
+        if (num_fields == 0)
+        {
+            continue;
+        }
+        if (num_fields > 2)
+        {
+            fprintf(stderr, "%s:%d: expected a program and an optional output file\n", jobs_path, line_number);
+            result = -1;
+            continue;
+        }
+
+        if (count >= cap)
+        {
+            cap = cap ? cap * 2 : 16;
+            jobs = xrealloc(jobs, (size_t)cap * sizeof(BatchJob));
+        }
+        BatchJob *job = &jobs[count++];
+        memset(job, 0, sizeof(*job));
+        resolve_job_path(job, fields[0]);
+        job->output_path = fields[1] ? xstrdup(fields[1]) : NULL;
+    }
+    fclose(fp);
+
+    *jobs_out = jobs;
+    *count_out = count;
+    return result;
+}
+
+/* Read each job's program, sharing one BatchSource per distinct text */
+static BatchSource **load_sources(BatchJob *jobs, int num_jobs, int *num_sources)
+{
+    BatchSource **sources = xcalloc((size_t)num_jobs, sizeof(BatchSource *));
+    int count = 0;
+    for (int i = 0; i < num_jobs; i++)
+    {
+        char *text = read_file(jobs[i].path, jobs[i].error, sizeof(jobs[i].error));
+        if (text == NULL)
+        {
+            continue;
+        }
+
+        uint64_t hash = bpc_hash(text, strlen(text));
+        for (int j = 0; j < count; j++)
+        {
+            if (sources[j]->hash == hash && strcmp(sources[j]->text, text) == 0)
+            {
+                jobs[i].source = sources[j];
+                break;
+            }
+        }
+        if (jobs[i].source != NULL)
+        {
+            free(text);
+            continue;
+        }
+
+        BatchSource *src = xcalloc(1, sizeof(BatchSource));
+        src->text = text;
+        src->hash = hash;
+        pthread_mutex_init(&src->lock, NULL);
+        sources[count++] = src;
+        jobs[i].source = src;
+    }
+    *num_sources = count;
+    return sources;
+}
+
+static double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int batch_run(const char *jobs_path, int workers, const ExecLimits *limits)
+{
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    Batch batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.limits = limits;
+    if (parse_jobs(jobs_path, &batch.jobs, &batch.num_jobs) != 0)
+    {
+        for (int i = 0; i < batch.num_jobs; i++)
+        {
+            free(batch.jobs[i].path);
+            free(batch.jobs[i].output_path);
+            free(batch.jobs[i].directory);
+        }
+        free(batch.jobs);
+        return 1;
+    }
+    if (batch.num_jobs == 0)
+    {
+        fprintf(stderr, "Batch: no jobs in %s\n", jobs_path);
+        return 0;
+    }
+
+    int num_sources = 0;
+    BatchSource **sources = load_sources(batch.jobs, batch.num_jobs, &num_sources);
+
+    if (workers <= 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? (int)cpus : 1;
+    }
+    if (workers > batch.num_jobs)
+    {
+        workers = batch.num_jobs;
+    }
+
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.job_done, NULL);
+    pthread_t *threads = xcalloc((size_t)workers, sizeof(pthread_t));
+    int started = 0;
+    for (int i = 0; i < workers; i++)
+    {
+        if (pthread_create(&threads[started], NULL, worker_main, &batch) == 0)
+        {
+            started++;
+        }
+    }
+    if (started == 0)
+    {
+        error_exit(ERR_OUT_OF_MEMORY, "Cannot start batch worker threads");
+    }
+
+    /* Report jobs in order as they finish, so the output does not depend on
+     * which worker ran what */
+    int failed = 0;
+    for (int i = 0; i < batch.num_jobs; i++)
+    {
+        BatchJob *job = &batch.jobs[i];
+        pthread_mutex_lock(&batch.lock);
+        while (!job->done)
+        {
+            pthread_cond_wait(&batch.job_done, &batch.lock);
+        }
+        pthread_mutex_unlock(&batch.lock);
+
+        if (job->output_path == NULL && job->out.len > 0)
+        {
+            fwrite(job->out.data, 1, job->out.len, stdout);
+            fflush(stdout);
+        }
+        if (job->err.len > 0)
+        {
+            fputs(job->err.data, stderr);
+        }
+        failed += job->failed;
+
+        free(job->out.data);
+        free(job->err.data);
+        free(job->path);
+        free(job->output_path);
+        free(job->directory);
+    }
+
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    pthread_cond_destroy(&batch.job_done);
+    pthread_mutex_destroy(&batch.lock);
+
+    for (int i = 0; i < num_sources; i++)
+    {
+        basicpp_program_free(sources[i]->program);
+        pthread_mutex_destroy(&sources[i]->lock);
+        free(sources[i]->text);
+        free(sources[i]);
+    }
+    free(sources);
+    free(batch.jobs);
+
+    fprintf(stderr, "Batch: %d jobs, %d programs, %d failed, %.2f s (-j %d)\n", batch.num_jobs, num_sources, failed,
+            elapsed_seconds(&start), started);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,26 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "common.h"
+
+/*
+ * Batch runner (--batch)
+ *
+ * Runs every program listed in a jobs file on a pool of worker threads,
+ * each job in its own interpreter instance with relative file names
+ * resolved against the program's directory. A job line is
+ *
+ *     program.bas [output-file]
+ *
+ * Blank lines and lines starting with # are skipped. A job's output goes
+ * to its output file, or to stdout in job order; its errors go to stderr
+ * prefixed with the program name. Programs with the same source are
+ * compiled once and shared between the jobs that run them.
+ */
+
+/* workers <= 0 uses one per online CPU. limits->statements and
+ * limits->output apply to each job. Returns 0 if every job ran to
+ * completion, 1 otherwise. */
+int batch_run(const char *jobs_path, int workers, const ExecLimits *limits);
+
+#endif /* BATCH_H */
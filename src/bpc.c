@@ -0,0 +1,516 @@
+#include "bpc.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * File layout (all integers little-endian):
+ *
+ *   "BPC\0"  u32 version  u32 strict  u32 reserved
+ *   u64 source hash  u64 source length  u64 payload length  u64 payload hash
+ *   payload: line count, then per line
+ *            line_number  src_line  src_column  <stmt>
+ *
+ * Payload integers are LEB128 varints (zigzag for signed values), which
+ * keeps the mostly-small AST fields to a byte each. Nodes are written
+ * depth-first with a presence byte in front, strings as varint length+1
+ * (0 for NULL) followed by the bytes, and doubles as a 0 byte for zero or
+ * a 1 byte and the IEEE bit pattern. Nothing in the file depends on where
+ * it is mapped.
+ */
+
+#define BPC_MAGIC "BPC"
+#define BPC_VERSION 7
+#define BPC_HEADER_SIZE 48
+
+uint64_t bpc_hash(const char *text, size_t len)
+{
+    /* FNV-1a */
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)text[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+char *bpc_cache_path(const char *source_path, const char *cache_dir, uint64_t hash)
+{
+    size_t size;
+    char *path;
+    if (cache_dir && *cache_dir)
+    {
+        size = strlen(cache_dir) + 1 + 16 + 5;
+        path = xmalloc(size);
+        snprintf(path, size, "%s/%016llx.bpc", cache_dir, (unsigned long long)hash);
+    }
+    else
+    {
+        size = strlen(source_path) + 5;
+        path = xmalloc(size);
+        snprintf(path, size, "%s.bpc", source_path);
+    }
+    return path;
+}
+
+/* ---------- Writing ---------- */
+
+typedef struct
+{
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+} WriteBuf;
+
+static void put_bytes(WriteBuf *b, const void *src, size_t n)
+{
+    if (b->len + n > b->cap)
+    {
+        while (b->len + n > b->cap)
+            b->cap = b->cap ? b->cap * 2 : 4096;
+        b->data = xrealloc(b->data, b->cap);
+    }
+    memcpy(b->data + b->len, src, n);
+    b->len += n;
+}
+
+static void put_u8(WriteBuf *b, unsigned v)
+{
+    unsigned char c = (unsigned char)v;
+    put_bytes(b, &c, 1);
+}
+
+static void put_u32(WriteBuf *b, uint32_t v)
+{
+    unsigned char c[4];
+    for (int i = 0; i < 4; i++)
+        c[i] = (unsigned char)(v >> (8 * i));
+    put_bytes(b, c, 4);
+}
+
+static void put_u64(WriteBuf *b, uint64_t v)
+{
+    unsigned char c[8];
+    for (int i = 0; i < 8; i++)
+        c[i] = (unsigned char)(v >> (8 * i));
+    put_bytes(b, c, 8);
+}
+
+static void put_uv(WriteBuf *b, uint64_t v)
+{
+    unsigned char c[10];
+    int n = 0;
+    do
+    {
+        c[n] = (unsigned char)(v & 0x7f);
+        v >>= 7;
+        if (v)
+            c[n] |= 0x80;
+        n++;
+    } while (v);
+    put_bytes(b, c, (size_t)n);
+}
+
+static void put_i32(WriteBuf *b, int v)
+{
+    /* zigzag so small negative values stay short */
+    uint32_t u = (uint32_t)v;
+    put_uv(b, (uint32_t)((u << 1) ^ (v < 0 ? 0xffffffffu : 0u)));
+}
+
+static void put_f64(WriteBuf *b, double v)
+{
+    if (v == 0.0 && !signbit(v))
+    {
+        put_u8(b, 0);
+        return;
+    }
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    put_u8(b, 1);
+    put_u64(b, bits);
+}
+
+static void put_str(WriteBuf *b, const char *s)
+{
+    if (s == NULL)
+    {
+        put_uv(b, 0);
+        return;
+    }
+    size_t len = strlen(s);
+    put_uv(b, (uint64_t)len + 1);
+    put_bytes(b, s, len);
+}
+
+static void put_params(WriteBuf *b, const ASTParameterList *list)
+{
+    put_u8(b, list != NULL);
+    if (list == NULL)
+        return;
+    put_uv(b, (uint64_t)list->num_params);
+    for (int i = 0; i < list->num_params; i++)
+    {
+        put_str(b, list->params[i]->name);
+        put_i32(b, (int)list->params[i]->type);
+    }
+}
+
+static void put_expr(WriteBuf *b, const ASTExpr *e)
+{
+    put_u8(b, e != NULL);
+    if (e == NULL)
+        return;
+    put_i32(b, (int)e->type);
+    put_i32(b, e->line_number);
+    put_i32(b, e->column_number);
+    put_i32(b, (int)e->inferred_type);
+    put_i32(b, (int)e->op);
+    put_f64(b, e->num_value);
+    put_str(b, e->str_value);
+    put_str(b, e->var_name);
+    put_str(b, e->member_name);
+    put_uv(b, (uint64_t)e->num_children);
+    for (int i = 0; i < e->num_children; i++)
+        put_expr(b, e->children[i]);
+    put_expr(b, e->member_obj);
+}
+
+static void put_stmt(WriteBuf *b, const ASTStmt *s)
+{
+    put_u8(b, s != NULL);
+    if (s == NULL)
+        return;
+    put_i32(b, (int)s->type);
+    put_i32(b, s->line_number);
+    put_i32(b, s->target_line);
+    put_i32(b, s->file_handle);
+    put_i32(b, s->mode);
+    put_i32(b, s->is_loop_end);
+    put_i32(b, s->data.condition_type);
+    put_str(b, s->comment);
+    put_str(b, s->var_name);
+    put_uv(b, (uint64_t)s->num_exprs);
+    for (int i = 0; i < s->num_exprs; i++)
+        put_expr(b, s->exprs[i]);
+    put_uv(b, (uint64_t)s->num_call_args);
+    for (int i = 0; i < s->num_call_args; i++)
+        put_expr(b, s->call_args[i]);
+    put_params(b, s->parameters);
+    put_params(b, s->members);
+    put_uv(b, (uint64_t)s->num_methods);
+    for (int i = 0; i < s->num_methods; i++)
+        put_str(b, s->method_names[i]);
+    put_stmt(b, s->body);
+    put_stmt(b, s->else_body);
+    put_stmt(b, s->next);
+}
+
+int bpc_save(const char *path, const Program *prog, uint64_t hash, size_t text_len, int strict)
+{
+    WriteBuf payload = {NULL, 0, 0};
+    put_uv(&payload, (uint64_t)prog->num_lines);
+    for (int i = 0; i < prog->num_lines; i++)
+    {
+        const ProgramLine *line = prog->lines[i];
+        put_i32(&payload, line->line_number);
+        put_i32(&payload, line->src_line);
+        put_i32(&payload, line->src_column);
+        put_stmt(&payload, line->stmt);
+    }
+
+    WriteBuf header = {NULL, 0, 0};
+    put_bytes(&header, BPC_MAGIC, 4);
+    put_u32(&header, BPC_VERSION);
+    put_u32(&header, (uint32_t)(strict != 0));
+    put_u32(&header, 0);
+    put_u64(&header, hash);
+    put_u64(&header, (uint64_t)text_len);
+    put_u64(&header, (uint64_t)payload.len);
+    put_u64(&header, bpc_hash((const char *)payload.data, payload.len));
+
+    /* Write to a private temp file and rename it into place, so concurrent
+     * starts never see a half-written cache */
+    size_t tmp_size = strlen(path) + 32;
+    char *tmp = xmalloc(tmp_size);
+    snprintf(tmp, tmp_size, "%s.%ld.tmp", path, (long)getpid());
+
+    int ok = 0;
+    FILE *fp = fopen(tmp, "wb");
+    if (fp)
+    {
+        ok = fwrite(header.data, 1, header.len, fp) == header.len &&
+             fwrite(payload.data, 1, payload.len, fp) == payload.len;
+        ok = (fclose(fp) == 0) && ok;
+        if (ok)
+            ok = rename(tmp, path) == 0;
+        if (!ok)
+            remove(tmp);
+    }
+
+    free(tmp);
+    free(header.data);
+    free(payload.data);
+    return ok ? 0 : -1;
+}
+
+/* ---------- Reading ---------- */
+
+typedef struct
+{
+    const unsigned char *p;
+    const unsigned char *end;
+    int bad;
+} ReadBuf;
+
+static int need(ReadBuf *r, size_t n)
+{
+    if (r->bad || (size_t)(r->end - r->p) < n)
+    {
+        r->bad = 1;
+        return 0;
+    }
+    return 1;
+}
+
+static unsigned get_u8(ReadBuf *r)
+{
+    if (!need(r, 1))
+        return 0;
+    return *r->p++;
+}
+
+static uint32_t get_u32(ReadBuf *r)
+{
+    if (!need(r, 4))
+        return 0;
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++)
+        v |= (uint32_t)r->p[i] << (8 * i);
+    r->p += 4;
+    return v;
+}
+
+static uint64_t get_u64(ReadBuf *r)
+{
+    if (!need(r, 8))
+        return 0;
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++)
+        v |= (uint64_t)r->p[i] << (8 * i);
+    r->p += 8;
+    return v;
+}
+
+static uint64_t get_uv(ReadBuf *r)
+{
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        unsigned c = get_u8(r);
+        v |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return v;
+    }
+    r->bad = 1;
+    return 0;
+}
+
+static int get_i32(ReadBuf *r)
+{
+    uint64_t z = get_uv(r);
+    if (z > 0xffffffffu)
+        r->bad = 1;
+    uint32_t u = (uint32_t)((z >> 1) ^ (0u - (uint32_t)(z & 1)));
+    return (int)u;
+}
+
+static double get_f64(ReadBuf *r)
+{
+    if (!get_u8(r))
+        return 0.0;
+    uint64_t bits = get_u64(r);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static char *get_str(ReadBuf *r)
+{
+    uint64_t n = get_uv(r);
+    if (n == 0 || !need(r, n - 1))
+        return NULL;
+    char *s = xmalloc((size_t)n);
+    memcpy(s, r->p, (size_t)(n - 1));
+    s[n - 1] = '\0';
+    r->p += n - 1;
+    return s;
+}
+
+/* Element count; every element takes at least one byte, so anything larger
+ * than what is left can only come from a corrupt file */
+static int get_count(ReadBuf *r)
+{
+    uint64_t n = get_uv(r);
+    if (n > (uint64_t)(r->end - r->p) || n > INT32_MAX)
+    {
+        r->bad = 1;
+        return 0;
+    }
+    return (int)n;
+}
+
+static ASTParameterList *get_params(ReadBuf *r)
+{
+    if (!get_u8(r))
+        return NULL;
+    ASTParameterList *list = ast_parameter_list_create();
+    int n = get_count(r);
+    for (int i = 0; i < n && !r->bad; i++)
+    {
+        char *name = get_str(r);
+        VarType type = (VarType)get_i32(r);
+        ast_parameter_list_add(list, name ? name : "", type);
+        free(name);
+    }
+    return list;
+}
+
+static ASTExpr *get_expr(ReadBuf *r)
+{
+    if (!get_u8(r) || r->bad)
+        return NULL;
+    ASTExpr *e = ast_expr_create((ExprType)get_i32(r));
+    e->line_number = get_i32(r);
+    e->column_number = get_i32(r);
+    e->inferred_type = (VarType)get_i32(r);
+    e->op = (OpType)get_i32(r);
+    e->num_value = get_f64(r);
+    e->str_value = get_str(r);
+    e->var_name = get_str(r);
+    e->member_name = get_str(r);
+    int n = get_count(r);
+    if (n > 0)
+    {
+        e->children = xcalloc((size_t)n, sizeof(ASTExpr *));
+        e->capacity_children = n;
+        for (int i = 0; i < n && !r->bad; i++)
+            e->children[e->num_children++] = get_expr(r);
+    }
+    e->member_obj = get_expr(r);
+    return e;
+}
+
+static ASTStmt *get_stmt(ReadBuf *r)
+{
+    if (!get_u8(r) || r->bad)
+        return NULL;
+    ASTStmt *s = ast_stmt_create((StmtType)get_i32(r));
+    s->line_number = get_i32(r);
+    s->target_line = get_i32(r);
+    s->file_handle = get_i32(r);
+    s->mode = get_i32(r);
+    s->is_loop_end = get_i32(r);
+    s->data.condition_type = get_i32(r);
+    s->comment = get_str(r);
+    s->var_name = get_str(r);
+
+    int n = get_count(r);
+    if (n > 0)
+    {
+        s->exprs = xcalloc((size_t)n, sizeof(ASTExpr *));
+        s->capacity_exprs = n;
+        for (int i = 0; i < n && !r->bad; i++)
+            s->exprs[s->num_exprs++] = get_expr(r);
+    }
+
+    n = get_count(r);
+    if (n > 0)
+    {
+        s->call_args = xcalloc((size_t)n, sizeof(ASTExpr *));
+        s->capacity_call_args = n;
+        for (int i = 0; i < n && !r->bad; i++)
+            s->call_args[s->num_call_args++] = get_expr(r);
+    }
+
+    s->parameters = get_params(r);
+    s->members = get_params(r);
+
+    n = get_count(r);
+    if (n > 0)
+    {
+        s->method_names = xcalloc((size_t)n, sizeof(char *));
+        s->capacity_methods = n;
+        for (int i = 0; i < n && !r->bad; i++)
+            s->method_names[s->num_methods++] = get_str(r);
+    }
+
+    s->body = get_stmt(r);
+    s->else_body = get_stmt(r);
+    s->next = get_stmt(r);
+    return s;
+}
+
+static Program *decode(const unsigned char *data, size_t size, uint64_t hash, size_t text_len, int strict)
+{
+    ReadBuf r = {data, data + size, 0};
+
+    if (!need(&r, BPC_HEADER_SIZE) || memcmp(r.p, BPC_MAGIC, 4) != 0)
+        return NULL;
+    r.p += 4;
+    if (get_u32(&r) != BPC_VERSION || get_u32(&r) != (uint32_t)(strict != 0))
+        return NULL;
+    get_u32(&r);
+    if (get_u64(&r) != hash || get_u64(&r) != (uint64_t)text_len)
+        return NULL;
+    uint64_t payload_len = get_u64(&r);
+    uint64_t payload_hash = get_u64(&r);
+    if (payload_len != (uint64_t)(r.end - r.p) ||
+        bpc_hash((const char *)r.p, (size_t)payload_len) != payload_hash)
+        return NULL;
+
+    Program *prog = ast_program_create();
+    int n = get_count(&r);
+    for (int i = 0; i < n && !r.bad; i++)
+    {
+        int line_number = get_i32(&r);
+        int src_line = get_i32(&r);
+        int src_column = get_i32(&r);
+        ProgramLine *line = ast_program_line_create(line_number, get_stmt(&r));
+        line->src_line = src_line;
+        line->src_column = src_column;
+        ast_program_add_line(prog, line);
+    }
+
+    if (r.bad || r.p != r.end)
+    {
+        ast_program_free(prog);
+        return NULL;
+    }
+    return prog;
+}
+
+Program *bpc_load(const char *path, uint64_t hash, size_t text_len, int strict)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    Program *prog = NULL;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= BPC_HEADER_SIZE)
+    {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            prog = decode(map, (size_t)st.st_size, hash, text_len, strict);
+            munmap(map, (size_t)st.st_size);
+        }
+    }
+
+    close(fd);
+    return prog;
+}
@@ -0,0 +1,27 @@
+#ifndef BPC_H
+#define BPC_H
+
+#include "common.h"
+#include "ast.h"
+
+/*
+ * Precompiled program cache (.bpc)
+ *
+ * A parsed Program serialized to a flat, pointer-free byte stream, keyed
+ * by a hash of the program text it was parsed from. Loading a valid cache
+ * file rebuilds the AST directly and skips lexing and parsing.
+ */
+
+uint64_t bpc_hash(const char *text, size_t len);
+
+/* Cache file for a source: DIR/<hash>.bpc when cache_dir is set, otherwise
+ * SOURCE.bpc next to the source. Caller frees. */
+char *bpc_cache_path(const char *source_path, const char *cache_dir, uint64_t hash);
+
+/* NULL if the file is missing, stale, or corrupt */
+Program *bpc_load(const char *path, uint64_t hash, size_t text_len, int strict);
+
+/* Write atomically (temp file + rename); 0 on success */
+int bpc_save(const char *path, const Program *prog, uint64_t hash, size_t text_len, int strict);
+
+#endif /* BPC_H */
@@ -1,5 +1,6 @@
 #include "builtins.h"
 #include "eval.h"
+#include "errors.h"
 #include <math.h>
 #include <string.h>
 #include <ctype.h>
@@ -304,6 +305,22 @@ double call_numeric_function(RuntimeState *state, const char *func_name,
         }
         return 0.0;
     }
+    else if (strcmp(func_name, "HASKEY") == 0)
+    {
+        /* HASKEY(map, key$): -1 if the map holds the key, else 0 */
+        ASTExpr *map = num_args > 0 ? args[0] : NULL;
+        char *key = num_args > 1 ? eval_map_key(state, args[1]) : NULL;
+        if (map == NULL || map->type != EXPR_VAR || key == NULL ||
+            !runtime_is_map(state, map->slot, map->var_name))
+        {
+            free(key);
+            runtime_set_error(state, BASIC_ERR_TYPE_MISMATCH, map ? map->line_number : 0);
+            return 0.0;
+        }
+        int found = runtime_map_has_key(state, map->slot, map->var_name, key);
+        free(key);
+        return found ? -1.0 : 0.0;
+    }
     else if (strcmp(func_name, "GETA") == 0)
     {
         return (double)runtime_get_reg_a(state);
@@ -342,8 +359,8 @@ double call_numeric_function(RuntimeState *state, const char *func_name,
     }
     else if (strcmp(func_name, "FRE") == 0)
     {
-        /* Free memory - return a large value */
-        return 65000.0;
+        /* Free memory: MEMORY SIZE less what variables, arrays and strings hold */
+        return runtime_get_free_memory(state);
     }
     else if (strcmp(func_name, "POS") == 0)
     {
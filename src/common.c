@@ -1,5 +1,23 @@
 #include "common.h"
 #include <stdarg.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static ExecLimits g_limits;                /* All zero: unlimited */
+static unsigned long long g_output_bytes; /* Console output counted so far */
+static char g_time_message[96];           /* The watchdog can only write() */
+static size_t g_time_message_len;
+
+/* A failed or oversized allocation under --max-memory is the limit, not an
+ * out-of-memory error in the interpreter */
+static void check_memory_limit(size_t size, int failed)
+{
+    if (g_limits.memory != 0 && (failed || size > g_limits.memory))
+    {
+        limit_exceeded(LIMIT_MEMORY);
+    }
+}
 
 /*
  * Memory allocation wrappers with error checking
@@ -11,9 +29,11 @@ void *xmalloc(size_t size)
     {
         error_exit(ERR_OUT_OF_MEMORY, "xmalloc: attempted zero-size allocation");
     }
+    check_memory_limit(size, 0);
     void *ptr = malloc(size);
     if (ptr == NULL)
     {
+        check_memory_limit(size, 1);
         error_exit(ERR_OUT_OF_MEMORY, "xmalloc: out of memory (%zu bytes)", size);
     }
     return ptr;
@@ -25,9 +45,11 @@ void *xcalloc(size_t count, size_t size)
     {
         error_exit(ERR_OUT_OF_MEMORY, "xcalloc: attempted zero-size allocation");
     }
+    check_memory_limit(count > SIZE_MAX / size ? SIZE_MAX : count * size, 0);
     void *ptr = calloc(count, size);
     if (ptr == NULL)
     {
+        check_memory_limit(count * size, 1);
         error_exit(ERR_OUT_OF_MEMORY, "xcalloc: out of memory (%zu x %zu bytes)", count, size);
     }
     return ptr;
@@ -39,9 +61,11 @@ void *xrealloc(void *ptr, size_t size)
     {
         error_exit(ERR_OUT_OF_MEMORY, "xrealloc: attempted zero-size allocation");
     }
+    check_memory_limit(size, 0);
     void *new_ptr = realloc(ptr, size);
     if (new_ptr == NULL)
     {
+        check_memory_limit(size, 1);
         error_exit(ERR_OUT_OF_MEMORY, "xrealloc: out of memory (%zu bytes)", size);
     }
     return new_ptr;
@@ -59,6 +83,160 @@ char *xstrdup(const char *str)
     return copy;
 }
 
+/*
+ * Variable typing rules
+ */
+
+VarType var_type_from_name(const VarType letter_types[26], const char *name)
+{
+    if (name == NULL || name[0] == '\0')
+    {
+        return VAR_DOUBLE;
+    }
+
+    char last = name[strlen(name) - 1];
+    if (last == '$')
+        return VAR_STRING;
+    if (last == '%')
+        return VAR_INTEGER;
+    if (last == '!')
+        return VAR_SINGLE;
+    if (last == '#')
+        return VAR_DOUBLE;
+
+    char first = (char)toupper((unsigned char)name[0]);
+    if (letter_types && first >= 'A' && first <= 'Z')
+    {
+        return letter_types[first - 'A'];
+    }
+
+    return VAR_DOUBLE;
+}
+
+void var_type_set_range(VarType letter_types[26], VarType type, char start_letter, char end_letter)
+{
+    if (letter_types == NULL || start_letter > end_letter)
+    {
+        return;
+    }
+
+    for (char c = start_letter; c <= end_letter; c++)
+    {
+        if (c >= 'A' && c <= 'Z')
+        {
+            letter_types[c - 'A'] = type;
+        }
+    }
+}
+
+/*
+ * Execution limits
+ */
+
+static void watchdog_expired(int sig)
+{
+    (void)sig;
+    ssize_t written = write(STDERR_FILENO, g_time_message, g_time_message_len);
+    (void)written;
+    _exit(ERR_LIMIT_EXCEEDED);
+}
+
+int limits_set(const ExecLimits *limits)
+{
+    int result = 0;
+    g_limits = *limits;
+    g_output_bytes = 0;
+
+    /* RLIMIT_DATA makes malloc fail past the limit, which the allocation
+     * wrappers then report; the hard limit is left alone */
+    if (g_limits.memory != 0)
+    {
+        struct rlimit rl;
+        if (getrlimit(RLIMIT_DATA, &rl) == 0)
+        {
+            if (rl.rlim_max == RLIM_INFINITY || (rlim_t)g_limits.memory < rl.rlim_max)
+            {
+                rl.rlim_cur = (rlim_t)g_limits.memory;
+            }
+            else
+            {
+                rl.rlim_cur = rl.rlim_max;
+            }
+            if (setrlimit(RLIMIT_DATA, &rl) != 0)
+            {
+                result = -1;
+            }
+        }
+        else
+        {
+            result = -1;
+        }
+    }
+
+    /* A timer rather than polling, so SLEEP and blocking INPUT are covered */
+    if (g_limits.seconds > 0)
+    {
+        int len = snprintf(g_time_message, sizeof(g_time_message), "ERROR [%d]: Time limit exceeded (%g s)\n",
+                           ERR_LIMIT_EXCEEDED, g_limits.seconds);
+        g_time_message_len = (len > 0 && (size_t)len < sizeof(g_time_message)) ? (size_t)len : 0;
+
+        struct itimerval timer;
+        memset(&timer, 0, sizeof(timer));
+        timer.it_value.tv_sec = (time_t)g_limits.seconds;
+        timer.it_value.tv_usec = (suseconds_t)((g_limits.seconds - (double)timer.it_value.tv_sec) * 1e6);
+        if (timer.it_value.tv_sec == 0 && timer.it_value.tv_usec == 0)
+        {
+            timer.it_value.tv_usec = 1;
+        }
+        signal(SIGALRM, watchdog_expired);
+        if (setitimer(ITIMER_REAL, &timer, NULL) != 0)
+        {
+            result = -1;
+        }
+    }
+
+    return result;
+}
+
+const ExecLimits *limits_get(void)
+{
+    return &g_limits;
+}
+
+void limits_count_output(size_t bytes)
+{
+    if (g_limits.output == 0)
+    {
+        return;
+    }
+    g_output_bytes += bytes;
+    if (g_output_bytes > g_limits.output)
+    {
+        limit_exceeded(LIMIT_OUTPUT);
+    }
+}
+
+void limit_exceeded(LimitKind kind)
+{
+    fflush(stdout);
+    switch (kind)
+    {
+    case LIMIT_STATEMENTS:
+        error_exit(ERR_LIMIT_EXCEEDED, "Statement limit exceeded (%llu statements)", g_limits.statements);
+        break;
+    case LIMIT_TIME:
+        error_exit(ERR_LIMIT_EXCEEDED, "Time limit exceeded (%g s)", g_limits.seconds);
+        break;
+    case LIMIT_MEMORY:
+        error_exit(ERR_LIMIT_EXCEEDED, "Memory limit exceeded (%zu bytes)", g_limits.memory);
+        break;
+    case LIMIT_OUTPUT:
+        error_exit(ERR_LIMIT_EXCEEDED, "Output limit exceeded (%llu bytes)", g_limits.output);
+        break;
+    }
+    exit(ERR_LIMIT_EXCEEDED);
+}
+
 /*
  * Platform detection functions
  */
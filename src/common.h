@@ -33,7 +33,7 @@
 
 /* Configuration macros */
 #define MAX_STACK_DEPTH 1024
-#define MAX_FILES 32
+#define MAX_FILES 255 /* Default cap on open file channels */
 #define MAX_VARIABLES 10000
 #define MAX_ARRAYS 1000
 #define MAX_DIMENSIONS 10
@@ -54,6 +54,7 @@
 #define ERR_FILE_IO_ERROR 8
 #define ERR_STACK_OVERFLOW 9
 #define ERR_UNDEFINED_LINE 10
+#define ERR_LIMIT_EXCEEDED 11 /* Exit status when an execution limit stops a run */
 
 /* Forward declarations (actual definitions in their respective headers) */
 
@@ -68,12 +69,47 @@ typedef enum
     VAR_LONG
 } VarType;
 
+/* Variable typing rules (type suffix, else DEFxxx letter ranges), shared
+ * by the symbol table resolver and the runtime */
+VarType var_type_from_name(const VarType letter_types[26], const char *name);
+void var_type_set_range(VarType letter_types[26], VarType type, char start_letter, char end_letter);
+
 /* Memory allocation utilities (with error checking) */
 void *xmalloc(size_t size);
 void *xcalloc(size_t count, size_t size);
 void *xrealloc(void *ptr, size_t size);
 char *xstrdup(const char *str);
 
+/* Execution limits for untrusted programs (--max-statements, --max-time,
+ * --max-memory, --max-output); 0 leaves a resource unlimited */
+typedef struct
+{
+    unsigned long long statements; /* Statements executed */
+    double seconds;                /* Wall-clock time from limits_set */
+    size_t memory;                 /* Heap and data segment, in bytes */
+    unsigned long long output;     /* Bytes written to the console */
+} ExecLimits;
+
+typedef enum
+{
+    LIMIT_STATEMENTS,
+    LIMIT_TIME,
+    LIMIT_MEMORY,
+    LIMIT_OUTPUT
+} LimitKind;
+
+/* Install the limits process-wide: caps the data segment for the memory
+ * limit and starts the wall-clock watchdog. Returns 0, or -1 if the
+ * operating system refused a limit. */
+int limits_set(const ExecLimits *limits);
+const ExecLimits *limits_get(void);
+
+/* Count console output against the output limit */
+void limits_count_output(size_t bytes);
+
+/* Report the limit that was hit and exit with ERR_LIMIT_EXCEEDED */
+void limit_exceeded(LimitKind kind);
+
 /* Platform detection functions */
 const char *platform_name(void);
 const char *arch_name(void);
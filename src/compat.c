@@ -6,8 +6,8 @@
 #include <stdlib.h>
 #include <string.h>
 
-/* Global compatibility state */
-CompatState *g_compat_state = NULL;
+/* Compatibility state of the parser on this thread */
+_Thread_local CompatState *g_compat_state = NULL;
 
 /* TRS-80 Level II BASIC keywords (authentic set) */
 static const char *trs80_keywords[] = {
@@ -228,11 +228,11 @@ static void collect_dims(ASTStmt *stmt, const char **declared_arrays, int *decla
     /* Collect DIM statements */
     if (stmt->type == STMT_DIM)
     {
-        /* DIM has array expressions as children */
+        /* DIM has array expressions as children, and variables for maps */
         for (int i = 0; i < stmt->num_exprs; i++)
         {
             ASTExpr *expr = stmt->exprs[i];
-            if (expr && expr->type == EXPR_ARRAY && expr->var_name != NULL)
+            if (expr && (expr->type == EXPR_ARRAY || expr->type == EXPR_VAR) && expr->var_name != NULL)
             {
                 /* Check if already in list */
                 int found = 0;
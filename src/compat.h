@@ -34,8 +34,8 @@ typedef struct
     int violation_count;
 } CompatState;
 
-/* Global compatibility state */
-extern CompatState *g_compat_state;
+/* Compatibility state of the parser on this thread (NULL: no checking) */
+extern _Thread_local CompatState *g_compat_state;
 
 /* Initialize compatibility checking */
 CompatState *compat_init(int strict_mode);
@@ -1,4 +1,5 @@
 #include "errors.h"
+#include "termio.h"
 
 const char *error_message(int error_code)
 {
@@ -57,5 +58,7 @@ const char *error_message(int error_code)
 
 void error_print(int error_code, int line_number)
 {
-    fprintf(stderr, "?%s IN %d\n", error_message(error_code), line_number);
+    char buf[96];
+    snprintf(buf, sizeof(buf), "?%s IN %d\n", error_message(error_code), line_number);
+    termio_write_error(buf);
 }
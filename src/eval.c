@@ -36,7 +36,7 @@ static int eval_expr_is_string(RuntimeState *state, ASTExpr *expr)
 
         if (expr->type == EXPR_VAR || expr->type == EXPR_ARRAY)
         {
-            if (expr->var_name && runtime_get_variable_type(state, expr->var_name) == VAR_STRING)
+            if (expr->var_name && runtime_get_slot_type(state, expr->slot, expr->var_name) == VAR_STRING)
             {
                 return 1;
             }
@@ -69,12 +69,94 @@ char *eval_string_expr(RuntimeState *state, ASTExpr *expr)
     return eval_string_expr_internal(state, expr);
 }
 
+char *eval_map_key(RuntimeState *state, ASTExpr *key)
+{
+    if (!eval_expr_is_string(state, key))
+    {
+        return NULL;
+    }
+    return eval_string_expr_internal(state, key);
+}
+
+/* NAME(key) of a map: the element's value, or 0 or "" with ?Type mismatch
+ * for a key that is not a string */
+static double eval_map_element(RuntimeState *state, ASTExpr *expr)
+{
+    char *key = eval_map_key(state, expr->children[0]);
+    if (key == NULL)
+    {
+        runtime_set_error(state, BASIC_ERR_TYPE_MISMATCH, expr->line_number);
+        return 0.0;
+    }
+    double value = runtime_get_map_slot(state, expr->slot, expr->var_name, key);
+    free(key);
+    return value;
+}
+
+static char *eval_string_map_element(RuntimeState *state, ASTExpr *expr)
+{
+    char *key = eval_map_key(state, expr->children[0]);
+    if (key == NULL)
+    {
+        runtime_set_error(state, BASIC_ERR_TYPE_MISMATCH, expr->line_number);
+        return xstrdup("");
+    }
+    char *value = runtime_get_string_map_slot(state, expr->slot, expr->var_name, key);
+    free(key);
+    return value;
+}
+
+/* Fused "variable relop constant" test on a resolved numeric slot; returns
+ * -1 when the condition does not have that shape */
+static int eval_slot_compare(RuntimeState *state, ASTExpr *expr)
+{
+    if (expr->type != EXPR_BINARY_OP || expr->num_children != 2 ||
+        expr->op < OP_EQ || expr->op > OP_GE)
+    {
+        return -1;
+    }
+    ASTExpr *var = expr->children[0];
+    ASTExpr *limit = expr->children[1];
+    if (var == NULL || limit == NULL || var->type != EXPR_VAR || limit->type != EXPR_NUMBER)
+    {
+        return -1;
+    }
+    double *value = runtime_slot_number(state, var->slot);
+    if (value == NULL)
+    {
+        return -1;
+    }
+
+    double left = *value;
+    double right = limit->num_value;
+    switch (expr->op)
+    {
+    case OP_EQ:
+        return fabs(left - right) < 1e-9;
+    case OP_NE:
+        return fabs(left - right) >= 1e-9;
+    case OP_LT:
+        return left < right;
+    case OP_LE:
+        return left <= right;
+    case OP_GT:
+        return left > right;
+    default:
+        return left >= right;
+    }
+}
+
 int eval_condition(RuntimeState *state, ASTExpr *expr)
 {
     if (expr == NULL)
     {
         return 0;
     }
+    int fused = eval_slot_compare(state, expr);
+    if (fused >= 0)
+    {
+        return fused;
+    }
     double result = eval_expr_internal(state, expr);
     return eval_is_true(result);
 }
@@ -117,15 +199,16 @@ static double eval_expr_internal(RuntimeState *state, ASTExpr *expr)
         /* Variable reference */
         if (expr->var_name)
         {
-            if (strcasecmp(expr->var_name, "ERR") == 0)
+            /* ERR and ERL are never given a slot */
+            if (expr->slot < 0 && strcasecmp(expr->var_name, "ERR") == 0)
             {
                 return (double)runtime_get_error(state);
             }
-            if (strcasecmp(expr->var_name, "ERL") == 0)
+            if (expr->slot < 0 && strcasecmp(expr->var_name, "ERL") == 0)
             {
                 return (double)runtime_get_error_line(state);
             }
-            return runtime_get_variable(state, expr->var_name);
+            return runtime_get_slot(state, expr->slot, expr->var_name);
         }
         return 0.0;
 
@@ -133,14 +216,18 @@ static double eval_expr_internal(RuntimeState *state, ASTExpr *expr)
         /* Array element access */
         if (expr->var_name && expr->num_children > 0)
         {
+            if (expr->num_children == 1 && runtime_is_map(state, expr->slot, expr->var_name))
+            {
+                return eval_map_element(state, expr);
+            }
             /* Evaluate indices */
             int *indices = xmalloc(expr->num_children * sizeof(int));
             for (int i = 0; i < expr->num_children; i++)
             {
                 indices[i] = (int)eval_expr_internal(state, expr->children[i]);
             }
-            double result = runtime_get_array_element(state, expr->var_name,
-                                                      indices, expr->num_children);
+            double result = runtime_get_array_slot(state, expr->slot, expr->var_name,
+                                                   indices, expr->num_children);
             free(indices);
             return result;
         }
@@ -287,8 +374,17 @@ static double eval_expr_internal(RuntimeState *state, ASTExpr *expr)
         /* Call built-in function */
         if (expr->var_name)
         {
-            return call_numeric_function(state, expr->var_name,
-                                         expr->children, expr->num_children);
+            Profiler *prof = runtime_get_profiler(state);
+            if (prof == NULL)
+            {
+                return call_numeric_function(state, expr->var_name,
+                                             expr->children, expr->num_children);
+            }
+            profile_call_enter(prof, PROFILE_BUILTIN, expr->var_name);
+            double value = call_numeric_function(state, expr->var_name,
+                                                 expr->children, expr->num_children);
+            profile_call_exit(prof);
+            return value;
         }
         return 0.0;
 
@@ -444,14 +540,22 @@ static char *eval_string_expr_internal(RuntimeState *state, ASTExpr *expr)
         /* Variable reference */
         if (expr->var_name)
         {
-            return runtime_get_string_variable(state, expr->var_name);
+            return runtime_get_string_slot(state, expr->slot, expr->var_name);
         }
         return xstrdup("");
 
     case EXPR_FUNC_CALL:
         if (expr->var_name)
         {
-            return call_string_function(state, expr->var_name, expr->children, expr->num_children);
+            Profiler *prof = runtime_get_profiler(state);
+            if (prof == NULL)
+            {
+                return call_string_function(state, expr->var_name, expr->children, expr->num_children);
+            }
+            profile_call_enter(prof, PROFILE_BUILTIN, expr->var_name);
+            char *value = call_string_function(state, expr->var_name, expr->children, expr->num_children);
+            profile_call_exit(prof);
+            return value;
         }
         return xstrdup("");
 
@@ -478,12 +582,16 @@ static char *eval_string_expr_internal(RuntimeState *state, ASTExpr *expr)
     case EXPR_ARRAY:
         if (expr->var_name && expr->num_children > 0)
         {
+            if (expr->num_children == 1 && runtime_is_map(state, expr->slot, expr->var_name))
+            {
+                return eval_string_map_element(state, expr);
+            }
             int *indices = xmalloc(expr->num_children * sizeof(int));
             for (int i = 0; i < expr->num_children; i++)
             {
                 indices[i] = (int)eval_expr_internal(state, expr->children[i]);
             }
-            char *result = runtime_get_string_array_element(state, expr->var_name, indices, expr->num_children);
+            char *result = runtime_get_string_array_slot(state, expr->slot, expr->var_name, indices, expr->num_children);
             free(indices);
             return result;
         }
@@ -566,6 +674,12 @@ int is_string_expr(ASTExpr *expr)
         return is_string_variable(expr->var_name);
     }
 
+    /* N$(I) parses as a call and becomes an array read once resolved */
+    if ((expr->type == EXPR_ARRAY || expr->type == EXPR_PROC_CALL) && expr->var_name)
+    {
+        return is_string_variable(expr->var_name);
+    }
+
     if (expr->type == EXPR_FUNC_CALL && expr->var_name)
     {
         /* String functions: LEFT$, RIGHT$, MID$, CHR$, STR$, etc. */
@@ -10,6 +10,9 @@ double eval_numeric_expr(RuntimeState *state, ASTExpr *expr);
 char *eval_string_expr(RuntimeState *state, ASTExpr *expr);
 int eval_condition(RuntimeState *state, ASTExpr *expr);
 
+/* A map key (caller frees), or NULL if key is not a string expression */
+char *eval_map_key(RuntimeState *state, ASTExpr *key);
+
 int eval_is_true(double value);
 
 /* Helper functions */
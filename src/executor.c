@@ -8,6 +8,8 @@
 #include "termio.h"
 #include "lexer.h"
 #include "parser.h"
+#include "optimize.h"
+#include "matrix.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -17,8 +19,29 @@
 #include <unistd.h>
 #include <time.h>
 #include <signal.h>
+#include <limits.h>
+#include <pthread.h>
 
-static volatile sig_atomic_t *g_interrupt_flag = NULL;
+/* Per thread, so each embedded interpreter (libbasicpp) has its own */
+static _Thread_local volatile sig_atomic_t *g_interrupt_flag = NULL;
+
+/* Threads a PARALLEL FOR is spread over, 0 = one per CPU */
+static int g_parallel_workers = 0;
+
+/* Set while this thread runs iterations of a PARALLEL FOR */
+static _Thread_local int g_in_parallel_loop = 0;
+
+/* AST_DEBUG tracing, read from the environment once per thread: the
+ * checks sit on the per-statement path */
+static int ast_debug(void)
+{
+    static _Thread_local int enabled = -1;
+    if (enabled < 0)
+    {
+        enabled = getenv("AST_DEBUG") != NULL;
+    }
+    return enabled;
+}
 
 void executor_set_interrupt_flag(volatile sig_atomic_t *flag)
 {
@@ -44,10 +67,19 @@ void executor_trigger_interrupt(void)
     }
 }
 
-/* Process SDL events periodically during loops */
+/* Process SDL events periodically during loops; only the thread running
+ * the program touches the display */
 void executor_process_events(void)
 {
-    termio_handle_events();
+    if (!g_in_parallel_loop)
+    {
+        termio_handle_events();
+    }
+}
+
+void executor_set_parallel_workers(int workers)
+{
+    g_parallel_workers = workers;
 }
 
 static void preload_data(RuntimeState *state, Program *prog)
@@ -123,6 +155,10 @@ static void proc_scope_push(ExecutionContext *ctx, ProcedureScope *scope)
     }
     ctx->scope_stack[ctx->scope_sp++] = *scope;
     free(scope); /* Container freed, values are in stack */
+    if (ctx->scope_sp > ctx->stats->peak_call_depth)
+    {
+        ctx->stats->peak_call_depth = ctx->scope_sp;
+    }
 }
 
 /* Pop a scope from the scope stack */
@@ -173,6 +209,7 @@ static int execute_input_stmt(ExecutionContext *ctx, ASTStmt *stmt);
 static int execute_line_input_stmt(ExecutionContext *ctx, ASTStmt *stmt);
 static int execute_let_stmt(ExecutionContext *ctx, ASTStmt *stmt);
 static int execute_if_stmt(ExecutionContext *ctx, ASTStmt *stmt);
+static int execute_case_stmt(ExecutionContext *ctx, ASTStmt *stmt);
 static int execute_on_goto_stmt(ExecutionContext *ctx, ASTStmt *stmt);
 static int execute_for_stmt(ExecutionContext *ctx, ASTStmt *stmt);
 static int execute_next_stmt(ExecutionContext *ctx, ASTStmt *stmt);
@@ -181,6 +218,7 @@ static int execute_gosub_stmt(ExecutionContext *ctx, ASTStmt *stmt);
 static int execute_return_stmt(ExecutionContext *ctx, ASTStmt *stmt);
 static int execute_procedure_call_stmt(ExecutionContext *ctx, ASTStmt *stmt);
 static int execute_dim_stmt(ExecutionContext *ctx, ASTStmt *stmt);
+static int execute_mat_stmt(ExecutionContext *ctx, ASTStmt *stmt);
 static int execute_read_stmt(ExecutionContext *ctx, ASTStmt *stmt);
 static int execute_data_stmt(ExecutionContext *ctx, ASTStmt *stmt);
 static int execute_restore_stmt(ExecutionContext *ctx, ASTStmt *stmt);
@@ -209,6 +247,8 @@ static int execute_while_stmt(ExecutionContext *ctx, ASTStmt *stmt);
 static int execute_wend_stmt(ExecutionContext *ctx, ASTStmt *stmt);
 static int execute_do_loop_stmt(ExecutionContext *ctx, ASTStmt *stmt);
 static int execute_exit_stmt(ExecutionContext *ctx, ASTStmt *stmt);
+static int execute_systat_stmt(ExecutionContext *ctx, ASTStmt *stmt);
+static int prepare_chain(ASTStmt *stmt);
 
 /* Find program line by line number */
 int find_program_line(Program *prog, int line_number)
@@ -229,6 +269,30 @@ int find_program_line(Program *prog, int line_number)
     return -1;
 }
 
+/* The runtime's own budget (libbasicpp) takes precedence over the
+ * process-wide --max-statements */
+static unsigned long long statement_limit_for(RuntimeState *state)
+{
+    unsigned long long limit = runtime_get_statement_limit(state);
+    if (limit == 0)
+    {
+        limit = limits_get()->statements;
+    }
+    return limit ? limit : ULLONG_MAX;
+}
+
+/* Past the statement limit: --max-statements ends the process, a
+ * runtime's own budget ends the run like END. Every later statement is
+ * over the limit too, so enclosing loops and procedures unwind. */
+static int statement_limit_reached(ExecutionContext *ctx)
+{
+    if (runtime_get_statement_limit(ctx->runtime) == 0)
+    {
+        limit_exceeded(LIMIT_STATEMENTS);
+    }
+    return 1;
+}
+
 /* Execute a single statement */
 static int execute_stmt_internal(ExecutionContext *ctx, ASTStmt *stmt)
 {
@@ -238,6 +302,10 @@ static int execute_stmt_internal(ExecutionContext *ctx, ASTStmt *stmt)
     }
 
     runtime_set_current_state(ctx->runtime);
+    if (++ctx->stats->statements > ctx->statement_limit)
+    {
+        return statement_limit_reached(ctx);
+    }
 
     int result = 0;
 
@@ -264,6 +332,9 @@ static int execute_stmt_internal(ExecutionContext *ctx, ASTStmt *stmt)
     case STMT_IF:
         result = execute_if_stmt(ctx, stmt);
         break;
+    case STMT_CASE:
+        result = execute_case_stmt(ctx, stmt);
+        break;
     case STMT_ON_GOTO:
         result = execute_on_goto_stmt(ctx, stmt);
         break;
@@ -285,6 +356,9 @@ static int execute_stmt_internal(ExecutionContext *ctx, ASTStmt *stmt)
     case STMT_DIM:
         result = execute_dim_stmt(ctx, stmt);
         break;
+    case STMT_MAT:
+        result = execute_mat_stmt(ctx, stmt);
+        break;
     case STMT_READ:
         result = execute_read_stmt(ctx, stmt);
         break;
@@ -372,6 +446,9 @@ static int execute_stmt_internal(ExecutionContext *ctx, ASTStmt *stmt)
         termio_write("TRACE OFF\n");
         result = 0;
         break;
+    case STMT_SYSTAT:
+        result = execute_systat_stmt(ctx, stmt);
+        break;
     case STMT_STOP:
         /* STOP: halt program execution and store stop line number */
         runtime_set_stop_state(ctx->runtime, ctx->program->lines[ctx->current_line_index]->line_number);
@@ -476,10 +553,16 @@ static int execute_stmt_internal(ExecutionContext *ctx, ASTStmt *stmt)
         return 0;
     }
 
+    /* RETURN ends the procedure body, including from inside an IF */
+    if (ctx->proc_return_flag)
+    {
+        return 0;
+    }
+
     /* Execute chained statements (colon-separated on same line) */
     if (stmt->next != NULL)
     {
-        if (getenv("AST_DEBUG"))
+        if (ast_debug())
         {
             fprintf(stderr, "[AST] Chain from line %d\n", ctx->program->lines[ctx->current_line_index]->line_number);
         }
@@ -493,11 +576,46 @@ static void ensure_for_capacity(ExecutionContext *ctx)
 {
     if (ctx->for_sp >= ctx->for_cap)
     {
+        int old_cap = ctx->for_cap;
         ctx->for_cap = (ctx->for_cap == 0) ? 16 : ctx->for_cap * 2;
         ctx->for_stack = xrealloc(ctx->for_stack, ctx->for_cap * sizeof(ForFrame));
+        memset(ctx->for_stack + old_cap, 0, (ctx->for_cap - old_cap) * sizeof(ForFrame));
     }
 }
 
+/* A frame on top of the FOR stack, cleared of any FOR EACH keys a loop
+ * left there */
+static ForFrame *push_for_frame(ExecutionContext *ctx)
+{
+    ensure_for_capacity(ctx);
+    ForFrame *frame = &ctx->for_stack[ctx->for_sp++];
+    if (ctx->for_sp > ctx->stats->peak_for_depth)
+    {
+        ctx->stats->peak_for_depth = ctx->for_sp;
+    }
+    if (frame->keys != NULL)
+    {
+        runtime_release_map_keys(ctx->runtime, frame->keys, frame->num_keys);
+    }
+    frame->map = NULL;
+    frame->keys = NULL;
+    frame->num_keys = 0;
+    frame->key_index = 0;
+    return frame;
+}
+
+static void free_for_stack(ExecutionContext *ctx)
+{
+    for (int i = 0; i < ctx->for_cap; i++)
+    {
+        if (ctx->for_stack[i].keys != NULL)
+        {
+            runtime_release_map_keys(ctx->runtime, ctx->for_stack[i].keys, ctx->for_stack[i].num_keys);
+        }
+    }
+    free(ctx->for_stack);
+}
+
 static void ensure_while_capacity(ExecutionContext *ctx)
 {
     if (ctx->while_sp >= ctx->while_cap)
@@ -532,7 +650,7 @@ static int expr_is_string(RuntimeState *state, ASTExpr *expr)
 
         if (expr->type == EXPR_VAR || expr->type == EXPR_ARRAY)
         {
-            if (expr->var_name && runtime_get_variable_type(state, expr->var_name) == VAR_STRING)
+            if (expr->var_name && runtime_get_slot_type(state, expr->slot, expr->var_name) == VAR_STRING)
             {
                 return 1;
             }
@@ -863,13 +981,23 @@ static int execute_line_input_stmt(ExecutionContext *ctx, ASTStmt *stmt)
         return 0;
     }
 
-    FILE *fp = (stmt->file_handle > 0) ? runtime_get_file(ctx->runtime, stmt->file_handle) : stdin;
+    char line[1024];
+    if (stmt->file_handle <= 0)
+    {
+        if (termio_read_line_raw(line, sizeof(line)) < 0)
+        {
+            return 0;
+        }
+        runtime_set_string_variable(ctx->runtime, expr->var_name, line);
+        return 0;
+    }
+
+    FILE *fp = runtime_get_file(ctx->runtime, stmt->file_handle);
     if (!fp)
     {
         return -1;
     }
 
-    char line[1024];
     if (fgets(line, sizeof(line), fp) == NULL)
     {
         return 0;
@@ -1010,7 +1138,7 @@ static int execute_input_stmt(ExecutionContext *ctx, ASTStmt *stmt)
 
         memset(input_buffer, 0, sizeof(input_buffer));
         termio_write(prompt);
-        termio_present();
+        termio_flush();
 
         int len = termio_readline(input_buffer, sizeof(input_buffer));
 
@@ -1026,15 +1154,10 @@ static int execute_input_stmt(ExecutionContext *ctx, ASTStmt *stmt)
         {
             /* Fallback to stdin if termio fails */
             termio_write("\n");
-            if (fgets(input_buffer, sizeof(input_buffer), stdin) == NULL)
+            if (termio_read_line_raw(input_buffer, sizeof(input_buffer)) < 0)
             {
                 return -1;
             }
-            size_t slen = strlen(input_buffer);
-            if (slen > 0 && input_buffer[slen - 1] == '\n')
-            {
-                input_buffer[slen - 1] = '\0';
-            }
         }
         else
         {
@@ -1069,6 +1192,66 @@ static int execute_input_stmt(ExecutionContext *ctx, ASTStmt *stmt)
 }
 
 /* Execute LET statement (variable assignment) */
+/* Fused "V = W + constant" / "V = W - constant" / "V = constant + W" on
+ * resolved numeric slots. Returns 0 when the statement has another shape. */
+static int execute_let_step(ExecutionContext *ctx, ASTExpr *lhs, ASTExpr *rhs)
+{
+    if (lhs->type != EXPR_VAR || rhs->type != EXPR_BINARY_OP || rhs->num_children != 2 ||
+        (rhs->op != OP_ADD && rhs->op != OP_SUB))
+    {
+        return 0;
+    }
+
+    ASTExpr *var = rhs->children[0];
+    ASTExpr *constant = rhs->children[1];
+    if (rhs->op == OP_ADD && var && var->type == EXPR_NUMBER)
+    {
+        var = rhs->children[1];
+        constant = rhs->children[0];
+    }
+    if (var == NULL || constant == NULL || var->type != EXPR_VAR || constant->type != EXPR_NUMBER)
+    {
+        return 0;
+    }
+
+    double *src = runtime_slot_number(ctx->runtime, var->slot);
+    double *dst = runtime_slot_number(ctx->runtime, lhs->slot);
+    if (src == NULL || dst == NULL)
+    {
+        return 0;
+    }
+    *dst = (rhs->op == OP_ADD) ? *src + constant->num_value : *src - constant->num_value;
+    return 1;
+}
+
+/* Store into map element NAME(key), from value_expr when it is given and
+ * otherwise from num or str; 0 or a negative BASIC error */
+static int store_map_element(ExecutionContext *ctx, ASTExpr *element, ASTExpr *value_expr, double num,
+                             const char *str)
+{
+    char *key = eval_map_key(ctx->runtime, element->children[0]);
+    if (key == NULL)
+    {
+        return -BASIC_ERR_TYPE_MISMATCH;
+    }
+
+    int stored;
+    if (runtime_get_slot_type(ctx->runtime, element->slot, element->var_name) == VAR_STRING)
+    {
+        char *value = value_expr ? eval_string_expr(ctx->runtime, value_expr) : NULL;
+        stored = runtime_set_string_map_slot(ctx->runtime, element->slot, element->var_name, key,
+                                             value ? value : str);
+        free(value);
+    }
+    else
+    {
+        double value = value_expr ? eval_numeric_expr(ctx->runtime, value_expr) : num;
+        stored = runtime_set_map_slot(ctx->runtime, element->slot, element->var_name, key, value);
+    }
+    free(key);
+    return stored < 0 ? -BASIC_ERR_ILLEGAL_QUANTITY : 0;
+}
+
 static int execute_let_stmt(ExecutionContext *ctx, ASTStmt *stmt)
 {
     if (stmt == NULL || stmt->num_exprs < 2)
@@ -1084,6 +1267,17 @@ static int execute_let_stmt(ExecutionContext *ctx, ASTStmt *stmt)
         return 0;
     }
 
+    if (execute_let_step(ctx, lhs, rhs))
+    {
+        return 0;
+    }
+
+    if (lhs->type == EXPR_ARRAY && lhs->num_children == 1 &&
+        runtime_is_map(ctx->runtime, lhs->slot, lhs->var_name))
+    {
+        return store_map_element(ctx, lhs, rhs, 0.0, NULL);
+    }
+
     /* Array assignment: lhs is EXPR_ARRAY with children as indices */
     if (lhs->type == EXPR_ARRAY)
     {
@@ -1095,17 +1289,17 @@ static int execute_let_stmt(ExecutionContext *ctx, ASTStmt *stmt)
             indices[i] = (int)eval_numeric_expr(ctx->runtime, lhs->children[i]);
         }
 
-        VarType vtype = runtime_get_variable_type(ctx->runtime, lhs->var_name);
+        VarType vtype = runtime_get_slot_type(ctx->runtime, lhs->slot, lhs->var_name);
         if (vtype == VAR_STRING)
         {
             char *str_val = eval_string_expr(ctx->runtime, rhs);
-            runtime_set_string_array_element(ctx->runtime, lhs->var_name, indices, num_indices, str_val);
+            runtime_set_string_array_slot(ctx->runtime, lhs->slot, lhs->var_name, indices, num_indices, str_val);
             free(str_val);
         }
         else
         {
             double value = eval_numeric_expr(ctx->runtime, rhs);
-            runtime_set_array_element(ctx->runtime, lhs->var_name, indices, num_indices, value);
+            runtime_set_array_slot(ctx->runtime, lhs->slot, lhs->var_name, indices, num_indices, value);
         }
 
         free(indices);
@@ -1114,7 +1308,7 @@ static int execute_let_stmt(ExecutionContext *ctx, ASTStmt *stmt)
     {
         /* Simple variable assignment */
         const char *var_name = lhs->var_name;
-        VarType var_type = runtime_get_variable_type(ctx->runtime, var_name);
+        VarType var_type = runtime_get_slot_type(ctx->runtime, lhs->slot, var_name);
 
         if (var_type == VAR_STRING)
         {
@@ -1128,13 +1322,13 @@ static int execute_let_stmt(ExecutionContext *ctx, ASTStmt *stmt)
                 return -err; /* Return negated error code */
             }
 
-            runtime_set_string_variable(ctx->runtime, var_name, str_val);
+            runtime_set_string_slot(ctx->runtime, lhs->slot, var_name, str_val);
             free(str_val);
         }
         else
         {
             double num_val = eval_numeric_expr(ctx->runtime, rhs);
-            runtime_set_variable(ctx->runtime, var_name, num_val);
+            runtime_set_slot(ctx->runtime, lhs->slot, var_name, num_val);
         }
     }
 
@@ -1176,6 +1370,247 @@ static int execute_if_stmt(ExecutionContext *ctx, ASTStmt *stmt)
     return 0;
 }
 
+/* Integral WHEN values within this range go into the dispatch tables */
+#define CASE_KEY_LIMIT 1000000000.0
+
+static unsigned int case_hash(const char *sval, long ival)
+{
+    unsigned int h = 2166136261u;
+    if (sval)
+    {
+        for (const unsigned char *p = (const unsigned char *)sval; *p; p++)
+        {
+            h = (h ^ *p) * 16777619u;
+        }
+        return h;
+    }
+    return (unsigned int)((unsigned long)ival * 2654435761u);
+}
+
+/* Bucket holding the key, or the empty bucket where it would go */
+static CaseBucket *case_bucket(CaseTable *table, const char *sval, long ival)
+{
+    unsigned int mask = (unsigned int)table->num_buckets - 1;
+    unsigned int i = case_hash(sval, ival) & mask;
+    for (;;)
+    {
+        CaseBucket *b = &table->buckets[i];
+        if (b->arm < 0)
+            return b;
+        if (sval ? (b->sval && strcmp(b->sval, sval) == 0) : (!b->sval && b->ival == ival))
+            return b;
+        i = (i + 1) & mask;
+    }
+}
+
+/* Index the constant WHEN values of a CASE statement. Integral numbers go
+ * into a dense table when they cover a small range, otherwise into the hash
+ * with the strings; any other WHEN value is compared in order. */
+static CaseTable *build_case_table(ASTStmt *stmt)
+{
+    CaseTable *table = xcalloc(1, sizeof(CaseTable));
+    int num_arms = stmt->num_exprs - 1;
+    table->num_arms = num_arms;
+    if (num_arms <= 0)
+    {
+        return table;
+    }
+
+    table->arms = xmalloc(num_arms * sizeof(ASTStmt *));
+    table->kind = xmalloc(num_arms);
+
+    int num_ints = 0, num_keys = 0;
+    long min = 0, max = 0;
+    ASTStmt *arm = stmt->body;
+    for (int i = 0; i < num_arms; i++)
+    {
+        ASTExpr *value = stmt->exprs[i + 1];
+        table->arms[i] = arm ? arm->body : NULL;
+        arm = arm ? arm->next : NULL;
+
+        if (value && value->type == EXPR_NUMBER && value->num_value == floor(value->num_value) &&
+            fabs(value->num_value) <= CASE_KEY_LIMIT)
+        {
+            long v = (long)value->num_value;
+            min = (num_ints == 0 || v < min) ? v : min;
+            max = (num_ints == 0 || v > max) ? v : max;
+            num_ints++;
+            num_keys++;
+            table->kind[i] = CASE_ARM_INT;
+        }
+        else if (value && value->type == EXPR_STRING && value->str_value)
+        {
+            num_keys++;
+            table->num_string_arms++;
+            table->kind[i] = CASE_ARM_STRING;
+        }
+        else
+        {
+            table->num_expr_arms++;
+            table->kind[i] = CASE_ARM_EXPR;
+        }
+    }
+
+    int dense = num_ints > 0 && max - min < 2L * num_ints + 8;
+    if (dense)
+    {
+        table->dense_min = (int)min;
+        table->dense_size = (int)(max - min + 1);
+        table->dense = xmalloc(table->dense_size * sizeof(int));
+        memset(table->dense, 0xff, table->dense_size * sizeof(int));
+        num_keys -= num_ints;
+    }
+    if (num_keys > 0)
+    {
+        table->num_buckets = 8;
+        while (table->num_buckets < num_keys * 2)
+        {
+            table->num_buckets *= 2;
+        }
+        table->buckets = xmalloc(table->num_buckets * sizeof(CaseBucket));
+        for (int i = 0; i < table->num_buckets; i++)
+        {
+            table->buckets[i].arm = -1;
+        }
+    }
+
+    /* Earlier arms win on duplicate values, as in a chain of comparisons */
+    for (int i = 0; i < num_arms; i++)
+    {
+        ASTExpr *value = stmt->exprs[i + 1];
+        if (table->kind[i] == CASE_ARM_INT && dense)
+        {
+            int *slot = &table->dense[(long)value->num_value - min];
+            if (*slot < 0)
+                *slot = i;
+        }
+        else if (table->kind[i] != CASE_ARM_EXPR)
+        {
+            const char *sval = table->kind[i] == CASE_ARM_STRING ? value->str_value : NULL;
+            long ival = sval ? 0 : (long)value->num_value;
+            CaseBucket *b = case_bucket(table, sval, ival);
+            if (b->arm < 0)
+            {
+                b->arm = i;
+                b->sval = sval;
+                b->ival = ival;
+            }
+        }
+    }
+
+    return table;
+}
+
+/* First integer arm equal to value, under the 1e-9 tolerance of '=' */
+static int case_lookup_number(CaseTable *table, double value)
+{
+    double key = floor(value + 0.5);
+    if (fabs(value - key) >= 1e-9 || fabs(key) > CASE_KEY_LIMIT)
+    {
+        return -1;
+    }
+
+    long k = (long)key;
+    if (table->dense && k >= table->dense_min && k - table->dense_min < table->dense_size)
+    {
+        return table->dense[k - table->dense_min];
+    }
+    if (table->buckets && !table->dense)
+    {
+        return case_bucket(table, NULL, k)->arm;
+    }
+    return -1;
+}
+
+/* Execute CASE statement: the selector is evaluated once and constant WHEN
+ * values are found through the dispatch table. Each arm matches exactly
+ * when "selector = value" would be true. */
+static int execute_case_stmt(ExecutionContext *ctx, ASTStmt *stmt)
+{
+    if (stmt == NULL || stmt->num_exprs == 0)
+    {
+        return 0;
+    }
+
+    if (stmt->case_table == NULL)
+    {
+        stmt->case_table = build_case_table(stmt);
+    }
+    CaseTable *table = stmt->case_table;
+
+    /* '=' compares as strings when either side is a string */
+    ASTExpr *selector = stmt->exprs[0];
+    int selector_is_string = expr_is_string(ctx->runtime, selector);
+    double number = 0.0;
+    char *text = NULL;
+    if (selector_is_string)
+    {
+        text = eval_string_expr(ctx->runtime, selector);
+    }
+    else
+    {
+        number = eval_numeric_expr(ctx->runtime, selector);
+    }
+
+    int match = table->num_arms;
+    if (!selector_is_string)
+    {
+        int arm = case_lookup_number(table, number);
+        if (arm >= 0)
+            match = arm;
+    }
+    if (table->num_string_arms > 0)
+    {
+        if (text == NULL)
+        {
+            text = eval_string_expr(ctx->runtime, selector);
+        }
+        CaseBucket *b = case_bucket(table, text ? text : "", 0);
+        if (b->arm >= 0 && b->arm < match)
+            match = b->arm;
+    }
+
+    /* Arms without a table entry, up to the table's match, in source order */
+    if (table->num_expr_arms > 0 || selector_is_string)
+    {
+        for (int i = 0; i < match; i++)
+        {
+            ASTExpr *value = stmt->exprs[i + 1];
+            if (table->kind[i] == CASE_ARM_STRING || (table->kind[i] == CASE_ARM_INT && !selector_is_string))
+                continue;
+
+            int equal;
+            if (selector_is_string || expr_is_string(ctx->runtime, value))
+            {
+                if (text == NULL)
+                {
+                    text = eval_string_expr(ctx->runtime, selector);
+                }
+                char *other = eval_string_expr(ctx->runtime, value);
+                equal = strcmp(text ? text : "", other ? other : "") == 0;
+                free(other);
+            }
+            else
+            {
+                equal = fabs(number - eval_numeric_expr(ctx->runtime, value)) < 1e-9;
+            }
+            if (equal)
+            {
+                match = i;
+                break;
+            }
+        }
+    }
+    free(text);
+
+    ASTStmt *body = (match < table->num_arms) ? table->arms[match] : stmt->else_body;
+    if (body != NULL)
+    {
+        return execute_stmt_internal(ctx, body);
+    }
+    return 0;
+}
+
 static int execute_on_goto_stmt(ExecutionContext *ctx, ASTStmt *stmt)
 {
     if (stmt == NULL || stmt->num_exprs < 2)
@@ -1220,42 +1655,329 @@ static int execute_on_goto_stmt(ExecutionContext *ctx, ASTStmt *stmt)
     return 0;
 }
 
-/* Execute FOR statement */
-static int execute_for_stmt(ExecutionContext *ctx, ASTStmt *stmt)
+/* A FOR whose NEXT follows it directly runs as a native loop on the
+ * counter's slot, with no frame. Returns 0 when the loop does not qualify. */
+/* Continue after a loop's NEXT without running the body again */
+static void skip_past_next(ExecutionContext *ctx, ASTStmt *next_stmt, int next_line_index)
 {
-    if (stmt == NULL || stmt->num_exprs < 3)
+    if (next_stmt->next != NULL)
+    {
+        ctx->next_line_index = next_line_index;
+        ctx->next_stmt_override = next_stmt->next;
+    }
+    else
+    {
+        ctx->next_line_index = next_line_index + 1;
+        if (next_line_index == ctx->current_line_index)
+        {
+            ctx->skip_chained = 1;
+        }
+    }
+}
+
+static int execute_empty_for(ExecutionContext *ctx, ASTStmt *stmt, ASTStmt *next_stmt,
+                             int next_line_index, ASTExpr *var_expr, double end, double step)
+{
+    int same_line = next_line_index == ctx->current_line_index;
+    if (same_line ? stmt->next != next_stmt
+                  : (next_line_index != ctx->current_line_index + 1 || stmt->next != NULL ||
+                     ctx->program->lines[next_line_index]->stmt != next_stmt))
     {
         return 0;
     }
 
-    ASTExpr *var_expr = stmt->exprs[0];
-    if (var_expr == NULL || var_expr->var_name == NULL)
+    /* NEXT must close this loop only */
+    if (next_stmt->num_exprs > 1 ||
+        (next_stmt->num_exprs == 1 && (next_stmt->exprs[0] == NULL || next_stmt->exprs[0]->var_name == NULL ||
+                                       strcmp(next_stmt->exprs[0]->var_name, var_expr->var_name) != 0)))
     {
         return 0;
     }
 
-    /* Get loop variable name */
-    const char *loop_var = var_expr->var_name;
+    /* TRON reports every pass through the loop */
+    double *counter = runtime_slot_number(ctx->runtime, var_expr->slot);
+    if (counter == NULL || runtime_get_trace(ctx->runtime))
+    {
+        return 0;
+    }
 
-    /* Evaluate start, end, and optional step */
-    double start = eval_numeric_expr(ctx->runtime, stmt->exprs[1]);
-    double end = eval_numeric_expr(ctx->runtime, stmt->exprs[2]);
-    double step = (stmt->num_exprs > 3) ? eval_numeric_expr(ctx->runtime, stmt->exprs[3]) : 1.0;
+    /* The body runs once before the first test, as in NEXT */
+    double value = *counter;
+    unsigned int polls = 0;
+    do
+    {
+        value += step;
+        if ((++polls & 0xffff) == 0 &&
+            ((g_interrupt_flag && *g_interrupt_flag) || ctx->stats->statements + polls > ctx->statement_limit))
+        {
+            break;
+        }
+    } while (step > 0 ? value <= end : value >= end);
+    *counter = value;
+    ctx->stats->statements += polls; /* One NEXT per pass */
+    if (ctx->stats->statements > ctx->statement_limit)
+    {
+        statement_limit_reached(ctx); /* Else the next statement ends the run */
+    }
 
-    if (step == 0.0)
+    skip_past_next(ctx, next_stmt, next_line_index);
+    return 1;
+}
+
+/* One thread's share of a PARALLEL FOR: a run of consecutive passes */
+typedef struct
+{
+    Program *program;
+    RuntimeState *runtime; /* The thread's worker runtime */
+    volatile sig_atomic_t *interrupt_flag;
+    ASTExpr *var;
+    int body_first; /* The body is lines [body_first, body_end) */
+    int body_end;
+    double first;   /* Counter value of the first pass */
+    double step;
+    long long passes;
+    unsigned long long statement_limit;
+    int result; /* 0, 1 when stopped early, or a negative error */
+} ParallelChunk;
+
+/* Run a chunk's passes through the body, each as the main loop would run
+ * the lines between FOR and NEXT */
+static void *run_parallel_chunk(void *arg)
+{
+    ParallelChunk *chunk = arg;
+    Program *prog = chunk->program;
+    g_in_parallel_loop = 1;
+    g_interrupt_flag = chunk->interrupt_flag;
+
+    ExecutionContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.runtime = chunk->runtime;
+    ctx.program = prog;
+    ctx.return_line_index = -1;
+    ctx.stats = runtime_stats(chunk->runtime);
+    ctx.statement_limit = chunk->statement_limit;
+    runtime_set_execution_context(chunk->runtime, &ctx);
+
+    double value = chunk->first;
+    for (long long n = 0; n < chunk->passes && chunk->result == 0; n++)
+    {
+        runtime_set_slot(ctx.runtime, chunk->var->slot, chunk->var->var_name, value);
+        value += chunk->step;
+        ctx.for_sp = 0;
+        ctx.while_sp = 0;
+        ctx.current_line_index = chunk->body_first;
+        ctx.next_line_index = chunk->body_first + 1;
+        while (ctx.current_line_index < chunk->body_end)
+        {
+            if (g_interrupt_flag && *g_interrupt_flag)
+            {
+                chunk->result = 1;
+                break;
+            }
+
+            ASTStmt *stmt = ctx.next_stmt_override ? ctx.next_stmt_override : prog->lines[ctx.current_line_index]->stmt;
+            ctx.next_stmt_override = NULL;
+            int result = execute_stmt_internal(&ctx, stmt);
+            if (result != 0)
+            {
+                chunk->result = result;
+                break;
+            }
+
+            if (ctx.next_line_index == ctx.current_line_index + 1)
+            {
+                ctx.current_line_index++;
+            }
+            else
+            {
+                ctx.current_line_index = ctx.next_line_index;
+            }
+            ctx.next_line_index = ctx.current_line_index + 1;
+        }
+    }
+
+    free_for_stack(&ctx);
+    free(ctx.while_stack);
+    free(ctx.scope_stack);
+    g_in_parallel_loop = 0;
+    return NULL;
+}
+
+/*
+ * Run a PARALLEL FOR whose NEXT is alone on line next_index. The passes
+ * are split into one run of consecutive counter values per thread, each
+ * thread with a worker runtime; this thread takes the first run. After
+ * the loop the scalars are those the last pass left, as after the
+ * sequential loop, and each REDUCE variable is its value before the loop
+ * combined with every thread's part in order. Returns 0 to run the loop
+ * sequentially instead (one thread, TRON, profiling), else 1 with the
+ * statement's result in *result.
+ */
+static int execute_parallel_for(ExecutionContext *ctx, ASTStmt *stmt, ASTExpr *var_expr, double start, double end,
+                                double step, int next_index, int *result)
+{
+    int workers = g_parallel_workers;
+    if (workers <= 0)
     {
-        /* Invalid step - avoid infinite loop */
-        return -1;
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? (int)cpus : 1;
+    }
+    if (workers < 2 || g_in_parallel_loop || ctx->profiler != NULL || runtime_get_trace(ctx->runtime) ||
+        ctx->program->lines[ctx->current_line_index]->stmt != stmt || next_index <= ctx->current_line_index)
+    {
+        return 0;
     }
 
-    /* Set loop variable to start value */
-    runtime_set_variable(ctx->runtime, loop_var, start);
+    /* Step the counter as NEXT would, so each run starts from the very
+     * value the sequential loop reaches */
+    long long passes = 0;
+    double value = start;
+    do
+    {
+        if ((++passes & 0xffff) == 0 && g_interrupt_flag && *g_interrupt_flag)
+        {
+            return 0;
+        }
+        value += step;
+    } while (step > 0 ? value <= end : value >= end);
+    if (passes < workers)
+    {
+        workers = (int)passes;
+    }
+    if (workers < 2)
+    {
+        return 0;
+    }
 
-    /* Find the NEXT statement for this FOR loop */
+    /* Build CASE tables before the threads share the body */
+    for (int i = ctx->current_line_index + 1; i < next_index; i++)
+    {
+        prepare_chain(ctx->program->lines[i]->stmt);
+    }
+
+    int num_reductions = stmt->num_call_args;
+    double *initial = xmalloc((size_t)(num_reductions + 1) * sizeof(double));
+    for (int r = 0; r < num_reductions; r++)
+    {
+        initial[r] = runtime_get_slot(ctx->runtime, stmt->call_args[r]->slot, stmt->call_args[r]->var_name);
+    }
+
+    ParallelChunk *chunks = xcalloc((size_t)workers, sizeof(ParallelChunk));
+    value = start;
+    for (int c = 0; c < workers; c++)
+    {
+        ParallelChunk *chunk = &chunks[c];
+        chunk->program = ctx->program;
+        chunk->runtime = runtime_create_worker(ctx->runtime);
+        chunk->interrupt_flag = g_interrupt_flag;
+        chunk->var = var_expr;
+        chunk->body_first = ctx->current_line_index + 1;
+        chunk->body_end = next_index;
+        chunk->first = value;
+        chunk->step = step;
+        chunk->passes = passes / workers + (c < passes % workers);
+        chunk->statement_limit = ctx->statement_limit == ULLONG_MAX ? ULLONG_MAX
+                                                                    : ctx->statement_limit - ctx->stats->statements;
+        for (long long n = 0; n < chunk->passes; n++)
+        {
+            value += step;
+        }
+
+        /* Sums and products are gathered from nothing, extremes from the
+         * value before the loop */
+        for (int r = 0; r < num_reductions; r++)
+        {
+            ASTExpr *reduce = stmt->call_args[r];
+            double identity = reduce->op == OP_ADD ? 0.0 : reduce->op == OP_MUL ? 1.0 : initial[r];
+            runtime_set_slot(chunk->runtime, reduce->slot, reduce->var_name, identity);
+        }
+    }
+
+    pthread_t *threads = xcalloc((size_t)workers, sizeof(pthread_t));
+    int *started = xcalloc((size_t)workers, sizeof(int));
+    for (int c = 1; c < workers; c++)
+    {
+        started[c] = pthread_create(&threads[c], NULL, run_parallel_chunk, &chunks[c]) == 0;
+    }
+    run_parallel_chunk(&chunks[0]);
+    for (int c = 1; c < workers; c++)
+    {
+        if (started[c])
+        {
+            pthread_join(threads[c], NULL);
+        }
+        else
+        {
+            run_parallel_chunk(&chunks[c]); /* No thread to spare: run it here */
+        }
+    }
+    runtime_set_current_state(ctx->runtime);
+
+    /* The sequential loop would have stopped at the earliest error */
+    int error = 0;
+    for (int c = 0; c < workers && error == 0; c++)
+    {
+        error = chunks[c].result < 0 ? chunks[c].result : 0;
+    }
+    for (int c = 0; c < workers; c++)
+    {
+        runtime_join_worker(ctx->runtime, chunks[c].runtime, error == 0 && c == workers - 1);
+    }
+    if (error == 0)
+    {
+        for (int r = 0; r < num_reductions; r++)
+        {
+            ASTExpr *reduce = stmt->call_args[r];
+            double total = initial[r];
+            for (int c = 0; c < workers; c++)
+            {
+                double part = runtime_get_slot(chunks[c].runtime, reduce->slot, reduce->var_name);
+                if (reduce->op == OP_ADD)
+                    total += part;
+                else if (reduce->op == OP_MUL)
+                    total *= part;
+                else if (reduce->op == OP_LT ? part < total : part > total)
+                    total = part;
+            }
+            runtime_set_slot(ctx->runtime, reduce->slot, reduce->var_name, total);
+        }
+        runtime_set_slot(ctx->runtime, var_expr->slot, var_expr->var_name, value);
+    }
+
+    for (int c = 0; c < workers; c++)
+    {
+        runtime_free_worker(chunks[c].runtime);
+    }
+    free(started);
+    free(threads);
+    free(chunks);
+    free(initial);
+
+    if (error != 0)
+    {
+        *result = error;
+    }
+    else if (ctx->stats->statements > ctx->statement_limit)
+    {
+        *result = statement_limit_reached(ctx);
+    }
+    else
+    {
+        ctx->next_line_index = next_index + 1;
+        *result = 0;
+    }
+    return 1;
+}
+
+/* Execute FOR statement */
+/* The line index of the NEXT that closes the FOR stmt on the current
+ * line, or -1 if there is none, with that NEXT; for a loop within one
+ * line also the body's first statement and what follows the NEXT */
+static int find_loop_next(ExecutionContext *ctx, ASTStmt *stmt, ASTStmt **body_start, ASTStmt **after_next,
+                          ASTStmt **next_stmt)
+{
     int next_line_index = -1;
     int nesting_level = 0;
-    ASTStmt *body_start = NULL;
-    ASTStmt *after_next = NULL;
 
     /* First, check for NEXT in chained statements on the same line (after this FOR) */
     ASTStmt *current_stmt = stmt->next;
@@ -1271,8 +1993,9 @@ static int execute_for_stmt(ExecutionContext *ctx, ASTStmt *stmt)
             if (nesting_level < count)
             {
                 next_line_index = ctx->current_line_index;
-                body_start = stmt->next;
-                after_next = current_stmt->next;
+                *body_start = stmt->next;
+                *after_next = current_stmt->next;
+                *next_stmt = current_stmt;
                 break;
             }
             nesting_level -= count;
@@ -1297,6 +2020,7 @@ static int execute_for_stmt(ExecutionContext *ctx, ASTStmt *stmt)
                 if (nesting_level < count)
                 {
                     next_line_index = i;
+                    *next_stmt = line_stmt;
                     break;
                 }
                 nesting_level -= count;
@@ -1304,42 +2028,189 @@ static int execute_for_stmt(ExecutionContext *ctx, ASTStmt *stmt)
         }
     }
 
-    if (next_line_index < 0)
+    return next_line_index;
+}
+
+/* FOR EACH var IN map: the body runs for each key the map held when the
+ * loop started, in ascending order, passing over keys deleted meanwhile.
+ * An empty map skips the body. */
+static int execute_for_each_stmt(ExecutionContext *ctx, ASTStmt *stmt)
+{
+    ASTExpr *var_expr = stmt->exprs[0];
+    ASTExpr *map = stmt->exprs[1];
+    if (!runtime_is_map(ctx->runtime, map->slot, map->var_name) ||
+        runtime_get_slot_type(ctx->runtime, var_expr->slot, var_expr->var_name) != VAR_STRING)
+    {
+        return -BASIC_ERR_TYPE_MISMATCH;
+    }
+
+    ASTStmt *body_start = NULL;
+    ASTStmt *after_next = NULL;
+    ASTStmt *next_stmt = NULL;
+    int next_line_index = find_loop_next(ctx, stmt, &body_start, &after_next, &next_stmt);
+    if (next_line_index < 0)
+    {
+        return -1;
+    }
+
+    int num_keys;
+    MapKey **keys = runtime_map_keys(ctx->runtime, map->slot, map->var_name, &num_keys);
+    if (keys == NULL)
+    {
+        skip_past_next(ctx, next_stmt, next_line_index);
+        return 0;
+    }
+    runtime_set_string_slot(ctx->runtime, var_expr->slot, var_expr->var_name, runtime_map_key_text(keys[0]));
+
+    ForFrame *frame = push_for_frame(ctx);
+    frame->var_name = var_expr->var_name;
+    frame->slot = var_expr->slot;
+    frame->end = 0.0;
+    frame->step = 0.0;
+    frame->ascending = 1;
+    frame->for_line_index = ctx->current_line_index;
+    frame->next_line_index = next_line_index;
+    frame->body_start = body_start;
+    frame->after_next = after_next;
+    frame->map = map;
+    frame->keys = keys;
+    frame->num_keys = num_keys;
+
+    ctx->next_line_index = ctx->current_line_index + 1;
+    return 0;
+}
+
+static int execute_for_stmt(ExecutionContext *ctx, ASTStmt *stmt)
+{
+    if (stmt != NULL && stmt->mode == FOR_EACH && stmt->num_exprs == 2)
+    {
+        return execute_for_each_stmt(ctx, stmt);
+    }
+    if (stmt == NULL || stmt->num_exprs < 3)
+    {
+        return 0;
+    }
+
+    ASTExpr *var_expr = stmt->exprs[0];
+    if (var_expr == NULL || var_expr->var_name == NULL)
+    {
+        return 0;
+    }
+
+    /* Get loop variable name */
+    const char *loop_var = var_expr->var_name;
+
+    /* Evaluate start, end, and optional step */
+    double start = eval_numeric_expr(ctx->runtime, stmt->exprs[1]);
+    double end = eval_numeric_expr(ctx->runtime, stmt->exprs[2]);
+    double step = (stmt->num_exprs > 3) ? eval_numeric_expr(ctx->runtime, stmt->exprs[3]) : 1.0;
+
+    if (step == 0.0)
+    {
+        /* Invalid step - avoid infinite loop */
+        return -1;
+    }
+
+    /* Set loop variable to start value */
+    runtime_set_slot(ctx->runtime, var_expr->slot, loop_var, start);
+
+    ASTStmt *body_start = NULL;
+    ASTStmt *after_next = NULL;
+    ASTStmt *next_stmt = NULL;
+    int next_line_index = find_loop_next(ctx, stmt, &body_start, &after_next, &next_stmt);
+    if (next_line_index < 0)
+    {
+        /* NEXT not found */
+        return -1;
+    }
+
+    int parallel_result;
+    if (stmt->mode == FOR_PARALLEL &&
+        execute_parallel_for(ctx, stmt, var_expr, start, end, step, next_line_index, &parallel_result))
+    {
+        return parallel_result;
+    }
+
+    if (execute_empty_for(ctx, stmt, next_stmt, next_line_index, var_expr, end, step))
+    {
+        return 0;
+    }
+
+    ForFrame *frame = push_for_frame(ctx);
+    frame->var_name = loop_var;
+    frame->slot = var_expr->slot;
+    frame->end = end;
+    frame->step = step;
+    frame->ascending = step > 0;
+    frame->for_line_index = ctx->current_line_index;
+    frame->next_line_index = next_line_index;
+    frame->body_start = body_start;
+    frame->after_next = after_next;
+
+    /* Continue to next line after FOR */
+    ctx->next_line_index = ctx->current_line_index + 1;
+    return 0;
+}
+
+/* Whether a frame belongs to the variable NEXT names: by slot when both
+ * are resolved, by name otherwise */
+static int for_frame_matches(const ForFrame *frame, const ASTExpr *var)
+{
+    if (frame->slot >= 0 && var->slot >= 0)
+    {
+        return frame->slot == var->slot;
+    }
+    return var->var_name && strcmp(frame->var_name, var->var_name) == 0;
+}
+
+/* Leave the loop of frame_index. Inner loops still open are left too. */
+static void pop_for_frame(ExecutionContext *ctx, int frame_index)
+{
+    ForFrame *frame = &ctx->for_stack[frame_index];
+    ctx->for_sp = frame_index;
+    if (frame->next_line_index == frame->for_line_index && frame->after_next != NULL)
+    {
+        ctx->next_line_index = frame->for_line_index;
+        ctx->next_stmt_override = frame->after_next;
+    }
+    else
+    {
+        ctx->next_line_index = frame->next_line_index + 1;
+    }
+}
+
+/* Give a FOR EACH variable the next key still in the map; 0 with the keys
+ * released when there is none */
+static int next_map_key(ExecutionContext *ctx, ForFrame *frame)
+{
+    const ASTExpr *map = frame->map;
+    while (++frame->key_index < frame->num_keys)
     {
-        /* NEXT not found */
-        return -1;
+        const char *key = runtime_map_key_text(frame->keys[frame->key_index]);
+        if (runtime_map_has_key(ctx->runtime, map->slot, map->var_name, key))
+        {
+            runtime_set_string_slot(ctx->runtime, frame->slot, frame->var_name, key);
+            return 1;
+        }
     }
-
-    ensure_for_capacity(ctx);
-    ForFrame *frame = &ctx->for_stack[ctx->for_sp++];
-    frame->var_name = xstrdup(loop_var);
-    frame->end = end;
-    frame->step = step;
-    frame->for_line_index = ctx->current_line_index;
-    frame->next_line_index = next_line_index;
-    frame->body_start = body_start;
-    frame->after_next = after_next;
-
-    /* Continue to next line after FOR */
-    ctx->next_line_index = ctx->current_line_index + 1;
+    runtime_release_map_keys(ctx->runtime, frame->keys, frame->num_keys);
+    frame->keys = NULL;
     return 0;
 }
 
-static int execute_next_for_var(ExecutionContext *ctx, const char *name)
+static int execute_next_for_var(ExecutionContext *ctx, const ASTExpr *var)
 {
     if (ctx->for_sp <= 0)
     {
         return 0;
     }
 
-    ForFrame *frame = NULL;
     int frame_index = ctx->for_sp - 1;
-
-    if (name)
+    if (var)
     {
         for (int i = ctx->for_sp - 1; i >= 0; i--)
         {
-            if (ctx->for_stack[i].var_name && strcmp(ctx->for_stack[i].var_name, name) == 0)
+            if (for_frame_matches(&ctx->for_stack[i], var))
             {
                 frame_index = i;
                 break;
@@ -1347,68 +2218,60 @@ static int execute_next_for_var(ExecutionContext *ctx, const char *name)
         }
     }
 
-    frame = &ctx->for_stack[frame_index];
+    ForFrame *frame = &ctx->for_stack[frame_index];
 
     /* Check for interrupt (Ctrl-C) - exit FOR loop immediately without consuming the flag */
     if (g_interrupt_flag && *g_interrupt_flag)
     {
-        /* Clean up FOR frame and exit - DON'T reset the flag here */
-        free(frame->var_name);
-        if (frame_index != ctx->for_sp - 1)
-        {
-            memmove(&ctx->for_stack[frame_index], &ctx->for_stack[frame_index + 1],
-                    (ctx->for_sp - frame_index - 1) * sizeof(ForFrame));
-        }
-        ctx->for_sp--;
+        ctx->for_sp = frame_index;
         ctx->next_line_index = frame->next_line_index + 1;
         return 0;
     }
 
     /* Process SDL events periodically to keep UI responsive */
-    static int event_counter = 0;
-    if (++event_counter >= 10000)
+    if (++ctx->event_counter >= 10000)
     {
-        event_counter = 0;
+        ctx->event_counter = 0;
         executor_process_events();
     }
 
-    double loop_value = runtime_get_variable(ctx->runtime, frame->var_name);
-    loop_value += frame->step;
-    runtime_set_variable(ctx->runtime, frame->var_name, loop_value);
-
-    if ((frame->step > 0 && loop_value <= frame->end) || (frame->step < 0 && loop_value >= frame->end))
+    int more;
+    if (frame->keys != NULL)
     {
-        if (frame->next_line_index == frame->for_line_index && frame->body_start != NULL)
+        more = next_map_key(ctx, frame);
+    }
+    else
+    {
+        double loop_value;
+        double *counter = runtime_slot_number(ctx->runtime, frame->slot);
+        if (counter != NULL)
         {
-            ctx->next_line_index = frame->for_line_index;
-            ctx->next_stmt_override = frame->body_start;
+            loop_value = (*counter += frame->step);
         }
         else
         {
-            ctx->next_line_index = frame->for_line_index + 1;
+            loop_value = runtime_get_slot(ctx->runtime, frame->slot, frame->var_name) + frame->step;
+            runtime_set_slot(ctx->runtime, frame->slot, frame->var_name, loop_value);
         }
-        return 1;
+        more = frame->ascending ? loop_value <= frame->end : loop_value >= frame->end;
     }
-    else
+
+    if (more)
     {
-        free(frame->var_name);
-        if (frame_index != ctx->for_sp - 1)
-        {
-            memmove(&ctx->for_stack[frame_index], &ctx->for_stack[frame_index + 1],
-                    (ctx->for_sp - frame_index - 1) * sizeof(ForFrame));
-        }
-        ctx->for_sp--;
-        if (frame->next_line_index == frame->for_line_index && frame->after_next != NULL)
+        ctx->for_sp = frame_index + 1; /* Inner loops left open are abandoned */
+        if (frame->next_line_index == frame->for_line_index && frame->body_start != NULL)
         {
             ctx->next_line_index = frame->for_line_index;
-            ctx->next_stmt_override = frame->after_next;
+            ctx->next_stmt_override = frame->body_start;
         }
         else
         {
-            ctx->next_line_index = frame->next_line_index + 1;
+            ctx->next_line_index = frame->for_line_index + 1;
         }
+        return 1;
     }
-    return 0;
+
+    pop_for_frame(ctx, frame_index);
     return 0;
 }
 
@@ -1456,7 +2319,7 @@ static int execute_while_stmt(ExecutionContext *ctx, ASTStmt *stmt)
                 ctx->next_line_index = ctx->current_line_index + 1;
             }
 
-            if (getenv("AST_DEBUG"))
+            if (ast_debug())
             {
                 fprintf(stderr, "[AST] WHILE reuse line_index=%d sp=%d\n",
                         ctx->current_line_index, ctx->while_sp);
@@ -1507,10 +2370,14 @@ static int execute_while_stmt(ExecutionContext *ctx, ASTStmt *stmt)
         /* Condition is true - push frame and continue to next line */
         ensure_while_capacity(ctx);
         WhileFrame *frame = &ctx->while_stack[ctx->while_sp++];
+        if (ctx->while_sp > ctx->stats->peak_while_depth)
+        {
+            ctx->stats->peak_while_depth = ctx->while_sp;
+        }
         frame->condition = condition;
         frame->while_line_index = ctx->current_line_index;
 
-        if (getenv("AST_DEBUG"))
+        if (ast_debug())
         {
             fprintf(stderr, "[AST] WHILE push line_index=%d sp=%d\n",
                     frame->while_line_index, ctx->while_sp);
@@ -1573,7 +2440,7 @@ static int execute_wend_stmt(ExecutionContext *ctx, ASTStmt *stmt)
     if (cond_value)
     {
         /* Condition is still true - jump back to WHILE */
-        if (getenv("AST_DEBUG"))
+        if (ast_debug())
         {
             fprintf(stderr, "[AST] WEND cond=1 line_index=%d -> while_index=%d sp=%d\n",
                     ctx->current_line_index, frame->while_line_index, ctx->while_sp);
@@ -1583,7 +2450,7 @@ static int execute_wend_stmt(ExecutionContext *ctx, ASTStmt *stmt)
     else
     {
         /* Condition is false - pop frame and continue */
-        if (getenv("AST_DEBUG"))
+        if (ast_debug())
         {
             fprintf(stderr, "[AST] WEND cond=0 line_index=%d pop sp=%d\n",
                     ctx->current_line_index, ctx->while_sp);
@@ -1783,9 +2650,7 @@ static int execute_next_stmt(ExecutionContext *ctx, ASTStmt *stmt)
 
     for (int i = 0; i < stmt->num_exprs; i++)
     {
-        ASTExpr *var = stmt->exprs[i];
-        const char *name = var ? var->var_name : NULL;
-        if (execute_next_for_var(ctx, name))
+        if (execute_next_for_var(ctx, stmt->exprs[i]))
         {
             if (stmt->next != NULL && ctx->next_stmt_override == NULL &&
                 ctx->next_line_index != ctx->current_line_index)
@@ -1939,6 +2804,11 @@ static int execute_procedure_call_stmt(ExecutionContext *ctx, ASTStmt *stmt)
         return -251;
     }
 
+    if (ctx->profiler)
+    {
+        profile_call_enter(ctx->profiler, PROFILE_PROCEDURE, proc_def->var_name);
+    }
+
     /* Create and push a new scope for this procedure call */
     ProcedureScope *new_scope = proc_scope_create();
     proc_scope_push(ctx, new_scope);
@@ -2090,6 +2960,11 @@ static int execute_procedure_call_stmt(ExecutionContext *ctx, ASTStmt *stmt)
     runtime_set_variable(ctx->runtime, "result", return_value);
     ctx->proc_return_value = return_value;
 
+    if (ctx->profiler)
+    {
+        profile_call_exit(ctx->profiler);
+    }
+
     return result;
 }
 
@@ -2108,6 +2983,11 @@ static int execute_dim_stmt(ExecutionContext *ctx, ASTStmt *stmt)
         {
             continue;
         }
+        if (array->type == EXPR_VAR)
+        {
+            runtime_dim_map(ctx->runtime, array->var_name);
+            continue;
+        }
 
         int num_dims = array->num_children;
         if (num_dims <= 0)
@@ -2138,6 +3018,259 @@ static int execute_dim_stmt(ExecutionContext *ctx, ASTStmt *stmt)
     return 0;
 }
 
+/*
+ * An array as a MAT matrix, Dartmouth style: a one-dimensional array is a
+ * row of its elements 1..bound (a column when it is the right operand of a
+ * product), a two-dimensional one has rows 1..bound1 and columns
+ * 1..bound2. Row and column 0 take no part.
+ */
+static int mat_view(ExecutionContext *ctx, ASTExpr *array, int as_column, MatrixView *view, int *num_dims)
+{
+    int bounds[2];
+    double *data = runtime_array_data(ctx->runtime, array->slot, array->var_name, num_dims, bounds);
+    if (data == NULL)
+    {
+        VarType type = runtime_get_slot_type(ctx->runtime, array->slot, array->var_name);
+        return type == VAR_STRING ? -BASIC_ERR_TYPE_MISMATCH : -BASIC_ERR_SUBSCRIPT_OUT_OF_RANGE;
+    }
+
+    if (*num_dims == 1)
+    {
+        view->data = data + 1;
+        view->rows = as_column ? bounds[0] : 1;
+        view->cols = as_column ? 1 : bounds[0];
+        view->stride = as_column ? 1 : bounds[0];
+    }
+    else
+    {
+        view->stride = bounds[1] + 1;
+        view->data = data + view->stride + 1;
+        view->rows = bounds[0];
+        view->cols = bounds[1];
+    }
+    return (view->rows > 0 && view->cols > 0) ? 0 : -BASIC_ERR_SUBSCRIPT_OUT_OF_RANGE;
+}
+
+/* The target as a rows x cols matrix of num_dims dimensions (a
+ * one-dimensional target holds rows * cols elements). It is dimensioned
+ * afresh only when its shape differs, so MAT into an array of the right
+ * size reuses its storage and leaves row and column 0 alone. */
+static int mat_target(ExecutionContext *ctx, ASTExpr *target, int num_dims, int rows, int cols, MatrixView *view)
+{
+    if (runtime_get_slot_type(ctx->runtime, target->slot, target->var_name) == VAR_STRING)
+    {
+        return -BASIC_ERR_TYPE_MISMATCH;
+    }
+
+    int bounds[2] = {num_dims == 1 ? rows * cols : rows, cols};
+    int current_dims;
+    int current[2];
+    double *data = runtime_array_data(ctx->runtime, target->slot, target->var_name, &current_dims, current);
+    if (data == NULL || current_dims != num_dims || current[0] != bounds[0] ||
+        (num_dims == 2 && current[1] != bounds[1]))
+    {
+        runtime_dim_array(ctx->runtime, target->var_name, bounds, num_dims);
+    }
+    return mat_view(ctx, target, 0, view, &current_dims);
+}
+
+/* Store a dense result into a target of the same element count */
+static void mat_store(const MatrixView *dst, double *result)
+{
+    MatrixView src = {result, dst->rows, dst->cols, dst->cols};
+    matrix_copy(dst, &src);
+    free(result);
+}
+
+/* Execute MAT statement: whole-array arithmetic over the element storage */
+static int execute_mat_stmt(ExecutionContext *ctx, ASTStmt *stmt)
+{
+    if (stmt == NULL || stmt->num_exprs == 0)
+    {
+        return 0;
+    }
+
+    ASTExpr *target = stmt->exprs[0];
+    MatrixView dst, a, b;
+    int a_dims, b_dims, err;
+
+    switch ((MatOp)stmt->mode)
+    {
+    case MAT_ZER:
+    case MAT_CON:
+    case MAT_IDN:
+    {
+        int num_dims = stmt->num_exprs - 1;
+        if (num_dims > 2)
+        {
+            return -BASIC_ERR_SUBSCRIPT_OUT_OF_RANGE;
+        }
+        if (num_dims > 0)
+        {
+            int bounds[2] = {1, 1};
+            for (int i = 0; i < num_dims; i++)
+            {
+                bounds[i] = (int)eval_numeric_expr(ctx->runtime, stmt->exprs[i + 1]);
+                if (bounds[i] <= 0)
+                {
+                    return -BASIC_ERR_ILLEGAL_QUANTITY;
+                }
+            }
+            err = mat_target(ctx, target, num_dims, bounds[0], bounds[1], &dst);
+        }
+        else
+        {
+            err = mat_view(ctx, target, 0, &dst, &num_dims);
+        }
+        if (err != 0)
+        {
+            return err;
+        }
+
+        if (stmt->mode == MAT_IDN)
+        {
+            if (num_dims != 2 || dst.rows != dst.cols)
+            {
+                return -BASIC_ERR_SUBSCRIPT_OUT_OF_RANGE;
+            }
+            matrix_identity(&dst);
+        }
+        else
+        {
+            matrix_fill(&dst, stmt->mode == MAT_CON ? 1.0 : 0.0);
+        }
+        return 0;
+    }
+
+    case MAT_COPY:
+    case MAT_SCALE:
+    case MAT_ADD:
+    case MAT_SUB:
+    {
+        int first = stmt->mode == MAT_SCALE ? 2 : 1;
+        int operands = (stmt->mode == MAT_ADD || stmt->mode == MAT_SUB) ? 2 : 1;
+        if (stmt->num_exprs != first + operands)
+        {
+            return -BASIC_ERR_SYNTAX_ERROR;
+        }
+        double k = stmt->mode == MAT_SCALE ? eval_numeric_expr(ctx->runtime, stmt->exprs[1]) : 1.0;
+
+        if ((err = mat_view(ctx, stmt->exprs[first], 0, &a, &a_dims)) != 0)
+        {
+            return err;
+        }
+        if (operands == 2)
+        {
+            if ((err = mat_view(ctx, stmt->exprs[first + 1], 0, &b, &b_dims)) != 0)
+            {
+                return err;
+            }
+            if (b_dims != a_dims || b.rows != a.rows || b.cols != a.cols)
+            {
+                return -BASIC_ERR_SUBSCRIPT_OUT_OF_RANGE;
+            }
+        }
+
+        /* Element-wise, so the target may be an operand; views are taken
+         * again in case dimensioning the target created a variable */
+        if ((err = mat_target(ctx, target, a_dims, a.rows, a.cols, &dst)) != 0)
+        {
+            return err;
+        }
+        mat_view(ctx, stmt->exprs[first], 0, &a, &a_dims);
+        if (operands == 2)
+        {
+            mat_view(ctx, stmt->exprs[first + 1], 0, &b, &b_dims);
+        }
+
+        if (stmt->mode == MAT_ADD)
+        {
+            matrix_add(&dst, &a, &b);
+        }
+        else if (stmt->mode == MAT_SUB)
+        {
+            matrix_sub(&dst, &a, &b);
+        }
+        else if (stmt->mode == MAT_SCALE)
+        {
+            matrix_scale(&dst, k, &a);
+        }
+        else
+        {
+            matrix_copy(&dst, &a);
+        }
+        return 0;
+    }
+
+    case MAT_MUL:
+    {
+        if (stmt->num_exprs != 3)
+        {
+            return -BASIC_ERR_SYNTAX_ERROR;
+        }
+        if ((err = mat_view(ctx, stmt->exprs[1], 0, &a, &a_dims)) != 0 ||
+            (err = mat_view(ctx, stmt->exprs[2], 1, &b, &b_dims)) != 0)
+        {
+            return err;
+        }
+        if (a.cols != b.rows)
+        {
+            return -BASIC_ERR_SUBSCRIPT_OUT_OF_RANGE;
+        }
+
+        /* Into a separate buffer: the target may be either operand */
+        double *result = xmalloc((size_t)a.rows * b.cols * sizeof(double));
+        matrix_multiply(result, &a, &b);
+        int rows = a.rows;
+        int cols = b.cols;
+        if ((err = mat_target(ctx, target, (a_dims == 2 && b_dims == 2) ? 2 : 1, rows, cols, &dst)) != 0)
+        {
+            free(result);
+            return err;
+        }
+        mat_store(&dst, result);
+        return 0;
+    }
+
+    case MAT_TRN:
+    case MAT_INV:
+    {
+        if (stmt->num_exprs != 2)
+        {
+            return -BASIC_ERR_SYNTAX_ERROR;
+        }
+        if ((err = mat_view(ctx, stmt->exprs[1], 0, &a, &a_dims)) != 0)
+        {
+            return err;
+        }
+        if (a_dims != 2 || (stmt->mode == MAT_INV && a.rows != a.cols))
+        {
+            return -BASIC_ERR_SUBSCRIPT_OUT_OF_RANGE;
+        }
+
+        double *result = xmalloc((size_t)a.rows * a.cols * sizeof(double));
+        if (stmt->mode == MAT_TRN)
+        {
+            matrix_transpose(result, &a);
+        }
+        else if (matrix_invert(result, &a) != 0)
+        {
+            free(result);
+            return -BASIC_ERR_DIVISION_BY_ZERO; /* Singular */
+        }
+        if ((err = mat_target(ctx, target, 2, a.cols, a.rows, &dst)) != 0)
+        {
+            free(result);
+            return err;
+        }
+        mat_store(&dst, result);
+        return 0;
+    }
+    }
+
+    return -BASIC_ERR_SYNTAX_ERROR;
+}
+
 /* Execute READ statement */
 static int execute_read_stmt(ExecutionContext *ctx, ASTStmt *stmt)
 {
@@ -2162,7 +3295,25 @@ static int execute_read_stmt(ExecutionContext *ctx, ASTStmt *stmt)
             return -BASIC_ERR_OUT_OF_DATA;
         }
 
-        if (var->type == EXPR_ARRAY)
+        if (var->type == EXPR_ARRAY && var->num_children == 1 &&
+            runtime_is_map(ctx->runtime, var->slot, var->var_name))
+        {
+            char buf[64];
+            const char *text = str_val;
+            if (dtype != VAR_STRING || str_val == NULL)
+            {
+                snprintf(buf, sizeof(buf), "%.15g", num_val);
+                text = buf;
+            }
+            double value = (dtype == VAR_STRING && str_val) ? strtod(str_val, NULL) : num_val;
+            int err = store_map_element(ctx, var, NULL, value, text);
+            if (err != 0)
+            {
+                free(str_val);
+                return err;
+            }
+        }
+        else if (var->type == EXPR_ARRAY)
         {
             int num_indices = var->num_children;
             int *indices = xmalloc(sizeof(int) * (num_indices > 0 ? num_indices : 1));
@@ -2171,37 +3322,37 @@ static int execute_read_stmt(ExecutionContext *ctx, ASTStmt *stmt)
                 indices[j] = (int)eval_numeric_expr(ctx->runtime, var->children[j]);
             }
 
-            VarType vtype = runtime_get_variable_type(ctx->runtime, var->var_name);
+            VarType vtype = runtime_get_slot_type(ctx->runtime, var->slot, var->var_name);
             if (vtype == VAR_STRING)
             {
                 const char *src = (dtype == VAR_STRING && str_val) ? str_val : "";
-                runtime_set_string_array_element(ctx->runtime, var->var_name, indices, num_indices, src);
+                runtime_set_string_array_slot(ctx->runtime, var->slot, var->var_name, indices, num_indices, src);
             }
             else
             {
                 double value = (dtype == VAR_STRING && str_val) ? strtod(str_val, NULL) : num_val;
-                runtime_set_array_element(ctx->runtime, var->var_name, indices, num_indices, value);
+                runtime_set_array_slot(ctx->runtime, var->slot, var->var_name, indices, num_indices, value);
             }
             free(indices);
         }
         else
         {
-            VarType vtype = runtime_get_variable_type(ctx->runtime, var->var_name);
+            VarType vtype = runtime_get_slot_type(ctx->runtime, var->slot, var->var_name);
             if (vtype == VAR_STRING)
             {
                 if (dtype == VAR_STRING && str_val)
-                    runtime_set_string_variable(ctx->runtime, var->var_name, str_val);
+                    runtime_set_string_slot(ctx->runtime, var->slot, var->var_name, str_val);
                 else
                 {
                     char buf[64];
                     snprintf(buf, sizeof(buf), "%.15g", num_val);
-                    runtime_set_string_variable(ctx->runtime, var->var_name, buf);
+                    runtime_set_string_slot(ctx->runtime, var->slot, var->var_name, buf);
                 }
             }
             else
             {
                 double value = (dtype == VAR_STRING && str_val) ? strtod(str_val, NULL) : num_val;
-                runtime_set_variable(ctx->runtime, var->var_name, value);
+                runtime_set_slot(ctx->runtime, var->slot, var->var_name, value);
             }
         }
 
@@ -2357,7 +3508,7 @@ static int execute_resume_stmt(ExecutionContext *ctx, ASTStmt *stmt)
 
     if (!runtime_is_in_error_handler(ctx->runtime))
     {
-        fprintf(stderr, "?RESUME WITHOUT ERROR\n");
+        termio_write_error("?RESUME WITHOUT ERROR\n");
         return 0;
     }
 
@@ -2437,6 +3588,7 @@ static int execute_sleep_stmt(ExecutionContext *ctx, ASTStmt *stmt)
 
     if (usec > 0)
     {
+        termio_flush(); /* Show output produced before the pause */
         usleep(usec);
     }
 
@@ -2601,6 +3753,16 @@ static int execute_cls_stmt(ExecutionContext *ctx, ASTStmt *stmt)
     return 0;
 }
 
+/* SYSTAT: print the runtime statistics so far */
+static int execute_systat_stmt(ExecutionContext *ctx, ASTStmt *stmt)
+{
+    (void)stmt; /* Unused */
+    char *report = runtime_format_stats(ctx->runtime);
+    termio_write(report);
+    free(report);
+    return 0;
+}
+
 static int execute_clear_stmt(ExecutionContext *ctx, ASTStmt *stmt)
 {
     (void)stmt; /* Memory size argument ignored for now */
@@ -2622,6 +3784,24 @@ static int execute_delete_stmt(ExecutionContext *ctx, ASTStmt *stmt)
         return 0;
     }
 
+    /* DELETE name(key$) removes one key from a map */
+    ASTExpr *element = stmt->exprs[0];
+    if (element->type == EXPR_ARRAY)
+    {
+        if (!runtime_is_map(ctx->runtime, element->slot, element->var_name))
+        {
+            return -BASIC_ERR_TYPE_MISMATCH;
+        }
+        char *key = eval_map_key(ctx->runtime, element->children[0]);
+        if (key == NULL)
+        {
+            return -BASIC_ERR_TYPE_MISMATCH;
+        }
+        int deleted = runtime_delete_map_key(ctx->runtime, element->slot, element->var_name, key);
+        free(key);
+        return deleted < 0 ? -BASIC_ERR_ILLEGAL_QUANTITY : 0;
+    }
+
     int start_line, end_line;
 
     /* Check for special markers */
@@ -2697,7 +3877,9 @@ static int execute_merge_stmt(ExecutionContext *ctx, ASTStmt *stmt)
     }
 
     /* Read and parse the merge file */
-    FILE *fp = fopen(filename_expr->str_value, "r");
+    char path[PATH_MAX];
+    const char *resolved = runtime_resolve_path(ctx->runtime, filename_expr->str_value, path, sizeof(path));
+    FILE *fp = resolved ? fopen(resolved, "r") : NULL;
     if (!fp)
     {
         termio_printf("?FILE NOT FOUND\n");
@@ -2734,8 +3916,7 @@ static int execute_merge_stmt(ExecutionContext *ctx, ASTStmt *stmt)
 
     /* Parse the merged program */
     Lexer *lexer = lexer_create(file_content);
-    Token *tokens = lexer_tokenize(lexer);
-    Parser *parser = parser_create(tokens, lexer_token_count(lexer));
+    Parser *parser = parser_create_streaming(lexer);
     Program *merged_program = parse_program(parser);
 
     if (parser_has_error(parser))
@@ -2749,9 +3930,12 @@ static int execute_merge_stmt(ExecutionContext *ctx, ASTStmt *stmt)
         return -1;
     }
 
+    optimize_program(merged_program);
+
     /* Merge parsed lines into current program */
     if (merged_program && merged_program->num_lines > 0)
     {
+        ctx->program->modified = 1;
         for (int i = 0; i < merged_program->num_lines; i++)
         {
             ProgramLine *merged_line = merged_program->lines[i];
@@ -2827,10 +4011,7 @@ static int execute_merge_stmt(ExecutionContext *ctx, ASTStmt *stmt)
     runtime_clear_all(ctx->runtime);
 
     /* Close all open files */
-    for (int i = 0; i < 10; i++)
-    {
-        runtime_close_file(ctx->runtime, i + 1);
-    }
+    runtime_close_all_files(ctx->runtime);
 
     return 0;
 }
@@ -3046,6 +4227,47 @@ static int execute_end_stmt(ExecutionContext *ctx, ASTStmt *stmt)
     return 1; /* Non-zero return signals end */
 }
 
+/* Build the CASE tables of a statement chain; -1 if it contains MERGE */
+static int prepare_chain(ASTStmt *stmt)
+{
+    int result = 0;
+    for (; stmt != NULL; stmt = stmt->next)
+    {
+        if (stmt->type == STMT_CASE && stmt->case_table == NULL)
+        {
+            stmt->case_table = build_case_table(stmt);
+        }
+        else if (stmt->type == STMT_MERGE)
+        {
+            result = -1;
+        }
+        if (prepare_chain(stmt->body) != 0 || prepare_chain(stmt->else_body) != 0)
+        {
+            result = -1;
+        }
+    }
+    return result;
+}
+
+int executor_prepare_program(Program *prog)
+{
+    int result = 0;
+    for (int i = 0; prog != NULL && i < prog->num_lines; i++)
+    {
+        if (prog->lines[i] != NULL && prepare_chain(prog->lines[i]->stmt) != 0)
+        {
+            result = -1;
+        }
+    }
+    return result;
+}
+
+void executor_preload_data(RuntimeState *state, Program *prog)
+{
+    preload_data(state, prog);
+    runtime_set_data_program(state, prog);
+}
+
 /* Main program execution */
 int execute_program(RuntimeState *state, Program *prog)
 {
@@ -3078,11 +4300,22 @@ int execute_program(RuntimeState *state, Program *prog)
     ctx.proc_return_flag = 0;
     ctx.proc_return_value = 0.0;
     ctx.in_procedure = 0;
+    ctx.scope_stack = NULL;
+    ctx.scope_sp = 0;
+    ctx.scope_cap = 0;
+    ctx.profiler = runtime_get_profiler(state);
+    ctx.stats = runtime_stats(state);
+    ctx.statement_limit = statement_limit_for(state);
+    ctx.event_counter = 0;
 
     /* Set execution context so expressions can access it */
     runtime_set_execution_context(state, &ctx);
 
-    preload_data(state, prog);
+    if (runtime_get_data_program(state) != prog)
+    {
+        preload_data(state, prog);
+    }
+    runtime_set_data_program(state, NULL);
 
     /* Execute program line by line */
     int line_counter = 0;
@@ -3103,7 +4336,7 @@ int execute_program(RuntimeState *state, Program *prog)
         ASTStmt *stmt = ctx.next_stmt_override ? ctx.next_stmt_override : prog->lines[ctx.current_line_index]->stmt;
         ctx.next_stmt_override = NULL;
 
-        if (getenv("AST_DEBUG"))
+        if (ast_debug())
         {
             fprintf(stderr, "[AST] Line %d\n", prog->lines[ctx.current_line_index]->line_number);
         }
@@ -3117,7 +4350,15 @@ int execute_program(RuntimeState *state, Program *prog)
 
         if (stmt != NULL)
         {
+            if (ctx.profiler)
+            {
+                profile_line_enter(ctx.profiler, ctx.current_line_index);
+            }
             int result = execute_stmt_internal(&ctx, stmt);
+            if (ctx.profiler)
+            {
+                profile_line_exit(ctx.profiler);
+            }
 
             if (result != 0)
             {
@@ -3167,20 +4408,15 @@ int execute_program(RuntimeState *state, Program *prog)
         ctx.next_line_index = ctx.current_line_index + 1;
     }
 
-    if (ctx.for_stack)
-    {
-        for (int i = 0; i < ctx.for_sp; i++)
-        {
-            free(ctx.for_stack[i].var_name);
-        }
-        free(ctx.for_stack);
-    }
+    free_for_stack(&ctx);
 
     if (ctx.while_stack)
     {
         free(ctx.while_stack);
     }
 
+    free(ctx.scope_stack);
+
     return 0;
 }
 
@@ -3225,11 +4461,22 @@ int execute_program_from_line(RuntimeState *state, Program *prog, int start_line
     ctx.proc_return_flag = 0;
     ctx.proc_return_value = 0.0;
     ctx.in_procedure = 0;
+    ctx.scope_stack = NULL;
+    ctx.scope_sp = 0;
+    ctx.scope_cap = 0;
+    ctx.profiler = runtime_get_profiler(state);
+    ctx.stats = runtime_stats(state);
+    ctx.statement_limit = statement_limit_for(state);
+    ctx.event_counter = 0;
 
     /* Set execution context so expressions can access it */
     runtime_set_execution_context(state, &ctx);
 
-    preload_data(state, prog);
+    if (runtime_get_data_program(state) != prog)
+    {
+        preload_data(state, prog);
+    }
+    runtime_set_data_program(state, NULL);
 
     /* Execute program line by line */
     int line_counter = 0;
@@ -3250,7 +4497,7 @@ int execute_program_from_line(RuntimeState *state, Program *prog, int start_line
         ASTStmt *stmt = ctx.next_stmt_override ? ctx.next_stmt_override : prog->lines[ctx.current_line_index]->stmt;
         ctx.next_stmt_override = NULL;
 
-        if (getenv("AST_DEBUG"))
+        if (ast_debug())
         {
             fprintf(stderr, "[AST] Line %d\n", prog->lines[ctx.current_line_index]->line_number);
         }
@@ -3264,7 +4511,15 @@ int execute_program_from_line(RuntimeState *state, Program *prog, int start_line
 
         if (stmt != NULL)
         {
+            if (ctx.profiler)
+            {
+                profile_line_enter(ctx.profiler, ctx.current_line_index);
+            }
             int result = execute_stmt_internal(&ctx, stmt);
+            if (ctx.profiler)
+            {
+                profile_line_exit(ctx.profiler);
+            }
 
             if (result != 0)
             {
@@ -3314,20 +4569,15 @@ int execute_program_from_line(RuntimeState *state, Program *prog, int start_line
         ctx.next_line_index = ctx.current_line_index + 1;
     }
 
-    if (ctx.for_stack)
-    {
-        for (int i = 0; i < ctx.for_sp; i++)
-        {
-            free(ctx.for_stack[i].var_name);
-        }
-        free(ctx.for_stack);
-    }
+    free_for_stack(&ctx);
 
     if (ctx.while_stack)
     {
         free(ctx.while_stack);
     }
 
+    free(ctx.scope_stack);
+
     return 0;
 }
 
@@ -3358,11 +4608,20 @@ int execute_statement(RuntimeState *state, ASTStmt *stmt, Program *prog)
     ctx.proc_return_flag = 0;
     ctx.proc_return_value = 0.0;
     ctx.in_procedure = 0;
+    ctx.scope_stack = NULL;
+    ctx.scope_sp = 0;
+    ctx.scope_cap = 0;
+    ctx.profiler = runtime_get_profiler(state);
+    ctx.stats = runtime_stats(state);
+    ctx.statement_limit = statement_limit_for(state);
+    ctx.event_counter = 0;
 
     /* Set execution context so expressions can access it */
     runtime_set_execution_context(state, &ctx);
 
-    return execute_stmt_internal(&ctx, stmt);
+    int result = execute_stmt_internal(&ctx, stmt);
+    free_for_stack(&ctx);
+    return result;
 }
 
 /* Execute a procedure call in expression context and return its value */
@@ -3410,6 +4669,11 @@ double executor_execute_procedure_expr(ExecutionContext *ctx, const char *proc_n
         return 0.0;
     }
 
+    if (ctx->profiler)
+    {
+        profile_call_enter(ctx->profiler, PROFILE_PROCEDURE, proc_def->var_name);
+    }
+
     /* Create and push a new scope for this procedure call */
     ProcedureScope *new_scope = proc_scope_create();
     proc_scope_push(ctx, new_scope);
@@ -3549,6 +4813,11 @@ double executor_execute_procedure_expr(ExecutionContext *ctx, const char *proc_n
         proc_scope_free(scope);
     }
 
+    if (ctx->profiler)
+    {
+        profile_call_exit(ctx->profiler);
+    }
+
     return return_value;
 }
 
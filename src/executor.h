@@ -3,19 +3,28 @@
 
 #include "ast.h"
 #include "runtime.h"
+#include "profile.h"
 #include <signal.h>
 #include <time.h>
 
 /* Frame structures for FOR and WHILE loops */
 typedef struct ForFrame
 {
-    char *var_name;
+    const char *var_name; /* The FOR statement's own name; used when unresolved */
+    int slot;             /* Counter's storage slot, -1 = unresolved */
     double end;
     double step;
+    int ascending; /* step > 0 */
     int for_line_index;
     int next_line_index;
     ASTStmt *body_start;
     ASTStmt *after_next;
+    /* FOR EACH: the map, and its keys when the loop started; NULL for FOR.
+     * Frames popped keep their keys until the slot is reused. */
+    ASTExpr *map;
+    MapKey **keys;
+    int num_keys;
+    int key_index; /* Key the variable holds */
 } ForFrame;
 
 typedef struct WhileFrame
@@ -59,11 +68,25 @@ typedef struct
     ProcedureScope *scope_stack; /* Stack of procedure scopes for local variables */
     int scope_sp;                /* Scope stack pointer */
     int scope_cap;               /* Scope stack capacity */
+    Profiler *profiler;          /* RUN PROFILE hooks, NULL when not profiling */
+    RuntimeStats *stats;         /* The runtime's counters (runtime_stats) */
+    unsigned long long statement_limit; /* Statement budget, ULLONG_MAX if unlimited */
+    int event_counter;           /* NEXT passes since SDL events were last processed */
 } ExecutionContext;
 
 /* Executor functions */
 
 int execute_program(RuntimeState *state, Program *prog);
+
+/* Build ahead what execution would otherwise build on first use (CASE
+ * dispatch tables), leaving the program read-only while it runs so that
+ * runtimes on several threads can share it. Returns 0, or -1 if the
+ * program uses MERGE, which rewrites it, and must not be shared. */
+int executor_prepare_program(Program *prog);
+
+/* Load prog's DATA into state now rather than when its next run starts,
+ * so a template runtime can be copied ready to run (--serve) */
+void executor_preload_data(RuntimeState *state, Program *prog);
 int execute_program_from_line(RuntimeState *state, Program *prog, int start_line_num);
 int execute_statement(RuntimeState *state, ASTStmt *stmt, Program *prog);
 
@@ -73,6 +96,10 @@ double executor_execute_procedure_expr(ExecutionContext *ctx, const char *proc_n
 
 void executor_set_interrupt_flag(volatile sig_atomic_t *flag);
 
+/* Threads each PARALLEL FOR is spread over; 0 (the default) for one per
+ * CPU, 1 to run them as ordinary FOR loops. Set before any program runs. */
+void executor_set_parallel_workers(int workers);
+
 int executor_check_interrupt(void);
 
 void executor_trigger_interrupt(void);
@@ -3,114 +3,262 @@
 #include <string.h>
 #include <stdlib.h>
 
-/* Keyword table for recognition */
-static const struct
+/*
+ * Keyword recognition. Identifiers are already upper-cased by the lexer, so
+ * dispatch on length and first letter and finish with one memcmp against
+ * the few candidates left in that bucket.
+ */
+static TokenType lookup_keyword(const char *str, int len)
 {
-    const char *name;
-    TokenType type;
-} keyword_table[] = {
-    {"PRINT", TOK_PRINT},
-    {"USING", TOK_USING},
-    {"INPUT", TOK_INPUT},
-    {"LET", TOK_LET},
-    {"IF", TOK_IF},
-    {"THEN", TOK_THEN},
-    {"ELSE", TOK_ELSE},
-    {"ON", TOK_ON},
-    {"GOTO", TOK_GOTO},
-    {"GOSUB", TOK_GOSUB},
-    {"RETURN", TOK_RETURN},
-    {"PROCEDURE", TOK_PROCEDURE},
-    {"CLASS", TOK_CLASS},
-    {"NEW", TOK_NEW},
-    {"FOR", TOK_FOR},
-    {"TO", TOK_TO},
-    {"STEP", TOK_STEP},
-    {"NEXT", TOK_NEXT},
-    {"DIM", TOK_DIM},
-    {"DATA", TOK_DATA},
-    {"READ", TOK_READ},
-    {"RESTORE", TOK_RESTORE},
-    {"OPEN", TOK_OPEN},
-    {"CLOSE", TOK_CLOSE},
-    {"WRITE", TOK_WRITE},
-    {"GET", TOK_GET},
-    {"PUT", TOK_PUT},
-    {"LINE", TOK_LINE},
-    {"AS", TOK_AS},
-    {"OUTPUT", TOK_OUTPUT},
-    {"APPEND", TOK_APPEND},
-    {"POKE", TOK_POKE},
-    {"SAVE", TOK_SAVE},
-    {"DELETE", TOK_DELETE},
-    {"MERGE", TOK_MERGE},
-    {"ERROR", TOK_ERROR},
-    {"RESUME", TOK_RESUME},
-    {"SLEEP", TOK_SLEEP},
-    {"BEEP", TOK_BEEP},
-    {"CLS", TOK_CLS},
-    {"DEF", TOK_DEF},
-    {"DEFINT", TOK_DEFINT},
-    {"DEFSNG", TOK_DEFSNG},
-    {"DEFDBL", TOK_DEFDBL},
-    {"DEFSTR", TOK_DEFSTR},
-    {"TRON", TOK_TRON},
-    {"TROFF", TOK_TROFF},
-    {"STOP", TOK_STOP},
-    {"CONT", TOK_CONT},
-    {"SOUND", TOK_SOUND},
-    {"TAB", TOK_TAB},
-    {"WHILE", TOK_WHILE},
-    {"WEND", TOK_WEND},
-    {"DO", TOK_DO},
-    {"LOOP", TOK_LOOP},
-    {"UNTIL", TOK_UNTIL},
-    {"EXIT", TOK_EXIT},
-    {"CLEAR", TOK_CLEAR},
-    {"AT", TOK_AT},
-    {"END", TOK_END},
-    {"ENDIF", TOK_ENDIF},
-    {"REM", TOK_REM},
-    {"CASE", TOK_CASE},
-    {"OF", TOK_OF},
-    {"WHEN", TOK_WHEN},
-    {"OTHERWISE", TOK_OTHERWISE},
-    {"ENDCASE", TOK_ENDCASE},
-    {"AND", TOK_AND},
-    {"OR", TOK_OR},
-    {"NOT", TOK_NOT},
-    {"MOD", TOK_MOD},
-    {NULL, TOK_UNKNOWN}};
-
-/* Helper to check if string is a keyword */
-static TokenType lookup_keyword(const char *str)
-{
-    for (int i = 0; keyword_table[i].name != NULL; i++)
+#define KW(s, tok)                              \
+    if (memcmp(str, s, sizeof(s) - 1) == 0)     \
+        return tok;
+
+    switch (len)
     {
-        if (strcasecmp(str, keyword_table[i].name) == 0)
+    case 2:
+        switch (str[0])
+        {
+        case 'A':
+            KW("AS", TOK_AS)
+            KW("AT", TOK_AT)
+            break;
+        case 'D':
+            KW("DO", TOK_DO)
+            break;
+        case 'I':
+            KW("IF", TOK_IF)
+            break;
+        case 'O':
+            KW("ON", TOK_ON)
+            KW("OF", TOK_OF)
+            KW("OR", TOK_OR)
+            break;
+        case 'T':
+            KW("TO", TOK_TO)
+            break;
+        }
+        break;
+    case 3:
+        switch (str[0])
+        {
+        case 'A':
+            KW("AND", TOK_AND)
+            break;
+        case 'C':
+            KW("CLS", TOK_CLS)
+            break;
+        case 'D':
+            KW("DIM", TOK_DIM)
+            KW("DEF", TOK_DEF)
+            break;
+        case 'E':
+            KW("END", TOK_END)
+            break;
+        case 'F':
+            KW("FOR", TOK_FOR)
+            break;
+        case 'G':
+            KW("GET", TOK_GET)
+            break;
+        case 'L':
+            KW("LET", TOK_LET)
+            break;
+        case 'M':
+            KW("MOD", TOK_MOD)
+            KW("MAT", TOK_MAT)
+            break;
+        case 'N':
+            KW("NEW", TOK_NEW)
+            KW("NOT", TOK_NOT)
+            break;
+        case 'P':
+            KW("PUT", TOK_PUT)
+            break;
+        case 'R':
+            KW("REM", TOK_REM)
+            break;
+        case 'T':
+            KW("TAB", TOK_TAB)
+            break;
+        }
+        break;
+    case 4:
+        switch (str[0])
+        {
+        case 'B':
+            KW("BEEP", TOK_BEEP)
+            break;
+        case 'C':
+            KW("CONT", TOK_CONT)
+            KW("CASE", TOK_CASE)
+            break;
+        case 'D':
+            KW("DATA", TOK_DATA)
+            break;
+        case 'E':
+            KW("ELSE", TOK_ELSE)
+            KW("EXIT", TOK_EXIT)
+            break;
+        case 'G':
+            KW("GOTO", TOK_GOTO)
+            break;
+        case 'L':
+            KW("LINE", TOK_LINE)
+            KW("LOOP", TOK_LOOP)
+            break;
+        case 'N':
+            KW("NEXT", TOK_NEXT)
+            break;
+        case 'O':
+            KW("OPEN", TOK_OPEN)
+            break;
+        case 'P':
+            KW("POKE", TOK_POKE)
+            break;
+        case 'R':
+            KW("READ", TOK_READ)
+            break;
+        case 'S':
+            KW("STEP", TOK_STEP)
+            KW("SAVE", TOK_SAVE)
+            KW("STOP", TOK_STOP)
+            break;
+        case 'T':
+            KW("THEN", TOK_THEN)
+            KW("TRON", TOK_TRON)
+            break;
+        case 'W':
+            KW("WEND", TOK_WEND)
+            KW("WHEN", TOK_WHEN)
+            break;
+        }
+        break;
+    case 5:
+        switch (str[0])
+        {
+        case 'C':
+            KW("CLASS", TOK_CLASS)
+            KW("CLOSE", TOK_CLOSE)
+            KW("CLEAR", TOK_CLEAR)
+            break;
+        case 'E':
+            KW("ERROR", TOK_ERROR)
+            KW("ENDIF", TOK_ENDIF)
+            break;
+        case 'G':
+            KW("GOSUB", TOK_GOSUB)
+            break;
+        case 'I':
+            KW("INPUT", TOK_INPUT)
+            break;
+        case 'M':
+            KW("MERGE", TOK_MERGE)
+            break;
+        case 'P':
+            KW("PRINT", TOK_PRINT)
+            break;
+        case 'S':
+            KW("SLEEP", TOK_SLEEP)
+            KW("SOUND", TOK_SOUND)
+            break;
+        case 'T':
+            KW("TROFF", TOK_TROFF)
+            break;
+        case 'U':
+            KW("USING", TOK_USING)
+            KW("UNTIL", TOK_UNTIL)
+            break;
+        case 'W':
+            KW("WRITE", TOK_WRITE)
+            KW("WHILE", TOK_WHILE)
+            break;
+        }
+        break;
+    case 6:
+        switch (str[0])
+        {
+        case 'A':
+            KW("APPEND", TOK_APPEND)
+            break;
+        case 'D':
+            KW("DELETE", TOK_DELETE)
+            KW("DEFINT", TOK_DEFINT)
+            KW("DEFSNG", TOK_DEFSNG)
+            KW("DEFDBL", TOK_DEFDBL)
+            KW("DEFSTR", TOK_DEFSTR)
+            break;
+        case 'O':
+            KW("OUTPUT", TOK_OUTPUT)
+            break;
+        case 'R':
+            KW("RETURN", TOK_RETURN)
+            KW("RESUME", TOK_RESUME)
+            break;
+        case 'S':
+            KW("SYSTAT", TOK_SYSTAT)
+            break;
+        }
+        break;
+    case 7:
+        switch (str[0])
         {
-            return keyword_table[i].type;
+        case 'E':
+            KW("ENDCASE", TOK_ENDCASE)
+            break;
+        case 'R':
+            KW("RESTORE", TOK_RESTORE)
+            break;
         }
+        break;
+    case 8:
+        switch (str[0])
+        {
+        case 'P':
+            KW("PARALLEL", TOK_PARALLEL)
+            break;
+        }
+        break;
+    case 9:
+        switch (str[0])
+        {
+        case 'O':
+            KW("OTHERWISE", TOK_OTHERWISE)
+            break;
+        case 'P':
+            KW("PROCEDURE", TOK_PROCEDURE)
+            break;
+        }
+        break;
     }
+#undef KW
     return TOK_IDENTIFIER;
 }
 
-/* Helper to add token to lexer */
+/*
+ * Reserve len+1 bytes of token text. The arena is sized up front from the
+ * input length (no token's text is longer than the source it was lexed
+ * from), so it never moves and tokens can point straight into it.
+ */
+static char *text_alloc(Lexer *lexer, int len)
+{
+    char *p = lexer->text + lexer->text_len;
+    lexer->text_len += (size_t)len + 1;
+    return p;
+}
+
+/* Helper to emit the token being scanned. Token text is borrowed, not
+ * copied: it must be a string literal or live in the lexer's text arena. */
 static void add_token(Lexer *lexer, TokenType type, const char *value,
                       double num_value, const char *str_value,
                       int line, int col)
 {
-    if (lexer->num_tokens >= lexer->capacity)
-    {
-        lexer->capacity *= 2;
-        lexer->tokens = xrealloc(lexer->tokens, lexer->capacity * sizeof(Token));
-    }
-
-    Token *tok = &lexer->tokens[lexer->num_tokens++];
+    Token *tok = lexer->emit;
+    lexer->emitted = 1;
     tok->type = type;
-    tok->value = value ? xstrdup(value) : NULL;
+    tok->value = (char *)value;
     tok->num_value = num_value;
-    tok->str_value = str_value ? xstrdup(str_value) : NULL;
+    tok->str_value = (char *)str_value;
     tok->line_number = line;
     tok->column_number = col;
 }
@@ -125,129 +273,131 @@ static void skip_whitespace(Lexer *lexer)
     }
 }
 
+/* Copy the source span [start, lexer->pos) into the text arena */
+static char *span_text(Lexer *lexer, int start)
+{
+    int len = lexer->pos - start;
+    char *text = text_alloc(lexer, len);
+    memcpy(text, lexer->input + start, (size_t)len);
+    text[len] = '\0';
+    return text;
+}
+
 /* Lex a number */
 static void lex_number(Lexer *lexer)
 {
     int start_col = lexer->column;
-    char buffer[64];
-    int idx = 0;
+    int start = lexer->pos;
+    const char *in = lexer->input;
 
     /* Integer part */
-    while (isdigit(lexer->input[lexer->pos]) && idx < 63)
+    while (isdigit((unsigned char)in[lexer->pos]))
     {
-        buffer[idx++] = lexer->input[lexer->pos++];
-        lexer->column++;
+        lexer->pos++;
     }
 
     /* Decimal part */
-    if (lexer->input[lexer->pos] == '.')
+    if (in[lexer->pos] == '.')
     {
-        buffer[idx++] = lexer->input[lexer->pos++];
-        lexer->column++;
-
-        while (isdigit(lexer->input[lexer->pos]) && idx < 63)
+        lexer->pos++;
+        while (isdigit((unsigned char)in[lexer->pos]))
         {
-            buffer[idx++] = lexer->input[lexer->pos++];
-            lexer->column++;
+            lexer->pos++;
         }
     }
 
     /* Exponent part */
-    if ((lexer->input[lexer->pos] == 'e' || lexer->input[lexer->pos] == 'E') && idx < 60)
+    if (in[lexer->pos] == 'e' || in[lexer->pos] == 'E')
     {
-        buffer[idx++] = lexer->input[lexer->pos++];
-        lexer->column++;
-
-        if (lexer->input[lexer->pos] == '+' || lexer->input[lexer->pos] == '-')
+        lexer->pos++;
+        if (in[lexer->pos] == '+' || in[lexer->pos] == '-')
         {
-            buffer[idx++] = lexer->input[lexer->pos++];
-            lexer->column++;
+            lexer->pos++;
         }
-
-        while (isdigit(lexer->input[lexer->pos]) && idx < 63)
+        while (isdigit((unsigned char)in[lexer->pos]))
         {
-            buffer[idx++] = lexer->input[lexer->pos++];
-            lexer->column++;
+            lexer->pos++;
         }
     }
 
-    buffer[idx] = '\0';
-    double num = strtod(buffer, NULL);
-
-    add_token(lexer, TOK_NUMBER, buffer, num, NULL, lexer->line, start_col);
+    lexer->column += lexer->pos - start;
+    char *text = span_text(lexer, start);
+    add_token(lexer, TOK_NUMBER, text, strtod(text, NULL), NULL, lexer->line, start_col);
 }
 
 /* Lex a string literal */
 static void lex_string(Lexer *lexer)
 {
     int start_col = lexer->column;
-    char buffer[512];
-    int idx = 0;
+    const char *in = lexer->input;
 
     lexer->pos++; /* Skip opening quote */
-    lexer->column++;
+    int start = lexer->pos;
 
-    while (lexer->input[lexer->pos] != '\0' &&
-           lexer->input[lexer->pos] != '"' &&
-           lexer->input[lexer->pos] != '\n' &&
-           idx < 511)
+    while (in[lexer->pos] != '\0' && in[lexer->pos] != '"' && in[lexer->pos] != '\n')
     {
-        buffer[idx++] = lexer->input[lexer->pos++];
-        lexer->column++;
+        lexer->pos++;
     }
 
-    if (lexer->input[lexer->pos] == '"')
+    /* Both value and str_value share the one copy of the contents */
+    char *text = span_text(lexer, start);
+
+    if (in[lexer->pos] == '"')
     {
         lexer->pos++; /* Skip closing quote */
-        lexer->column++;
     }
+    lexer->column += lexer->pos - start + 1;
 
-    buffer[idx] = '\0';
-    add_token(lexer, TOK_STRING, buffer, 0.0, buffer, lexer->line, start_col);
+    add_token(lexer, TOK_STRING, text, 0.0, text, lexer->line, start_col);
 }
 
 /* Lex an identifier or keyword */
 static void lex_identifier(Lexer *lexer)
 {
     int start_col = lexer->column;
-    char buffer[128];
-    int idx = 0;
-
-    /* First character (letter or underscore) */
-    while ((isalnum(lexer->input[lexer->pos]) ||
-            lexer->input[lexer->pos] == '_' ||
-            lexer->input[lexer->pos] == '$' ||
-            lexer->input[lexer->pos] == '%' ||
-            lexer->input[lexer->pos] == '!' ||
-            lexer->input[lexer->pos] == '#') &&
-           idx < 127)
+    int start = lexer->pos;
+    const char *in = lexer->input;
+
+    while (isalnum((unsigned char)in[lexer->pos]) ||
+           in[lexer->pos] == '_' ||
+           in[lexer->pos] == '$' ||
+           in[lexer->pos] == '%' ||
+           in[lexer->pos] == '!' ||
+           in[lexer->pos] == '#')
     {
-        buffer[idx++] = toupper(lexer->input[lexer->pos]);
         lexer->pos++;
-        lexer->column++;
     }
 
-    buffer[idx] = '\0';
+    int len = lexer->pos - start;
+    char *text = text_alloc(lexer, len);
+    for (int i = 0; i < len; i++)
+    {
+        text[i] = (char)toupper((unsigned char)in[start + i]);
+    }
+    text[len] = '\0';
+    lexer->column += len;
 
     /* Check if it's a keyword */
-    TokenType type = lookup_keyword(buffer);
-    add_token(lexer, type, buffer, 0.0, NULL, lexer->line, start_col);
+    TokenType type = lookup_keyword(text, len);
+    add_token(lexer, type, text, 0.0, NULL, lexer->line, start_col);
 }
 
-/* Main tokenization function */
-Token *lexer_tokenize(Lexer *lexer)
+/*
+ * Scan the next token into *out. Whitespace and comments are skipped; once
+ * the input is exhausted a single TOK_EOF is produced, after which this
+ * returns 0. This is the streaming entry point used by the parser.
+ */
+int lexer_next_token(Lexer *lexer, Token *out)
 {
-    if (lexer == NULL || lexer->input == NULL)
+    if (lexer == NULL || lexer->input == NULL || lexer->done)
     {
-        return NULL;
+        return 0;
     }
 
-    lexer->pos = 0;
-    lexer->line = 1;
-    lexer->column = 1;
-    lexer->num_tokens = 0;
+    lexer->emit = out;
+    lexer->emitted = 0;
 
-    while (lexer->input[lexer->pos] != '\0')
+    while (!lexer->emitted && lexer->input[lexer->pos] != '\0')
     {
         char ch = lexer->input[lexer->pos];
 
@@ -455,8 +605,42 @@ Token *lexer_tokenize(Lexer *lexer)
         }
     }
 
-    /* Add EOF token */
-    add_token(lexer, TOK_EOF, NULL, 0.0, NULL, lexer->line, lexer->column);
+    if (!lexer->emitted)
+    {
+        add_token(lexer, TOK_EOF, NULL, 0.0, NULL, lexer->line, lexer->column);
+        lexer->done = 1;
+    }
+    return 1;
+}
+
+/* Tokenize the whole input into an array (used by --dump-tokens) */
+Token *lexer_tokenize(Lexer *lexer)
+{
+    if (lexer == NULL || lexer->input == NULL)
+    {
+        return NULL;
+    }
+
+    lexer->pos = 0;
+    lexer->line = 1;
+    lexer->column = 1;
+    lexer->text_len = 0;
+    lexer->done = 0;
+    lexer->num_tokens = 0;
+
+    for (;;)
+    {
+        if (lexer->num_tokens >= lexer->capacity)
+        {
+            lexer->capacity = lexer->capacity ? lexer->capacity * 2 : 1024;
+            lexer->tokens = xrealloc(lexer->tokens, lexer->capacity * sizeof(Token));
+        }
+        if (!lexer_next_token(lexer, &lexer->tokens[lexer->num_tokens]))
+        {
+            break;
+        }
+        lexer->num_tokens++;
+    }
 
     return lexer->tokens;
 }
@@ -469,9 +653,14 @@ Lexer *lexer_create(const char *input)
     lexer->pos = 0;
     lexer->line = 1;
     lexer->column = 1;
-    lexer->capacity = 1024;
-    lexer->tokens = xmalloc(lexer->capacity * sizeof(Token));
+    lexer->tokens = NULL;
     lexer->num_tokens = 0;
+    lexer->capacity = 0;
+
+    /* Each token consumes at least one input byte and its text is no longer
+     * than that span, so twice the input length bounds text plus NULs. */
+    lexer->text = xmalloc(2 * (input ? strlen(input) : 0) + 1);
+    lexer->text_len = 0;
     return lexer;
 }
 
@@ -484,19 +673,9 @@ void lexer_free(Lexer *lexer)
     }
     if (lexer->tokens != NULL)
     {
-        for (int i = 0; i < lexer->num_tokens; i++)
-        {
-            if (lexer->tokens[i].value != NULL)
-            {
-                free(lexer->tokens[i].value);
-            }
-            if (lexer->tokens[i].str_value != NULL)
-            {
-                free(lexer->tokens[i].str_value);
-            }
-        }
         free(lexer->tokens);
     }
+    free(lexer->text);
     free(lexer);
 }
 
@@ -708,6 +887,12 @@ const char *token_type_name(TokenType type)
         return "TRON";
     case TOK_TROFF:
         return "TROFF";
+    case TOK_SYSTAT:
+        return "SYSTAT";
+    case TOK_MAT:
+        return "MAT";
+    case TOK_PARALLEL:
+        return "PARALLEL";
     case TOK_STOP:
         return "STOP";
     case TOK_CONT:
@@ -103,6 +103,9 @@ typedef enum
     TOK_DEFSTR,
     TOK_TRON,
     TOK_TROFF,
+    TOK_SYSTAT,
+    TOK_MAT,
+    TOK_PARALLEL,
     TOK_STOP,
     TOK_CONT,
     TOK_SOUND,
@@ -158,6 +161,11 @@ typedef struct
     Token *tokens;
     int num_tokens;
     int capacity;
+    char *text;      /* Arena holding every token's text; tokens point into it */
+    size_t text_len;
+    Token *emit;     /* Destination of the token being scanned */
+    int emitted;
+    int done;        /* TOK_EOF has been produced */
 } Lexer;
 
 /* Lexer functions */
@@ -165,6 +173,7 @@ typedef struct
 Lexer *lexer_create(const char *input);
 void lexer_free(Lexer *lexer);
 Token *lexer_tokenize(Lexer *lexer);
+int lexer_next_token(Lexer *lexer, Token *out);
 int lexer_token_count(Lexer *lexer);
 
 Token lexer_peek(Lexer *lexer);
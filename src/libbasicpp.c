@@ -0,0 +1,367 @@
+#include "basicpp.h"
+#include "common.h"
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "optimize.h"
+#include "symtable.h"
+#include "runtime.h"
+#include "executor.h"
+#include "termio.h"
+#include <errno.h>
+
+/* A compiled program; the AST refers into the lexer and parser */
+struct BasicppProgram
+{
+    char *text;
+    Lexer *lexer;
+    Parser *parser;
+    Program *program;
+    SymbolTable *symtable;
+    int shareable; /* executor_prepare_program found no MERGE */
+};
+
+struct Basicpp
+{
+    BasicppIO io;
+    BasicppProgram *program;
+    int owns_program; /* Loaded by basicpp_load, not lent by basicpp_use */
+    char *directory;
+
+    unsigned long long max_statements;
+    unsigned long long statements;  /* Executed by the last run */
+    volatile sig_atomic_t interrupt; /* The executor's flag, cleared when it stops */
+    volatile sig_atomic_t interrupt_requested;
+    int error_reported;             /* The running program reported an error */
+    char error[256];
+};
+
+static void set_error(Basicpp *bp, const char *fmt, const char *arg)
+{
+    snprintf(bp->error, sizeof(bp->error), fmt, arg);
+}
+
+void basicpp_program_free(BasicppProgram *prog)
+{
+    if (prog == NULL)
+    {
+        return;
+    }
+    symtable_free(prog->symtable);
+    ast_program_free(prog->program);
+    if (prog->parser)
+    {
+        parser_free(prog->parser);
+    }
+    if (prog->lexer)
+    {
+        lexer_free(prog->lexer);
+    }
+    free(prog->text);
+    free(prog);
+}
+
+static void unload(Basicpp *bp)
+{
+    if (bp->owns_program)
+    {
+        basicpp_program_free(bp->program);
+    }
+    bp->program = NULL;
+    bp->owns_program = 0;
+}
+
+/* Console callbacks while the instance runs: errors are remembered for
+ * basicpp_error before they go to the embedder */
+static void sink_write(void *user, const char *text, size_t len)
+{
+    Basicpp *bp = user;
+    if (bp->io.write)
+    {
+        bp->io.write(bp->io.user, text, len);
+    }
+}
+
+static int sink_read_line(void *user, char *buf, int maxlen)
+{
+    Basicpp *bp = user;
+    return bp->io.read_line ? bp->io.read_line(bp->io.user, buf, maxlen) : -1;
+}
+
+static void sink_error(void *user, const char *text)
+{
+    Basicpp *bp = user;
+    bp->error_reported = 1;
+    snprintf(bp->error, sizeof(bp->error), "%s", text);
+    size_t len = strlen(bp->error);
+    if (len > 0 && bp->error[len - 1] == '\n')
+    {
+        bp->error[len - 1] = '\0';
+    }
+
+    if (bp->io.error)
+    {
+        bp->io.error(bp->io.user, text);
+    }
+    else
+    {
+        fputs(text, stderr);
+    }
+}
+
+static void stdio_write(void *user, const char *text, size_t len)
+{
+    (void)user;
+    fwrite(text, 1, len, stdout);
+    fflush(stdout);
+}
+
+static int stdio_read_line(void *user, char *buf, int size)
+{
+    (void)user;
+    if (fgets(buf, size, stdin) == NULL)
+    {
+        return -1;
+    }
+    size_t len = strlen(buf);
+    while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r'))
+    {
+        buf[--len] = '\0';
+    }
+    return (int)len;
+}
+
+Basicpp *basicpp_create(const BasicppIO *io)
+{
+    Basicpp *bp = xcalloc(1, sizeof(Basicpp));
+    if (io)
+    {
+        bp->io = *io;
+    }
+    else
+    {
+        bp->io.write = stdio_write;
+        bp->io.read_line = stdio_read_line;
+    }
+    return bp;
+}
+
+void basicpp_free(Basicpp *bp)
+{
+    if (bp == NULL)
+    {
+        return;
+    }
+    unload(bp);
+    free(bp->directory);
+    free(bp);
+}
+
+/* The CLI loader's rules: drop a leading line number, skip blank lines
+ * and ! comment lines */
+static char *program_text(const char *source)
+{
+    size_t cap = strlen(source) + 2;
+    char *text = xmalloc(cap);
+    size_t len = 0;
+
+    const char *line = source;
+    while (*line)
+    {
+        const char *eol = strchr(line, '\n');
+        const char *end = eol ? eol : line + strlen(line);
+        const char *next = eol ? eol + 1 : end;
+        while (end > line && end[-1] == '\r')
+        {
+            end--;
+        }
+
+        const char *trimmed = line;
+        while (trimmed < end && isspace((unsigned char)*trimmed))
+        {
+            trimmed++;
+        }
+        if (trimmed == end || *trimmed == '!')
+        {
+            line = next;
+            continue;
+        }
+
+        if (isdigit((unsigned char)*trimmed))
+        {
+            const char *after = trimmed;
+            while (after < end && isdigit((unsigned char)*after))
+            {
+                after++;
+            }
+            if (after < end && isspace((unsigned char)*after))
+            {
+                line = after + 1;
+            }
+        }
+
+        memcpy(text + len, line, (size_t)(end - line));
+        len += (size_t)(end - line);
+        text[len++] = '\n';
+        line = next;
+    }
+    text[len] = '\0';
+    return text;
+}
+
+BasicppProgram *basicpp_compile(const char *source, char *error, size_t error_size)
+{
+    BasicppProgram *prog = xcalloc(1, sizeof(BasicppProgram));
+    prog->text = program_text(source ? source : "");
+    prog->lexer = lexer_create(prog->text);
+    prog->parser = parser_create_streaming(prog->lexer);
+    prog->program = parse_program(prog->parser);
+    if (parser_has_error(prog->parser))
+    {
+        snprintf(error, error_size, "Parse error: %s", parser_error_message(prog->parser));
+        basicpp_program_free(prog);
+        return NULL;
+    }
+
+    optimize_program(prog->program);
+
+    prog->symtable = symtable_create();
+    if (symtable_analyze_program(prog->symtable, prog->program) != 0)
+    {
+        snprintf(error, error_size, "Symbol table analysis failed");
+        basicpp_program_free(prog);
+        return NULL;
+    }
+
+    prog->shareable = executor_prepare_program(prog->program) == 0;
+    return prog;
+}
+
+BasicppProgram *basicpp_compile_file(const char *path, char *error, size_t error_size)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        snprintf(error, error_size, "Cannot open %s: %s", path, strerror(errno));
+        return NULL;
+    }
+
+    size_t cap = 4096;
+    size_t len = 0;
+    char *source = xmalloc(cap);
+    size_t got;
+    while ((got = fread(source + len, 1, cap - len - 1, fp)) > 0)
+    {
+        len += got;
+        if (len == cap - 1)
+        {
+            cap *= 2;
+            source = xrealloc(source, cap);
+        }
+    }
+    source[len] = '\0';
+    fclose(fp);
+
+    BasicppProgram *prog = basicpp_compile(source, error, error_size);
+    free(source);
+    return prog;
+}
+
+int basicpp_program_shareable(const BasicppProgram *prog)
+{
+    return prog->shareable;
+}
+
+void basicpp_use(Basicpp *bp, BasicppProgram *prog)
+{
+    unload(bp);
+    bp->program = prog;
+}
+
+BasicppStatus basicpp_load(Basicpp *bp, const char *source)
+{
+    unload(bp);
+    bp->error[0] = '\0';
+    bp->program = basicpp_compile(source, bp->error, sizeof(bp->error));
+    bp->owns_program = 1;
+    return bp->program ? BASICPP_OK : BASICPP_ERROR;
+}
+
+BasicppStatus basicpp_load_file(Basicpp *bp, const char *path)
+{
+    unload(bp);
+    bp->error[0] = '\0';
+    bp->program = basicpp_compile_file(path, bp->error, sizeof(bp->error));
+    bp->owns_program = 1;
+    return bp->program ? BASICPP_OK : BASICPP_ERROR;
+}
+
+void basicpp_set_directory(Basicpp *bp, const char *dir)
+{
+    free(bp->directory);
+    bp->directory = dir ? xstrdup(dir) : NULL;
+}
+
+BasicppStatus basicpp_run(Basicpp *bp)
+{
+    bp->statements = 0;
+    bp->error_reported = 0;
+    bp->interrupt = 0;
+    bp->interrupt_requested = 0;
+    if (bp->program == NULL)
+    {
+        set_error(bp, "%s", "No program loaded");
+        return BASICPP_ERROR;
+    }
+    bp->error[0] = '\0';
+
+    RuntimeState *runtime = runtime_create();
+    runtime_set_statement_limit(runtime, bp->max_statements);
+    runtime_set_directory(runtime, bp->directory);
+    runtime_preallocate(runtime, bp->program->symtable);
+
+    TermioSink sink = {sink_write, sink_read_line, sink_error, bp};
+    termio_set_sink(&sink);
+    executor_set_interrupt_flag(&bp->interrupt);
+
+    execute_program(runtime, bp->program->program);
+
+    executor_set_interrupt_flag(NULL);
+    termio_set_sink(NULL);
+    bp->statements = runtime_stats(runtime)->statements;
+    runtime_preallocate(runtime, NULL);
+    runtime_free(runtime);
+
+    if (bp->interrupt_requested)
+    {
+        set_error(bp, "%s", "Interrupted");
+        return BASICPP_INTERRUPTED;
+    }
+    if (bp->max_statements != 0 && bp->statements > bp->max_statements)
+    {
+        snprintf(bp->error, sizeof(bp->error), "Statement limit exceeded (%llu statements)", bp->max_statements);
+        return BASICPP_LIMIT;
+    }
+    return bp->error_reported ? BASICPP_ERROR : BASICPP_OK;
+}
+
+void basicpp_set_max_statements(Basicpp *bp, unsigned long long limit)
+{
+    bp->max_statements = limit;
+}
+
+void basicpp_interrupt(Basicpp *bp)
+{
+    bp->interrupt_requested = 1;
+    bp->interrupt = 1;
+}
+
+const char *basicpp_error(const Basicpp *bp)
+{
+    return bp->error;
+}
+
+unsigned long long basicpp_statements(const Basicpp *bp)
+{
+    return bp->statements;
+}
@@ -5,8 +5,14 @@
 #include "runtime.h"
 #include "executor.h"
 #include "symtable.h"
+#include "optimize.h"
 #include "compat.h"
 #include "termio.h"
+#include "bpc.h"
+#include "profile.h"
+#include "batch.h"
+#include "serve.h"
+#include "parallel.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -38,6 +44,15 @@ typedef struct
 } StoredLine;
 
 static volatile sig_atomic_t g_interrupt = 0;
+static int g_max_files = MAX_FILES; /* Cap on open file channels (--max-files) */
+static int g_use_cache = 0; /* Use precompiled .bpc files (--cache) */
+static const char *g_cache_dir = NULL; /* Where to keep them (--cache-dir) */
+static int g_profile = 0; /* Profile the program run (--profile) */
+static const char *g_profile_out = NULL; /* Collapsed stacks file (--profile-out) */
+static int g_stats = 0; /* Report resource statistics at exit (--stats) */
+static ExecLimits g_limits; /* --max-statements/-time/-memory/-output, 0 = unlimited */
+static int g_serve = 0; /* Serve runs of the program instead of running it (--serve) */
+static const char *g_serve_socket = NULL; /* Unix socket to serve on (--socket), else stdin */
 static char g_loaded_program_dir[PATH_MAX] = ""; /* Directory of loaded BASIC program */
 
 static void handle_sigint(int sig)
@@ -112,13 +127,45 @@ static char *build_program_text(StoredLine *lines, int count)
         total += (lines[i].text ? strlen(lines[i].text) : 0) + 1;
 
     char *buf = xmalloc(total + 1);
-    buf[0] = '\0';
+    size_t off = 0;
     for (int i = 0; i < count; i++)
     {
         if (lines[i].text)
-            strcat(buf, lines[i].text);
-        strcat(buf, "\n");
+        {
+            size_t len = strlen(lines[i].text);
+            memcpy(buf + off, lines[i].text, len);
+            off += len;
+        }
+        buf[off++] = '\n';
+    }
+    buf[off] = '\0';
+    return buf;
+}
+
+/* Read an entire stream into a NUL-terminated buffer; *out_len gets its length */
+static char *read_whole_file(FILE *fp, size_t *out_len)
+{
+    size_t cap = 4096;
+    if (fseek(fp, 0, SEEK_END) == 0)
+    {
+        long size = ftell(fp);
+        if (size > 0)
+            cap = (size_t)size + 2; /* Room to observe EOF in one read */
+        rewind(fp);
+    }
+
+    char *buf = xmalloc(cap);
+    size_t len = 0;
+    for (;;)
+    {
+        len += fread(buf + len, 1, cap - len - 1, fp);
+        if (len < cap - 1)
+            break;
+        cap *= 2;
+        buf = xrealloc(buf, cap);
     }
+    buf[len] = '\0';
+    *out_len = len;
     return buf;
 }
 
@@ -196,13 +243,20 @@ static int load_program_file(StoredLine **lines, int *count, int *cap, const cha
         return 1;
     }
 
+    size_t size;
+    char *data = read_whole_file(fp, &size);
+    fclose(fp);
+
     clear_program(lines, count, cap);
 
-    char buffer[1024];
-    while (fgets(buffer, sizeof(buffer), fp))
+    char *next;
+    for (char *buffer = data; buffer < data + size; buffer = next)
     {
-        size_t len = strlen(buffer);
-        while (len > 0 && (buffer[len - 1] == '\n' || buffer[len - 1] == '\r'))
+        char *eol = memchr(buffer, '\n', (size_t)(data + size - buffer));
+        next = eol ? eol + 1 : data + size;
+        size_t len = (size_t)((eol ? eol : data + size) - buffer);
+        buffer[len] = '\0';
+        while (len > 0 && buffer[len - 1] == '\r')
         {
             buffer[--len] = '\0';
         }
@@ -233,7 +287,7 @@ static int load_program_file(StoredLine **lines, int *count, int *cap, const cha
         append_line(lines, count, cap, buffer);
     }
 
-    fclose(fp);
+    free(data);
 
     /* Extract directory from resolved_path and store it */
     const char *last_slash = strrchr(resolved_path, '/');
@@ -255,7 +309,8 @@ static int load_program_file(StoredLine **lines, int *count, int *cap, const cha
     return 0;
 }
 
-static int save_program_file(StoredLine *lines, int count, const char *filename)
+/* Write the program to filename; the confirmation names it shown_name */
+static int save_program_file(StoredLine *lines, int count, const char *filename, const char *shown_name)
 {
     /* Resolve file path:
      * 1. If absolute path, use it directly
@@ -312,7 +367,7 @@ static int save_program_file(StoredLine *lines, int count, const char *filename)
         return 1;
     }
 
-    termio_printf("FILE SAVED to %s\n", filename);
+    termio_printf("FILE SAVED to %s\n", shown_name);
     return 0;
 }
 
@@ -326,7 +381,14 @@ static RuntimeState *g_runtime = NULL;
 
 static int save_callback(const char *filename)
 {
-    return save_program_file(g_save_lines, g_save_line_count, filename);
+    char path[PATH_MAX];
+    const char *resolved = runtime_resolve_path(g_runtime, filename, path, sizeof(path));
+    if (resolved == NULL)
+    {
+        termio_printf("?SAVE ERROR: %s\n", strerror(ENAMETOOLONG));
+        return 1;
+    }
+    return save_program_file(g_save_lines, g_save_line_count, resolved, filename);
 }
 
 /* Global delete context for DELETE statement in programs */
@@ -356,8 +418,7 @@ static int run_program_text(RuntimeState *runtime, const char *program_text)
 static int run_program_text_from_line(RuntimeState *runtime, const char *program_text, int start_line_num)
 {
     Lexer *lexer = lexer_create(program_text);
-    Token *tokens = lexer_tokenize(lexer);
-    Parser *parser = parser_create(tokens, lexer_token_count(lexer));
+    Parser *parser = parser_create_streaming(lexer);
     Program *program = parse_program(parser);
 
     if (parser_has_error(parser))
@@ -369,6 +430,8 @@ static int run_program_text_from_line(RuntimeState *runtime, const char *program
         return 1;
     }
 
+    optimize_program(program);
+
     SymbolTable *symtable = symtable_create();
     if (symtable_analyze_program(symtable, program) != 0)
     {
@@ -380,6 +443,8 @@ static int run_program_text_from_line(RuntimeState *runtime, const char *program
         return 1;
     }
 
+    runtime_preallocate(runtime, symtable);
+
     int result;
     if (start_line_num > 0)
     {
@@ -390,6 +455,7 @@ static int run_program_text_from_line(RuntimeState *runtime, const char *program
         result = execute_program(runtime, program);
     }
 
+    runtime_preallocate(runtime, NULL);
     symtable_free(symtable);
     parser_free(parser);
     lexer_free(lexer);
@@ -397,6 +463,216 @@ static int run_program_text_from_line(RuntimeState *runtime, const char *program
     return result;
 }
 
+/*
+ * Parsed form of the stored program, kept across interactive RUNs. Every
+ * top-level unit remembers where it started in the source, so after an
+ * edit only the units overlapping the changed lines are re-parsed; the
+ * units before and after them are carried over as-is.
+ */
+typedef struct
+{
+    char **texts; /* Stored line text the cache was built from */
+    int count;
+    Program *program;
+    SymbolTable *symtable;
+} ProgramCache;
+
+static ProgramCache g_program_cache;
+
+static void program_cache_clear(ProgramCache *cache)
+{
+    for (int i = 0; i < cache->count; i++)
+        free(cache->texts[i]);
+    free(cache->texts);
+    ast_program_free(cache->program);
+    symtable_free(cache->symtable);
+    memset(cache, 0, sizeof(*cache));
+}
+
+static const char *stored_text(const StoredLine *line)
+{
+    return line->text ? line->text : "";
+}
+
+/* True if a unit is the first token on its source line */
+static int unit_starts_line(StoredLine *lines, const ProgramLine *unit)
+{
+    const char *text = stored_text(&lines[unit->src_line - 1]);
+    for (int i = 0; i < unit->src_column - 1; i++)
+    {
+        if (text[i] != ' ' && text[i] != '\t')
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Return the parsed program for the stored lines, re-parsing only what
+ * changed since the previous call. Reports the error and returns NULL if
+ * the program does not parse.
+ */
+static Program *program_cache_get(ProgramCache *cache, StoredLine *lines, int count)
+{
+    if (cache->program && cache->program->modified)
+        program_cache_clear(cache); /* MERGE rewrote it at run time */
+
+    int old_count = cache->count;
+    int prefix = 0;
+    while (prefix < count && prefix < old_count &&
+           strcmp(stored_text(&lines[prefix]), cache->texts[prefix]) == 0)
+        prefix++;
+    if (cache->program && prefix == count && prefix == old_count)
+        return cache->program;
+
+    int suffix = 0;
+    while (suffix < count - prefix && suffix < old_count - prefix &&
+           strcmp(stored_text(&lines[count - 1 - suffix]), cache->texts[old_count - 1 - suffix]) == 0)
+        suffix++;
+
+    Program *old = cache->program;
+    int units = old ? old->num_lines : 0;
+
+    /* Keep leading units whose successor starts inside the unchanged prefix:
+     * parsing them never looked past that successor's first token. The
+     * re-parse has to begin at the start of a source line. */
+    int keep = 0;
+    while (keep + 1 < units && old->lines[keep + 1]->src_line - 1 < prefix)
+        keep++;
+    while (keep > 0 && !unit_starts_line(lines, old->lines[keep]))
+        keep--;
+    int first_line = keep > 0 ? old->lines[keep]->src_line - 1 : 0;
+
+    /* Units lying wholly in the unchanged suffix are places where the new
+     * parse can rejoin the old one; their positions shift by the edit */
+    int shift = count - old_count;
+    int first_resync = keep;
+    while (first_resync < units && old->lines[first_resync]->src_line - 1 < old_count - suffix)
+        first_resync++;
+    int num_resync = units - first_resync;
+    int *resync_lines = NULL;
+    int *resync_columns = NULL;
+    if (num_resync > 0)
+    {
+        resync_lines = xmalloc((size_t)num_resync * sizeof(int));
+        resync_columns = xmalloc((size_t)num_resync * sizeof(int));
+        for (int i = 0; i < num_resync; i++)
+        {
+            resync_lines[i] = old->lines[first_resync + i]->src_line + shift;
+            resync_columns[i] = old->lines[first_resync + i]->src_column;
+        }
+    }
+
+    char *program_text = build_program_text(lines + first_line, count - first_line);
+    Lexer *lexer = lexer_create(program_text);
+    lexer->line = first_line + 1;
+    Parser *parser = parser_create_streaming(lexer);
+    parser_set_resync(parser, resync_lines, resync_columns, num_resync);
+    Program *fresh = parse_program(parser);
+    int hit = parser->resync_hit;
+    int failed = parser_has_error(parser);
+    if (failed)
+        termio_printf("Parse error: %s\n", parser_error_message(parser));
+    parser_free(parser);
+    lexer_free(lexer);
+    free(program_text);
+    free(resync_lines);
+    free(resync_columns);
+
+    if (failed)
+    {
+        ast_program_free(fresh);
+        program_cache_clear(cache);
+        return NULL;
+    }
+    optimize_program(fresh); /* Carried-over units were optimized already */
+
+    /* Splice: kept prefix units, freshly parsed units, rejoined suffix units */
+    int resume = hit >= 0 ? first_resync + hit : units;
+    Program *prog = ast_program_create();
+    for (int i = 0; i < keep; i++)
+        ast_program_add_line(prog, old->lines[i]);
+    for (int i = 0; i < fresh->num_lines; i++)
+        ast_program_add_line(prog, fresh->lines[i]);
+    for (int i = resume; i < units; i++)
+    {
+        old->lines[i]->src_line += shift;
+        ast_program_add_line(prog, old->lines[i]);
+    }
+    for (int i = keep; i < resume; i++)
+    {
+        ast_stmt_free(old->lines[i]->stmt);
+        free(old->lines[i]);
+    }
+    if (old)
+    {
+        old->num_lines = 0;
+        ast_program_free(old);
+    }
+
+    /* Resolution is redone for the whole program: a DEFxxx edit retypes
+     * names everywhere after it, and dropped units must give up their slots.
+     * The walk is cheap next to parsing. */
+    symtable_free(cache->symtable);
+    cache->symtable = symtable_create();
+    if (symtable_analyze_program(cache->symtable, prog) != 0)
+    {
+        termio_printf("Symbol table analysis failed\n");
+        fresh->num_lines = 0;
+        ast_program_free(fresh);
+        cache->program = prog;
+        program_cache_clear(cache);
+        return NULL;
+    }
+
+    /* An edit inside a PARALLEL FOR body leaves the loop itself carried
+     * over, so its checks are made on the whole program */
+    char parallel_msg[512];
+    if (parallel_check_program(prog, 0, parallel_msg, sizeof(parallel_msg)) != 0)
+    {
+        termio_printf("Parse error: %s\n", parallel_msg);
+        fresh->num_lines = 0;
+        ast_program_free(fresh);
+        cache->program = prog;
+        program_cache_clear(cache);
+        return NULL;
+    }
+    fresh->num_lines = 0;
+    ast_program_free(fresh);
+
+    /* Record the text this parse corresponds to, reusing unchanged copies */
+    char **texts = xmalloc((size_t)(count > 0 ? count : 1) * sizeof(char *));
+    for (int i = 0; i < count; i++)
+    {
+        if (i < prefix)
+            texts[i] = cache->texts[i];
+        else if (i >= count - suffix)
+            texts[i] = cache->texts[i - shift];
+        else
+            texts[i] = xstrdup(stored_text(&lines[i]));
+    }
+    for (int i = prefix; i < old_count - suffix; i++)
+        free(cache->texts[i]);
+    free(cache->texts);
+
+    cache->texts = texts;
+    cache->count = count;
+    cache->program = prog;
+    return prog;
+}
+
+/* Detach the profiler, print its report and write the collapsed stacks */
+static void finish_profile(RuntimeState *runtime, Profiler *prof, const Program *program,
+                           const char *stacks_path, FILE *report)
+{
+    runtime_set_profiler(runtime, NULL);
+    profile_report(prof, program, report);
+    if (stacks_path && profile_write_collapsed(prof, program, stacks_path) != 0)
+    {
+        fprintf(stderr, "Cannot write profile stacks to %s\n", stacks_path);
+    }
+    profile_free(prof);
+}
+
 static int starts_with_keyword(const char *line, const char *keyword)
 {
     size_t len = strlen(keyword);
@@ -428,6 +704,7 @@ static void run_interactive(void)
 
     RuntimeState *runtime = runtime_create();
     runtime_set_memory_size(runtime, 32768); /* Default memory size */
+    runtime_set_max_files(runtime, g_max_files);
     executor_set_interrupt_flag(&g_interrupt);
 
     signal(SIGINT, handle_sigint);
@@ -601,7 +878,7 @@ static void run_interactive(void)
             }
             else
             {
-                int ret = save_program_file(lines, line_count, fname);
+                int ret = save_program_file(lines, line_count, fname, fname);
                 if (ret != 0)
                 {
                     /* Error message already printed by save_program_file */
@@ -622,6 +899,7 @@ static void run_interactive(void)
             runtime_free(runtime);
             runtime = runtime_create();
             runtime_set_memory_size(runtime, 32768); /* Default memory size */
+            runtime_set_max_files(runtime, g_max_files);
             g_interrupt = 0;
             continue;
         }
@@ -638,8 +916,7 @@ static void run_interactive(void)
                 compat_clear_violations(g_compat_state);
 
                 Lexer *lexer = lexer_create(program_text);
-                Token *tokens = lexer_tokenize(lexer);
-                Parser *parser = parser_create(tokens, lexer_token_count(lexer));
+                Parser *parser = parser_create_streaming(lexer);
                 Program *program = parse_program(parser);
 
                 if (program)
@@ -655,13 +932,17 @@ static void run_interactive(void)
                 continue;
             }
 
+            /* RUN PROFILE ["stacks file"] */
+            int profile = starts_with_keyword(rest, "PROFILE");
+            char *stacks_path = profile ? parse_filename_arg(rest) : NULL;
+
             /* Parse optional line number argument - no longer supported */
             int start_line_num = -1;
             (void)start_line_num;
 
-            char *program_text = build_program_text(lines, line_count);
             runtime_free(runtime);
             runtime = runtime_create();
+            runtime_set_max_files(runtime, g_max_files);
             g_interrupt = 0;
 
             compat_clear_violations(g_compat_state);
@@ -675,24 +956,24 @@ static void run_interactive(void)
             runtime_set_delete_callback(runtime, delete_callback);
             runtime_set_merge_callback(runtime, merge_callback);
 
-            /* Change to loaded program directory for file I/O */
-            char saved_cwd[PATH_MAX];
-            if (getcwd(saved_cwd, sizeof(saved_cwd)) == NULL)
-            {
-                strcpy(saved_cwd, "."); /* Fallback */
-            }
-
-            if (g_loaded_program_dir[0] != '\0' && chdir(g_loaded_program_dir) == 0)
+            Program *program = program_cache_get(&g_program_cache, lines, line_count);
+            runtime_preallocate(runtime, g_program_cache.symtable);
+            Profiler *prof = (profile && program) ? profile_create() : NULL;
+            runtime_set_profiler(runtime, prof);
+            if (program != NULL) /* Else the parse error was reported */
             {
-                run_program_text(runtime, program_text);
-                chdir(saved_cwd); /* Restore original directory */
+                /* The program's files are relative to the loaded program */
+                runtime_set_directory(runtime, g_loaded_program_dir);
+                execute_program(runtime, program);
+                runtime_set_directory(runtime, NULL);
             }
-            else
+            /* Direct-mode statements are not resolved against this table */
+            runtime_preallocate(runtime, NULL);
+            if (prof)
             {
-                run_program_text(runtime, program_text);
+                finish_profile(runtime, prof, program, stacks_path, stdout);
             }
-
-            free(program_text);
+            free(stacks_path);
 
             /* After program ends, move to new line (PRINT@ may have moved cursor) */
             termio_write("\n");
@@ -718,14 +999,53 @@ static void run_interactive(void)
     }
 
     clear_program(&lines, &line_count, &line_cap);
+    program_cache_clear(&g_program_cache);
     termio_shutdown();
 }
 
+/* A positive count, optionally scaled by a K, M or G suffix (powers of 1024) */
+static int parse_limit_count(const char *text, unsigned long long *out)
+{
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (end == text || errno != 0 || value == 0 || text[0] == '-')
+    {
+        return 0;
+    }
+
+    int shift = 0;
+    switch (toupper((unsigned char)*end))
+    {
+    case 'K':
+        shift = 10;
+        break;
+    case 'M':
+        shift = 20;
+        break;
+    case 'G':
+        shift = 30;
+        break;
+    }
+    if (shift != 0)
+    {
+        end++;
+    }
+    if (*end != '\0' || value > (ULLONG_MAX >> shift))
+    {
+        return 0;
+    }
+    *out = value << shift;
+    return 1;
+}
+
 int main(int argc, char *argv[])
 {
     int strict_mode = 0;
     int dump_tokens = 0;
     const char *filename = NULL;
+    const char *batch_file = NULL;
+    int thread_count = 0;
 
     for (int i = 1; i < argc; i++)
     {
@@ -737,6 +1057,96 @@ int main(int argc, char *argv[])
         {
             dump_tokens = 1;
         }
+        else if (strcmp(argv[i], "--max-files") == 0 && i + 1 < argc)
+        {
+            g_max_files = atoi(argv[++i]);
+            if (g_max_files <= 0)
+            {
+                fprintf(stderr, "Invalid --max-files value: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--cache") == 0)
+        {
+            g_use_cache = 1;
+        }
+        else if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc)
+        {
+            g_use_cache = 1;
+            g_cache_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--profile") == 0)
+        {
+            g_profile = 1;
+        }
+        else if (strcmp(argv[i], "--profile-out") == 0 && i + 1 < argc)
+        {
+            g_profile = 1;
+            g_profile_out = argv[++i];
+        }
+        else if (strcmp(argv[i], "--stats") == 0)
+        {
+            g_stats = 1;
+        }
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+        {
+            batch_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--serve") == 0)
+        {
+            g_serve = 1;
+        }
+        else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+        {
+            g_serve_socket = argv[++i];
+        }
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            char *end;
+            long workers = strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || workers < 1 || workers > 1024)
+            {
+                fprintf(stderr, "Invalid -j value: %s\n", argv[i]);
+                return 1;
+            }
+            thread_count = (int)workers;
+        }
+        else if (strcmp(argv[i], "--max-statements") == 0 && i + 1 < argc)
+        {
+            if (!parse_limit_count(argv[++i], &g_limits.statements))
+            {
+                fprintf(stderr, "Invalid --max-statements value: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--max-time") == 0 && i + 1 < argc)
+        {
+            char *end;
+            g_limits.seconds = strtod(argv[++i], &end);
+            if (end == argv[i] || *end != '\0' || !(g_limits.seconds > 0))
+            {
+                fprintf(stderr, "Invalid --max-time value: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--max-memory") == 0 && i + 1 < argc)
+        {
+            unsigned long long bytes;
+            if (!parse_limit_count(argv[++i], &bytes) || bytes > SIZE_MAX)
+            {
+                fprintf(stderr, "Invalid --max-memory value: %s\n", argv[i]);
+                return 1;
+            }
+            g_limits.memory = (size_t)bytes;
+        }
+        else if (strcmp(argv[i], "--max-output") == 0 && i + 1 < argc)
+        {
+            if (!parse_limit_count(argv[++i], &g_limits.output))
+            {
+                fprintf(stderr, "Invalid --max-output value: %s\n", argv[i]);
+                return 1;
+            }
+        }
         else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0)
         {
             printf("TRS-80 BASIC Interpreter - AST Implementation\n\n");
@@ -744,6 +1154,21 @@ int main(int argc, char *argv[])
             printf("Options:\n");
             printf("  --strict        Enforce TRS-80 Level II BASIC compatibility\n");
             printf("  --dump-tokens   Print token stream and exit\n");
+            printf("  --max-files N   Maximum number of open file channels (default %d)\n", MAX_FILES);
+            printf("  --cache         Reuse a precompiled FILE.bpc, writing it if stale\n");
+            printf("  --cache-dir DIR Keep precompiled programs in DIR, named by content hash\n");
+            printf("  --profile       Report time per line, procedure and builtin on stderr\n");
+            printf("  --profile-out F Also write collapsed stacks (flamegraph input) to F\n");
+            printf("  --stats         Report statements, allocations and stack depths on stderr\n");
+            printf("  --batch JOBS    Run the programs listed in JOBS (\"program [output]\" lines)\n");
+            printf("  -j N            Batch worker threads, or threads per PARALLEL FOR (default: one per CPU)\n");
+            printf("  --serve         Serve \"RUN <n>\" requests for the program on stdin\n");
+            printf("  --socket PATH   With --serve, listen on a Unix socket instead\n");
+            printf("  --max-statements N  Stop after N statements (per job or request)\n");
+            printf("  --max-time SECS     Stop after SECS seconds of wall-clock time (per request)\n");
+            printf("  --max-memory BYTES  Cap the interpreter's heap (K, M, G suffixes; per request)\n");
+            printf("  --max-output BYTES  Cap console output (K, M, G suffixes; per job or request)\n");
+            printf("                      A limit ends the run with exit status %d\n", ERR_LIMIT_EXCEEDED);
             printf("  --help, -h      Show this help message\n\n");
             printf("Interactive commands:\n");
             printf("  NEW         Clear program\n");
@@ -751,6 +1176,7 @@ int main(int argc, char *argv[])
             printf("  LIST        Display program\n");
             printf("  RUN         Execute program\n");
             printf("  RUN CHECK   Check TRS-80 compatibility\n");
+            printf("  RUN PROFILE Execute program and report where time went\n");
             printf("  LOAD \"file\" Load program from file\n");
             printf("  SAVE \"file\" Save program to file\n");
             printf("  SYSTEM      Exit interpreter\n\n");
@@ -764,6 +1190,37 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (batch_file != NULL)
+    {
+        /* Statement and output budgets belong to each job; time and memory
+         * stay process-wide */
+        ExecLimits process_limits = g_limits;
+        process_limits.statements = 0;
+        process_limits.output = 0;
+        if (limits_set(&process_limits) != 0)
+        {
+            fprintf(stderr, "Warning: the operating system refused a --max-time or --max-memory limit\n");
+        }
+        /* The jobs already keep every thread busy */
+        executor_set_parallel_workers(1);
+        return batch_run(batch_file, thread_count, &g_limits);
+    }
+
+    executor_set_parallel_workers(thread_count);
+
+    if (g_serve && filename == NULL)
+    {
+        fprintf(stderr, "--serve needs a program\n");
+        return 1;
+    }
+
+    /* A server applies the limits to each request instead */
+    ExecLimits no_limits = {0, 0, 0, 0};
+    if (limits_set(g_serve ? &no_limits : &g_limits) != 0)
+    {
+        fprintf(stderr, "Warning: the operating system refused a --max-time or --max-memory limit\n");
+    }
+
     g_compat_state = compat_init(strict_mode);
 
     if (filename == NULL)
@@ -826,10 +1283,10 @@ int main(int argc, char *argv[])
     char *program_text = build_program_text(lines, line_count);
 
     Lexer *lexer = lexer_create(program_text);
-    Token *tokens = lexer_tokenize(lexer);
 
     if (dump_tokens)
     {
+        Token *tokens = lexer_tokenize(lexer);
         int num_tokens = lexer_token_count(lexer);
         for (int i = 0; i < num_tokens; i++)
         {
@@ -844,21 +1301,41 @@ int main(int argc, char *argv[])
         return 0;
     }
 
-    Parser *parser = parser_create(tokens, lexer_token_count(lexer));
-    Program *program = parse_program(parser);
+    /* A precompiled program keyed by the text's hash skips parsing */
+    Parser *parser = NULL;
+    Program *program = NULL;
+    char *cache_path = NULL;
+    size_t text_len = strlen(program_text);
+    uint64_t text_hash = 0;
+    if (g_use_cache)
+    {
+        text_hash = bpc_hash(program_text, text_len);
+        cache_path = bpc_cache_path(file_to_run, g_cache_dir, text_hash);
+        program = bpc_load(cache_path, text_hash, text_len, strict_mode);
+    }
+    int from_cache = program != NULL;
 
-    if (parser_has_error(parser))
+    if (!from_cache)
     {
-        termio_printf("Parse error: %s\n", parser_error_message(parser));
-        parser_free(parser);
-        lexer_free(lexer);
-        ast_program_free(program);
-        free(program_text);
-        clear_program(&lines, &line_count, &line_cap);
-        return 1;
+        parser = parser_create_streaming(lexer);
+        program = parse_program(parser);
+
+        if (parser_has_error(parser))
+        {
+            termio_printf("Parse error: %s\n", parser_error_message(parser));
+            parser_free(parser);
+            lexer_free(lexer);
+            ast_program_free(program);
+            free(program_text);
+            free(cache_path);
+            clear_program(&lines, &line_count, &line_cap);
+            return 1;
+        }
+        optimize_program(program); /* Cached programs are stored optimized */
     }
 
     RuntimeState *runtime = runtime_create();
+    runtime_set_max_files(runtime, g_max_files);
     g_save_lines = lines;
     g_save_line_count = line_count;
     g_save_lines_cap = line_cap;
@@ -870,6 +1347,7 @@ int main(int argc, char *argv[])
     executor_set_interrupt_flag(&g_interrupt);
     signal(SIGINT, handle_sigint);
 
+    /* Resolution is not cached: it runs on loaded programs too */
     SymbolTable *symtable = symtable_create();
     if (symtable_analyze_program(symtable, program) != 0)
     {
@@ -880,25 +1358,35 @@ int main(int argc, char *argv[])
         lexer_free(lexer);
         ast_program_free(program);
         free(program_text);
+        free(cache_path);
         return 1;
     }
 
-    /* Change to program directory for file I/O (batch mode) */
-    char saved_cwd[PATH_MAX];
-    if (getcwd(saved_cwd, sizeof(saved_cwd)) == NULL)
+    /* Save before running: MERGE may rewrite the program */
+    if (cache_path && !from_cache)
     {
-        strcpy(saved_cwd, "."); /* Fallback */
+        bpc_save(cache_path, program, text_hash, text_len, strict_mode);
     }
+    free(cache_path);
 
-    int result;
-    if (g_loaded_program_dir[0] != '\0' && chdir(g_loaded_program_dir) == 0)
+    runtime_preallocate(runtime, symtable);
+
+    Profiler *prof = g_profile && !g_serve ? profile_create() : NULL;
+    runtime_set_profiler(runtime, prof);
+
+    /* File I/O is relative to the program's directory */
+    runtime_set_directory(runtime, g_loaded_program_dir);
+    int result = g_serve ? serve_run(runtime, program, g_serve_socket, &g_limits) : execute_program(runtime, program);
+
+    if (prof)
     {
-        result = execute_program(runtime, program);
-        chdir(saved_cwd); /* Restore original directory */
+        finish_profile(runtime, prof, program, g_profile_out, stderr);
     }
-    else
+    if (g_stats && !g_serve)
     {
-        result = execute_program(runtime, program);
+        char *report = runtime_format_stats(runtime);
+        fputs(report, stderr);
+        free(report);
     }
 
     clear_program(&lines, &line_count, &line_cap);
@@ -0,0 +1,220 @@
+#include "matrix.h"
+#include <math.h>
+
+/* Tile edge for the blocked product and transpose: three 64 x 64 tiles of
+ * doubles fit in a typical 256K L2 */
+#define MATRIX_BLOCK 64
+
+static int min_int(int a, int b)
+{
+    return a < b ? a : b;
+}
+
+void matrix_copy(const MatrixView *dst, const MatrixView *a)
+{
+    if (dst->data == a->data)
+    {
+        return;
+    }
+    for (int i = 0; i < dst->rows; i++)
+    {
+        memmove(dst->data + (size_t)i * dst->stride, a->data + (size_t)i * a->stride,
+                (size_t)dst->cols * sizeof(double));
+    }
+}
+
+void matrix_add(const MatrixView *dst, const MatrixView *a, const MatrixView *b)
+{
+    for (int i = 0; i < dst->rows; i++)
+    {
+        double *d = dst->data + (size_t)i * dst->stride;
+        const double *x = a->data + (size_t)i * a->stride;
+        const double *y = b->data + (size_t)i * b->stride;
+        for (int j = 0; j < dst->cols; j++)
+        {
+            d[j] = x[j] + y[j];
+        }
+    }
+}
+
+void matrix_sub(const MatrixView *dst, const MatrixView *a, const MatrixView *b)
+{
+    for (int i = 0; i < dst->rows; i++)
+    {
+        double *d = dst->data + (size_t)i * dst->stride;
+        const double *x = a->data + (size_t)i * a->stride;
+        const double *y = b->data + (size_t)i * b->stride;
+        for (int j = 0; j < dst->cols; j++)
+        {
+            d[j] = x[j] - y[j];
+        }
+    }
+}
+
+void matrix_scale(const MatrixView *dst, double k, const MatrixView *a)
+{
+    for (int i = 0; i < dst->rows; i++)
+    {
+        double *d = dst->data + (size_t)i * dst->stride;
+        const double *x = a->data + (size_t)i * a->stride;
+        for (int j = 0; j < dst->cols; j++)
+        {
+            d[j] = k * x[j];
+        }
+    }
+}
+
+void matrix_fill(const MatrixView *dst, double value)
+{
+    for (int i = 0; i < dst->rows; i++)
+    {
+        double *d = dst->data + (size_t)i * dst->stride;
+        for (int j = 0; j < dst->cols; j++)
+        {
+            d[j] = value;
+        }
+    }
+}
+
+void matrix_identity(const MatrixView *dst)
+{
+    matrix_fill(dst, 0.0);
+    for (int i = 0; i < dst->rows; i++)
+    {
+        dst->data[(size_t)i * dst->stride + i] = 1.0;
+    }
+}
+
+/*
+ * Blocked i-k-j product. The inner loop adds a scaled row of b to a row
+ * of out, both contiguous; each element still sums its terms in k order,
+ * so the result matches the textbook triple loop exactly.
+ */
+void matrix_multiply(double *out, const MatrixView *a, const MatrixView *b)
+{
+    int n = a->rows;
+    int m = a->cols;
+    int p = b->cols;
+    memset(out, 0, (size_t)n * p * sizeof(double));
+
+    for (int ii = 0; ii < n; ii += MATRIX_BLOCK)
+    {
+        int i_end = min_int(ii + MATRIX_BLOCK, n);
+        for (int kk = 0; kk < m; kk += MATRIX_BLOCK)
+        {
+            int k_end = min_int(kk + MATRIX_BLOCK, m);
+            for (int jj = 0; jj < p; jj += MATRIX_BLOCK)
+            {
+                int j_end = min_int(jj + MATRIX_BLOCK, p);
+                for (int i = ii; i < i_end; i++)
+                {
+                    double *restrict c = out + (size_t)i * p;
+                    const double *arow = a->data + (size_t)i * a->stride;
+                    for (int k = kk; k < k_end; k++)
+                    {
+                        const double aik = arow[k];
+                        const double *restrict brow = b->data + (size_t)k * b->stride;
+                        for (int j = jj; j < j_end; j++)
+                        {
+                            c[j] += aik * brow[j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void matrix_transpose(double *out, const MatrixView *a)
+{
+    int n = a->rows;
+    int m = a->cols;
+    for (int ii = 0; ii < n; ii += MATRIX_BLOCK)
+    {
+        int i_end = min_int(ii + MATRIX_BLOCK, n);
+        for (int jj = 0; jj < m; jj += MATRIX_BLOCK)
+        {
+            int j_end = min_int(jj + MATRIX_BLOCK, m);
+            for (int i = ii; i < i_end; i++)
+            {
+                const double *arow = a->data + (size_t)i * a->stride;
+                for (int j = jj; j < j_end; j++)
+                {
+                    out[(size_t)j * n + i] = arow[j];
+                }
+            }
+        }
+    }
+}
+
+/* Gauss-Jordan elimination with partial pivoting, carried out on a dense
+ * copy of a while the same row operations turn the identity into out */
+int matrix_invert(double *out, const MatrixView *a)
+{
+    int n = a->rows;
+    double *work = xmalloc((size_t)n * n * sizeof(double));
+    MatrixView w = {work, n, n, n};
+    MatrixView o = {out, n, n, n};
+    matrix_copy(&w, a);
+    matrix_identity(&o);
+
+    for (int col = 0; col < n; col++)
+    {
+        int pivot = col;
+        for (int r = col + 1; r < n; r++)
+        {
+            if (fabs(work[(size_t)r * n + col]) > fabs(work[(size_t)pivot * n + col]))
+            {
+                pivot = r;
+            }
+        }
+        if (work[(size_t)pivot * n + col] == 0.0)
+        {
+            free(work);
+            return -1;
+        }
+
+        double *prow = work + (size_t)col * n;
+        double *orow = out + (size_t)col * n;
+        if (pivot != col)
+        {
+            double *qrow = work + (size_t)pivot * n;
+            double *qout = out + (size_t)pivot * n;
+            for (int j = 0; j < n; j++)
+            {
+                double t = prow[j];
+                prow[j] = qrow[j];
+                qrow[j] = t;
+                t = orow[j];
+                orow[j] = qout[j];
+                qout[j] = t;
+            }
+        }
+
+        double scale = 1.0 / prow[col];
+        for (int j = 0; j < n; j++)
+        {
+            prow[j] *= scale;
+            orow[j] *= scale;
+        }
+
+        for (int r = 0; r < n; r++)
+        {
+            double f = work[(size_t)r * n + col];
+            if (r == col || f == 0.0)
+            {
+                continue;
+            }
+            double *restrict wr = work + (size_t)r * n;
+            double *restrict outr = out + (size_t)r * n;
+            for (int j = 0; j < n; j++)
+            {
+                wr[j] -= f * prow[j];
+                outr[j] -= f * orow[j];
+            }
+        }
+    }
+
+    free(work);
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include "common.h"
+
+/*
+ * Whole-array kernels for the MAT statements
+ *
+ * A MatrixView is a rows x cols window onto an array's double storage.
+ * Columns are always adjacent, so every inner loop here runs over
+ * contiguous memory with no per-element lookups and is left to the
+ * compiler to vectorize. Results that depend on more than the matching
+ * element (product, transpose, inverse) go to a separate dense buffer, so
+ * the target may be one of the operands.
+ */
+
+typedef struct
+{
+    double *data; /* First element */
+    int rows;
+    int cols;
+    int stride; /* Elements from one row to the next */
+} MatrixView;
+
+/* dst = a, dst = a + b, dst = a - b and dst = k * a; same shapes throughout */
+void matrix_copy(const MatrixView *dst, const MatrixView *a);
+void matrix_add(const MatrixView *dst, const MatrixView *a, const MatrixView *b);
+void matrix_sub(const MatrixView *dst, const MatrixView *a, const MatrixView *b);
+void matrix_scale(const MatrixView *dst, double k, const MatrixView *a);
+
+/* Every element set to value; the identity (dst must be square) */
+void matrix_fill(const MatrixView *dst, double value);
+void matrix_identity(const MatrixView *dst);
+
+/* out = a * b as a dense a->rows x b->cols buffer; a->cols == b->rows */
+void matrix_multiply(double *out, const MatrixView *a, const MatrixView *b);
+
+/* out = the transpose of a, dense a->cols x a->rows */
+void matrix_transpose(double *out, const MatrixView *a);
+
+/* out = the inverse of square a, dense; -1 if a is singular */
+int matrix_invert(double *out, const MatrixView *a);
+
+#endif /* MATRIX_H */
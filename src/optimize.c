@@ -0,0 +1,216 @@
+#include "optimize.h"
+#include <math.h>
+
+static void optimize_chain(ASTStmt **link, int keep_head);
+
+/* Turn expr into a numeric literal in place, so parents keep their pointer */
+static void make_number(ASTExpr *expr, double value)
+{
+    for (int i = 0; i < expr->num_children; i++)
+    {
+        ast_expr_free(expr->children[i]);
+    }
+    free(expr->children);
+    expr->children = NULL;
+    expr->num_children = 0;
+    expr->capacity_children = 0;
+    expr->type = EXPR_NUMBER;
+    expr->op = OP_NONE;
+    expr->num_value = value;
+}
+
+/* Same results as the numeric operators in eval.c. Returns 0 for operators
+ * that are not folded (string operators, division by zero). */
+static int fold_binary(OpType op, double left, double right, double *out)
+{
+    switch (op)
+    {
+    case OP_ADD:
+        *out = left + right;
+        return 1;
+    case OP_SUB:
+        *out = left - right;
+        return 1;
+    case OP_MUL:
+        *out = left * right;
+        return 1;
+    case OP_DIV:
+        if (right == 0.0)
+            return 0; /* Leave the error to run time */
+        *out = left / right;
+        return 1;
+    case OP_MOD:
+        *out = (right != 0.0) ? fmod(left, right) : 0.0;
+        return 1;
+    case OP_POWER:
+        *out = pow(left, right);
+        return 1;
+    case OP_EQ:
+        *out = (fabs(left - right) < 1e-9) ? -1.0 : 0.0;
+        return 1;
+    case OP_NE:
+        *out = (fabs(left - right) >= 1e-9) ? -1.0 : 0.0;
+        return 1;
+    case OP_LT:
+        *out = (left < right) ? -1.0 : 0.0;
+        return 1;
+    case OP_LE:
+        *out = (left <= right) ? -1.0 : 0.0;
+        return 1;
+    case OP_GT:
+        *out = (left > right) ? -1.0 : 0.0;
+        return 1;
+    case OP_GE:
+        *out = (left >= right) ? -1.0 : 0.0;
+        return 1;
+    case OP_AND:
+        *out = (left != 0.0 && right != 0.0) ? -1.0 : 0.0;
+        return 1;
+    case OP_OR:
+        *out = (left != 0.0 || right != 0.0) ? -1.0 : 0.0;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Non-zero if 1/c is exact, i.e. c is a power of two whose reciprocal is
+ * a normal double; then x / c and x * (1/c) round identically */
+static int exact_reciprocal(double c)
+{
+    int exp;
+    double mant = frexp(c, &exp);
+    return (mant == 0.5 || mant == -0.5) && 1 - exp >= -1022 && 1 - exp <= 1023;
+}
+
+static void optimize_binary(ASTExpr *expr)
+{
+    ASTExpr *left = expr->children[0];
+    ASTExpr *right = expr->children[1];
+    if (left == NULL || right == NULL)
+        return;
+
+    double value;
+    if (left->type == EXPR_NUMBER && right->type == EXPR_NUMBER)
+    {
+        if (fold_binary(expr->op, left->num_value, right->num_value, &value))
+            make_number(expr, value);
+        return;
+    }
+
+    if (right->type != EXPR_NUMBER)
+        return;
+
+    /* X ^ 2 -> X * X for a plain variable. The product is correctly
+     * rounded, so it is never less accurate than pow(). X ^ 3 is left
+     * alone: X * X * X rounds twice and can differ in the last digit. */
+    if (expr->op == OP_POWER && left->type == EXPR_VAR && right->num_value == 2.0)
+    {
+        ast_expr_free(right);
+        expr->op = OP_MUL;
+        expr->children[1] = ast_expr_copy(left);
+        return;
+    }
+
+    /* X / 2^k -> X * 2^-k */
+    if (expr->op == OP_DIV && exact_reciprocal(right->num_value))
+    {
+        expr->op = OP_MUL;
+        right->num_value = 1.0 / right->num_value;
+    }
+}
+
+void optimize_expr(ASTExpr *expr)
+{
+    if (expr == NULL)
+    {
+        return;
+    }
+
+    for (int i = 0; i < expr->num_children; i++)
+    {
+        optimize_expr(expr->children[i]);
+    }
+    optimize_expr(expr->member_obj);
+
+    if (expr->type == EXPR_BINARY_OP && expr->num_children == 2)
+    {
+        optimize_binary(expr);
+    }
+    else if (expr->type == EXPR_UNARY_OP && expr->num_children == 1 &&
+             expr->children[0] && expr->children[0]->type == EXPR_NUMBER)
+    {
+        double operand = expr->children[0]->num_value;
+        switch (expr->op)
+        {
+        case OP_NEG:
+            make_number(expr, -operand);
+            break;
+        case OP_PLUS:
+            make_number(expr, operand);
+            break;
+        case OP_NOT:
+            make_number(expr, operand != 0.0 ? 0.0 : -1.0);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static void optimize_stmt(ASTStmt *stmt)
+{
+    /* DATA items are read back as literals by preload_data; leave them */
+    if (stmt->type != STMT_DATA)
+    {
+        for (int i = 0; i < stmt->num_exprs; i++)
+        {
+            optimize_expr(stmt->exprs[i]);
+        }
+    }
+    for (int i = 0; i < stmt->num_call_args; i++)
+    {
+        optimize_expr(stmt->call_args[i]);
+    }
+    optimize_chain(&stmt->body, 0);
+    optimize_chain(&stmt->else_body, 0);
+}
+
+/* Optimize a statement chain, unlinking REMs. A lone REM body is kept so
+ * the owner's shape is unchanged. A program line keeps its head statement
+ * (keep_head): DATA preloading only looks at line heads. */
+static void optimize_chain(ASTStmt **link, int keep_head)
+{
+    int head = 1;
+    while (*link != NULL)
+    {
+        ASTStmt *stmt = *link;
+        if (stmt->type == STMT_REM && !(head && keep_head) && (!head || stmt->next))
+        {
+            *link = stmt->next;
+            stmt->next = NULL;
+            ast_stmt_free(stmt);
+            continue;
+        }
+
+        optimize_stmt(stmt);
+        link = &stmt->next;
+        head = 0;
+    }
+}
+
+void optimize_program(Program *prog)
+{
+    if (prog == NULL)
+    {
+        return;
+    }
+
+    for (int i = 0; i < prog->num_lines; i++)
+    {
+        if (prog->lines[i] != NULL)
+        {
+            optimize_chain(&prog->lines[i]->stmt, 1);
+        }
+    }
+}
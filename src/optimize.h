@@ -0,0 +1,19 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "common.h"
+#include "ast.h"
+
+/*
+ * AST optimization pass, run between parsing and symbol resolution.
+ *
+ * Folds operator subtrees whose operands are all literals, rewrites X ^ 2
+ * as X * X and division by a power of two as multiplication by its exact
+ * reciprocal, and unlinks REM statements from statement chains. Nothing
+ * that can raise a run-time error is folded.
+ */
+
+void optimize_program(Program *prog);
+void optimize_expr(ASTExpr *expr);
+
+#endif /* OPTIMIZE_H */
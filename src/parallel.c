@@ -0,0 +1,613 @@
+#include "parallel.h"
+#include <stdarg.h>
+#include <strings.h>
+
+/* Deepest chain of FN calls followed into DEF FN bodies */
+#define PARALLEL_FN_DEPTH 8
+
+/* Builtins whose result depends on, or changes, state outside the
+ * iteration: the random sequence, the keyboard, files, the console */
+static const char *const unsafe_builtins[] = {"RND", "INKEY$", "USR", "EOF", "LOC", "LOF", "POS", "POINT", "FRE", NULL};
+
+typedef enum
+{
+    USE_READ,   /* Read before anything wrote it: shared */
+    USE_PRIVATE /* Written first, unconditionally: private to the iteration */
+} UseKind;
+
+typedef struct
+{
+    const char *name;
+    UseKind kind;
+} VarUse;
+
+typedef struct
+{
+    const Program *prog;
+    const ASTStmt *loop; /* The PARALLEL FOR being checked */
+    int src_line;        /* Source line of the statement being checked */
+    VarUse *uses;        /* First use of each scalar in the body, in order */
+    int num_uses;
+    int capacity_uses;
+    int conditional;     /* Inside IF, CASE, WHILE or DO */
+    const ASTStmt *fn;   /* DEF FN whose body is being followed, or NULL */
+    int fn_depth;
+    char *msg;
+    size_t size;
+    int failed;
+} LoopCheck;
+
+static void check_expr(LoopCheck *check, const ASTExpr *expr);
+
+static void fail(LoopCheck *check, const char *fmt, ...)
+{
+    if (check->failed)
+    {
+        return;
+    }
+    check->failed = 1;
+
+    char text[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(text, sizeof(text), fmt, ap);
+    va_end(ap);
+    snprintf(check->msg, check->size, "%s (line %d)", text, check->src_line);
+}
+
+static const char *loop_var(const LoopCheck *check)
+{
+    return check->loop->exprs[0]->var_name;
+}
+
+static const ASTExpr *reduction_of(const LoopCheck *check, const char *name)
+{
+    for (int i = 0; i < check->loop->num_call_args; i++)
+    {
+        if (strcmp(check->loop->call_args[i]->var_name, name) == 0)
+        {
+            return check->loop->call_args[i];
+        }
+    }
+    return NULL;
+}
+
+static const char *reduction_symbol(OpType op)
+{
+    switch (op)
+    {
+    case OP_ADD:
+        return "+";
+    case OP_MUL:
+        return "*";
+    case OP_LT:
+        return "MIN";
+    default:
+        return "MAX";
+    }
+}
+
+static VarUse *find_use(LoopCheck *check, const char *name)
+{
+    for (int i = 0; i < check->num_uses; i++)
+    {
+        if (strcmp(check->uses[i].name, name) == 0)
+        {
+            return &check->uses[i];
+        }
+    }
+    return NULL;
+}
+
+static void add_use(LoopCheck *check, const char *name, UseKind kind)
+{
+    if (check->num_uses == check->capacity_uses)
+    {
+        check->capacity_uses = check->capacity_uses ? check->capacity_uses * 2 : 16;
+        check->uses = xrealloc(check->uses, check->capacity_uses * sizeof(VarUse));
+    }
+    check->uses[check->num_uses].name = name;
+    check->uses[check->num_uses].kind = kind;
+    check->num_uses++;
+}
+
+/* A parameter of the DEF FN being followed */
+static int is_fn_param(const LoopCheck *check, const char *name)
+{
+    if (check->fn == NULL)
+    {
+        return 0;
+    }
+    for (int i = 1; i < check->fn->num_exprs - 1; i++)
+    {
+        const ASTExpr *param = check->fn->exprs[i];
+        if (param && param->str_value && strcasecmp(param->str_value, name) == 0)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void check_read(LoopCheck *check, const char *name)
+{
+    if (strcmp(name, loop_var(check)) == 0 || is_fn_param(check, name))
+    {
+        return;
+    }
+    const ASTExpr *reduction = reduction_of(check, name);
+    if (reduction != NULL)
+    {
+        /* A MIN or MAX is compared against as it goes; a sum or product
+         * is only whole once the workers' parts are combined */
+        if (reduction->op == OP_ADD || reduction->op == OP_MUL)
+        {
+            fail(check, "PARALLEL FOR reads REDUCE %s = %s variable %s outside its update", name,
+                 reduction_symbol(reduction->op), name);
+        }
+        return;
+    }
+    if (find_use(check, name) == NULL)
+    {
+        add_use(check, name, USE_READ);
+    }
+}
+
+static void check_write(LoopCheck *check, const char *name)
+{
+    if (strcmp(name, loop_var(check)) == 0)
+    {
+        fail(check, "PARALLEL FOR assigns its loop variable %s", name);
+        return;
+    }
+    if (reduction_of(check, name) != NULL)
+    {
+        return;
+    }
+    VarUse *use = find_use(check, name);
+    if (use != NULL && use->kind == USE_PRIVATE)
+    {
+        return;
+    }
+    if (use == NULL && !check->conditional)
+    {
+        add_use(check, name, USE_PRIVATE);
+        return;
+    }
+    fail(check, "PARALLEL FOR writes shared variable %s (assign it first in every iteration, or REDUCE it)", name);
+}
+
+static int mentions(const ASTExpr *expr, const char *name)
+{
+    if (expr == NULL)
+    {
+        return 0;
+    }
+    if ((expr->type == EXPR_VAR || expr->type == EXPR_ARRAY || expr->type == EXPR_PROC_CALL) && expr->var_name &&
+        strcmp(expr->var_name, name) == 0)
+    {
+        return 1;
+    }
+    for (int i = 0; i < expr->num_children; i++)
+    {
+        if (mentions(expr->children[i], name))
+        {
+            return 1;
+        }
+    }
+    return mentions(expr->member_obj, name);
+}
+
+static const ASTStmt *find_def_fn(const Program *prog, const char *name)
+{
+    for (int i = 0; i < prog->num_lines; i++)
+    {
+        for (const ASTStmt *stmt = prog->lines[i]->stmt; stmt; stmt = stmt->next)
+        {
+            if (stmt->type == STMT_DEF_FN && stmt->num_exprs >= 2 && stmt->exprs[0]->str_value &&
+                strcasecmp(stmt->exprs[0]->str_value, name) == 0)
+            {
+                return stmt;
+            }
+        }
+    }
+    return NULL;
+}
+
+static int is_procedure(const Program *prog, const char *name)
+{
+    for (int i = 0; i < prog->num_lines; i++)
+    {
+        const ASTStmt *stmt = prog->lines[i]->stmt;
+        if (stmt && stmt->type == STMT_PROCEDURE_DEF && stmt->var_name && strcasecmp(stmt->var_name, name) == 0)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Whether name is DIMmed AS MAP anywhere in the program */
+static int is_map(const Program *prog, const char *name)
+{
+    for (int i = 0; i < prog->num_lines; i++)
+    {
+        for (const ASTStmt *stmt = prog->lines[i]->stmt; stmt; stmt = stmt->next)
+        {
+            if (stmt->type != STMT_DIM)
+            {
+                continue;
+            }
+            for (int j = 0; j < stmt->num_exprs; j++)
+            {
+                const ASTExpr *entry = stmt->exprs[j];
+                if (entry && entry->type == EXPR_VAR && entry->var_name && strcasecmp(entry->var_name, name) == 0)
+                {
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static void check_call(LoopCheck *check, const ASTExpr *expr)
+{
+    for (int i = 0; unsafe_builtins[i]; i++)
+    {
+        if (strcasecmp(expr->var_name, unsafe_builtins[i]) == 0)
+        {
+            fail(check, "PARALLEL FOR cannot use %s", unsafe_builtins[i]);
+            return;
+        }
+    }
+
+    /* The body of an FN runs as part of the iteration */
+    const ASTStmt *def = strncasecmp(expr->var_name, "FN", 2) == 0 ? find_def_fn(check->prog, expr->var_name) : NULL;
+    if (def != NULL && check->fn_depth < PARALLEL_FN_DEPTH)
+    {
+        const ASTStmt *outer = check->fn;
+        check->fn = def;
+        check->fn_depth++;
+        check_expr(check, def->exprs[def->num_exprs - 1]);
+        check->fn_depth--;
+        check->fn = outer;
+    }
+}
+
+static void check_expr(LoopCheck *check, const ASTExpr *expr)
+{
+    if (expr == NULL || check->failed)
+    {
+        return;
+    }
+
+    switch (expr->type)
+    {
+    case EXPR_VAR:
+        if (strcasecmp(expr->var_name, "INKEY$") == 0)
+        {
+            fail(check, "PARALLEL FOR cannot use INKEY$");
+            return;
+        }
+        check_read(check, expr->var_name);
+        return;
+    case EXPR_FUNC_CALL:
+        check_call(check, expr);
+        break;
+    case EXPR_PROC_CALL:
+        /* Array elements are read with the same syntax */
+        if (is_procedure(check->prog, expr->var_name))
+        {
+            fail(check, "PARALLEL FOR cannot call procedure %s", expr->var_name);
+            return;
+        }
+        break;
+    case EXPR_MEMBER_ACCESS:
+    case EXPR_NEW:
+        fail(check, "PARALLEL FOR cannot use objects");
+        return;
+    default:
+        break;
+    }
+
+    for (int i = 0; i < expr->num_children; i++)
+    {
+        check_expr(check, expr->children[i]);
+    }
+}
+
+/* S = S + e and S = e + S (or S = S - e) for REDUCE S = +, likewise for *;
+ * MIN and MAX variables may be assigned anything */
+static void check_reduction_update(LoopCheck *check, const ASTExpr *reduction, const ASTExpr *rhs)
+{
+    const char *name = reduction->var_name;
+    if (reduction->op == OP_LT || reduction->op == OP_GT)
+    {
+        check_expr(check, rhs);
+        return;
+    }
+
+    OpType inverse = reduction->op == OP_ADD ? OP_SUB : OP_DIV;
+    const ASTExpr *other = NULL;
+    if (rhs->type == EXPR_BINARY_OP && rhs->num_children == 2)
+    {
+        const ASTExpr *left = rhs->children[0];
+        const ASTExpr *right = rhs->children[1];
+        int left_is_var = left->type == EXPR_VAR && strcmp(left->var_name, name) == 0;
+        int right_is_var = right->type == EXPR_VAR && strcmp(right->var_name, name) == 0;
+        if (left_is_var && (rhs->op == reduction->op || rhs->op == inverse))
+        {
+            other = right;
+        }
+        else if (right_is_var && rhs->op == reduction->op)
+        {
+            other = left;
+        }
+    }
+    if (other == NULL || mentions(other, name))
+    {
+        fail(check, "REDUCE %s = %s allows only %s = %s %s expression", name, reduction_symbol(reduction->op), name,
+             name, reduction_symbol(reduction->op));
+        return;
+    }
+    check_expr(check, other);
+}
+
+static void check_let(LoopCheck *check, const ASTStmt *stmt)
+{
+    if (stmt->num_exprs < 2)
+    {
+        return;
+    }
+    const ASTExpr *lhs = stmt->exprs[0];
+    const ASTExpr *rhs = stmt->exprs[1];
+
+    if (lhs->type == EXPR_ARRAY && is_map(check->prog, lhs->var_name))
+    {
+        /* Inserting may rehash the table under the other threads */
+        fail(check, "PARALLEL FOR cannot write to map %s", lhs->var_name);
+        return;
+    }
+    if (lhs->type == EXPR_ARRAY)
+    {
+        /* Arrays are shared: iterations must write elements of their own */
+        for (int i = 0; i < lhs->num_children; i++)
+        {
+            check_expr(check, lhs->children[i]);
+        }
+        check_expr(check, rhs);
+        return;
+    }
+    if (lhs->type != EXPR_VAR)
+    {
+        fail(check, "PARALLEL FOR cannot use objects");
+        return;
+    }
+
+    const ASTExpr *reduction = reduction_of(check, lhs->var_name);
+    if (reduction != NULL)
+    {
+        check_reduction_update(check, reduction, rhs);
+        return;
+    }
+    check_expr(check, rhs);
+    check_write(check, lhs->var_name);
+}
+
+static void check_chain(LoopCheck *check, const ASTStmt *stmt);
+
+static void check_conditional_chain(LoopCheck *check, const ASTStmt *stmt)
+{
+    check->conditional++;
+    check_chain(check, stmt);
+    check->conditional--;
+}
+
+static void check_stmt(LoopCheck *check, const ASTStmt *stmt)
+{
+    switch (stmt->type)
+    {
+    case STMT_REM:
+        return;
+    case STMT_LET:
+        check_let(check, stmt);
+        return;
+    case STMT_IF:
+        check_expr(check, stmt->num_exprs > 0 ? stmt->exprs[0] : NULL);
+        check_conditional_chain(check, stmt->body);
+        check_conditional_chain(check, stmt->else_body);
+        return;
+    case STMT_CASE:
+        for (int i = 0; i < stmt->num_exprs; i++)
+        {
+            check_expr(check, stmt->exprs[i]);
+        }
+        for (const ASTStmt *arm = stmt->body; arm; arm = arm->next)
+        {
+            check_conditional_chain(check, arm->body);
+        }
+        check_conditional_chain(check, stmt->else_body);
+        return;
+    case STMT_FOR:
+        if (stmt->mode == FOR_PARALLEL)
+        {
+            fail(check, "PARALLEL FOR loops cannot be nested");
+            return;
+        }
+        if (stmt->mode == FOR_EACH)
+        {
+            fail(check, "PARALLEL FOR body cannot contain FOR EACH");
+            return;
+        }
+        /* The counter is set before the bounds are used again */
+        for (int i = 1; i < stmt->num_exprs; i++)
+        {
+            check_expr(check, stmt->exprs[i]);
+        }
+        check_write(check, stmt->exprs[0]->var_name);
+        return;
+    case STMT_NEXT:
+        return;
+    case STMT_WHILE:
+        check_expr(check, stmt->num_exprs > 0 ? stmt->exprs[0] : NULL);
+        check->conditional++;
+        return;
+    case STMT_DO_LOOP:
+        if (stmt->is_loop_end)
+        {
+            check->conditional -= check->conditional > 0;
+            check_expr(check, stmt->num_exprs > 0 ? stmt->exprs[0] : NULL);
+        }
+        else
+        {
+            check_expr(check, stmt->num_exprs > 0 ? stmt->exprs[0] : NULL);
+            check->conditional++;
+        }
+        return;
+    case STMT_WEND:
+        check->conditional -= check->conditional > 0;
+        return;
+    case STMT_GOTO:
+    case STMT_GOSUB:
+    case STMT_ON_GOTO:
+    case STMT_RETURN:
+    case STMT_EXIT:
+    case STMT_END:
+    case STMT_STOP:
+        fail(check, "PARALLEL FOR body cannot leave the loop (%s)", stmt_type_name(stmt->type));
+        return;
+    default:
+        fail(check, "PARALLEL FOR body cannot contain %s", stmt_type_name(stmt->type));
+        return;
+    }
+}
+
+static void check_chain(LoopCheck *check, const ASTStmt *stmt)
+{
+    for (; stmt != NULL && !check->failed; stmt = stmt->next)
+    {
+        check_stmt(check, stmt);
+    }
+}
+
+/* The line holding the NEXT that closes the FOR on line for_index, found
+ * as the executor finds it; -1 if there is none */
+static int find_next_line(const Program *prog, int for_index)
+{
+    int nesting = 0;
+    for (int i = for_index + 1; i < prog->num_lines; i++)
+    {
+        const ASTStmt *stmt = prog->lines[i]->stmt;
+        if (stmt == NULL)
+        {
+            continue;
+        }
+        if (stmt->type == STMT_FOR)
+        {
+            nesting++;
+        }
+        else if (stmt->type == STMT_NEXT)
+        {
+            int count = stmt->num_exprs > 0 ? stmt->num_exprs : 1;
+            if (nesting < count)
+            {
+                return i;
+            }
+            nesting -= count;
+        }
+    }
+    return -1;
+}
+
+static void check_loop(LoopCheck *check, int for_index)
+{
+    const ASTStmt *loop = check->loop;
+    const char *var = loop_var(check);
+
+    for (int i = 0; i < loop->num_call_args; i++)
+    {
+        const char *name = loop->call_args[i]->var_name;
+        if (strcmp(name, var) == 0 || name[strlen(name) - 1] == '$')
+        {
+            fail(check, "Cannot REDUCE %s", name);
+            return;
+        }
+        for (int j = 0; j < i; j++)
+        {
+            if (strcmp(loop->call_args[j]->var_name, name) == 0)
+            {
+                fail(check, "%s is in REDUCE twice", name);
+                return;
+            }
+        }
+    }
+
+    int next_index = find_next_line(check->prog, for_index);
+    if (next_index < 0)
+    {
+        fail(check, "PARALLEL FOR without NEXT");
+        return;
+    }
+    const ASTStmt *next = check->prog->lines[next_index]->stmt;
+    check->src_line = check->prog->lines[next_index]->src_line;
+    if (next->next != NULL || next->num_exprs > 1 ||
+        (next->num_exprs == 1 && strcmp(next->exprs[0]->var_name, var) != 0))
+    {
+        fail(check, "The NEXT of a PARALLEL FOR must close it alone, on a line of its own");
+        return;
+    }
+
+    for (int i = for_index + 1; i < next_index && !check->failed; i++)
+    {
+        check->src_line = check->prog->lines[i]->src_line;
+        check_chain(check, check->prog->lines[i]->stmt);
+    }
+}
+
+/* A PARALLEL FOR anywhere but at the start of a line of its own */
+static int misplaced_parallel(const ASTStmt *stmt, int at_line_start)
+{
+    for (; stmt != NULL; stmt = stmt->next)
+    {
+        if (stmt->type == STMT_FOR && stmt->mode == FOR_PARALLEL && !(at_line_start && stmt->next == NULL))
+        {
+            return 1;
+        }
+        if (misplaced_parallel(stmt->body, 0) || misplaced_parallel(stmt->else_body, 0))
+        {
+            return 1;
+        }
+        at_line_start = 0;
+    }
+    return 0;
+}
+
+int parallel_check_program(const Program *prog, int first, char *msg, size_t size)
+{
+    LoopCheck check;
+    memset(&check, 0, sizeof(check));
+    check.prog = prog;
+    check.msg = msg;
+    check.size = size;
+
+    for (int i = first; i < prog->num_lines && !check.failed; i++)
+    {
+        const ASTStmt *stmt = prog->lines[i]->stmt;
+        check.src_line = prog->lines[i]->src_line;
+        if (misplaced_parallel(stmt, 1))
+        {
+            fail(&check, "PARALLEL FOR must be on a line of its own");
+        }
+        else if (stmt && stmt->type == STMT_FOR && stmt->mode == FOR_PARALLEL)
+        {
+            check.loop = stmt;
+            check.num_uses = 0;
+            check.conditional = 0;
+            check_loop(&check, i);
+        }
+    }
+
+    free(check.uses);
+    return check.failed ? -1 : 0;
+}
@@ -0,0 +1,23 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "common.h"
+#include "ast.h"
+
+/*
+ * Load-time checks for PARALLEL FOR
+ *
+ * The executor runs a parallel loop's iterations on several threads, each
+ * with private copies of the scalar variables and shared access to the
+ * arrays. That has the sequential loop's meaning only if no iteration
+ * depends on another, so the body is limited to statements that touch
+ * nothing but variables and arrays, may not leave the loop, and may write
+ * a scalar only if every iteration sets it before reading it, or if it is
+ * a declared REDUCE variable.
+ */
+
+/* Check the PARALLEL FOR loops among prog's lines from first on. Returns
+ * 0, or -1 with a description of the first problem in msg. */
+int parallel_check_program(const Program *prog, int first, char *msg, size_t size);
+
+#endif /* PARALLEL_H */
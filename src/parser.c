@@ -2,6 +2,7 @@
 #include "compat.h"
 #include "common.h"
 #include "eval.h"
+#include "parallel.h"
 #include <string.h>
 #include <strings.h>
 #include <stdio.h>
@@ -33,7 +34,7 @@ static int is_builtin_function(const char *name)
     const char *funcs[] = {
         "ABS", "SIN", "COS", "TAN", "ATN", "EXP", "LOG", "LN", "SQR", "INT", "SGN", "RND",
         "VAL", "ASC", "LEN", "CHR$", "STR$", "LEFT$", "RIGHT$", "MID$", "STRING$", "SPACE$", "INKEY$",
-        "EOF", "PEEK", "FRE", "POS", "LOC", "LOF", "VARPTR", "USR", "GETA", "GETB", "POINT", "INSTR", NULL};
+        "EOF", "PEEK", "FRE", "POS", "LOC", "LOF", "VARPTR", "USR", "GETA", "GETB", "POINT", "INSTR", "HASKEY", NULL};
     for (int i = 0; funcs[i]; i++)
     {
         if (strcasecmp(name, funcs[i]) == 0)
@@ -60,12 +61,14 @@ static ASTStmt *parse_cls_stmt(Parser *parser);
 static ASTStmt *parse_clear_stmt(Parser *parser);
 static ASTStmt *parse_for_stmt(Parser *parser);
 static ASTStmt *parse_next_stmt(Parser *parser);
+static ASTStmt *parse_parallel_stmt(Parser *parser);
 static ASTStmt *parse_while_stmt(Parser *parser);
 static ASTStmt *parse_wend_stmt(Parser *parser);
 static ASTStmt *parse_do_loop_stmt(Parser *parser);
 static ASTStmt *parse_loop_stmt(Parser *parser);
 static ASTStmt *parse_exit_stmt(Parser *parser);
 static ASTStmt *parse_dim_stmt(Parser *parser);
+static ASTStmt *parse_mat_stmt(Parser *parser);
 static ASTStmt *parse_read_stmt(Parser *parser);
 static ASTStmt *parse_data_stmt(Parser *parser);
 static ASTStmt *parse_restore_stmt(Parser *parser);
@@ -93,9 +96,55 @@ Parser *parser_create(Token *tokens, int num_tokens)
     parser->pos = 0;
     parser->error_code = 0;
     parser->error_msg = NULL;
+    parser->resync_hit = -1;
     return parser;
 }
 
+Parser *parser_create_streaming(Lexer *lexer)
+{
+    Parser *parser = xcalloc(1, sizeof(Parser));
+    parser->lexer = lexer;
+    parser->resync_hit = -1;
+    return parser;
+}
+
+/*
+ * Make parse_program stop before a top-level unit whose first token sits
+ * at one of the given source positions. Used by the REPL to re-parse an
+ * edited region and pick up cached units again once the parse is back in
+ * step with them.
+ */
+void parser_set_resync(Parser *parser, const int *lines, const int *columns, int count)
+{
+    parser->resync_lines = lines;
+    parser->resync_columns = columns;
+    parser->num_resync = count;
+    parser->resync_hit = -1;
+}
+
+static int at_resync_point(Parser *parser, Token *tok)
+{
+    /* Binary search for the first position on the token's line */
+    int lo = 0, hi = parser->num_resync;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (parser->resync_lines[mid] < tok->line_number)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for (int i = lo; i < parser->num_resync && parser->resync_lines[i] == tok->line_number; i++)
+    {
+        if (parser->resync_columns[i] == tok->column_number)
+        {
+            parser->resync_hit = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
 void parser_free(Parser *parser)
 {
     if (parser == NULL)
@@ -111,18 +160,37 @@ void parser_free(Parser *parser)
 
 /* Token utilities */
 
-static Token *current_token(Parser *parser)
+/* Token at absolute index, or NULL past the end of input */
+static Token *token_at(Parser *parser, int index)
 {
-    if (parser->pos >= parser->num_tokens)
+    if (parser->lexer == NULL)
     {
-        return NULL;
+        return index < parser->num_tokens ? &parser->tokens[index] : NULL;
     }
-    return &parser->tokens[parser->pos];
+
+    while (parser->ring_end <= index)
+    {
+        if (!lexer_next_token(parser->lexer, &parser->ring[parser->ring_end % PARSER_RING_SIZE]))
+        {
+            return NULL;
+        }
+        parser->ring_end++;
+    }
+    if (index < parser->ring_end - PARSER_RING_SIZE)
+    {
+        error_exit(ERR_SYNTAX_ERROR, "parser: rewound past token window");
+    }
+    return &parser->ring[index % PARSER_RING_SIZE];
+}
+
+static Token *current_token(Parser *parser)
+{
+    return token_at(parser, parser->pos);
 }
 
 static void advance(Parser *parser)
 {
-    if (parser->pos < parser->num_tokens)
+    if (current_token(parser))
     {
         parser->pos++;
     }
@@ -130,11 +198,7 @@ static void advance(Parser *parser)
 
 static Token *peek_next_token(Parser *parser)
 {
-    if (parser->pos + 1 >= parser->num_tokens)
-    {
-        return NULL;
-    }
-    return &parser->tokens[parser->pos + 1];
+    return token_at(parser, parser->pos + 1);
 }
 
 static int match(Parser *parser, TokenType type)
@@ -295,6 +359,9 @@ static int is_statement_token(Token *tok)
     case TOK_DEFSTR:
     case TOK_TRON:
     case TOK_TROFF:
+    case TOK_SYSTAT:
+    case TOK_MAT:
+    case TOK_PARALLEL:
     case TOK_CASE:
     case TOK_STOP:
     case TOK_CONT:
@@ -630,7 +697,7 @@ Program *parse_program(Parser *parser)
 
     Program *prog = ast_program_create();
 
-    while (parser->pos < parser->num_tokens && !parser_has_error(parser))
+    while (current_token(parser) && !parser_has_error(parser))
     {
         Token *tok = current_token(parser);
         if (!tok)
@@ -645,6 +712,15 @@ Program *parse_program(Parser *parser)
             continue;
         }
 
+        if (parser->num_resync > 0 && at_resync_point(parser, tok))
+        {
+            break;
+        }
+
+        int first_new = prog->num_lines;
+        int src_line = tok->line_number;
+        int src_column = tok->column_number;
+
         /* Check for CLASS definition (Phase 2 Basic++) */
         if (tok->type == TOK_CLASS)
         {
@@ -688,10 +764,7 @@ Program *parse_program(Parser *parser)
             else
             {
                 /* If we couldn't parse a line, advance to avoid infinite loop */
-                if (parser->pos < parser->num_tokens)
-                {
-                    advance(parser);
-                }
+                advance(parser);
             }
         }
         /* Check for statement keyword without line number (Phase 1 Basic++) */
@@ -716,11 +789,26 @@ Program *parse_program(Parser *parser)
             advance(parser);
         }
 
+        for (int i = first_new; i < prog->num_lines; i++)
+        {
+            prog->lines[i]->src_line = src_line;
+            prog->lines[i]->src_column = src_column;
+        }
+
         /* Skip newlines between lines */
         while (match(parser, TOK_NEWLINE))
             ;
     }
 
+    /* A partial parse is checked once it is spliced into the program */
+    char msg[512];
+    if (!parser_has_error(parser) && parser->num_resync == 0 && parallel_check_program(prog, 0, msg, sizeof(msg)) != 0)
+    {
+        parser->error_code = 1;
+        free(parser->error_msg);
+        parser->error_msg = xstrdup(msg);
+    }
+
     return prog;
 }
 
@@ -840,12 +928,16 @@ ASTStmt *parse_statement(Parser *parser)
         return parse_for_stmt(parser);
     case TOK_NEXT:
         return parse_next_stmt(parser);
+    case TOK_PARALLEL:
+        return parse_parallel_stmt(parser);
     case TOK_WHILE:
         return parse_while_stmt(parser);
     case TOK_WEND:
         return parse_wend_stmt(parser);
     case TOK_DIM:
         return parse_dim_stmt(parser);
+    case TOK_MAT:
+        return parse_mat_stmt(parser);
     case TOK_READ:
         return parse_read_stmt(parser);
     case TOK_DATA:
@@ -884,6 +976,9 @@ ASTStmt *parse_statement(Parser *parser)
     case TOK_TROFF:
         advance(parser); /* consume TROFF */
         return ast_stmt_create(STMT_TROFF);
+    case TOK_SYSTAT:
+        advance(parser); /* consume SYSTAT */
+        return ast_stmt_create(STMT_SYSTAT);
     case TOK_CASE:
         return parse_case_stmt(parser);
     case TOK_STOP:
@@ -925,6 +1020,71 @@ ASTStmt *parse_statement(Parser *parser)
 }
 
 /* Statement implementations */
+
+static int is_case_clause(Token *tok)
+{
+    return tok && (tok->type == TOK_WHEN || tok->type == TOK_OTHERWISE || tok->type == TOK_ENDCASE);
+}
+
+/* Statements of one CASE arm, up to the next WHEN, OTHERWISE or ENDCASE.
+ * Line numbers in front of arm lines are accepted and ignored. */
+static ASTStmt *parse_case_arm(Parser *parser)
+{
+    ASTStmt *head = NULL;
+    ASTStmt *tail = NULL;
+
+    while (current_token(parser) && current_token(parser)->type != TOK_EOF)
+    {
+        Token *tok = current_token(parser);
+        if (tok->type == TOK_NEWLINE || tok->type == TOK_COLON || tok->type == TOK_NUMBER)
+        {
+            advance(parser);
+            continue;
+        }
+        if (is_case_clause(tok))
+        {
+            break;
+        }
+
+        ASTStmt *stmt = parse_statement(parser);
+        if (!stmt)
+        {
+            if (parser_has_error(parser))
+            {
+                break;
+            }
+            advance(parser);
+            continue;
+        }
+
+        if (!head)
+        {
+            head = stmt;
+        }
+        else
+        {
+            tail->next = stmt;
+        }
+        for (tail = stmt; tail->next; tail = tail->next)
+            ;
+    }
+
+    return head;
+}
+
+/*
+ * CASE expr OF
+ * WHEN value
+ *   statements
+ * ...
+ * OTHERWISE
+ *   statements
+ * ENDCASE
+ *
+ * Builds a STMT_CASE: exprs[0] is the selector and exprs[1..] the WHEN
+ * values; body chains one STMT_BLOCK per WHEN, in order, holding that arm's
+ * statements; else_body holds the OTHERWISE statements.
+ */
 static ASTStmt *parse_case_stmt(Parser *parser)
 {
     advance(parser); /* consume CASE */
@@ -945,195 +1105,86 @@ static ASTStmt *parse_case_stmt(Parser *parser)
     }
 
     Token *tok = current_token(parser);
-
-    /* Multi-line CASE/OF/WHEN/ENDCASE block (when OF is followed by NEWLINE) */
-    if (tok && tok->type == TOK_NEWLINE)
+    if (!tok || tok->type != TOK_NEWLINE)
     {
-        advance(parser); /* consume NEWLINE after OF */
+        parser_error(parser, "CASE statement must span multiple lines with WHEN clauses");
+        ast_expr_free(case_expr);
+        return NULL;
+    }
 
-        ASTStmt *root_if = NULL;
-        ASTStmt *current_else = NULL;
-        ASTStmt *otherwise_body = NULL;
+    ASTStmt *case_stmt = ast_stmt_create(STMT_CASE);
+    ast_stmt_add_expr(case_stmt, case_expr);
 
-        while (1)
+    /* Only remarks may come before the first WHEN */
+    ASTStmt *lead = parse_case_arm(parser);
+    for (ASTStmt *s = lead; s; s = s->next)
+    {
+        if (s->type != STMT_REM)
         {
-            Token *ctok = current_token(parser);
-
-            /* End of input */
-            if (!ctok || ctok->type == TOK_EOF)
-                break;
+            parser_error(parser, "Expected WHEN after CASE ... OF");
+            break;
+        }
+    }
+    ast_stmt_free(lead);
 
-            /* Expect numbered line for WHEN/OTHERWISE/ENDCASE */
-            if (ctok->type != TOK_NUMBER)
-            {
-                advance(parser);
-                continue;
-            }
+    ASTStmt *arm_tail = NULL;
+    int have_otherwise = 0;
+    while (!parser_has_error(parser))
+    {
+        tok = current_token(parser);
+        if (!tok || tok->type == TOK_EOF)
+        {
+            parser_error(parser, "CASE without ENDCASE");
+            break;
+        }
 
-            advance(parser); /* skip line number */
-            Token *peek = current_token(parser);
+        if (tok->type == TOK_ENDCASE)
+        {
+            advance(parser);
+            return case_stmt;
+        }
 
-            if (peek && peek->type == TOK_ENDCASE)
+        advance(parser);
+        if (tok->type == TOK_OTHERWISE)
+        {
+            if (have_otherwise)
             {
-                /* Found ENDCASE, end the block */
-                advance(parser);
-                if (current_token(parser) && current_token(parser)->type == TOK_NEWLINE)
-                    advance(parser);
+                parser_error(parser, "Duplicate OTHERWISE in CASE");
                 break;
             }
-            else if (peek && peek->type == TOK_OTHERWISE)
-            {
-                /* Parse OTHERWISE block */
-                advance(parser);
-                while (match(parser, TOK_NEWLINE))
-                    ;
-
-                ASTStmt *otherwise_block = NULL;
-                ASTStmt *otherwise_tail = NULL;
-
-                while (1)
-                {
-                    Token *ctok2 = current_token(parser);
-                    if (!ctok2 || ctok2->type == TOK_EOF)
-                        break;
-                    if (ctok2->type != TOK_NUMBER)
-                    {
-                        advance(parser);
-                        continue;
-                    }
-
-                    int save_pos = parser->pos;
-                    advance(parser);
-                    Token *peek2 = current_token(parser);
-
-                    if (peek2 && peek2->type == TOK_ENDCASE)
-                    {
-                        parser->pos = save_pos;
-                        break;
-                    }
-
-                    parser->pos = save_pos;
-                    ProgramLine *pline = parse_line(parser);
-                    if (pline && pline->stmt)
-                    {
-                        if (!otherwise_block)
-                        {
-                            otherwise_block = pline->stmt;
-                            otherwise_tail = pline->stmt;
-                        }
-                        else
-                        {
-                            otherwise_tail->next = pline->stmt;
-                            otherwise_tail = pline->stmt;
-                        }
-                    }
-                }
-
-                otherwise_body = otherwise_block;
-                continue;
-            }
-            else if (peek && peek->type == TOK_WHEN)
-            {
-                /* Parse WHEN clause */
-                advance(parser);
-
-                ASTExpr *when_value = parse_expression(parser);
-                if (!when_value)
-                {
-                    parser_error(parser, "Expected value after WHEN");
-                    continue;
-                }
-
-                /* Create equality comparison: CASE_EXPR = WHEN_VALUE */
-                ASTExpr *comparison = ast_expr_create(EXPR_BINARY_OP);
-                comparison->op = OP_EQ;
-                ast_expr_add_child(comparison, ast_expr_copy(case_expr));
-                ast_expr_add_child(comparison, when_value);
-
-                while (match(parser, TOK_NEWLINE))
-                    ;
-
-                /* Parse statements for this WHEN clause until next WHEN/OTHERWISE/ENDCASE */
-                ASTStmt *when_block = NULL;
-                ASTStmt *when_tail = NULL;
-
-                while (1)
-                {
-                    Token *ctok2 = current_token(parser);
-                    if (!ctok2 || ctok2->type == TOK_EOF)
-                        break;
-                    if (ctok2->type != TOK_NUMBER)
-                    {
-                        advance(parser);
-                        continue;
-                    }
-
-                    int save_pos = parser->pos;
-                    advance(parser);
-                    Token *peek2 = current_token(parser);
-
-                    if (peek2 && (peek2->type == TOK_WHEN || peek2->type == TOK_OTHERWISE || peek2->type == TOK_ENDCASE))
-                    {
-                        parser->pos = save_pos;
-                        break;
-                    }
-
-                    parser->pos = save_pos;
-                    ProgramLine *pline = parse_line(parser);
-                    if (pline && pline->stmt)
-                    {
-                        if (!when_block)
-                        {
-                            when_block = pline->stmt;
-                            when_tail = pline->stmt;
-                        }
-                        else
-                        {
-                            when_tail->next = pline->stmt;
-                            while (when_tail->next)
-                                when_tail = when_tail->next;
-                        }
-                    }
-                }
-
-                /* Create IF statement for this WHEN */
-                ASTStmt *if_stmt = ast_stmt_create(STMT_IF);
-                ast_stmt_add_expr(if_stmt, comparison);
-                ast_stmt_set_body(if_stmt, when_block);
-
-                /* Chain to previous IF */
-                if (!root_if)
-                {
-                    root_if = if_stmt;
-                    current_else = if_stmt;
-                }
-                else
-                {
-                    current_else->else_body = if_stmt;
-                    current_else = if_stmt;
-                }
-            }
-            else
-            {
-                advance(parser);
-            }
+            have_otherwise = 1;
+            case_stmt->else_body = parse_case_arm(parser);
+            continue;
         }
 
-        /* Set OTHERWISE as final else_body */
-        if (otherwise_body && current_else)
+        /* WHEN value */
+        if (have_otherwise)
         {
-            current_else->else_body = otherwise_body;
+            parser_error(parser, "WHEN after OTHERWISE in CASE");
+            break;
         }
+        ASTExpr *when_value = parse_expression(parser);
+        if (!when_value)
+        {
+            parser_error(parser, "Expected value after WHEN");
+            break;
+        }
+        ast_stmt_add_expr(case_stmt, when_value);
 
-        /* Free the original case expression */
-        ast_expr_free(case_expr);
-
-        return root_if ? root_if : ast_stmt_create(STMT_BLOCK);
+        ASTStmt *arm = ast_stmt_create(STMT_BLOCK);
+        arm->body = parse_case_arm(parser);
+        if (arm_tail)
+        {
+            arm_tail->next = arm;
+        }
+        else
+        {
+            case_stmt->body = arm;
+        }
+        arm_tail = arm;
     }
 
-    /* Single-line CASE (all on one line - not supported yet, same as multi-line) */
-    parser_error(parser, "CASE statement must span multiple lines with WHEN clauses");
-    ast_expr_free(case_expr);
+    ast_stmt_free(case_stmt);
     return NULL;
 }
 
@@ -2180,11 +2231,71 @@ static ASTStmt *parse_clear_stmt(Parser *parser)
     return stmt;
 }
 
+/* FOR EACH var IN map; EACH and IN are not reserved, so FOR EACH = ...
+ * is still an ordinary loop */
+static ASTStmt *parse_for_each_stmt(Parser *parser)
+{
+    if (g_compat_state)
+    {
+        compat_record_violation(g_compat_state, COMPAT_MODERN_KEYWORD, 0,
+                                "FOR EACH not in TRS-80 Level II BASIC");
+        if (compat_is_strict(g_compat_state))
+        {
+            parser_error(parser, "FOR EACH not allowed in strict TRS-80 mode");
+            return NULL;
+        }
+    }
+
+    advance(parser); /* consume EACH */
+    Token *tok = current_token(parser);
+    if (!tok || !is_identifier_token(tok))
+    {
+        parser_error(parser, "Expected variable after FOR EACH");
+        return NULL;
+    }
+    ASTExpr *var = ast_expr_create(EXPR_VAR);
+    var->var_name = xstrdup(tok->value);
+    advance(parser);
+
+    tok = current_token(parser);
+    if (!tok || tok->type != TOK_IDENTIFIER || strcasecmp(tok->value, "IN") != 0)
+    {
+        parser_error(parser, "Expected IN in FOR EACH statement");
+        ast_expr_free(var);
+        return NULL;
+    }
+    advance(parser); /* consume IN */
+
+    tok = current_token(parser);
+    if (!tok || !is_identifier_token(tok))
+    {
+        parser_error(parser, "Expected map name after IN");
+        ast_expr_free(var);
+        return NULL;
+    }
+    ASTExpr *map = ast_expr_create(EXPR_VAR);
+    map->var_name = xstrdup(tok->value);
+    advance(parser);
+
+    ASTStmt *stmt = ast_stmt_create(STMT_FOR);
+    stmt->mode = FOR_EACH;
+    ast_stmt_add_expr(stmt, var);
+    ast_stmt_add_expr(stmt, map);
+    return stmt;
+}
+
 static ASTStmt *parse_for_stmt(Parser *parser)
 {
     advance(parser); /* consume FOR */
 
     Token *tok = current_token(parser);
+    Token *ntok = peek_next_token(parser);
+    if (tok && tok->type == TOK_IDENTIFIER && strcasecmp(tok->value, "EACH") == 0 && ntok &&
+        is_identifier_token(ntok))
+    {
+        return parse_for_each_stmt(parser);
+    }
+
     if (!tok || !is_identifier_token(tok))
     {
         parser_error(parser, "Expected variable after FOR");
@@ -2275,6 +2386,139 @@ static ASTStmt *parse_next_stmt(Parser *parser)
     return stmt;
 }
 
+/* PARALLEL FOR var = start TO end [STEP step] [REDUCE var = op, ...]
+ * where op is +, *, MIN or MAX */
+static ASTStmt *parse_parallel_stmt(Parser *parser)
+{
+    /* PARALLEL = ... and PARALLEL(...) = ... assign to a variable named PARALLEL */
+    Token *ntok = peek_next_token(parser);
+    if (ntok && (ntok->type == TOK_EQ || ntok->type == TOK_LPAREN || ntok->type == TOK_DOT))
+    {
+        return parse_let_stmt(parser);
+    }
+
+    if (g_compat_state)
+    {
+        compat_record_violation(g_compat_state, COMPAT_MODERN_KEYWORD, 0,
+                                "PARALLEL FOR not in TRS-80 Level II BASIC");
+        if (compat_is_strict(g_compat_state))
+        {
+            parser_error(parser, "PARALLEL FOR not allowed in strict TRS-80 mode");
+            return NULL;
+        }
+    }
+
+    advance(parser); /* consume PARALLEL */
+    Token *tok = current_token(parser);
+    if (!tok || tok->type != TOK_FOR)
+    {
+        parser_error(parser, "Expected FOR after PARALLEL");
+        return NULL;
+    }
+
+    ASTStmt *stmt = parse_for_stmt(parser);
+    if (!stmt)
+    {
+        return NULL;
+    }
+    if (stmt->mode == FOR_EACH)
+    {
+        parser_error(parser, "FOR EACH cannot be PARALLEL");
+        ast_stmt_free(stmt);
+        return NULL;
+    }
+    stmt->mode = FOR_PARALLEL;
+
+    tok = current_token(parser);
+    if (!tok || tok->type != TOK_IDENTIFIER || strcasecmp(tok->value, "REDUCE") != 0)
+    {
+        return stmt;
+    }
+    advance(parser); /* consume REDUCE */
+
+    do
+    {
+        tok = current_token(parser);
+        if (!tok || !is_identifier_token(tok))
+        {
+            parser_error(parser, "Expected variable after REDUCE");
+            ast_stmt_free(stmt);
+            return NULL;
+        }
+        ASTExpr *var = ast_expr_create(EXPR_VAR);
+        var->var_name = xstrdup(tok->value);
+        advance(parser);
+        if (stmt->num_call_args >= stmt->capacity_call_args)
+        {
+            stmt->capacity_call_args = stmt->capacity_call_args == 0 ? 4 : stmt->capacity_call_args * 2;
+            stmt->call_args = xrealloc(stmt->call_args, stmt->capacity_call_args * sizeof(ASTExpr *));
+        }
+        stmt->call_args[stmt->num_call_args++] = var;
+
+        if (!expect(parser, TOK_EQ, "Expected '=' after REDUCE variable"))
+        {
+            ast_stmt_free(stmt);
+            return NULL;
+        }
+        tok = current_token(parser);
+        if (tok && tok->type == TOK_PLUS)
+        {
+            var->op = OP_ADD;
+        }
+        else if (tok && tok->type == TOK_STAR)
+        {
+            var->op = OP_MUL;
+        }
+        else if (tok && tok->value && strcasecmp(tok->value, "MIN") == 0)
+        {
+            var->op = OP_LT;
+        }
+        else if (tok && tok->value && strcasecmp(tok->value, "MAX") == 0)
+        {
+            var->op = OP_GT;
+        }
+        else
+        {
+            parser_error(parser, "Expected +, *, MIN or MAX in REDUCE");
+            ast_stmt_free(stmt);
+            return NULL;
+        }
+        advance(parser);
+    } while (match(parser, TOK_COMMA));
+
+    return stmt;
+}
+
+/* name AS MAP in a DIM statement, as an EXPR_VAR */
+static ASTExpr *parse_dim_map(Parser *parser)
+{
+    if (g_compat_state)
+    {
+        compat_record_violation(g_compat_state, COMPAT_MODERN_KEYWORD, 0,
+                                "DIM AS MAP not in TRS-80 Level II BASIC");
+        if (compat_is_strict(g_compat_state))
+        {
+            parser_error(parser, "DIM AS MAP not allowed in strict TRS-80 mode");
+            return NULL;
+        }
+    }
+
+    ASTExpr *map = ast_expr_create(EXPR_VAR);
+    map->var_name = xstrdup(current_token(parser)->value);
+    advance(parser); /* consume name */
+    advance(parser); /* consume AS */
+
+    Token *tok = current_token(parser);
+    if (!tok || tok->type != TOK_IDENTIFIER || strcasecmp(tok->value, "MAP") != 0)
+    {
+        parser_error(parser, "Expected MAP after AS in DIM");
+        ast_expr_free(map);
+        return NULL;
+    }
+    advance(parser); /* consume MAP */
+    return map;
+}
+
 static ASTStmt *parse_dim_stmt(Parser *parser)
 {
     advance(parser); /* consume DIM */
@@ -2295,6 +2539,18 @@ static ASTStmt *parse_dim_stmt(Parser *parser)
             break;
         }
 
+        Token *ntok = peek_next_token(parser);
+        if (ntok && ntok->type == TOK_AS)
+        {
+            ASTExpr *map = parse_dim_map(parser);
+            if (!map)
+            {
+                break;
+            }
+            ast_stmt_add_expr(stmt, map);
+            continue;
+        }
+
         ASTExpr *array = ast_expr_create(EXPR_ARRAY);
         array->var_name = xstrdup(tok->value);
         advance(parser);
@@ -2326,6 +2582,152 @@ static ASTStmt *parse_dim_stmt(Parser *parser)
     return stmt;
 }
 
+/* A MAT operand: an array name without subscripts */
+static ASTExpr *parse_mat_array(Parser *parser)
+{
+    Token *tok = current_token(parser);
+    if (!tok || !is_identifier_token(tok))
+    {
+        parser_error(parser, "Expected array name in MAT");
+        return NULL;
+    }
+
+    ASTExpr *array = ast_expr_create(EXPR_ARRAY);
+    array->var_name = xstrdup(tok->value);
+    advance(parser);
+    return array;
+}
+
+static ASTStmt *parse_mat_stmt(Parser *parser)
+{
+    /* MAT = ... and MAT(...) = ... assign to a variable named MAT */
+    Token *ntok = peek_next_token(parser);
+    if (ntok && (ntok->type == TOK_EQ || ntok->type == TOK_LPAREN || ntok->type == TOK_DOT))
+    {
+        return parse_let_stmt(parser);
+    }
+
+    /* Compatibility check: MAT is Dartmouth BASIC, not TRS-80 Level II */
+    if (g_compat_state)
+    {
+        compat_record_violation(g_compat_state, COMPAT_MODERN_KEYWORD, 0,
+                                "MAT statement not in TRS-80 Level II BASIC");
+        if (compat_is_strict(g_compat_state))
+        {
+            parser_error(parser, "MAT not allowed in strict TRS-80 mode");
+            return NULL;
+        }
+    }
+
+    advance(parser); /* consume MAT */
+
+    ASTStmt *stmt = ast_stmt_create(STMT_MAT);
+    ASTExpr *target = parse_mat_array(parser);
+    if (target == NULL)
+    {
+        return stmt;
+    }
+    ast_stmt_add_expr(stmt, target);
+
+    if (!expect(parser, TOK_EQ, "Expected '=' in MAT"))
+    {
+        return stmt;
+    }
+
+    Token *tok = current_token(parser);
+    if (tok && tok->type == TOK_LPAREN)
+    {
+        /* (k) * A */
+        advance(parser);
+        ASTExpr *scalar = parse_expression(parser);
+        if (scalar)
+        {
+            ast_stmt_add_expr(stmt, scalar);
+        }
+        if (!expect(parser, TOK_RPAREN, "Expected ')' after MAT scalar") ||
+            !expect(parser, TOK_STAR, "Expected '*' after MAT scalar"))
+        {
+            return stmt;
+        }
+        stmt->mode = MAT_SCALE;
+        ASTExpr *operand = parse_mat_array(parser);
+        if (operand)
+        {
+            ast_stmt_add_expr(stmt, operand);
+        }
+        return stmt;
+    }
+
+    if (tok && is_identifier_token(tok))
+    {
+        const char *name = tok->value;
+        Token *after = peek_next_token(parser);
+        int has_args = after && after->type == TOK_LPAREN;
+
+        if (has_args && (strcasecmp(name, "TRN") == 0 || strcasecmp(name, "INV") == 0))
+        {
+            stmt->mode = strcasecmp(name, "TRN") == 0 ? MAT_TRN : MAT_INV;
+            advance(parser); /* consume TRN or INV */
+            advance(parser); /* consume ( */
+            ASTExpr *operand = parse_mat_array(parser);
+            if (operand)
+            {
+                ast_stmt_add_expr(stmt, operand);
+            }
+            expect(parser, TOK_RPAREN, "Expected ')' after MAT operand");
+            return stmt;
+        }
+
+        if (strcasecmp(name, "ZER") == 0 || strcasecmp(name, "CON") == 0 || strcasecmp(name, "IDN") == 0)
+        {
+            stmt->mode = strcasecmp(name, "ZER") == 0   ? MAT_ZER
+                         : strcasecmp(name, "CON") == 0 ? MAT_CON
+                                                        : MAT_IDN;
+            advance(parser);
+            if (match(parser, TOK_LPAREN))
+            {
+                /* New bounds for the target */
+                while (current_token(parser) && current_token(parser)->type != TOK_RPAREN)
+                {
+                    ASTExpr *bound = parse_expression(parser);
+                    if (bound)
+                    {
+                        ast_stmt_add_expr(stmt, bound);
+                    }
+                    if (!match(parser, TOK_COMMA))
+                    {
+                        break;
+                    }
+                }
+                expect(parser, TOK_RPAREN, "Expected ')' after MAT bounds");
+            }
+            return stmt;
+        }
+    }
+
+    ASTExpr *left = parse_mat_array(parser);
+    if (left == NULL)
+    {
+        return stmt;
+    }
+    ast_stmt_add_expr(stmt, left);
+    stmt->mode = MAT_COPY;
+
+    tok = current_token(parser);
+    if (tok && (tok->type == TOK_PLUS || tok->type == TOK_MINUS || tok->type == TOK_STAR))
+    {
+        stmt->mode = tok->type == TOK_PLUS ? MAT_ADD : tok->type == TOK_MINUS ? MAT_SUB
+                                                                              : MAT_MUL;
+        advance(parser);
+        ASTExpr *right = parse_mat_array(parser);
+        if (right)
+        {
+            ast_stmt_add_expr(stmt, right);
+        }
+    }
+    return stmt;
+}
+
 static ASTStmt *parse_read_stmt(Parser *parser)
 {
     advance(parser); /* consume READ */
@@ -2695,6 +3097,25 @@ static ASTStmt *parse_delete_stmt(Parser *parser)
         return stmt;
     }
 
+    /* DELETE name(key) removes a key from a map */
+    if (is_identifier_token(tok) && strcmp(tok->value, ".") != 0)
+    {
+        ASTExpr *element = ast_expr_create(EXPR_ARRAY);
+        element->var_name = xstrdup(tok->value);
+        advance(parser);
+        ASTExpr *key = NULL;
+        if (!expect(parser, TOK_LPAREN, "Expected '(' after map name in DELETE") ||
+            (key = parse_expression(parser)) == NULL)
+        {
+            ast_expr_free(element);
+            return stmt;
+        }
+        ast_expr_add_child(element, key);
+        expect(parser, TOK_RPAREN, "Expected ')' after map key");
+        ast_stmt_add_expr(stmt, element);
+        return stmt;
+    }
+
     /* Parse line number range */
     /* Possible forms: n, n-m, -m, . */
 
@@ -4,14 +4,28 @@
 #include "ast.h"
 #include "lexer.h"
 
+/* Tokens kept behind the cursor when streaming. The parser only rewinds
+ * by one token and holds Token pointers across a few advances, so a small
+ * window is enough. */
+#define PARSER_RING_SIZE 64
+
 /*
- * Parser context
+ * Parser context. Tokens come either from a prebuilt array (tokens and
+ * num_tokens) or are pulled on demand from lexer into ring; pos is an
+ * absolute token index in both cases.
  */
 typedef struct
 {
     Token *tokens;
     int num_tokens;
+    Lexer *lexer;
+    Token ring[PARSER_RING_SIZE];
+    int ring_end; /* Absolute index one past the newest token in ring */
     int pos;
+    const int *resync_lines; /* Ascending unit start positions to stop at */
+    const int *resync_columns;
+    int num_resync;
+    int resync_hit; /* Index of the position parse_program stopped at, or -1 */
     int error_code;
     char *error_msg;
 } Parser;
@@ -19,6 +33,8 @@ typedef struct
 /* Parser functions */
 
 Parser *parser_create(Token *tokens, int num_tokens);
+Parser *parser_create_streaming(Lexer *lexer);
+void parser_set_resync(Parser *parser, const int *lines, const int *columns, int count);
 void parser_free(Parser *parser);
 
 Program *parse_program(Parser *parser);
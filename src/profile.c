@@ -0,0 +1,477 @@
+#include "profile.h"
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+/* Rows per section of the report */
+#define PROFILE_REPORT_ROWS 20
+
+typedef struct
+{
+    char *name;
+    ProfileKind kind;
+    long count;
+    uint64_t total_ns; /* Outermost activations only: recursion is not double counted */
+    uint64_t self_ns;
+    uint64_t outer_start;
+    int active; /* Activations currently on the call stack */
+} ProfileFunc;
+
+/* Call tree node. The root is node 0; its children are line frames, and
+ * everything below those is a procedure or builtin frame. */
+typedef struct
+{
+    int func; /* Index into funcs, or -1 for the root and line frames */
+    int line; /* Line index for line frames */
+    int parent;
+    int first_child;
+    int next_sibling;
+    uint64_t self_ns;
+} ProfileNode;
+
+struct Profiler
+{
+    long *line_count;
+    uint64_t *line_ns;
+    int *line_node; /* Call tree node per line, 0 if none yet */
+    int lines_cap;
+    int line_index; /* Line being dispatched, -1 between lines */
+    uint64_t line_start;
+
+    ProfileFunc *funcs;
+    int num_funcs;
+    int funcs_cap;
+    int *func_index; /* Open-addressed hash of (kind, name) into funcs */
+    int func_index_cap;
+
+    ProfileNode *nodes;
+    int num_nodes;
+    int nodes_cap;
+    int current;   /* Node whose frame is running */
+    uint64_t last; /* Time of the last call tree transition */
+    uint64_t started;
+};
+
+static uint64_t profile_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int add_node(Profiler *prof, int parent, int func, int line)
+{
+    if (prof->num_nodes >= prof->nodes_cap)
+    {
+        prof->nodes_cap *= 2;
+        prof->nodes = xrealloc(prof->nodes, prof->nodes_cap * sizeof(ProfileNode));
+    }
+    int id = prof->num_nodes++;
+    ProfileNode *node = &prof->nodes[id];
+    node->func = func;
+    node->line = line;
+    node->parent = parent;
+    node->first_child = -1;
+    node->next_sibling = -1;
+    node->self_ns = 0;
+    if (parent >= 0)
+    {
+        node->next_sibling = prof->nodes[parent].first_child;
+        prof->nodes[parent].first_child = id;
+    }
+    return id;
+}
+
+Profiler *profile_create(void)
+{
+    Profiler *prof = xcalloc(1, sizeof(Profiler));
+    prof->lines_cap = 64;
+    prof->line_count = xcalloc(prof->lines_cap, sizeof(long));
+    prof->line_ns = xcalloc(prof->lines_cap, sizeof(uint64_t));
+    prof->line_node = xcalloc(prof->lines_cap, sizeof(int));
+    prof->line_index = -1;
+
+    prof->funcs_cap = 32;
+    prof->funcs = xmalloc(prof->funcs_cap * sizeof(ProfileFunc));
+    prof->func_index_cap = 64;
+    prof->func_index = xmalloc(prof->func_index_cap * sizeof(int));
+    memset(prof->func_index, 0xff, prof->func_index_cap * sizeof(int));
+
+    prof->nodes_cap = 64;
+    prof->nodes = xmalloc(prof->nodes_cap * sizeof(ProfileNode));
+    add_node(prof, -1, -1, -1);
+    prof->current = 0;
+    prof->started = prof->last = profile_now();
+    return prof;
+}
+
+void profile_free(Profiler *prof)
+{
+    if (prof == NULL)
+    {
+        return;
+    }
+    for (int i = 0; i < prof->num_funcs; i++)
+    {
+        free(prof->funcs[i].name);
+    }
+    free(prof->funcs);
+    free(prof->func_index);
+    free(prof->nodes);
+    free(prof->line_count);
+    free(prof->line_ns);
+    free(prof->line_node);
+    free(prof);
+}
+
+/* Charge the time since the last transition to the running frame */
+static void charge(Profiler *prof, uint64_t now)
+{
+    ProfileNode *node = &prof->nodes[prof->current];
+    uint64_t delta = now - prof->last;
+    node->self_ns += delta;
+    if (node->func >= 0)
+    {
+        prof->funcs[node->func].self_ns += delta;
+    }
+    prof->last = now;
+}
+
+static void grow_lines(Profiler *prof, int line_index)
+{
+    int old = prof->lines_cap;
+    while (prof->lines_cap <= line_index)
+    {
+        prof->lines_cap *= 2;
+    }
+    prof->line_count = xrealloc(prof->line_count, prof->lines_cap * sizeof(long));
+    prof->line_ns = xrealloc(prof->line_ns, prof->lines_cap * sizeof(uint64_t));
+    prof->line_node = xrealloc(prof->line_node, prof->lines_cap * sizeof(int));
+    memset(prof->line_count + old, 0, (prof->lines_cap - old) * sizeof(long));
+    memset(prof->line_ns + old, 0, (prof->lines_cap - old) * sizeof(uint64_t));
+    memset(prof->line_node + old, 0, (prof->lines_cap - old) * sizeof(int));
+}
+
+void profile_line_enter(Profiler *prof, int line_index)
+{
+    uint64_t now = profile_now();
+    charge(prof, now);
+    if (line_index >= prof->lines_cap)
+    {
+        grow_lines(prof, line_index);
+    }
+    if (prof->line_node[line_index] == 0)
+    {
+        prof->line_node[line_index] = add_node(prof, 0, -1, line_index);
+    }
+    prof->current = prof->line_node[line_index];
+    prof->line_count[line_index]++;
+    prof->line_index = line_index;
+    prof->line_start = now;
+}
+
+void profile_line_exit(Profiler *prof)
+{
+    if (prof->line_index < 0)
+    {
+        return;
+    }
+    uint64_t now = profile_now();
+    charge(prof, now);
+    prof->line_ns[prof->line_index] += now - prof->line_start;
+    prof->line_index = -1;
+    prof->current = 0;
+}
+
+static unsigned int func_hash(ProfileKind kind, const char *name)
+{
+    unsigned int h = 2166136261u ^ (unsigned int)kind;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++)
+    {
+        h = (h ^ (unsigned char)toupper(*p)) * 16777619u;
+    }
+    return h;
+}
+
+/* Bucket holding (kind, name), or the empty bucket where it would go.
+ * Names match case-insensitively, like procedure lookup. */
+static int *func_bucket(Profiler *prof, ProfileKind kind, const char *name)
+{
+    unsigned int mask = (unsigned int)prof->func_index_cap - 1;
+    unsigned int i = func_hash(kind, name) & mask;
+    while (prof->func_index[i] >= 0)
+    {
+        ProfileFunc *f = &prof->funcs[prof->func_index[i]];
+        if (f->kind == kind && strcasecmp(f->name, name) == 0)
+        {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return &prof->func_index[i];
+}
+
+static int intern_func(Profiler *prof, ProfileKind kind, const char *name)
+{
+    int *bucket = func_bucket(prof, kind, name);
+    if (*bucket >= 0)
+    {
+        return *bucket;
+    }
+
+    if (prof->num_funcs >= prof->funcs_cap)
+    {
+        prof->funcs_cap *= 2;
+        prof->funcs = xrealloc(prof->funcs, prof->funcs_cap * sizeof(ProfileFunc));
+    }
+    int id = prof->num_funcs++;
+    ProfileFunc *f = &prof->funcs[id];
+    memset(f, 0, sizeof(*f));
+    f->name = xstrdup(name);
+    f->kind = kind;
+    *bucket = id;
+
+    if (prof->num_funcs * 2 > prof->func_index_cap)
+    {
+        free(prof->func_index);
+        prof->func_index_cap *= 2;
+        prof->func_index = xmalloc(prof->func_index_cap * sizeof(int));
+        memset(prof->func_index, 0xff, prof->func_index_cap * sizeof(int));
+        for (int i = 0; i < prof->num_funcs; i++)
+        {
+            *func_bucket(prof, prof->funcs[i].kind, prof->funcs[i].name) = i;
+        }
+    }
+    return id;
+}
+
+void profile_call_enter(Profiler *prof, ProfileKind kind, const char *name)
+{
+    uint64_t now = profile_now();
+    charge(prof, now);
+
+    int id = intern_func(prof, kind, name ? name : "?");
+    ProfileFunc *f = &prof->funcs[id];
+    f->count++;
+    if (f->active++ == 0)
+    {
+        f->outer_start = now;
+    }
+
+    int child = prof->nodes[prof->current].first_child;
+    while (child >= 0 && prof->nodes[child].func != id)
+    {
+        child = prof->nodes[child].next_sibling;
+    }
+    if (child < 0)
+    {
+        child = add_node(prof, prof->current, id, -1);
+    }
+    prof->current = child;
+}
+
+void profile_call_exit(Profiler *prof)
+{
+    ProfileNode *node = &prof->nodes[prof->current];
+    if (node->func < 0)
+    {
+        return; /* Unbalanced exit */
+    }
+    uint64_t now = profile_now();
+    charge(prof, now);
+
+    ProfileFunc *f = &prof->funcs[node->func];
+    if (--f->active == 0)
+    {
+        f->total_ns += now - f->outer_start;
+    }
+    prof->current = node->parent;
+}
+
+/* Report */
+
+static _Thread_local const Profiler *g_sort_prof; /* qsort has no context argument */
+
+static int cmp_line_time(const void *a, const void *b)
+{
+    uint64_t ta = g_sort_prof->line_ns[*(const int *)a];
+    uint64_t tb = g_sort_prof->line_ns[*(const int *)b];
+    if (ta != tb)
+        return ta < tb ? 1 : -1;
+    return *(const int *)a - *(const int *)b;
+}
+
+static int cmp_func_time(const void *a, const void *b)
+{
+    const ProfileFunc *fa = &g_sort_prof->funcs[*(const int *)a];
+    const ProfileFunc *fb = &g_sort_prof->funcs[*(const int *)b];
+    if (fa->total_ns != fb->total_ns)
+        return fa->total_ns < fb->total_ns ? 1 : -1;
+    return strcasecmp(fa->name, fb->name);
+}
+
+static double ms(uint64_t ns)
+{
+    return ns / 1e6;
+}
+
+/* Source line of a program line, counting from 1 */
+static int source_line(const Program *prog, int line_index)
+{
+    if (prog && line_index < prog->num_lines && prog->lines[line_index]->src_line > 0)
+    {
+        return prog->lines[line_index]->src_line;
+    }
+    return line_index + 1;
+}
+
+static void report_funcs(const Profiler *prof, ProfileKind kind, const char *title, FILE *out)
+{
+    int *order = xmalloc((prof->num_funcs + 1) * sizeof(int));
+    int n = 0;
+    for (int i = 0; i < prof->num_funcs; i++)
+    {
+        if (prof->funcs[i].kind == kind)
+            order[n++] = i;
+    }
+    if (n > 0)
+    {
+        g_sort_prof = prof;
+        qsort(order, n, sizeof(int), cmp_func_time);
+        fprintf(out, "\n%-24s %10s %12s %12s\n", title, "calls", "total ms", "self ms");
+        for (int i = 0; i < n && i < PROFILE_REPORT_ROWS; i++)
+        {
+            const ProfileFunc *f = &prof->funcs[order[i]];
+            fprintf(out, "  %-22s %10ld %12.3f %12.3f\n", f->name, f->count,
+                    ms(f->total_ns), ms(f->self_ns));
+        }
+        if (n > PROFILE_REPORT_ROWS)
+            fprintf(out, "  (%d more)\n", n - PROFILE_REPORT_ROWS);
+    }
+    free(order);
+}
+
+void profile_report(const Profiler *prof, const Program *prog, FILE *out)
+{
+    if (prof == NULL || out == NULL)
+    {
+        return;
+    }
+
+    uint64_t elapsed = profile_now() - prof->started;
+    fprintf(out, "\nProfile: %.3f ms\n", ms(elapsed));
+
+    int *order = xmalloc(prof->lines_cap * sizeof(int));
+    int n = 0;
+    for (int i = 0; i < prof->lines_cap; i++)
+    {
+        if (prof->line_count[i] > 0)
+            order[n++] = i;
+    }
+    if (n > 0)
+    {
+        g_sort_prof = prof;
+        qsort(order, n, sizeof(int), cmp_line_time);
+        fprintf(out, "\n%-24s %10s %12s %7s\n", "Lines", "count", "total ms", "%");
+        for (int i = 0; i < n && i < PROFILE_REPORT_ROWS; i++)
+        {
+            int line = order[i];
+            const char *what = "";
+            if (prog && line < prog->num_lines && prog->lines[line]->stmt)
+                what = stmt_type_name(prog->lines[line]->stmt->type);
+            char label[64];
+            snprintf(label, sizeof(label), "line %d %s", source_line(prog, line), what);
+            fprintf(out, "  %-22s %10ld %12.3f %7.1f\n", label, prof->line_count[line],
+                    ms(prof->line_ns[line]),
+                    elapsed ? 100.0 * prof->line_ns[line] / elapsed : 0.0);
+        }
+        if (n > PROFILE_REPORT_ROWS)
+            fprintf(out, "  (%d more)\n", n - PROFILE_REPORT_ROWS);
+    }
+    free(order);
+
+    report_funcs(prof, PROFILE_PROCEDURE, "Procedures", out);
+    report_funcs(prof, PROFILE_BUILTIN, "Builtins", out);
+    fflush(out);
+}
+
+/* Collapsed stacks */
+
+typedef struct
+{
+    char *buf;
+    size_t len;
+    size_t cap;
+} PathBuf;
+
+static void path_append(PathBuf *path, const char *frame)
+{
+    size_t need = path->len + strlen(frame) + 2;
+    if (need > path->cap)
+    {
+        while (path->cap < need)
+            path->cap *= 2;
+        path->buf = xrealloc(path->buf, path->cap);
+    }
+    if (path->len > 0)
+        path->buf[path->len++] = ';';
+    strcpy(path->buf + path->len, frame);
+    path->len += strlen(frame);
+}
+
+static void write_node(const Profiler *prof, const Program *prog, int id, PathBuf *path, FILE *out)
+{
+    const ProfileNode *node = &prof->nodes[id];
+    size_t saved = path->len;
+    char frame[32];
+    if (node->func >= 0)
+    {
+        path_append(path, prof->funcs[node->func].name);
+    }
+    else if (node->line >= 0)
+    {
+        snprintf(frame, sizeof(frame), "line %d", source_line(prog, node->line));
+        path_append(path, frame);
+    }
+    else
+    {
+        path_append(path, "main");
+    }
+
+    unsigned long long us = (node->self_ns + 500) / 1000;
+    if (us > 0)
+    {
+        fprintf(out, "%s %llu\n", path->buf, us);
+    }
+    for (int child = node->first_child; child >= 0; child = prof->nodes[child].next_sibling)
+    {
+        write_node(prof, prog, child, path, out);
+    }
+
+    path->len = saved;
+    path->buf[saved] = '\0';
+}
+
+int profile_write_collapsed(const Profiler *prof, const Program *prog, const char *path)
+{
+    if (prof == NULL || path == NULL)
+    {
+        return -1;
+    }
+    FILE *out = fopen(path, "w");
+    if (out == NULL)
+    {
+        return -1;
+    }
+
+    PathBuf buf;
+    buf.cap = 256;
+    buf.len = 0;
+    buf.buf = xmalloc(buf.cap);
+    buf.buf[0] = '\0';
+    write_node(prof, prog, 0, &buf, out);
+    free(buf.buf);
+
+    return fclose(out) == 0 ? 0 : -1;
+}
@@ -0,0 +1,44 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "common.h"
+#include "ast.h"
+#include <stdio.h>
+
+/*
+ * Execution profiler (RUN PROFILE / --profile)
+ *
+ * Counts executions and accumulates wall time per program line, per
+ * procedure and per builtin function, and keeps a call tree from which a
+ * collapsed-stack file (one "frame;frame;... microseconds" line per stack,
+ * the input format of flamegraph tools) can be written. The executor only
+ * calls in here when a Profiler is attached to the runtime, so an
+ * unprofiled run pays a NULL test per line, call and builtin.
+ */
+
+typedef struct Profiler Profiler;
+
+typedef enum
+{
+    PROFILE_PROCEDURE,
+    PROFILE_BUILTIN
+} ProfileKind;
+
+Profiler *profile_create(void);
+void profile_free(Profiler *prof);
+
+/* Bracket one dispatch of prog->lines[line_index] */
+void profile_line_enter(Profiler *prof, int line_index);
+void profile_line_exit(Profiler *prof);
+
+/* Bracket a procedure, method or builtin call; calls nest */
+void profile_call_enter(Profiler *prof, ProfileKind kind, const char *name);
+void profile_call_exit(Profiler *prof);
+
+/* Sorted report of the hottest lines, procedures and builtins */
+void profile_report(const Profiler *prof, const Program *prog, FILE *out);
+
+/* Collapsed stacks in microseconds of self time; 0 on success */
+int profile_write_collapsed(const Profiler *prof, const Program *prog, const char *path);
+
+#endif /* PROFILE_H */
@@ -7,6 +7,32 @@
 #include <time.h>
 #include <stdio.h>
 #include <math.h>
+#include <stdarg.h>
+#include <limits.h>
+
+/* An interned map key: the runtime keeps one copy of each key text, shared
+ * by every map that holds it and by FOR EACH snapshots */
+struct MapKey
+{
+    unsigned int hash;
+    int refs; /* Map entries and snapshots holding the key */
+    char text[];
+};
+
+typedef struct
+{
+    MapKey *key; /* NULL = empty bucket */
+    RuntimeValue value;
+} MapEntry;
+
+/* Open-addressed table of a DIM ... AS MAP variable, linear probing on
+ * the key's hash, at most half full */
+typedef struct
+{
+    MapEntry *entries;
+    int capacity; /* Power of two */
+    int count;
+} BasicMap;
 
 /* Variable storage using simple dynamic array */
 typedef struct
@@ -14,11 +40,13 @@ typedef struct
     char *name;
     VarType type;
     RuntimeValue value;
-    int is_array;
+    int is_array; /* Also set for a map, which has no dimensions */
     int *dimensions;
     int num_dimensions;
     int total_elements;
     int address;
+    int store_hook; /* DEFUSR, PUTA or PUTB: runtime_set_slot also sets machine state */
+    BasicMap *map; /* DIM ... AS MAP table, NULL otherwise */
 } Variable;
 
 typedef struct
@@ -31,7 +59,8 @@ typedef struct
 typedef struct
 {
     FILE *fp;
-    int mode; /* 0 unused, 1 input, 2 output, 3 append */
+    int mode;   /* 1 input, 2 output, 3 append */
+    long start; /* Position at OPEN; the distance from it is the bytes moved */
 } FileHandle;
 
 typedef struct
@@ -48,6 +77,13 @@ struct RuntimeState
     Variable *variables;
     int num_variables;
     int capacity_variables;
+    int *var_index; /* Open-addressed hash of variable positions, -1 = empty */
+    int var_index_capacity;
+
+    /* Variables [0, num_slots) were preallocated from this symbol table, so
+     * a resolved reference's slot is its position in variables */
+    const SymbolTable *symbols;
+    int num_slots;
 
     /* User-defined functions */
     UserDefinedFunction *user_functions;
@@ -70,8 +106,10 @@ struct RuntimeState
     int num_data_segments;
     int capacity_data_segments;
 
-    /* File handles */
-    FileHandle *files;
+    /* File channels: slot (handle - 1) points to an open channel or NULL.
+     * The table grows on demand up to max_files; channels are allocated on OPEN. */
+    FileHandle **files;
+    int files_capacity;
     int max_files;
 
     /* Memory for POKE/PEEK */
@@ -152,36 +190,90 @@ struct RuntimeState
 
     /* Execution context - set during statement execution for access from evaluator */
     void *execution_context; /* ExecutionContext* (void* to avoid circular dependency) */
+
+    /* Profiler for RUN PROFILE / --profile, NULL when not profiling (not owned) */
+    void *profiler;
+
+    /* Resource statistics, and the bytes moved by channels already closed */
+    RuntimeStats stats;
+    long long closed_bytes_read;
+    long long closed_bytes_written;
+
+    /* Statement budget of this runtime alone (libbasicpp), 0 if none */
+    unsigned long long statement_limit;
+
+    /* Directory relative file names resolve against, NULL for the
+     * process's current directory */
+    char *directory;
+
+    /* Program whose DATA is already loaded for its next run (Program*) */
+    const void *data_program;
+
+    /* In a PARALLEL FOR worker, the leading variables whose names and
+     * arrays belong to the parent runtime; 0 otherwise */
+    int shared_variables;
+
+    /* Interned map keys: open-addressed, NULL = empty, at most half full.
+     * Shared with PARALLEL FOR workers, which only look keys up. */
+    MapKey **map_keys;
+    int map_keys_capacity;
+    int num_map_keys;
 };
 
-/* Helper to find variable by name */
-static Variable *find_variable(RuntimeState *state, const char *name)
+static unsigned int var_name_hash(const char *name)
 {
-    if (state == NULL || name == NULL)
+    unsigned int h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++)
     {
-        return NULL;
+        h = (h ^ *p) * 16777619u;
     }
+    return h;
+}
 
-    for (int i = 0; i < state->num_variables; i++)
+/* Bucket holding name, or the empty bucket where it would go */
+static int *var_index_bucket(RuntimeState *state, const char *name)
+{
+    unsigned int mask = (unsigned int)state->var_index_capacity - 1;
+    unsigned int i = var_name_hash(name) & mask;
+    while (state->var_index[i] >= 0 &&
+           strcmp(state->variables[state->var_index[i]].name, name) != 0)
     {
-        if (strcmp(state->variables[i].name, name) == 0)
-        {
-            return &state->variables[i];
-        }
+        i = (i + 1) & mask;
     }
+    return &state->var_index[i];
+}
 
-    return NULL;
+static void var_index_reset(RuntimeState *state)
+{
+    memset(state->var_index, 0xff, state->var_index_capacity * sizeof(int));
 }
 
-/* Helper to create variable if not exists */
-static Variable *ensure_variable(RuntimeState *state, const char *name, VarType type)
+/* Helper to find variable by name */
+static Variable *find_variable(RuntimeState *state, const char *name)
 {
-    Variable *var = find_variable(state, name);
-    if (var != NULL)
+    if (state == NULL || name == NULL)
     {
-        return var;
+        return NULL;
     }
 
+    int pos = *var_index_bucket(state, name);
+    return pos >= 0 ? &state->variables[pos] : NULL;
+}
+
+/* Copy a string value into variable storage */
+static char *store_string(RuntimeState *state, const char *value)
+{
+    size_t size = strlen(value) + 1;
+    char *copy = xmalloc(size);
+    memcpy(copy, value, size);
+    state->stats.allocs[STAT_STRINGS]++;
+    state->stats.alloc_bytes[STAT_STRINGS] += size;
+    return copy;
+}
+
+/* Append a variable that is known not to exist yet */
+static Variable *add_variable(RuntimeState *state, const char *name, VarType type)
+{
     /* Expand capacity if needed */
     if (state->num_variables >= state->capacity_variables)
     {
@@ -189,21 +281,40 @@ static Variable *ensure_variable(RuntimeState *state, const char *name, VarType
         state->variables = xrealloc(state->variables,
                                     state->capacity_variables * sizeof(Variable));
     }
+    if ((state->num_variables + 1) * 2 > state->var_index_capacity)
+    {
+        free(state->var_index);
+        state->var_index_capacity *= 2;
+        state->var_index = xmalloc(state->var_index_capacity * sizeof(int));
+        var_index_reset(state);
+        for (int i = 0; i < state->num_variables; i++)
+        {
+            *var_index_bucket(state, state->variables[i].name) = i;
+        }
+    }
 
     /* Create new variable */
-    var = &state->variables[state->num_variables++];
+    Variable *var = &state->variables[state->num_variables];
     var->name = xstrdup(name);
     var->type = type;
     var->is_array = 0;
     var->dimensions = NULL;
     var->num_dimensions = 0;
     var->total_elements = 0;
+    var->store_hook = strcasecmp(name, "DEFUSR") == 0 || strcasecmp(name, "PUTA") == 0 ||
+                      strcasecmp(name, "PUTB") == 0;
+    var->map = NULL;
+    *var_index_bucket(state, name) = state->num_variables++;
     var->address = 1000 + (state->num_variables * 4);
+    if (state->num_variables > state->stats.peak_variables)
+    {
+        state->stats.peak_variables = state->num_variables;
+    }
 
     /* Initialize value based on type */
     if (type == VAR_STRING)
     {
-        var->value.str_value = xstrdup("");
+        var->value.str_value = store_string(state, "");
     }
     else
     {
@@ -213,54 +324,79 @@ static Variable *ensure_variable(RuntimeState *state, const char *name, VarType
     return var;
 }
 
-/* Helper to get variable type from name */
-static VarType get_var_type_from_name(RuntimeState *state, const char *name)
+/* Helper to create variable if not exists */
+static Variable *ensure_variable(RuntimeState *state, const char *name, VarType type)
 {
-    if (name == NULL || name[0] == '\0')
+    Variable *var = find_variable(state, name);
+    if (var != NULL)
     {
-        return VAR_DOUBLE;
+        return var;
     }
 
-    int len = strlen(name);
-    char last = name[len - 1];
+    return add_variable(state, name, type);
+}
 
-    if (last == '$')
-        return VAR_STRING;
-    if (last == '%')
-        return VAR_INTEGER;
-    if (last == '!')
-        return VAR_SINGLE;
-    if (last == '#')
-        return VAR_DOUBLE;
+/* Helper to get variable type from name */
+static VarType get_var_type_from_name(RuntimeState *state, const char *name)
+{
+    return var_type_from_name(state ? state->letter_types : NULL, name);
+}
 
-    char first = (char)toupper((unsigned char)name[0]);
-    if (state && first >= 'A' && first <= 'Z')
+/* Variable for a reference: its preallocated slot when the symbol table
+ * resolved it, otherwise looked up by name */
+static Variable *slot_variable(RuntimeState *state, int slot, const char *name)
+{
+    if (slot >= 0 && slot < state->num_slots)
     {
-        return state->letter_types[first - 'A'];
+        return &state->variables[slot];
     }
+    return find_variable(state, name);
+}
+
+static void map_free(RuntimeState *state, BasicMap *map, int string_values);
 
-    return VAR_DOUBLE; /* Default */
+/* As slot_variable, creating an unresolved variable on first use */
+static Variable *bind_variable(RuntimeState *state, int slot, const char *name)
+{
+    if (slot >= 0 && slot < state->num_slots)
+    {
+        return &state->variables[slot];
+    }
+    return ensure_variable(state, name, get_var_type_from_name(state, name));
 }
 
-void runtime_set_def_range(RuntimeState *state, VarType type, char start_letter, char end_letter)
+void runtime_preallocate(RuntimeState *state, const void *symtable)
 {
+    const SymbolTable *table = (const SymbolTable *)symtable;
     if (state == NULL)
     {
         return;
     }
 
-    if (start_letter > end_letter)
+    state->symbols = table;
+    state->num_slots = 0;
+
+    /* Slots index variables directly, so storage must start out empty */
+    if (table == NULL || state->num_variables != 0)
     {
         return;
     }
 
-    for (char c = start_letter; c <= end_letter; c++)
+    for (int i = 0; i < table->num_symbols; i++)
     {
-        if (c >= 'A' && c <= 'Z')
-        {
-            state->letter_types[c - 'A'] = type;
-        }
+        add_variable(state, table->symbols[i].name, table->symbols[i].type);
+    }
+    state->num_slots = table->num_symbols;
+}
+
+void runtime_set_def_range(RuntimeState *state, VarType type, char start_letter, char end_letter)
+{
+    if (state == NULL)
+    {
+        return;
     }
+
+    var_type_set_range(state->letter_types, type, start_letter, end_letter);
 }
 
 static _Thread_local RuntimeState *g_current_state = NULL;
@@ -292,6 +428,206 @@ void *runtime_get_execution_context(RuntimeState *state)
     return NULL;
 }
 
+void runtime_set_profiler(RuntimeState *state, void *profiler)
+{
+    if (state)
+    {
+        state->profiler = profiler;
+    }
+}
+
+void *runtime_get_profiler(RuntimeState *state)
+{
+    if (state)
+    {
+        return state->profiler;
+    }
+    return NULL;
+}
+
+void runtime_set_statement_limit(RuntimeState *state, unsigned long long limit)
+{
+    if (state)
+    {
+        state->statement_limit = limit;
+    }
+}
+
+unsigned long long runtime_get_statement_limit(RuntimeState *state)
+{
+    if (state)
+    {
+        return state->statement_limit;
+    }
+    return 0;
+}
+
+/* Bytes read from or written to a channel since it was opened */
+static long long file_bytes_moved(const FileHandle *fh)
+{
+    long pos = ftell(fh->fp);
+    return (pos < 0 || fh->start < 0 || pos < fh->start) ? 0 : (long long)(pos - fh->start);
+}
+
+/* Add an open channel's traffic to the read or written total */
+static void add_file_bytes(const FileHandle *fh, long long *read, long long *written)
+{
+    if (fh == NULL || fh->fp == NULL)
+    {
+        return;
+    }
+    if (fh->mode == 1)
+    {
+        *read += file_bytes_moved(fh);
+    }
+    else
+    {
+        *written += file_bytes_moved(fh);
+    }
+}
+
+RuntimeStats *runtime_stats(RuntimeState *state)
+{
+    return state ? &state->stats : NULL;
+}
+
+void runtime_get_stats(RuntimeState *state, RuntimeStats *out)
+{
+    if (state == NULL || out == NULL)
+    {
+        return;
+    }
+
+    *out = state->stats;
+    ast_get_alloc_stats(&out->allocs[STAT_AST], &out->alloc_bytes[STAT_AST]);
+
+    out->variables = state->num_variables;
+    out->string_bytes = 0;
+    out->array_bytes = 0;
+    for (int i = 0; i < state->num_variables; i++)
+    {
+        const Variable *var = &state->variables[i];
+        if (var->map != NULL)
+        {
+            out->array_bytes += sizeof(BasicMap) + (size_t)var->map->capacity * sizeof(MapEntry);
+            for (int j = 0; var->type == VAR_STRING && j < var->map->capacity; j++)
+            {
+                const char *value = var->map->entries[j].value.str_value;
+                out->string_bytes += var->map->entries[j].key && value ? strlen(value) + 1 : 0;
+            }
+        }
+        else if (var->is_array)
+        {
+            if (var->type == VAR_STRING)
+            {
+                char **arr = (char **)var->value.array_ptr;
+                out->array_bytes += (size_t)var->total_elements * sizeof(char *);
+                for (int j = 0; j < var->total_elements; j++)
+                {
+                    out->string_bytes += arr[j] ? strlen(arr[j]) + 1 : 0;
+                }
+            }
+            else
+            {
+                out->array_bytes += (size_t)var->total_elements * sizeof(double);
+            }
+        }
+        else if (var->type == VAR_STRING && var->value.str_value != NULL)
+        {
+            out->string_bytes += strlen(var->value.str_value) + 1;
+        }
+    }
+    out->array_bytes += (size_t)state->map_keys_capacity * sizeof(MapKey *);
+    for (int i = 0; i < state->map_keys_capacity; i++)
+    {
+        out->string_bytes += state->map_keys[i] ? strlen(state->map_keys[i]->text) + 1 : 0;
+    }
+    out->memory_in_use = (size_t)state->num_variables * sizeof(Variable) +
+                         out->array_bytes + out->string_bytes;
+
+    out->file_bytes_read = state->closed_bytes_read;
+    out->file_bytes_written = state->closed_bytes_written;
+    for (int i = 0; i < state->files_capacity; i++)
+    {
+        add_file_bytes(state->files[i], &out->file_bytes_read, &out->file_bytes_written);
+    }
+}
+
+double runtime_get_free_memory(RuntimeState *state)
+{
+    if (state == NULL)
+    {
+        return 0.0;
+    }
+    RuntimeStats stats;
+    runtime_get_stats(state, &stats);
+    size_t total = (size_t)state->memory_size;
+    return stats.memory_in_use < total ? (double)(total - stats.memory_in_use) : 0.0;
+}
+
+/* Append printf-style text to a growing report */
+static void report_appendf(char **buf, size_t *len, size_t *cap, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (n <= 0)
+    {
+        return;
+    }
+    if (*len + (size_t)n + 1 > *cap)
+    {
+        *cap = (*len + (size_t)n + 1) * 2;
+        *buf = xrealloc(*buf, *cap);
+    }
+    va_start(ap, fmt);
+    vsnprintf(*buf + *len, *cap - *len, fmt, ap);
+    va_end(ap);
+    *len += (size_t)n;
+}
+
+char *runtime_format_stats(RuntimeState *state)
+{
+    static const char *category_names[STAT_CATEGORY_COUNT] = {"strings", "arrays", "AST nodes", "instances"};
+
+    RuntimeStats st;
+    memset(&st, 0, sizeof(st));
+    runtime_get_stats(state, &st);
+
+    size_t len = 0;
+    size_t cap = 1024;
+    char *buf = xmalloc(cap);
+    buf[0] = '\0';
+
+    report_appendf(&buf, &len, &cap, "Statistics\n");
+    report_appendf(&buf, &len, &cap, "  %-22s %12llu\n", "statements executed", st.statements);
+    report_appendf(&buf, &len, &cap, "  %-22s %12d  (peak %d)\n", "variables", st.variables, st.peak_variables);
+    report_appendf(&buf, &len, &cap, "  %-22s %12zu  (FRE %.0f)\n", "memory in use", st.memory_in_use,
+                   runtime_get_free_memory(state));
+    report_appendf(&buf, &len, &cap, "  %-22s %12zu\n", "string bytes", st.string_bytes);
+    report_appendf(&buf, &len, &cap, "  %-22s %12zu\n", "array bytes", st.array_bytes);
+
+    report_appendf(&buf, &len, &cap, "\n%-24s %12s %12s\n", "Allocations", "count", "bytes");
+    for (int i = 0; i < STAT_CATEGORY_COUNT; i++)
+    {
+        report_appendf(&buf, &len, &cap, "  %-22s %12llu %12llu\n", category_names[i], st.allocs[i],
+                       st.alloc_bytes[i]);
+    }
+
+    report_appendf(&buf, &len, &cap, "\n%-24s %12s\n", "Stack high-water", "depth");
+    report_appendf(&buf, &len, &cap, "  %-22s %12d\n", "FOR", st.peak_for_depth);
+    report_appendf(&buf, &len, &cap, "  %-22s %12d\n", "WHILE", st.peak_while_depth);
+    report_appendf(&buf, &len, &cap, "  %-22s %12d\n", "DO", st.peak_do_depth);
+    report_appendf(&buf, &len, &cap, "  %-22s %12d\n", "GOSUB", st.peak_gosub_depth);
+    report_appendf(&buf, &len, &cap, "  %-22s %12d\n", "procedure calls", st.peak_call_depth);
+
+    report_appendf(&buf, &len, &cap, "\n%-24s %12s\n", "Files", "bytes");
+    report_appendf(&buf, &len, &cap, "  %-22s %12lld\n", "read", st.file_bytes_read);
+    report_appendf(&buf, &len, &cap, "  %-22s %12lld\n", "written", st.file_bytes_written);
+    return buf;
+}
+
 RuntimeState *runtime_create(void)
 {
     RuntimeState *state = xcalloc(1, sizeof(RuntimeState));
@@ -300,6 +636,9 @@ RuntimeState *runtime_create(void)
     state->capacity_variables = 256;
     state->variables = xmalloc(state->capacity_variables * sizeof(Variable));
     state->num_variables = 0;
+    state->var_index_capacity = 2 * state->capacity_variables;
+    state->var_index = xmalloc(state->var_index_capacity * sizeof(int));
+    var_index_reset(state);
 
     /* User-defined functions */
     state->capacity_user_functions = 64;
@@ -333,9 +672,10 @@ RuntimeState *runtime_create(void)
     state->num_data_segments = 0;
     state->capacity_data_segments = 0;
 
-    /* Files */
-    state->max_files = 10;
-    state->files = xcalloc(state->max_files, sizeof(FileHandle));
+    /* Files (table allocated lazily on first OPEN) */
+    state->files = NULL;
+    state->files_capacity = 0;
+    state->max_files = MAX_FILES;
 
     /* Memory */
     state->memory_size = 32768;
@@ -428,9 +768,21 @@ void runtime_free(RuntimeState *state)
                 }
                 free(state->variables[i].value.array_ptr);
             }
+            if (state->variables[i].map != NULL)
+            {
+                map_free(state, state->variables[i].map, state->variables[i].type == VAR_STRING);
+            }
         }
         free(state->variables);
     }
+    free(state->var_index);
+
+    /* Keys still interned are held by FOR EACH snapshots left behind */
+    for (int i = 0; i < state->map_keys_capacity; i++)
+    {
+        free(state->map_keys[i]);
+    }
+    free(state->map_keys);
 
     /* Free call stack */
     if (state->call_stack != NULL)
@@ -454,17 +806,8 @@ void runtime_free(RuntimeState *state)
     free(state->data_segment_start);
 
     /* Close files */
-    if (state->files != NULL)
-    {
-        for (int i = 0; i < state->max_files; i++)
-        {
-            if (state->files[i].fp != NULL)
-            {
-                fclose(state->files[i].fp);
-            }
-        }
-        free(state->files);
-    }
+    runtime_close_all_files(state);
+    free(state->files);
 
     /* Free memory */
     if (state->memory != NULL)
@@ -534,21 +877,141 @@ void runtime_free(RuntimeState *state)
         free(state->instances);
     }
 
+    free(state->directory);
     free(state);
 }
 
+/*
+ * A worker has its own copies of the parent's scalars, its own stacks and
+ * counters, and no error handler (the parent reports its errors). Arrays,
+ * maps, functions, DATA, memory and the class and procedure registries
+ * stay the parent's; the parent must not change them, or run, until the
+ * worker is freed.
+ */
+RuntimeState *runtime_create_worker(RuntimeState *parent)
+{
+    RuntimeState *worker = xmalloc(sizeof(RuntimeState));
+    *worker = *parent;
+
+    worker->variables = xmalloc(parent->capacity_variables * sizeof(Variable));
+    memcpy(worker->variables, parent->variables, parent->num_variables * sizeof(Variable));
+    for (int i = 0; i < parent->num_variables; i++)
+    {
+        Variable *var = &worker->variables[i];
+        if (!var->is_array && var->type == VAR_STRING && var->value.str_value != NULL)
+        {
+            var->value.str_value = xstrdup(var->value.str_value);
+        }
+    }
+    worker->var_index = xmalloc(parent->var_index_capacity * sizeof(int));
+    memcpy(worker->var_index, parent->var_index, parent->var_index_capacity * sizeof(int));
+    worker->shared_variables = parent->num_variables;
+
+    worker->call_stack = xmalloc(worker->call_stack_capacity * sizeof(int));
+    worker->call_stack_ptr = 0;
+    worker->do_loop_stack = xmalloc(worker->do_loop_cap * sizeof(worker->do_loop_stack[0]));
+    worker->do_loop_sp = 0;
+    worker->scope_stack = scope_stack_create();
+
+    worker->files = NULL;
+    worker->files_capacity = 0;
+    worker->error_handler_line = 0;
+    worker->execution_context = NULL;
+    worker->profiler = NULL;
+    memset(&worker->stats, 0, sizeof(worker->stats));
+    return worker;
+}
+
+void runtime_join_worker(RuntimeState *parent, RuntimeState *worker, int take_scalars)
+{
+    RuntimeStats *ps = &parent->stats;
+    const RuntimeStats *ws = &worker->stats;
+    ps->statements += ws->statements;
+    for (int i = 0; i < STAT_CATEGORY_COUNT; i++)
+    {
+        ps->allocs[i] += ws->allocs[i];
+        ps->alloc_bytes[i] += ws->alloc_bytes[i];
+    }
+    ps->peak_for_depth = ws->peak_for_depth > ps->peak_for_depth ? ws->peak_for_depth : ps->peak_for_depth;
+    ps->peak_while_depth = ws->peak_while_depth > ps->peak_while_depth ? ws->peak_while_depth : ps->peak_while_depth;
+    ps->peak_do_depth = ws->peak_do_depth > ps->peak_do_depth ? ws->peak_do_depth : ps->peak_do_depth;
+
+    if (!take_scalars)
+    {
+        return;
+    }
+    for (int i = 0; i < worker->num_variables; i++)
+    {
+        Variable *wv = &worker->variables[i];
+        if (wv->is_array)
+        {
+            continue;
+        }
+        Variable *pv = i < worker->shared_variables ? &parent->variables[i] : ensure_variable(parent, wv->name, wv->type);
+        if (pv->is_array)
+        {
+            continue;
+        }
+        if (wv->type == VAR_STRING)
+        {
+            free(pv->value.str_value);
+            pv->value.str_value = wv->value.str_value;
+            wv->value.str_value = NULL;
+        }
+        else
+        {
+            pv->value.num_value = wv->value.num_value;
+        }
+    }
+}
+
+void runtime_free_worker(RuntimeState *worker)
+{
+    if (worker == NULL)
+    {
+        return;
+    }
+
+    for (int i = 0; i < worker->num_variables; i++)
+    {
+        Variable *var = &worker->variables[i];
+        if (!var->is_array && var->type == VAR_STRING)
+        {
+            free(var->value.str_value);
+        }
+        if (i >= worker->shared_variables)
+        {
+            free(var->name);
+        }
+    }
+    free(worker->variables);
+    free(worker->var_index);
+    free(worker->call_stack);
+    free(worker->do_loop_stack);
+    scope_stack_free(worker->scope_stack);
+    free(worker);
+}
+
 void runtime_set_variable(RuntimeState *state, const char *name, double value)
+{
+    runtime_set_slot(state, -1, name, value);
+}
+
+void runtime_set_slot(RuntimeState *state, int slot, const char *name, double value)
 {
     if (state == NULL || name == NULL)
     {
         return;
     }
 
-    VarType type = get_var_type_from_name(state, name);
-    Variable *var = ensure_variable(state, name, type);
+    Variable *var = bind_variable(state, slot, name);
 
-    if (type == VAR_STRING)
+    if (var->type == VAR_STRING)
     {
+        if (var->is_array)
+        {
+            return;
+        }
         /* Setting numeric value to string variable - convert */
         char buf[64];
         snprintf(buf, sizeof(buf), "%.10g", value);
@@ -556,9 +1019,9 @@ void runtime_set_variable(RuntimeState *state, const char *name, double value)
         {
             free(var->value.str_value);
         }
-        var->value.str_value = xstrdup(buf);
+        var->value.str_value = store_string(state, buf);
     }
-    else if (type == VAR_INTEGER)
+    else if (var->type == VAR_INTEGER)
     {
         var->value.num_value = (double)((int)value);
     }
@@ -568,6 +1031,11 @@ void runtime_set_variable(RuntimeState *state, const char *name, double value)
     }
 
     /* Special variables for machine code simulation */
+    char first = (char)toupper((unsigned char)name[0]);
+    if (first != 'D' && first != 'P')
+    {
+        return;
+    }
     if (strcasecmp(name, "DEFUSR") == 0)
     {
         state->usr_address = (int)value;
@@ -583,26 +1051,30 @@ void runtime_set_variable(RuntimeState *state, const char *name, double value)
 }
 
 void runtime_set_string_variable(RuntimeState *state, const char *name, const char *value)
+{
+    runtime_set_string_slot(state, -1, name, value);
+}
+
+void runtime_set_string_slot(RuntimeState *state, int slot, const char *name, const char *value)
 {
     if (state == NULL || name == NULL || value == NULL)
     {
         return;
     }
 
-    VarType type = get_var_type_from_name(state, name);
-    Variable *var = ensure_variable(state, name, type);
+    Variable *var = bind_variable(state, slot, name);
     if (var->is_array)
     {
         return;
     }
 
-    if (type == VAR_STRING)
+    if (var->type == VAR_STRING)
     {
         if (var->value.str_value != NULL)
         {
             free(var->value.str_value);
         }
-        var->value.str_value = xstrdup(value);
+        var->value.str_value = store_string(state, value);
     }
     else
     {
@@ -612,20 +1084,19 @@ void runtime_set_string_variable(RuntimeState *state, const char *name, const ch
 }
 
 double runtime_get_variable(RuntimeState *state, const char *name)
+{
+    return runtime_get_slot(state, -1, name);
+}
+
+double runtime_get_slot(RuntimeState *state, int slot, const char *name)
 {
     if (state == NULL || name == NULL)
     {
         return 0.0;
     }
 
-    VarType type = get_var_type_from_name(state, name);
-    Variable *var = find_variable(state, name);
-
-    if (var == NULL)
-    {
-        /* Auto-create with default value */
-        var = ensure_variable(state, name, type);
-    }
+    /* Auto-create with default value */
+    Variable *var = bind_variable(state, slot, name);
 
     if (var->type == VAR_STRING)
     {
@@ -636,6 +1107,21 @@ double runtime_get_variable(RuntimeState *state, const char *name)
     return var->value.num_value;
 }
 
+double *runtime_slot_number(RuntimeState *state, int slot)
+{
+    if (state == NULL || slot < 0 || slot >= state->num_slots)
+    {
+        return NULL;
+    }
+
+    Variable *var = &state->variables[slot];
+    if (var->is_array || var->store_hook || (var->type != VAR_DOUBLE && var->type != VAR_SINGLE))
+    {
+        return NULL;
+    }
+    return &var->value.num_value;
+}
+
 int runtime_has_variable(RuntimeState *state, const char *name)
 {
     if (state == NULL || name == NULL)
@@ -656,8 +1142,7 @@ void runtime_delete_variable(RuntimeState *state, const char *name)
         return;
     }
 
-    VarType type = get_var_type_from_name(state, name);
-    if (type == VAR_STRING)
+    if (runtime_get_variable_type(state, name) == VAR_STRING)
     {
         runtime_set_string_variable(state, name, "");
     }
@@ -668,20 +1153,19 @@ void runtime_delete_variable(RuntimeState *state, const char *name)
 }
 
 char *runtime_get_string_variable(RuntimeState *state, const char *name)
+{
+    return runtime_get_string_slot(state, -1, name);
+}
+
+char *runtime_get_string_slot(RuntimeState *state, int slot, const char *name)
 {
     if (state == NULL || name == NULL)
     {
         return xstrdup("");
     }
 
-    VarType type = get_var_type_from_name(state, name);
-    Variable *var = find_variable(state, name);
-
-    if (var == NULL)
-    {
-        /* Auto-create with default value */
-        var = ensure_variable(state, name, type);
-    }
+    /* Auto-create with default value */
+    Variable *var = bind_variable(state, slot, name);
 
     if (var->type == VAR_STRING)
     {
@@ -706,8 +1190,8 @@ void runtime_dim_array(RuntimeState *state, const char *name, int *dimensions, i
         return;
     }
 
-    VarType type = get_var_type_from_name(state, name);
-    Variable *var = ensure_variable(state, name, type);
+    Variable *var = bind_variable(state, -1, name);
+    VarType type = var->type;
 
     /* Calculate total elements */
     int total = 1;
@@ -716,183 +1200,620 @@ void runtime_dim_array(RuntimeState *state, const char *name, int *dimensions, i
         total *= (dimensions[i] + 1); /* BASIC arrays are 0-indexed with upper bound */
     }
 
-    /* Free old array if exists */
-    if (var->is_array && var->value.array_ptr != NULL)
+    /* Free old array or map if exists */
+    if (var->map != NULL)
+    {
+        map_free(state, var->map, type == VAR_STRING);
+        var->map = NULL;
+    }
+    else if (var->is_array && var->value.array_ptr != NULL)
+    {
+        if (var->type == VAR_STRING)
+        {
+            char **arr = (char **)var->value.array_ptr;
+            for (int i = 0; i < var->total_elements; i++)
+            {
+                if (arr[i])
+                    free(arr[i]);
+            }
+        }
+        free(var->value.array_ptr);
+    }
+    else if (!var->is_array && var->type == VAR_STRING)
+    {
+        /* The scalar's value gives way to the array */
+        free(var->value.str_value);
+    }
+    if (var->dimensions != NULL)
+    {
+        free(var->dimensions);
+    }
+
+    /* Allocate new array */
+    var->is_array = 1;
+    var->num_dimensions = num_dims;
+    var->dimensions = xmalloc(num_dims * sizeof(int));
+    memcpy(var->dimensions, dimensions, num_dims * sizeof(int));
+    var->total_elements = total;
+
+    size_t element_size = (type == VAR_STRING) ? sizeof(char *) : sizeof(double);
+    if (type == VAR_STRING)
+    {
+        var->value.array_ptr = xcalloc(total, sizeof(char *));
+    }
+    else
+    {
+        /* Numeric array - allocate as doubles */
+        var->value.array_ptr = (int *)xcalloc(total, sizeof(double));
+    }
+    state->stats.allocs[STAT_ARRAYS]++;
+    state->stats.alloc_bytes[STAT_ARRAYS] += (unsigned long long)total * element_size;
+}
+
+void runtime_set_array_element(RuntimeState *state, const char *name, int *indices, int num_indices, double value)
+{
+    runtime_set_array_slot(state, -1, name, indices, num_indices, value);
+}
+
+void runtime_set_array_slot(RuntimeState *state, int slot, const char *name, int *indices, int num_indices, double value)
+{
+    if (state == NULL || name == NULL || indices == NULL)
+    {
+        return;
+    }
+
+    Variable *var = slot_variable(state, slot, name);
+    if (var == NULL || !var->is_array)
+    {
+        return; /* Array not defined */
+    }
+
+    if (num_indices != var->num_dimensions)
+    {
+        return;
+    }
+
+    /* Calculate linear index */
+    int index = 0;
+    int multiplier = 1;
+    for (int i = num_indices - 1; i >= 0; i--)
+    {
+        index += indices[i] * multiplier;
+        multiplier *= (var->dimensions[i] + 1);
+    }
+
+    if (index >= 0 && index < var->total_elements)
+    {
+        double *array = (double *)var->value.array_ptr;
+        array[index] = value;
+    }
+}
+
+double runtime_get_array_element(RuntimeState *state, const char *name, int *indices, int num_indices)
+{
+    return runtime_get_array_slot(state, -1, name, indices, num_indices);
+}
+
+double runtime_get_array_slot(RuntimeState *state, int slot, const char *name, int *indices, int num_indices)
+{
+    if (state == NULL || name == NULL || indices == NULL)
+    {
+        return 0.0;
+    }
+
+    Variable *var = slot_variable(state, slot, name);
+    if (var == NULL || !var->is_array)
+    {
+        return 0.0; /* Array not defined */
+    }
+
+    if (num_indices != var->num_dimensions)
+    {
+        return 0.0;
+    }
+
+    /* Calculate linear index */
+    int index = 0;
+    int multiplier = 1;
+    for (int i = num_indices - 1; i >= 0; i--)
+    {
+        index += indices[i] * multiplier;
+        multiplier *= (var->dimensions[i] + 1);
+    }
+
+    if (index >= 0 && index < var->total_elements)
+    {
+        double *array = (double *)var->value.array_ptr;
+        return array[index];
+    }
+
+    return 0.0;
+}
+
+double *runtime_array_data(RuntimeState *state, int slot, const char *name, int *num_dims, int bounds[2])
+{
+    if (state == NULL || name == NULL)
+    {
+        return NULL;
+    }
+
+    Variable *var = slot_variable(state, slot, name);
+    if (var == NULL || !var->is_array || var->type == VAR_STRING || var->num_dimensions > 2)
+    {
+        return NULL;
+    }
+
+    *num_dims = var->num_dimensions;
+    bounds[0] = var->dimensions[0];
+    bounds[1] = var->num_dimensions == 2 ? var->dimensions[1] : 0;
+    return (double *)var->value.array_ptr;
+}
+
+void runtime_set_string_array_element(RuntimeState *state, const char *name, int *indices, int num_indices, const char *value)
+{
+    runtime_set_string_array_slot(state, -1, name, indices, num_indices, value);
+}
+
+void runtime_set_string_array_slot(RuntimeState *state, int slot, const char *name, int *indices, int num_indices, const char *value)
+{
+    if (state == NULL || name == NULL || indices == NULL)
+    {
+        return;
+    }
+
+    Variable *var = slot_variable(state, slot, name);
+    if (var == NULL || !var->is_array || var->type != VAR_STRING)
+    {
+        return;
+    }
+
+    if (num_indices != var->num_dimensions)
+    {
+        return;
+    }
+
+    int index = 0;
+    int multiplier = 1;
+    for (int i = var->num_dimensions - 1; i >= 0; i--)
+    {
+        if (indices[i] < 0 || indices[i] > var->dimensions[i])
+        {
+            return;
+        }
+        index += indices[i] * multiplier;
+        multiplier *= (var->dimensions[i] + 1);
+    }
+
+    char **arr = (char **)var->value.array_ptr;
+    if (arr[index])
+    {
+        free(arr[index]);
+    }
+    arr[index] = store_string(state, value ? value : "");
+}
+
+char *runtime_get_string_array_element(RuntimeState *state, const char *name, int *indices, int num_indices)
+{
+    return runtime_get_string_array_slot(state, -1, name, indices, num_indices);
+}
+
+char *runtime_get_string_array_slot(RuntimeState *state, int slot, const char *name, int *indices, int num_indices)
+{
+    if (state == NULL || name == NULL || indices == NULL)
+    {
+        return xstrdup("");
+    }
+
+    Variable *var = slot_variable(state, slot, name);
+    if (var == NULL || !var->is_array || var->type != VAR_STRING)
+    {
+        return xstrdup("");
+    }
+
+    if (num_indices != var->num_dimensions)
+    {
+        return xstrdup("");
+    }
+
+    int index = 0;
+    int multiplier = 1;
+    for (int i = var->num_dimensions - 1; i >= 0; i--)
+    {
+        if (indices[i] < 0 || indices[i] > var->dimensions[i])
+        {
+            return xstrdup("");
+        }
+        index += indices[i] * multiplier;
+        multiplier *= (var->dimensions[i] + 1);
+    }
+
+    char **arr = (char **)var->value.array_ptr;
+    return xstrdup(arr[index] ? arr[index] : "");
+}
+
+/*
+ * Maps (DIM name AS MAP): string keys to numbers, or to strings for a
+ * string variable. Keys are interned in the runtime's key table, so a map
+ * compares keys by pointer and a key that is not interned is in no map.
+ */
+
+static MapKey **map_key_bucket(RuntimeState *state, const char *text, unsigned int hash)
+{
+    unsigned int mask = (unsigned int)state->map_keys_capacity - 1;
+    unsigned int i = hash & mask;
+    while (state->map_keys[i] != NULL &&
+           (state->map_keys[i]->hash != hash || strcmp(state->map_keys[i]->text, text) != 0))
+    {
+        i = (i + 1) & mask;
+    }
+    return &state->map_keys[i];
+}
+
+/* The interned key for text, or NULL if no map holds it */
+static MapKey *find_map_key(RuntimeState *state, const char *text)
+{
+    if (state->num_map_keys == 0)
+    {
+        return NULL;
+    }
+    return *map_key_bucket(state, text, var_name_hash(text));
+}
+
+/* The interned key for text, created if needed, with a reference taken */
+static MapKey *intern_map_key(RuntimeState *state, const char *text)
+{
+    if ((state->num_map_keys + 1) * 2 > state->map_keys_capacity)
+    {
+        MapKey **old = state->map_keys;
+        int old_capacity = state->map_keys_capacity;
+        state->map_keys_capacity = old_capacity ? old_capacity * 2 : 64;
+        state->map_keys = xcalloc(state->map_keys_capacity, sizeof(MapKey *));
+        for (int i = 0; i < old_capacity; i++)
+        {
+            if (old[i] != NULL)
+            {
+                *map_key_bucket(state, old[i]->text, old[i]->hash) = old[i];
+            }
+        }
+        free(old);
+    }
+
+    unsigned int hash = var_name_hash(text);
+    MapKey **bucket = map_key_bucket(state, text, hash);
+    if (*bucket == NULL)
+    {
+        size_t len = strlen(text) + 1;
+        MapKey *key = xmalloc(sizeof(MapKey) + len);
+        key->hash = hash;
+        key->refs = 0;
+        memcpy(key->text, text, len);
+        *bucket = key;
+        state->num_map_keys++;
+        state->stats.allocs[STAT_STRINGS]++;
+        state->stats.alloc_bytes[STAT_STRINGS] += len;
+    }
+    (*bucket)->refs++;
+    return *bucket;
+}
+
+/* Drop a reference; the last one removes the key from the table, closing
+ * the gap by moving later entries of the probe run back */
+static void release_map_key(RuntimeState *state, MapKey *key)
+{
+    if (--key->refs > 0)
+    {
+        return;
+    }
+
+    unsigned int mask = (unsigned int)state->map_keys_capacity - 1;
+    unsigned int hole = (unsigned int)(map_key_bucket(state, key->text, key->hash) - state->map_keys);
+    for (unsigned int j = (hole + 1) & mask; state->map_keys[j] != NULL; j = (j + 1) & mask)
+    {
+        unsigned int home = state->map_keys[j]->hash & mask;
+        if (((j - home) & mask) >= ((j - hole) & mask))
+        {
+            state->map_keys[hole] = state->map_keys[j];
+            hole = j;
+        }
+    }
+    state->map_keys[hole] = NULL;
+    state->num_map_keys--;
+    free(key);
+}
+
+/* Bucket holding key, or the empty bucket where it would go */
+static MapEntry *map_bucket(BasicMap *map, const MapKey *key)
+{
+    unsigned int mask = (unsigned int)map->capacity - 1;
+    unsigned int i = key->hash & mask;
+    while (map->entries[i].key != NULL && map->entries[i].key != key)
+    {
+        i = (i + 1) & mask;
+    }
+    return &map->entries[i];
+}
+
+static BasicMap *map_create(RuntimeState *state)
+{
+    BasicMap *map = xmalloc(sizeof(BasicMap));
+    map->capacity = 16;
+    map->count = 0;
+    map->entries = xcalloc(map->capacity, sizeof(MapEntry));
+    state->stats.allocs[STAT_ARRAYS]++;
+    state->stats.alloc_bytes[STAT_ARRAYS] += sizeof(BasicMap) + map->capacity * sizeof(MapEntry);
+    return map;
+}
+
+static void map_free(RuntimeState *state, BasicMap *map, int string_values)
+{
+    for (int i = 0; i < map->capacity; i++)
+    {
+        if (map->entries[i].key != NULL)
+        {
+            if (string_values)
+            {
+                free(map->entries[i].value.str_value);
+            }
+            release_map_key(state, map->entries[i].key);
+        }
+    }
+    free(map->entries);
+    free(map);
+}
+
+/* Entry for key text, added with an empty value if it is missing */
+static MapEntry *map_insert(RuntimeState *state, Variable *var, const char *text)
+{
+    BasicMap *map = var->map;
+    MapKey *key = find_map_key(state, text);
+    if (key != NULL)
+    {
+        MapEntry *entry = map_bucket(map, key);
+        if (entry->key != NULL)
+        {
+            return entry;
+        }
+    }
+
+    if ((map->count + 1) * 2 > map->capacity)
     {
-        if (var->type == VAR_STRING)
+        MapEntry *old = map->entries;
+        int old_capacity = map->capacity;
+        map->capacity *= 2;
+        map->entries = xcalloc(map->capacity, sizeof(MapEntry));
+        for (int i = 0; i < old_capacity; i++)
         {
-            char **arr = (char **)var->value.array_ptr;
-            for (int i = 0; i < var->total_elements; i++)
+            if (old[i].key != NULL)
             {
-                if (arr[i])
-                    free(arr[i]);
+                *map_bucket(map, old[i].key) = old[i];
             }
         }
-        free(var->value.array_ptr);
+        free(old);
+        state->stats.allocs[STAT_ARRAYS]++;
+        state->stats.alloc_bytes[STAT_ARRAYS] += map->capacity * sizeof(MapEntry);
     }
-    if (var->dimensions != NULL)
-    {
-        free(var->dimensions);
-    }
-
-    /* Allocate new array */
-    var->is_array = 1;
-    var->num_dimensions = num_dims;
-    var->dimensions = xmalloc(num_dims * sizeof(int));
-    memcpy(var->dimensions, dimensions, num_dims * sizeof(int));
-    var->total_elements = total;
 
-    if (type == VAR_STRING)
+    key = intern_map_key(state, text);
+    MapEntry *entry = map_bucket(map, key);
+    entry->key = key;
+    if (var->type == VAR_STRING)
     {
-        var->value.array_ptr = xcalloc(total, sizeof(char *));
+        entry->value.str_value = NULL;
     }
     else
     {
-        /* Numeric array - allocate as doubles */
-        var->value.array_ptr = (int *)xcalloc(total, sizeof(double));
+        entry->value.num_value = 0.0;
     }
+    map->count++;
+    return entry;
 }
 
-void runtime_set_array_element(RuntimeState *state, const char *name, int *indices, int num_indices, double value)
+/* Entry for key text, or NULL if the map lacks it */
+static MapEntry *map_lookup(RuntimeState *state, const Variable *var, const char *text)
 {
-    if (state == NULL || name == NULL || indices == NULL)
+    MapKey *key = find_map_key(state, text);
+    if (key == NULL)
     {
-        return;
+        return NULL;
     }
+    MapEntry *entry = map_bucket(var->map, key);
+    return entry->key != NULL ? entry : NULL;
+}
 
-    Variable *var = find_variable(state, name);
-    if (var == NULL || !var->is_array)
+static Variable *map_variable(RuntimeState *state, int slot, const char *name)
+{
+    if (state == NULL || name == NULL)
     {
-        return; /* Array not defined */
+        return NULL;
     }
+    Variable *var = slot_variable(state, slot, name);
+    return (var != NULL && var->map != NULL) ? var : NULL;
+}
 
-    if (num_indices != var->num_dimensions)
+void runtime_dim_map(RuntimeState *state, const char *name)
+{
+    if (state == NULL || name == NULL)
     {
         return;
     }
 
-    /* Calculate linear index */
-    int index = 0;
-    int multiplier = 1;
-    for (int i = num_indices - 1; i >= 0; i--)
+    Variable *var = bind_variable(state, -1, name);
+    if (var->map != NULL)
     {
-        index += indices[i] * multiplier;
-        multiplier *= (var->dimensions[i] + 1);
+        map_free(state, var->map, var->type == VAR_STRING);
     }
-
-    if (index >= 0 && index < var->total_elements)
+    else if (var->is_array && var->value.array_ptr != NULL)
     {
-        double *array = (double *)var->value.array_ptr;
-        array[index] = value;
+        if (var->type == VAR_STRING)
+        {
+            char **arr = (char **)var->value.array_ptr;
+            for (int i = 0; i < var->total_elements; i++)
+            {
+                free(arr[i]);
+            }
+        }
+        free(var->value.array_ptr);
+    }
+    else if (!var->is_array && var->type == VAR_STRING)
+    {
+        free(var->value.str_value);
     }
+    free(var->dimensions);
+
+    var->is_array = 1;
+    var->dimensions = NULL;
+    var->num_dimensions = 0;
+    var->total_elements = 0;
+    var->value.array_ptr = NULL;
+    var->map = map_create(state);
 }
 
-double runtime_get_array_element(RuntimeState *state, const char *name, int *indices, int num_indices)
+int runtime_is_map(RuntimeState *state, int slot, const char *name)
 {
-    if (state == NULL || name == NULL || indices == NULL)
+    return map_variable(state, slot, name) != NULL;
+}
+
+double runtime_get_map_slot(RuntimeState *state, int slot, const char *name, const char *key)
+{
+    Variable *var = map_variable(state, slot, name);
+    if (var == NULL || var->type == VAR_STRING || key == NULL)
     {
         return 0.0;
     }
+    MapEntry *entry = map_lookup(state, var, key);
+    return entry ? entry->value.num_value : 0.0;
+}
 
-    Variable *var = find_variable(state, name);
-    if (var == NULL || !var->is_array)
+char *runtime_get_string_map_slot(RuntimeState *state, int slot, const char *name, const char *key)
+{
+    Variable *var = map_variable(state, slot, name);
+    if (var == NULL || var->type != VAR_STRING || key == NULL)
     {
-        return 0.0; /* Array not defined */
+        return xstrdup("");
     }
+    MapEntry *entry = map_lookup(state, var, key);
+    return xstrdup(entry && entry->value.str_value ? entry->value.str_value : "");
+}
 
-    if (num_indices != var->num_dimensions)
+int runtime_set_map_slot(RuntimeState *state, int slot, const char *name, const char *key, double value)
+{
+    Variable *var = map_variable(state, slot, name);
+    if (var == NULL || var->type == VAR_STRING || key == NULL)
     {
-        return 0.0;
+        return 0;
     }
-
-    /* Calculate linear index */
-    int index = 0;
-    int multiplier = 1;
-    for (int i = num_indices - 1; i >= 0; i--)
+    if (state->shared_variables > 0)
     {
-        index += indices[i] * multiplier;
-        multiplier *= (var->dimensions[i] + 1);
+        return -1;
     }
+    map_insert(state, var, key)->value.num_value = var->type == VAR_INTEGER ? (double)(int)value : value;
+    return 0;
+}
 
-    if (index >= 0 && index < var->total_elements)
+int runtime_set_string_map_slot(RuntimeState *state, int slot, const char *name, const char *key, const char *value)
+{
+    Variable *var = map_variable(state, slot, name);
+    if (var == NULL || var->type != VAR_STRING || key == NULL)
     {
-        double *array = (double *)var->value.array_ptr;
-        return array[index];
+        return 0;
+    }
+    if (state->shared_variables > 0)
+    {
+        return -1;
     }
+    MapEntry *entry = map_insert(state, var, key);
+    free(entry->value.str_value);
+    entry->value.str_value = store_string(state, value ? value : "");
+    return 0;
+}
 
-    return 0.0;
+int runtime_map_has_key(RuntimeState *state, int slot, const char *name, const char *key)
+{
+    Variable *var = map_variable(state, slot, name);
+    return var != NULL && key != NULL && map_lookup(state, var, key) != NULL;
 }
 
-void runtime_set_string_array_element(RuntimeState *state, const char *name, int *indices, int num_indices, const char *value)
+int runtime_delete_map_key(RuntimeState *state, int slot, const char *name, const char *key)
 {
-    if (state == NULL || name == NULL || indices == NULL)
+    Variable *var = map_variable(state, slot, name);
+    if (var == NULL || key == NULL)
     {
-        return;
+        return 0;
     }
-
-    Variable *var = find_variable(state, name);
-    if (var == NULL || !var->is_array || var->type != VAR_STRING)
+    if (state->shared_variables > 0)
     {
-        return;
+        return -1;
+    }
+    MapEntry *entry = map_lookup(state, var, key);
+    if (entry == NULL)
+    {
+        return 0;
     }
 
-    if (num_indices != var->num_dimensions)
+    BasicMap *map = var->map;
+    if (var->type == VAR_STRING)
     {
-        return;
+        free(entry->value.str_value);
     }
+    release_map_key(state, entry->key);
 
-    int index = 0;
-    int multiplier = 1;
-    for (int i = var->num_dimensions - 1; i >= 0; i--)
+    unsigned int mask = (unsigned int)map->capacity - 1;
+    unsigned int hole = (unsigned int)(entry - map->entries);
+    for (unsigned int j = (hole + 1) & mask; map->entries[j].key != NULL; j = (j + 1) & mask)
     {
-        if (indices[i] < 0 || indices[i] > var->dimensions[i])
+        unsigned int home = map->entries[j].key->hash & mask;
+        if (((j - home) & mask) >= ((j - hole) & mask))
         {
-            return;
+            map->entries[hole] = map->entries[j];
+            hole = j;
         }
-        index += indices[i] * multiplier;
-        multiplier *= (var->dimensions[i] + 1);
     }
+    map->entries[hole].key = NULL;
+    map->count--;
+    return 0;
+}
 
-    char **arr = (char **)var->value.array_ptr;
-    if (arr[index])
-    {
-        free(arr[index]);
-    }
-    arr[index] = xstrdup(value ? value : "");
+static int compare_map_keys(const void *a, const void *b)
+{
+    return strcmp((*(MapKey *const *)a)->text, (*(MapKey *const *)b)->text);
 }
 
-char *runtime_get_string_array_element(RuntimeState *state, const char *name, int *indices, int num_indices)
+MapKey **runtime_map_keys(RuntimeState *state, int slot, const char *name, int *count)
 {
-    if (state == NULL || name == NULL || indices == NULL)
+    Variable *var = map_variable(state, slot, name);
+    *count = 0;
+    if (var == NULL || var->map->count == 0)
     {
-        return xstrdup("");
+        return NULL;
     }
 
-    Variable *var = find_variable(state, name);
-    if (var == NULL || !var->is_array || var->type != VAR_STRING)
+    BasicMap *map = var->map;
+    MapKey **keys = xmalloc(map->count * sizeof(MapKey *));
+    for (int i = 0; i < map->capacity; i++)
     {
-        return xstrdup("");
+        if (map->entries[i].key != NULL)
+        {
+            keys[*count] = map->entries[i].key;
+            keys[*count]->refs++;
+            (*count)++;
+        }
     }
+    qsort(keys, *count, sizeof(MapKey *), compare_map_keys);
+    return keys;
+}
 
-    if (num_indices != var->num_dimensions)
-    {
-        return xstrdup("");
-    }
+const char *runtime_map_key_text(const MapKey *key)
+{
+    return key->text;
+}
 
-    int index = 0;
-    int multiplier = 1;
-    for (int i = var->num_dimensions - 1; i >= 0; i--)
+void runtime_release_map_keys(RuntimeState *state, MapKey **keys, int count)
+{
+    for (int i = 0; i < count; i++)
     {
-        if (indices[i] < 0 || indices[i] > var->dimensions[i])
-        {
-            return xstrdup("");
-        }
-        index += indices[i] * multiplier;
-        multiplier *= (var->dimensions[i] + 1);
+        release_map_key(state, keys[i]);
     }
-
-    char **arr = (char **)var->value.array_ptr;
-    return xstrdup(arr[index] ? arr[index] : "");
+    free(keys);
 }
 
 int runtime_push_call(RuntimeState *state, int return_line)
@@ -902,6 +1823,10 @@ int runtime_push_call(RuntimeState *state, int return_line)
         return 0;
     }
     state->call_stack[state->call_stack_ptr++] = return_line;
+    if (state->call_stack_ptr > state->stats.peak_gosub_depth)
+    {
+        state->stats.peak_gosub_depth = state->call_stack_ptr;
+    }
     return 1;
 }
 
@@ -955,6 +1880,10 @@ void runtime_clear_all(RuntimeState *state)
         {
             free(state->variables[i].value.str_value);
         }
+        if (state->variables[i].map != NULL)
+        {
+            map_free(state, state->variables[i].map, state->variables[i].type == VAR_STRING);
+        }
         if (state->variables[i].is_array)
         {
             free(state->variables[i].dimensions);
@@ -966,8 +1895,10 @@ void runtime_clear_all(RuntimeState *state)
         }
     }
 
-    /* Reset the variable array */
+    /* Reset the variable array, then give resolved references their slots back */
     state->num_variables = 0;
+    var_index_reset(state);
+    runtime_preallocate(state, state->symbols);
 }
 
 void runtime_set_error_handler(RuntimeState *state, int line)
@@ -1045,6 +1976,7 @@ void runtime_data_clear(RuntimeState *state)
     {
         return;
     }
+    state->data_program = NULL;
     if (state->data_values != NULL)
     {
         for (int i = 0; i < state->num_data_values; i++)
@@ -1068,6 +2000,19 @@ void runtime_data_clear(RuntimeState *state)
     state->capacity_data_segments = 0;
 }
 
+void runtime_set_data_program(RuntimeState *state, const void *prog)
+{
+    if (state)
+    {
+        state->data_program = prog;
+    }
+}
+
+const void *runtime_get_data_program(RuntimeState *state)
+{
+    return state ? state->data_program : NULL;
+}
+
 static void ensure_data_segment_capacity(RuntimeState *state)
 {
     if (state->num_data_segments >= state->capacity_data_segments)
@@ -1181,44 +2126,169 @@ int runtime_data_read(RuntimeState *state, VarType *out_type, double *out_num, c
     return 1;
 }
 
+/* Helper to map a channel number to its slot, or NULL if not open */
+static FileHandle *find_file(RuntimeState *state, int handle)
+{
+    if (state == NULL || handle <= 0 || handle > state->files_capacity)
+    {
+        return NULL;
+    }
+    return state->files[handle - 1];
+}
+
+/* Helper to grow the channel table so that `handle` has a slot */
+static int ensure_file_slot(RuntimeState *state, int handle)
+{
+    if (handle <= 0 || handle > state->max_files)
+    {
+        return 0;
+    }
+    if (handle <= state->files_capacity)
+    {
+        return 1;
+    }
+
+    int new_capacity = (state->files_capacity == 0) ? 16 : state->files_capacity * 2;
+    while (new_capacity < handle)
+    {
+        new_capacity *= 2;
+    }
+    if (new_capacity > state->max_files)
+    {
+        new_capacity = state->max_files;
+    }
+
+    state->files = xrealloc(state->files, (size_t)new_capacity * sizeof(FileHandle *));
+    for (int i = state->files_capacity; i < new_capacity; i++)
+    {
+        state->files[i] = NULL;
+    }
+    state->files_capacity = new_capacity;
+    return 1;
+}
+
+void runtime_set_max_files(RuntimeState *state, int max_files)
+{
+    if (state == NULL)
+    {
+        return;
+    }
+
+    if (max_files <= 0)
+    {
+        max_files = MAX_FILES;
+    }
+
+    /* Never shrink below a channel that is currently open */
+    for (int i = state->files_capacity; i > max_files; i--)
+    {
+        if (state->files[i - 1] != NULL)
+        {
+            max_files = i;
+            break;
+        }
+    }
+
+    state->max_files = max_files;
+}
+
+int runtime_get_max_files(RuntimeState *state)
+{
+    return state ? state->max_files : 0;
+}
+
+void runtime_set_directory(RuntimeState *state, const char *dir)
+{
+    if (state == NULL)
+    {
+        return;
+    }
+    free(state->directory);
+    state->directory = (dir && dir[0]) ? xstrdup(dir) : NULL;
+}
+
+const char *runtime_resolve_path(RuntimeState *state, const char *name, char *buf, size_t size)
+{
+    if (state == NULL || state->directory == NULL || name == NULL || name[0] == '/')
+    {
+        return name;
+    }
+    int len = snprintf(buf, size, "%s/%s", state->directory, name);
+    return (len >= 0 && (size_t)len < size) ? buf : NULL;
+}
+
 int runtime_open_file(RuntimeState *state, int handle, const char *filename, const char *mode)
 {
-    if (state == NULL || handle <= 0 || handle > state->max_files || filename == NULL || mode == NULL)
+    if (state == NULL || filename == NULL || mode == NULL || !ensure_file_slot(state, handle))
+    {
+        return 0;
+    }
+
+    FileHandle *fh = state->files[handle - 1];
+    if (fh != NULL && fh->fp != NULL)
+    {
+        add_file_bytes(fh, &state->closed_bytes_read, &state->closed_bytes_written);
+        fclose(fh->fp);
+        fh->fp = NULL;
+    }
+
+    char path[PATH_MAX];
+    const char *resolved = runtime_resolve_path(state, filename, path, sizeof(path));
+    FILE *fp = resolved ? fopen(resolved, mode) : NULL;
+    if (fp == NULL)
     {
+        free(fh);
+        state->files[handle - 1] = NULL;
         return 0;
     }
-    int idx = handle - 1;
-    if (state->files[idx].fp != NULL)
+
+    if (fh == NULL)
+    {
+        fh = xmalloc(sizeof(FileHandle));
+        state->files[handle - 1] = fh;
+    }
+    fh->fp = fp;
+    fh->mode = (mode[0] == 'r') ? 1 : (mode[0] == 'a' ? 3 : 2);
+    if (fh->mode == 3)
     {
-        fclose(state->files[idx].fp);
+        fseek(fp, 0, SEEK_END);
     }
-    state->files[idx].fp = fopen(filename, mode);
-    state->files[idx].mode = (mode[0] == 'r') ? 1 : (mode[0] == 'a' ? 3 : 2);
-    return state->files[idx].fp != NULL;
+    fh->start = ftell(fp);
+    return 1;
 }
 
 void runtime_close_file(RuntimeState *state, int handle)
 {
-    if (state == NULL || handle <= 0 || handle > state->max_files)
+    FileHandle *fh = find_file(state, handle);
+    if (fh == NULL)
     {
         return;
     }
-    int idx = handle - 1;
-    if (state->files[idx].fp != NULL)
+    if (fh->fp != NULL)
     {
-        fclose(state->files[idx].fp);
-        state->files[idx].fp = NULL;
-        state->files[idx].mode = 0;
+        add_file_bytes(fh, &state->closed_bytes_read, &state->closed_bytes_written);
+        fclose(fh->fp);
     }
+    free(fh);
+    state->files[handle - 1] = NULL;
 }
 
-FILE *runtime_get_file(RuntimeState *state, int handle)
+void runtime_close_all_files(RuntimeState *state)
 {
-    if (state == NULL || handle <= 0 || handle > state->max_files)
+    if (state == NULL)
     {
-        return NULL;
+        return;
     }
-    return state->files[handle - 1].fp;
+    for (int i = 0; i < state->files_capacity; i++)
+    {
+        runtime_close_file(state, i + 1);
+    }
+}
+
+FILE *runtime_get_file(RuntimeState *state, int handle)
+{
+    FileHandle *fh = find_file(state, handle);
+    return fh ? fh->fp : NULL;
 }
 
 int runtime_file_eof(RuntimeState *state, int handle)
@@ -1363,6 +2433,11 @@ int runtime_get_var_address(RuntimeState *state, const char *name)
 }
 
 VarType runtime_get_variable_type(RuntimeState *state, const char *name)
+{
+    return runtime_get_slot_type(state, -1, name);
+}
+
+VarType runtime_get_slot_type(RuntimeState *state, int slot, const char *name)
 {
     if (state == NULL || name == NULL)
     {
@@ -1370,7 +2445,7 @@ VarType runtime_get_variable_type(RuntimeState *state, const char *name)
     }
 
     /* First check if variable exists */
-    Variable *var = find_variable(state, name);
+    Variable *var = slot_variable(state, slot, name);
     if (var != NULL)
     {
         return var->type;
@@ -1685,6 +2760,10 @@ int runtime_push_do_loop(RuntimeState *state, int do_line, int condition_type, v
     }
 
     int sp = state->do_loop_sp++;
+    if (state->do_loop_sp > state->stats.peak_do_depth)
+    {
+        state->stats.peak_do_depth = state->do_loop_sp;
+    }
     state->do_loop_stack[sp].do_line_index = do_line;
     state->do_loop_stack[sp].loop_line_index = -1;
     state->do_loop_stack[sp].condition_type = condition_type;
@@ -1775,7 +2854,9 @@ int runtime_get_var_by_index(RuntimeState *state, int index, RuntimeVar *out_var
     Variable *var = &state->variables[index];
     out_var->name = var->name;
     out_var->is_string = (var->type == VAR_STRING);
-    out_var->is_array = var->is_array;
+    out_var->is_array = var->is_array && var->map == NULL;
+    out_var->is_map = var->map != NULL;
+    out_var->map_count = var->map ? var->map->count : 0;
     out_var->numeric_value = var->value.num_value;
     out_var->string_value = var->value.str_value;
     return 0;
@@ -2119,6 +3200,8 @@ ObjectInstance *runtime_create_instance(RuntimeState *state, const char *class_n
     ObjectInstance *instance = xcalloc(1, sizeof(ObjectInstance));
     instance->class_name = xstrdup(class_name);
     instance->instance_id = state->next_instance_id++;
+    state->stats.allocs[STAT_INSTANCES]++;
+    state->stats.alloc_bytes[STAT_INSTANCES] += sizeof(ObjectInstance);
 
     /* Create a scope for instance variables */
     instance->instance_scope = scope_create(scope_current(state->scope_stack));
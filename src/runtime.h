@@ -86,6 +86,40 @@ typedef struct
     int capacity;       /* Allocated capacity */
 } ClassRegistry;
 
+/*
+ * Resource statistics (--stats, SYSTAT, FRE)
+ */
+typedef enum
+{
+    STAT_STRINGS,   /* String values stored in variables and array elements */
+    STAT_ARRAYS,    /* DIM storage */
+    STAT_AST,       /* Parsed statements and expressions (per thread) */
+    STAT_INSTANCES, /* Class instances */
+    STAT_CATEGORY_COUNT
+} StatCategory;
+
+typedef struct
+{
+    /* Counters kept up to date while the program runs */
+    unsigned long long statements; /* Statements executed */
+    unsigned long long allocs[STAT_CATEGORY_COUNT];
+    unsigned long long alloc_bytes[STAT_CATEGORY_COUNT];
+    int peak_variables;
+    int peak_for_depth;
+    int peak_while_depth;
+    int peak_do_depth;
+    int peak_gosub_depth;
+    int peak_call_depth; /* Procedure and method calls */
+
+    /* Filled in by runtime_get_stats */
+    int variables;           /* Variables currently defined */
+    size_t string_bytes;     /* String data held by variables, arrays and maps */
+    size_t array_bytes;      /* Element storage held by arrays and maps */
+    size_t memory_in_use;    /* Variable table, arrays and strings */
+    long long file_bytes_read;
+    long long file_bytes_written;
+} RuntimeStats;
+
 /*
  * Runtime state (opaque structure, defined in runtime.c)
  */
@@ -96,6 +130,14 @@ typedef struct RuntimeState RuntimeState;
 RuntimeState *runtime_create(void);
 void runtime_free(RuntimeState *state);
 
+/* Runtime for one thread of a PARALLEL FOR: private copies of parent's
+ * scalars, parent's arrays. runtime_join_worker adds the worker's counters
+ * to parent's and, with take_scalars, gives parent the worker's scalar
+ * values. A worker is freed with runtime_free_worker, before parent. */
+RuntimeState *runtime_create_worker(RuntimeState *parent);
+void runtime_join_worker(RuntimeState *parent, RuntimeState *worker, int take_scalars);
+void runtime_free_worker(RuntimeState *worker);
+
 /* Current execution state (set by executor for ast_eval_expr) */
 void runtime_set_current_state(RuntimeState *state);
 RuntimeState *runtime_get_current_state(void);
@@ -140,12 +182,59 @@ void runtime_delete_variable(RuntimeState *state, const char *name);
 void runtime_set_string_variable(RuntimeState *state, const char *name, const char *value);
 char *runtime_get_string_variable(RuntimeState *state, const char *name);
 
+/* Storage for every symbol of an analyzed SymbolTable (void* to avoid a
+ * circular dependency), created up front so the slot the symbol table gave
+ * a reference indexes it directly. Kept across CLEAR. */
+void runtime_preallocate(RuntimeState *state, const void *symtable);
+
+/* Slot-addressed access for resolved references; a negative slot falls
+ * back to lookup by name */
+void runtime_set_slot(RuntimeState *state, int slot, const char *name, double value);
+double runtime_get_slot(RuntimeState *state, int slot, const char *name);
+void runtime_set_string_slot(RuntimeState *state, int slot, const char *name, const char *value);
+char *runtime_get_string_slot(RuntimeState *state, int slot, const char *name);
+VarType runtime_get_slot_type(RuntimeState *state, int slot, const char *name);
+void runtime_set_array_slot(RuntimeState *state, int slot, const char *name, int *indices, int num_indices, double value);
+double runtime_get_array_slot(RuntimeState *state, int slot, const char *name, int *indices, int num_indices);
+void runtime_set_string_array_slot(RuntimeState *state, int slot, const char *name, int *indices, int num_indices, const char *value);
+char *runtime_get_string_array_slot(RuntimeState *state, int slot, const char *name, int *indices, int num_indices);
+
+/* Storage of a resolved DOUBLE or SINGLE scalar, for the executor's fused
+ * fast paths; NULL for any other slot, and for DEFUSR, PUTA and PUTB, whose
+ * stores must go through runtime_set_slot. Valid until a variable is
+ * created. */
+double *runtime_slot_number(RuntimeState *state, int slot);
+
+/* Element storage of a numeric array of one or two dimensions, for MAT,
+ * with its dimension count and upper bounds; NULL for anything else.
+ * Valid until the array is dimensioned again. */
+double *runtime_array_data(RuntimeState *state, int slot, const char *name, int *num_dims, int bounds[2]);
+
 void runtime_dim_array(RuntimeState *state, const char *name, int *dimensions, int num_dims);
 void runtime_set_array_element(RuntimeState *state, const char *name, int *indices, int num_indices, double value);
 double runtime_get_array_element(RuntimeState *state, const char *name, int *indices, int num_indices);
 void runtime_set_string_array_element(RuntimeState *state, const char *name, int *indices, int num_indices, const char *value);
 char *runtime_get_string_array_element(RuntimeState *state, const char *name, int *indices, int num_indices);
 
+/* Maps (DIM name AS MAP): string keys to numbers, or to strings for a
+ * string variable. A missing key reads as 0 or "". The setters and
+ * runtime_delete_map_key return 0, or -1 in a PARALLEL FOR worker, which
+ * may only read maps. Keys are interned per runtime; runtime_map_keys
+ * returns a map's keys in ascending order, each held until released, or
+ * NULL with *count 0 for an empty map. */
+typedef struct MapKey MapKey;
+void runtime_dim_map(RuntimeState *state, const char *name);
+int runtime_is_map(RuntimeState *state, int slot, const char *name);
+double runtime_get_map_slot(RuntimeState *state, int slot, const char *name, const char *key);
+char *runtime_get_string_map_slot(RuntimeState *state, int slot, const char *name, const char *key);
+int runtime_set_map_slot(RuntimeState *state, int slot, const char *name, const char *key, double value);
+int runtime_set_string_map_slot(RuntimeState *state, int slot, const char *name, const char *key, const char *value);
+int runtime_map_has_key(RuntimeState *state, int slot, const char *name, const char *key);
+int runtime_delete_map_key(RuntimeState *state, int slot, const char *name, const char *key);
+MapKey **runtime_map_keys(RuntimeState *state, int slot, const char *name, int *count);
+const char *runtime_map_key_text(const MapKey *key);
+void runtime_release_map_keys(RuntimeState *state, MapKey **keys, int count);
+
 int runtime_push_call(RuntimeState *state, int return_line);
 int runtime_pop_call(RuntimeState *state);
 
@@ -178,9 +267,25 @@ void runtime_data_add_number(RuntimeState *state, double value);
 void runtime_data_add_string(RuntimeState *state, const char *value);
 int runtime_data_read(RuntimeState *state, VarType *out_type, double *out_num, char **out_str);
 
+/* Program (Program*) whose DATA executor_preload_data loaded ahead of its
+ * next run, which then starts without loading it again */
+void runtime_set_data_program(RuntimeState *state, const void *prog);
+const void *runtime_get_data_program(RuntimeState *state);
+
 /* File I/O support */
+
+/* Relative file names resolve against the runtime's directory instead of
+ * the process's current one, so runtimes on different threads can each
+ * have their own. runtime_resolve_path returns name itself when it needs
+ * no prefix, buf when it does, and NULL when the result does not fit. */
+void runtime_set_directory(RuntimeState *state, const char *dir);
+const char *runtime_resolve_path(RuntimeState *state, const char *name, char *buf, size_t size);
+
 int runtime_open_file(RuntimeState *state, int handle, const char *filename, const char *mode);
 void runtime_close_file(RuntimeState *state, int handle);
+void runtime_close_all_files(RuntimeState *state);
+void runtime_set_max_files(RuntimeState *state, int max_files);
+int runtime_get_max_files(RuntimeState *state);
 int runtime_file_eof(RuntimeState *state, int handle);
 long runtime_file_loc(RuntimeState *state, int handle);
 long runtime_file_lof(RuntimeState *state, int handle);
@@ -269,6 +374,8 @@ typedef struct
     const char *name;
     int is_string;
     int is_array;
+    int is_map;
+    int map_count; /* Keys in a map */
     double numeric_value;
     char *string_value;
 } RuntimeVar;
@@ -278,4 +385,23 @@ int runtime_get_var_by_index(RuntimeState *state, int index, RuntimeVar *out_var
 void runtime_set_execution_context(RuntimeState *state, void *ctx);
 void *runtime_get_execution_context(RuntimeState *state);
 
+/* Profiler attached for RUN PROFILE / --profile (Profiler*, see profile.h) */
+void runtime_set_profiler(RuntimeState *state, void *profiler);
+void *runtime_get_profiler(RuntimeState *state);
+
+/* Statement budget for this runtime only, 0 for none. Unlike the
+ * process-wide --max-statements, running past it ends just the current
+ * run, as END would; libbasicpp sets it per instance. */
+void runtime_set_statement_limit(RuntimeState *state, unsigned long long limit);
+unsigned long long runtime_get_statement_limit(RuntimeState *state);
+
+/* Resource statistics: the live counters (never NULL for a valid state),
+ * a snapshot including the derived sizes, the SYSTAT / --stats report
+ * (caller frees), and the free memory reported by FRE, which is MEMORY
+ * SIZE less memory_in_use and never negative */
+RuntimeStats *runtime_stats(RuntimeState *state);
+void runtime_get_stats(RuntimeState *state, RuntimeStats *out);
+char *runtime_format_stats(RuntimeState *state);
+double runtime_get_free_memory(RuntimeState *state);
+
 #endif /* RUNTIME_H */
@@ -0,0 +1,413 @@
+#include "serve.h"
+#include "executor.h"
+#include "termio.h"
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Largest input a request may carry */
+#define SERVE_MAX_INPUT (16u << 20)
+
+typedef struct
+{
+    RuntimeState *runtime;
+    Program *program;
+    const ExecLimits *limits;
+} Server;
+
+/* Requests are read straight from the descriptor: a forked child that
+ * exits must not flush or rewind a stdio stream the server still reads */
+typedef struct
+{
+    int fd;
+    char buf[4096];
+    size_t pos;
+    size_t len;
+} ServeReader;
+
+/* The child's console: INPUT reads the request's input, everything else
+ * goes to the pipe the server collects the response from */
+typedef struct
+{
+    const char *input;
+    size_t input_len;
+    size_t input_pos;
+    int error_reported;
+} ServeRun;
+
+static int reader_fill(ServeReader *r)
+{
+    ssize_t got;
+    do
+    {
+        got = read(r->fd, r->buf, sizeof(r->buf));
+    } while (got < 0 && errno == EINTR);
+    r->pos = 0;
+    r->len = got > 0 ? (size_t)got : 0;
+    return got > 0;
+}
+
+/* One request line without its newline; -1 at end of input or if it does
+ * not fit */
+static int reader_line(ServeReader *r, char *line, size_t size)
+{
+    size_t len = 0;
+    for (;;)
+    {
+        if (r->pos == r->len && !reader_fill(r))
+        {
+            return -1;
+        }
+        char c = r->buf[r->pos++];
+        if (c == '\n')
+        {
+            break;
+        }
+        if (len + 1 >= size)
+        {
+            return -1;
+        }
+        line[len++] = c;
+    }
+    if (len > 0 && line[len - 1] == '\r')
+    {
+        len--;
+    }
+    line[len] = '\0';
+    return (int)len;
+}
+
+static int reader_exact(ServeReader *r, char *dst, size_t n)
+{
+    while (n > 0)
+    {
+        if (r->pos == r->len && !reader_fill(r))
+        {
+            return -1;
+        }
+        size_t chunk = r->len - r->pos;
+        if (chunk > n)
+        {
+            chunk = n;
+        }
+        memcpy(dst, r->buf + r->pos, chunk);
+        r->pos += chunk;
+        dst += chunk;
+        n -= chunk;
+    }
+    return 0;
+}
+
+static int write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t put = write(fd, data, len);
+        if (put < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        data += put;
+        len -= (size_t)put;
+    }
+    return 0;
+}
+
+static int send_response(int fd, const char *status, const char *data, size_t len)
+{
+    char header[64];
+    int header_len = snprintf(header, sizeof(header), "%s %zu\n", status, len);
+    if (write_all(fd, header, (size_t)header_len) != 0)
+    {
+        return -1;
+    }
+    return write_all(fd, data, len);
+}
+
+static void child_write(void *user, const char *text, size_t len)
+{
+    (void)user;
+    fwrite(text, 1, len, stdout);
+    fflush(stdout);
+}
+
+static int child_read_line(void *user, char *buf, int size)
+{
+    ServeRun *run = user;
+    if (run->input_pos >= run->input_len)
+    {
+        return -1;
+    }
+    const char *start = run->input + run->input_pos;
+    size_t left = run->input_len - run->input_pos;
+    const char *eol = memchr(start, '\n', left);
+    size_t len = eol ? (size_t)(eol - start) : left;
+    run->input_pos += eol ? len + 1 : len;
+    if (len > 0 && start[len - 1] == '\r')
+    {
+        len--;
+    }
+    if (len > (size_t)size - 1)
+    {
+        len = (size_t)size - 1;
+    }
+    memcpy(buf, start, len);
+    buf[len] = '\0';
+    return (int)len;
+}
+
+static void child_error(void *user, const char *text)
+{
+    ServeRun *run = user;
+    run->error_reported = 1;
+    fputs(text, stdout);
+    fflush(stdout);
+}
+
+/* In the forked child: run the template's copy and exit */
+static void run_child(Server *srv, const char *input, size_t input_len, int out_fd)
+{
+    dup2(out_fd, STDOUT_FILENO);
+    dup2(out_fd, STDERR_FILENO); /* Limit reports */
+    close(out_fd);
+    signal(SIGPIPE, SIG_DFL);
+
+    /* Each request has the whole budget: the limits start over here */
+    limits_set(srv->limits);
+
+    ServeRun run = {input, input_len, 0, 0};
+    TermioSink sink = {child_write, child_read_line, child_error, &run};
+    termio_set_sink(&sink);
+    execute_program(srv->runtime, srv->program);
+    fflush(stdout);
+    _exit(run.error_reported ? 1 : 0);
+}
+
+/* Serve one request; -1 when the stream has ended or went wrong */
+static int serve_request(Server *srv, ServeReader *in, int out_fd)
+{
+    char line[64];
+    if (reader_line(in, line, sizeof(line)) < 0)
+    {
+        return -1;
+    }
+
+    /* "RUN" alone carries no input */
+    unsigned long long input_len = 0;
+    int valid = strncmp(line, "RUN", 3) == 0;
+    if (valid && line[3] != '\0')
+    {
+        char *end;
+        valid = line[3] == ' ' && isdigit((unsigned char)line[4]);
+        if (valid)
+        {
+            input_len = strtoull(line + 4, &end, 10);
+            valid = *end == '\0' && input_len <= SERVE_MAX_INPUT;
+        }
+    }
+    if (!valid)
+    {
+        const char *message = "Bad request\n";
+        send_response(out_fd, "ERROR", message, strlen(message));
+        return -1;
+    }
+
+    char *input = xmalloc((size_t)input_len + 1);
+    if (reader_exact(in, input, (size_t)input_len) != 0)
+    {
+        free(input);
+        return -1;
+    }
+
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0)
+    {
+        free(input);
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(pipe_fds[0]);
+        run_child(srv, input, (size_t)input_len, pipe_fds[1]);
+    }
+    close(pipe_fds[1]);
+    free(input);
+    if (pid < 0)
+    {
+        close(pipe_fds[0]);
+        const char *message = "Cannot start run\n";
+        return send_response(out_fd, "ERROR", message, strlen(message));
+    }
+
+    size_t cap = 4096;
+    size_t len = 0;
+    char *output = xmalloc(cap);
+    for (;;)
+    {
+        if (len == cap)
+        {
+            cap *= 2;
+            output = xrealloc(output, cap);
+        }
+        ssize_t got = read(pipe_fds[0], output + len, cap - len);
+        if (got < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (got <= 0)
+        {
+            break;
+        }
+        len += (size_t)got;
+    }
+    close(pipe_fds[0]);
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    {
+    }
+
+    const char *word = "ERROR";
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+    {
+        word = "OK";
+    }
+    else if (WIFEXITED(status) && WEXITSTATUS(status) == ERR_LIMIT_EXCEEDED)
+    {
+        word = "LIMIT";
+    }
+    else if (WIFSIGNALED(status))
+    {
+        char note[64];
+        int note_len = snprintf(note, sizeof(note), "?Run ended by signal %d\n", WTERMSIG(status));
+        if (len + (size_t)note_len > cap)
+        {
+            cap = len + (size_t)note_len;
+            output = xrealloc(output, cap);
+        }
+        memcpy(output + len, note, (size_t)note_len);
+        len += (size_t)note_len;
+    }
+
+    int result = send_response(out_fd, word, output, len);
+    free(output);
+    return result;
+}
+
+static void serve_stream(Server *srv, int in_fd, int out_fd)
+{
+    ServeReader *in = xcalloc(1, sizeof(ServeReader));
+    in->fd = in_fd;
+    while (serve_request(srv, in, out_fd) == 0)
+    {
+    }
+    free(in);
+}
+
+/* Connection processes are reaped as they end */
+static void reap_children(int sig)
+{
+    int saved_errno = errno;
+    signal(sig, reap_children);
+    while (waitpid(-1, NULL, WNOHANG) > 0)
+    {
+    }
+    errno = saved_errno;
+}
+
+static int serve_socket(Server *srv, const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    int bound = listen_fd >= 0 && bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+    if (!bound && listen_fd >= 0 && errno == EADDRINUSE)
+    {
+        /* A socket nobody answers on was left by an earlier server */
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (probe >= 0 && connect(probe, (struct sockaddr *)&addr, sizeof(addr)) != 0 && errno == ECONNREFUSED)
+        {
+            unlink(path);
+            bound = bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+        }
+        if (probe >= 0)
+        {
+            close(probe);
+        }
+    }
+    if (!bound || listen(listen_fd, 64) != 0)
+    {
+        fprintf(stderr, "Cannot listen on %s: %s\n", path, strerror(errno));
+        if (listen_fd >= 0)
+        {
+            close(listen_fd);
+        }
+        return 1;
+    }
+    fprintf(stderr, "Serving on %s\n", path);
+    signal(SIGCHLD, reap_children);
+
+    for (;;)
+    {
+        int conn = accept(listen_fd, NULL, NULL);
+        if (conn < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            fprintf(stderr, "accept: %s\n", strerror(errno));
+            break;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            signal(SIGCHLD, SIG_DFL);
+            close(listen_fd);
+            serve_stream(srv, conn, conn);
+            _exit(0);
+        }
+        close(conn);
+    }
+
+    close(listen_fd);
+    unlink(path);
+    return 1;
+}
+
+int serve_run(RuntimeState *template_state, Program *prog, const char *socket_path, const ExecLimits *limits)
+{
+    Server srv = {template_state, prog, limits};
+
+    /* Everything a run would otherwise set up first is done here, once */
+    executor_preload_data(template_state, prog);
+
+    /* A client that goes away must not take the server with it */
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, SIG_DFL);
+    fflush(stdout);
+
+    if (socket_path)
+    {
+        return serve_socket(&srv, socket_path);
+    }
+    serve_stream(&srv, STDIN_FILENO, STDOUT_FILENO);
+    return 0;
+}
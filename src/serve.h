@@ -0,0 +1,30 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include "common.h"
+#include "ast.h"
+#include "runtime.h"
+
+/*
+ * Server mode (--serve)
+ *
+ * The program is parsed, resolved and given its DATA once, in a template
+ * runtime. Each run request then forks a copy-on-write child that starts
+ * executing from the template straight away, so a request costs a fork
+ * rather than a process start and a parse. Requests and responses are
+ * length-framed:
+ *
+ *     RUN <n>\n<n bytes of input for INPUT and LINE INPUT>
+ *     <status> <n>\n<n bytes of console output, error reports included>
+ *
+ * where status is OK, ERROR (the program stopped on an error) or LIMIT
+ * (an execution limit stopped it). Requests come on stdin with responses
+ * on stdout, or over a Unix socket where each connection is served by its
+ * own process and may send any number of requests.
+ */
+
+/* Serve prog from template until the input ends (or forever on a socket).
+ * limits apply to each request. Returns the process exit status. */
+int serve_run(RuntimeState *template_state, Program *prog, const char *socket_path, const ExecLimits *limits);
+
+#endif /* SERVE_H */
@@ -2,33 +2,88 @@
 #include <string.h>
 #include <stdio.h>
 #include <ctype.h>
-
-/* Helper: Determine variable type from name suffix/defaults */
-static VarType get_var_type_from_name(const char *name);
-static void set_type_range(char start_letter, char end_letter, VarType type);
-
-static VarType letter_types[26];
-static int letter_types_initialized = 0;
+#include <strings.h>
 
 /* Forward declarations for analysis */
 static int analyze_program_line(SymbolTable *table, ProgramLine *line);
 static int analyze_statement(SymbolTable *table, ASTStmt *stmt);
 static int analyze_expression(SymbolTable *table, ASTExpr *expr);
 
+static unsigned int name_hash(const char *name)
+{
+    unsigned int h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++)
+    {
+        h = (h ^ *p) * 16777619u;
+    }
+    return h;
+}
+
+/* Bucket holding name, or the empty bucket where it would go */
+static int *index_bucket(SymbolTable *table, const char *name)
+{
+    unsigned int mask = (unsigned int)table->index_capacity - 1;
+    unsigned int i = name_hash(name) & mask;
+    while (table->index[i] >= 0 && strcmp(table->symbols[table->index[i]].name, name) != 0)
+    {
+        i = (i + 1) & mask;
+    }
+    return &table->index[i];
+}
+
+static void index_grow(SymbolTable *table)
+{
+    free(table->index);
+    table->index_capacity *= 2;
+    table->index = xmalloc(table->index_capacity * sizeof(int));
+    memset(table->index, 0xff, table->index_capacity * sizeof(int));
+    for (int i = 0; i < table->num_symbols; i++)
+    {
+        *index_bucket(table, table->symbols[i].name) = i;
+    }
+}
+
+/* Append a symbol that is known not to exist yet */
+static Symbol *add_symbol(SymbolTable *table, const char *name, VarType type)
+{
+    if (table->num_symbols >= table->capacity)
+    {
+        table->capacity *= 2;
+        table->symbols = xrealloc(table->symbols,
+                                  table->capacity * sizeof(Symbol));
+    }
+    if ((table->num_symbols + 1) * 2 > table->index_capacity)
+    {
+        index_grow(table);
+    }
+
+    Symbol *sym = &table->symbols[table->num_symbols];
+    sym->name = xstrdup(name);
+    sym->type = type;
+    sym->slot = table->num_symbols;
+    sym->rank = 0;
+    sym->is_array = 0;
+    sym->dimensions = NULL;
+    sym->num_dimensions = 0;
+    sym->is_function = 0;
+    sym->line_defined = 0;
+    *index_bucket(table, name) = table->num_symbols++;
+    return sym;
+}
+
 SymbolTable *symtable_create(void)
 {
     SymbolTable *table = xcalloc(1, sizeof(SymbolTable));
     table->capacity = 256;
     table->symbols = xmalloc(table->capacity * sizeof(Symbol));
     table->num_symbols = 0;
+    table->index_capacity = 512;
+    table->index = xmalloc(table->index_capacity * sizeof(int));
+    memset(table->index, 0xff, table->index_capacity * sizeof(int));
 
-    if (!letter_types_initialized)
+    for (int i = 0; i < 26; i++)
     {
-        for (int i = 0; i < 26; i++)
-        {
-            letter_types[i] = VAR_DOUBLE;
-        }
-        letter_types_initialized = 1;
+        table->letter_types[i] = VAR_DOUBLE;
     }
     return table;
 }
@@ -54,6 +109,8 @@ void symtable_free(SymbolTable *table)
         }
         free(table->symbols);
     }
+    free(table->array_names);
+    free(table->index);
     free(table);
 }
 
@@ -64,15 +121,8 @@ Symbol *symtable_lookup(SymbolTable *table, const char *name)
         return NULL;
     }
 
-    for (int i = 0; i < table->num_symbols; i++)
-    {
-        if (strcmp(table->symbols[i].name, name) == 0)
-        {
-            return &table->symbols[i];
-        }
-    }
-
-    return NULL;
+    int pos = *index_bucket(table, name);
+    return pos >= 0 ? &table->symbols[pos] : NULL;
 }
 
 void symtable_insert(SymbolTable *table, const char *name, VarType type)
@@ -91,131 +141,145 @@ void symtable_insert(SymbolTable *table, const char *name, VarType type)
         return;
     }
 
-    /* Expand capacity if needed */
-    if (table->num_symbols >= table->capacity)
-    {
-        table->capacity *= 2;
-        table->symbols = xrealloc(table->symbols,
-                                  table->capacity * sizeof(Symbol));
-    }
-
-    /* Add new symbol */
-    Symbol *sym = &table->symbols[table->num_symbols++];
-    sym->name = xstrdup(name);
-    sym->type = type;
-    sym->is_array = 0;
-    sym->dimensions = NULL;
-    sym->num_dimensions = 0;
-    sym->is_function = 0;
-    sym->line_defined = 0;
+    add_symbol(table, name, type);
 }
 
 void symtable_insert_array(SymbolTable *table, const char *name,
                            VarType type, int *dimensions, int num_dims)
 {
-    if (table == NULL || name == NULL)
+    if (table == NULL || name == NULL || num_dims <= 0)
     {
         return;
     }
 
-    /* Check if already exists */
-    Symbol *existing = symtable_lookup(table, name);
-    if (existing != NULL)
+    Symbol *sym = symtable_lookup(table, name);
+    if (sym == NULL)
     {
-        /* Already defined as array, update if needed */
-        if (existing->is_array && existing->dimensions != NULL)
-        {
-            free(existing->dimensions);
-        }
-        existing->type = type;
-        existing->is_array = 1;
-        existing->num_dimensions = num_dims;
-        existing->dimensions = xmalloc(num_dims * sizeof(int));
-        memcpy(existing->dimensions, dimensions, num_dims * sizeof(int));
-        return;
+        sym = add_symbol(table, name, type);
     }
-
-    /* Expand capacity if needed */
-    if (table->num_symbols >= table->capacity)
+    else if (sym->dimensions != NULL)
     {
-        table->capacity *= 2;
-        table->symbols = xrealloc(table->symbols,
-                                  table->capacity * sizeof(Symbol));
+        /* Redeclared: the latest DIM wins */
+        free(sym->dimensions);
     }
 
-    /* Add new array symbol */
-    Symbol *sym = &table->symbols[table->num_symbols++];
-    sym->name = xstrdup(name);
     sym->type = type;
     sym->is_array = 1;
+    sym->rank = num_dims;
+    sym->num_dimensions = num_dims;
     sym->dimensions = xmalloc(num_dims * sizeof(int));
     memcpy(sym->dimensions, dimensions, num_dims * sizeof(int));
-    sym->num_dimensions = num_dims;
-    sym->is_function = 0;
-    sym->line_defined = 0;
 }
 
-static VarType get_var_type_from_name(const char *name)
+/* Bucket holding name in the declared-array set, or the empty bucket
+ * where it would go */
+static const char **array_name_bucket(SymbolTable *table, const char *name)
 {
-    if (name == NULL || name[0] == '\0')
+    unsigned int mask = (unsigned int)table->array_names_capacity - 1;
+    unsigned int i = name_hash(name) & mask;
+    while (table->array_names[i] != NULL && strcmp(table->array_names[i], name) != 0)
     {
-        return VAR_DOUBLE; /* Default */
+        i = (i + 1) & mask;
     }
+    return &table->array_names[i];
+}
 
-    /* Check suffix */
-    int len = strlen(name);
-    char last = name[len - 1];
-
-    if (last == '$')
-    {
-        return VAR_STRING;
-    }
-    else if (last == '%')
-    {
-        return VAR_INTEGER;
-    }
-    else if (last == '!')
+static void add_array_name(SymbolTable *table, const char *name)
+{
+    if ((table->num_array_names + 1) * 2 > table->array_names_capacity)
     {
-        return VAR_SINGLE;
+        const char **old = table->array_names;
+        int old_capacity = table->array_names_capacity;
+        table->array_names_capacity = old_capacity ? old_capacity * 2 : 64;
+        table->array_names = xcalloc(table->array_names_capacity, sizeof(const char *));
+        for (int i = 0; i < old_capacity; i++)
+        {
+            if (old[i] != NULL)
+            {
+                *array_name_bucket(table, old[i]) = old[i];
+            }
+        }
+        free(old);
     }
-    else if (last == '#')
+
+    const char **bucket = array_name_bucket(table, name);
+    if (*bucket == NULL)
     {
-        return VAR_DOUBLE;
+        *bucket = name;
+        table->num_array_names++;
     }
+}
 
-    char first = (char)toupper((unsigned char)name[0]);
-    if (first >= 'A' && first <= 'Z')
+/* Record the names DIMmed or MAT-assigned in stmt and its nested bodies */
+static void collect_array_names(SymbolTable *table, ASTStmt *stmt)
+{
+    for (; stmt != NULL; stmt = stmt->next)
     {
-        return letter_types[first - 'A'];
+        if (stmt->type == STMT_DIM)
+        {
+            for (int i = 0; i < stmt->num_exprs; i++)
+            {
+                if (stmt->exprs[i] && stmt->exprs[i]->var_name)
+                {
+                    add_array_name(table, stmt->exprs[i]->var_name);
+                }
+            }
+        }
+        else if (stmt->type == STMT_MAT && stmt->num_exprs > 0 && stmt->exprs[0] && stmt->exprs[0]->var_name)
+        {
+            add_array_name(table, stmt->exprs[0]->var_name);
+        }
+        collect_array_names(table, stmt->body);
+        collect_array_names(table, stmt->else_body);
     }
-
-    return VAR_DOUBLE;
 }
 
-static void set_type_range(char start_letter, char end_letter, VarType type)
+/* Whether name is an array, or is DIMmed or MAT-assigned in the lines
+ * being analyzed */
+static int is_array_name(SymbolTable *table, const char *name)
 {
-    if (start_letter > end_letter)
+    Symbol *sym = symtable_lookup(table, name);
+    if (sym != NULL && sym->is_array)
     {
-        return;
+        return 1;
     }
+    return table->num_array_names > 0 && *array_name_bucket(table, name) != NULL;
+}
 
-    for (char c = start_letter; c <= end_letter; c++)
+int symtable_analyze_program(SymbolTable *table, Program *prog)
+{
+    if (prog == NULL)
     {
-        if (c >= 'A' && c <= 'Z')
-        {
-            letter_types[c - 'A'] = type;
-        }
+        return -1;
     }
+    return symtable_analyze_lines(table, prog, 0, prog->num_lines);
 }
-int symtable_analyze_program(SymbolTable *table, Program *prog)
+
+/* Analyze count lines starting at first, adding to what the table already
+ * holds */
+int symtable_analyze_lines(SymbolTable *table, Program *prog, int first, int count)
 {
     if (table == NULL || prog == NULL)
     {
         return -1;
     }
 
-    /* Analyze each program line */
-    for (int i = 0; i < prog->num_lines; i++)
+    /* A procedure may read an array whose DIM comes later in the program,
+     * so every declared name is known before any reference is resolved */
+    if (table->num_array_names > 0)
+    {
+        memset(table->array_names, 0, table->array_names_capacity * sizeof(const char *));
+        table->num_array_names = 0;
+    }
+    for (int i = first; i < first + count && i < prog->num_lines; i++)
+    {
+        if (prog->lines[i] != NULL)
+        {
+            collect_array_names(table, prog->lines[i]->stmt);
+        }
+    }
+
+    for (int i = first; i < first + count && i < prog->num_lines; i++)
     {
         if (analyze_program_line(table, prog->lines[i]) != 0)
         {
@@ -236,173 +300,135 @@ static int analyze_program_line(SymbolTable *table, ProgramLine *line)
     return analyze_statement(table, line->stmt);
 }
 
-static int analyze_statement(SymbolTable *table, ASTStmt *stmt)
+/* Resolve a variable or array reference, creating its symbol with the type
+ * in effect at this point of the walk */
+static Symbol *resolve_reference(SymbolTable *table, ASTExpr *expr)
 {
-    if (stmt == NULL)
+    Symbol *sym = symtable_lookup(table, expr->var_name);
+    if (sym == NULL)
     {
-        return 0;
+        sym = add_symbol(table, expr->var_name,
+                         var_type_from_name(table->letter_types, expr->var_name));
     }
+    if (expr->type == EXPR_ARRAY && sym->rank == 0)
+    {
+        sym->rank = expr->num_children;
+    }
+    expr->slot = sym->slot;
+    expr->inferred_type = sym->type;
+    return sym;
+}
 
-    switch (stmt->type)
+static void analyze_def_ranges(SymbolTable *table, ASTStmt *stmt)
+{
+    VarType type = VAR_DOUBLE;
+    if (stmt->type == STMT_DEFINT)
+        type = VAR_INTEGER;
+    else if (stmt->type == STMT_DEFSNG)
+        type = VAR_SINGLE;
+    else if (stmt->type == STMT_DEFDBL)
+        type = VAR_DOUBLE;
+    else if (stmt->type == STMT_DEFSTR)
+        type = VAR_STRING;
+
+    for (int i = 0; i < stmt->num_exprs; i++)
     {
-    case STMT_LET:
-        /* Assignment: analyze LHS and RHS */
-        if (stmt->num_exprs >= 2)
+        ASTExpr *expr = stmt->exprs[i];
+        if (!expr || expr->type != EXPR_STRING || !expr->str_value)
+            continue;
+        char start = expr->str_value[0];
+        char end = start;
+        if (strlen(expr->str_value) == 3 && expr->str_value[1] == '-')
         {
-            ASTExpr *lhs = stmt->exprs[0];
-            ASTExpr *rhs = stmt->exprs[1];
-
-            /* Register variable if not already defined */
-            if (lhs && lhs->var_name)
-            {
-                VarType type = get_var_type_from_name(lhs->var_name);
-
-                if (lhs->type == EXPR_ARRAY)
-                {
-                    /* Array assignment - should already be defined via DIM */
-                    Symbol *sym = symtable_lookup(table, lhs->var_name);
-                    if (sym == NULL)
-                    {
-                        /* Implicit array (not recommended, but some BASICs allow) */
-                        symtable_insert(table, lhs->var_name, type);
-                    }
-                }
-                else
-                {
-                    /* Simple variable */
-                    symtable_insert(table, lhs->var_name, type);
-                }
-            }
-
-            /* Analyze RHS expression */
-            analyze_expression(table, rhs);
+            end = expr->str_value[2];
         }
-        break;
-
-    case STMT_INPUT:
-        /* INPUT: register variables being input */
-        for (int i = 0; i < stmt->num_exprs; i++)
+        start = (char)toupper((unsigned char)start);
+        end = (char)toupper((unsigned char)end);
+        if (start >= 'A' && start <= 'Z' && end >= 'A' && end <= 'Z' && start <= end)
         {
-            ASTExpr *expr = stmt->exprs[i];
-            if (expr && expr->type == EXPR_VAR && expr->var_name)
-            {
-                VarType type = get_var_type_from_name(expr->var_name);
-                symtable_insert(table, expr->var_name, type);
-            }
+            var_type_set_range(table->letter_types, type, start, end);
         }
-        break;
+    }
+}
 
-    case STMT_DIM:
-        /* DIM: register array declarations */
-        for (int i = 0; i < stmt->num_exprs; i++)
+static void analyze_dim(SymbolTable *table, ASTStmt *stmt)
+{
+    for (int i = 0; i < stmt->num_exprs; i++)
+    {
+        ASTExpr *expr = stmt->exprs[i];
+        if (expr && expr->type == EXPR_VAR && expr->var_name)
         {
-            ASTExpr *expr = stmt->exprs[i];
-            if (expr && expr->type == EXPR_ARRAY && expr->var_name)
-            {
-                VarType type = get_var_type_from_name(expr->var_name);
-
-                /* Extract dimensions */
-                int num_dims = expr->num_children;
-                int *dims = xmalloc(num_dims * sizeof(int));
-
-                for (int j = 0; j < num_dims; j++)
-                {
-                    /* Dimensions are expressions, default to 10 for analysis */
-                    dims[j] = 10;
-                }
-
-                symtable_insert_array(table, expr->var_name, type, dims, num_dims);
-                free(dims);
-            }
+            /* NAME AS MAP: NAME(key) reads an element, as for an array */
+            resolve_reference(table, expr)->is_array = 1;
         }
-        break;
-
-    case STMT_FOR:
-        /* FOR: register loop variable */
-        if (stmt->num_exprs >= 1)
+        else if (expr && expr->type == EXPR_ARRAY && expr->var_name && expr->num_children > 0)
         {
-            ASTExpr *var = stmt->exprs[0];
-            if (var && var->var_name)
-            {
-                VarType type = get_var_type_from_name(var->var_name);
-                symtable_insert(table, var->var_name, type);
-            }
+            Symbol *sym = symtable_lookup(table, expr->var_name);
+            VarType type = sym ? sym->type : var_type_from_name(table->letter_types, expr->var_name);
 
-            /* Analyze start, end, step expressions */
-            for (int i = 1; i < stmt->num_exprs; i++)
+            /* Literal bounds are recorded; computed ones default to 10 */
+            int num_dims = expr->num_children;
+            int *dims = xmalloc(num_dims * sizeof(int));
+            for (int j = 0; j < num_dims; j++)
             {
-                analyze_expression(table, stmt->exprs[i]);
+                ASTExpr *bound = expr->children[j];
+                dims[j] = (bound && bound->type == EXPR_NUMBER) ? (int)bound->num_value : 10;
             }
-        }
-        break;
 
-    case STMT_PRINT:
-        /* PRINT: analyze all expressions */
-        for (int i = 0; i < stmt->num_exprs; i++)
-        {
-            analyze_expression(table, stmt->exprs[i]);
+            symtable_insert_array(table, expr->var_name, type, dims, num_dims);
+            free(dims);
         }
-        break;
+    }
+}
 
-    case STMT_IF:
-        /* IF: analyze condition and body */
-        if (stmt->num_exprs >= 1)
-        {
-            analyze_expression(table, stmt->exprs[0]);
-        }
-        if (stmt->body)
+/* A MAT target becomes an array when the statement runs, so later
+ * NAME(...) references to it are element reads, as after DIM */
+static void analyze_mat(SymbolTable *table, ASTStmt *stmt)
+{
+    ASTExpr *target = stmt->num_exprs > 0 ? stmt->exprs[0] : NULL;
+    if (target == NULL || target->var_name == NULL)
+    {
+        return;
+    }
+    Symbol *sym = resolve_reference(table, target);
+    sym->is_array = 1;
+}
+
+static int analyze_statement(SymbolTable *table, ASTStmt *stmt)
+{
+    for (; stmt != NULL; stmt = stmt->next)
+    {
+        switch (stmt->type)
         {
-            analyze_statement(table, stmt->body);
+        case STMT_DEFINT:
+        case STMT_DEFSNG:
+        case STMT_DEFDBL:
+        case STMT_DEFSTR:
+            analyze_def_ranges(table, stmt);
+            continue;
+
+        case STMT_DIM:
+            analyze_dim(table, stmt);
+            break;
+
+        case STMT_MAT:
+            analyze_mat(table, stmt);
+            break;
+
+        default:
+            break;
         }
-        break;
-
-    case STMT_NEXT:
-    case STMT_GOTO:
-    case STMT_GOSUB:
-    case STMT_RETURN:
-    case STMT_END:
-    case STMT_REM:
-        /* These don't introduce new variables */
-        break;
-
-    case STMT_DEFINT:
-    case STMT_DEFSNG:
-    case STMT_DEFDBL:
-    case STMT_DEFSTR:
-    {
-        VarType type = VAR_DOUBLE;
-        if (stmt->type == STMT_DEFINT)
-            type = VAR_INTEGER;
-        else if (stmt->type == STMT_DEFSNG)
-            type = VAR_SINGLE;
-        else if (stmt->type == STMT_DEFDBL)
-            type = VAR_DOUBLE;
-        else if (stmt->type == STMT_DEFSTR)
-            type = VAR_STRING;
 
         for (int i = 0; i < stmt->num_exprs; i++)
         {
-            ASTExpr *expr = stmt->exprs[i];
-            if (!expr || expr->type != EXPR_STRING || !expr->str_value)
-                continue;
-            char start = expr->str_value[0];
-            char end = start;
-            if (strlen(expr->str_value) == 3 && expr->str_value[1] == '-')
-            {
-                end = expr->str_value[2];
-            }
-            start = (char)toupper((unsigned char)start);
-            end = (char)toupper((unsigned char)end);
-            if (start >= 'A' && start <= 'Z' && end >= 'A' && end <= 'Z' && start <= end)
-            {
-                set_type_range(start, end, type);
-            }
+            analyze_expression(table, stmt->exprs[i]);
         }
-        break;
-    }
-
-    default:
-        break;
+        for (int i = 0; i < stmt->num_call_args; i++)
+        {
+            analyze_expression(table, stmt->call_args[i]);
+        }
+        analyze_statement(table, stmt->body);
+        analyze_statement(table, stmt->else_body);
     }
 
     return 0;
@@ -418,64 +444,45 @@ static int analyze_expression(SymbolTable *table, ASTExpr *expr)
     switch (expr->type)
     {
     case EXPR_VAR:
-        /* Variable reference */
-        if (expr->var_name)
-        {
-            Symbol *sym = symtable_lookup(table, expr->var_name);
-            if (sym == NULL)
-            {
-                /* Variable used but not defined - auto-create */
-                VarType type = get_var_type_from_name(expr->var_name);
-                symtable_insert(table, expr->var_name, type);
-            }
-        }
-        break;
-
-    case EXPR_ARRAY:
-        /* Array reference */
-        if (expr->var_name)
+        /* ERR and ERL are read from the error state, not from storage */
+        if (expr->var_name && strcasecmp(expr->var_name, "ERR") != 0 &&
+            strcasecmp(expr->var_name, "ERL") != 0)
         {
-            Symbol *sym = symtable_lookup(table, expr->var_name);
-            if (sym == NULL)
-            {
-                /* Array used but not defined */
-                VarType type = get_var_type_from_name(expr->var_name);
-                symtable_insert(table, expr->var_name, type);
-            }
-
-            /* Analyze subscript expressions */
-            for (int i = 0; i < expr->num_children; i++)
-            {
-                analyze_expression(table, expr->children[i]);
-            }
+            resolve_reference(table, expr);
         }
         break;
 
-    case EXPR_FUNC_CALL:
-        /* Function call - analyze arguments */
-        for (int i = 0; i < expr->num_children; i++)
+    case EXPR_PROC_CALL:
+        /* NAME(...) in an expression parses as a call; if NAME is
+         * dimensioned anywhere it is an element read */
+        if (expr->var_name && expr->num_children > 0 && is_array_name(table, expr->var_name))
         {
-            analyze_expression(table, expr->children[i]);
+            expr->type = EXPR_ARRAY;
+            resolve_reference(table, expr);
         }
         break;
 
-    case EXPR_BINARY_OP:
-    case EXPR_UNARY_OP:
-        /* Analyze operands */
-        for (int i = 0; i < expr->num_children; i++)
+    case EXPR_ARRAY:
+        if (expr->var_name)
         {
-            analyze_expression(table, expr->children[i]);
+            resolve_reference(table, expr);
         }
         break;
 
     case EXPR_NUMBER:
     case EXPR_STRING:
         /* Literals - no analysis needed */
-        break;
+        return 0;
 
     default:
         break;
     }
 
+    for (int i = 0; i < expr->num_children; i++)
+    {
+        analyze_expression(table, expr->children[i]);
+    }
+    analyze_expression(table, expr->member_obj);
+
     return 0;
 }
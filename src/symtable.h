@@ -11,6 +11,8 @@ typedef struct
 {
     char *name;
     VarType type;
+    int slot; /* Runtime storage index (position in the table) */
+    int rank; /* Subscript count when referenced as an array */
     int is_array;
     int *dimensions;
     int num_dimensions;
@@ -26,6 +28,12 @@ typedef struct
     Symbol *symbols;
     int num_symbols;
     int capacity;
+    int *index; /* Open-addressed hash of symbol positions, -1 = empty */
+    int index_capacity;
+    VarType letter_types[26]; /* DEFxxx ranges in effect during analysis */
+    const char **array_names; /* Open-addressed set of the names DIMmed or MAT-assigned in the lines being analyzed */
+    int array_names_capacity;
+    int num_array_names;
 } SymbolTable;
 
 /* Symbol table functions */
@@ -38,6 +46,10 @@ void symtable_insert(SymbolTable *table, const char *name, VarType type);
 void symtable_insert_array(SymbolTable *table, const char *name,
                            VarType type, int *dimensions, int num_dims);
 
+/* Resolve every variable and array reference: assign each name a slot, a
+ * type (suffix, else the DEFxxx range in effect where it first appears in
+ * program order) and a rank, and record the slot in the ASTExpr */
 int symtable_analyze_program(SymbolTable *table, Program *prog);
+int symtable_analyze_lines(SymbolTable *table, Program *prog, int first, int count);
 
 #endif /* SYMTABLE_H */
@@ -1,14 +1,23 @@
 #include "termio.h"
+#include "common.h"
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
 #include <ctype.h>
 #include <unistd.h>
 
+/* Embedder's console for this thread (termio_set_sink) */
+static _Thread_local TermioSink g_sink;
+static _Thread_local int g_sink_set = 0;
+
 /* Check if stdout is a TTY for conditional ANSI output */
 static int is_tty_mode(void)
 {
     static int cached = -1;
+    if (g_sink_set)
+    {
+        return 0; /* No escape sequences into a sink */
+    }
     if (cached == -1)
     {
         cached = isatty(STDOUT_FILENO) ? 1 : 0;
@@ -37,22 +46,73 @@ void termio_clear(void)
     }
 }
 
+void termio_set_sink(const TermioSink *sink)
+{
+    if (sink)
+    {
+        g_sink = *sink;
+        g_sink_set = 1;
+    }
+    else
+    {
+        memset(&g_sink, 0, sizeof(g_sink));
+        g_sink_set = 0;
+    }
+}
+
+static void sink_write(const char *text, size_t len)
+{
+    if (g_sink.write)
+    {
+        g_sink.write(g_sink.user, text, len);
+    }
+}
+
 void termio_write(const char *str)
 {
     if (!str)
         return;
+    size_t len = strlen(str);
+    limits_count_output(len);
+    if (g_sink_set)
+    {
+        sink_write(str, len);
+        return;
+    }
     fputs(str, stdout);
     fflush(stdout);
 }
 
 void termio_write_char(char c)
 {
+    limits_count_output(1);
+    if (g_sink_set)
+    {
+        sink_write(&c, 1);
+        return;
+    }
     fputc(c, stdout);
     fflush(stdout);
 }
 
+void termio_write_error(const char *str)
+{
+    if (g_sink_set && g_sink.error)
+    {
+        g_sink.error(g_sink.user, str);
+        return;
+    }
+    fputs(str, stderr);
+}
+
 void termio_put_char_at(int row, int col, char c)
 {
+    limits_count_output(1);
+    if (g_sink_set)
+    {
+        sink_write(&c, 1);
+        return;
+    }
     /* Use ANSI cursor save/restore only in TTY mode */
     if (is_tty_mode())
     {
@@ -81,10 +141,23 @@ void termio_present(void)
     fflush(stdout);
 }
 
-int termio_readline(char *buf, int maxlen)
+void termio_flush(void)
+{
+    fflush(stdout);
+}
+
+int termio_read_line_raw(char *buf, int maxlen)
 {
     if (!buf || maxlen <= 0)
         return -1;
+    if (g_sink_set)
+    {
+        int len = g_sink.read_line ? g_sink.read_line(g_sink.user, buf, maxlen) : -1;
+        if (len < 0)
+            return -1;
+        buf[len < maxlen ? len : maxlen - 1] = '\0';
+        return (int)strlen(buf);
+    }
     if (fgets(buf, maxlen, stdin) == NULL)
         return -1;
     size_t len = strlen(buf);
@@ -92,6 +165,15 @@ int termio_readline(char *buf, int maxlen)
     {
         buf[--len] = '\0';
     }
+    return (int)len;
+}
+
+int termio_readline(char *buf, int maxlen)
+{
+    int result = termio_read_line_raw(buf, maxlen);
+    if (result < 0)
+        return -1;
+    size_t len = (size_t)result;
     for (size_t i = 0; i < len; i++)
     {
         unsigned char ch = (unsigned char)buf[i];
@@ -117,8 +199,11 @@ void termio_render_graphics(void)
 void termio_beep(int duration_ms, int freq_hz)
 {
     (void)freq_hz;
-    printf("\a");
-    fflush(stdout);
+    if (!g_sink_set)
+    {
+        printf("\a");
+        fflush(stdout);
+    }
     if (duration_ms > 0)
     {
         unsigned int usec = (unsigned int)(duration_ms * 1000);
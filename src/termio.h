@@ -14,12 +14,38 @@ void termio_put_char_at(int row, int col, char c);
 void termio_printf(const char *fmt, ...);
 void termio_present(void);
 
+/* Display pending output now. termio_present() may defer and coalesce
+   frames; call this before blocking for input or sleeping. */
+void termio_flush(void);
+
 /* Blocking line editor. Returns length, 0 for empty line, -1 on EOF/quit. */
 int termio_readline(char *buf, int maxlen);
 
 /* LINE EDIT mode: edit a line from the scrollback. Returns length, -1 on cancel. */
 int termio_lineedit(int line_num, char *buf, int maxlen);
 
+/* Read a line of program input as typed (LINE INPUT), without the case
+   folding of termio_readline. Returns length, -1 on EOF. */
+int termio_read_line_raw(char *buf, int maxlen);
+
+/* Report an interpreter error such as "?SYNTAX ERROR IN 10" (stderr). */
+void termio_write_error(const char *str);
+
+/* Console redirection for embedders (libbasicpp, --batch). While a sink
+   is set on a thread, that thread's output, input lines and error reports
+   go to the callbacks instead of stdio or the SDL window, and screen
+   control is ignored; NULL restores the console. A NULL write discards
+   output, a NULL read_line reads as EOF and a NULL error uses stderr. */
+typedef struct
+{
+    void (*write)(void *user, const char *text, size_t len);
+    int (*read_line)(void *user, char *buf, int maxlen); /* Length without the newline, -1 on EOF */
+    void (*error)(void *user, const char *text);
+    void *user;
+} TermioSink;
+
+void termio_set_sink(const TermioSink *sink);
+
 /* Handle events like scrolling (call periodically when not in readline) */
 void termio_handle_events(void);
 
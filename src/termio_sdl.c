@@ -11,27 +11,73 @@
 #include <stdio.h>
 #include <ctype.h>
 #include "termio.h"
+#include "common.h"
 
 // Forward declarations
 
 #define TERM_COLS 132
 #define TERM_ROWS 32
 #define FONT_SIZE 16
+#define SCROLLBACK_MAX 2000
 
 static SDL_Window *g_window = NULL;
 static SDL_Renderer *g_renderer = NULL;
 static TTF_Font *g_font = NULL;
 static int g_sdl_enabled = 0;
+
+/* Embedder's console for this thread (termio_set_sink); it replaces the
+   window, which belongs to the main thread */
+static _Thread_local TermioSink g_sink;
+static _Thread_local int g_sink_set = 0;
 static int g_char_width = 10;
 static int g_char_height = 20;
 static float g_dpi_scale = 1.0f;
 
-/* Text buffer */
-static char g_screen[TERM_ROWS][TERM_COLS + 1];
-static Uint8 g_attr[TERM_ROWS][TERM_COLS]; /* per-cell color index */
-static Uint8 g_write_color = 0;            /* current write color  */
+/* Text buffer: a single ring of rows holding the scrollback followed by
+   the live screen. Screen row r is ring row g_screen_top + r and the
+   g_scrollback_count rows before it are history, so scrolling the screen
+   advances g_screen_top instead of copying rows. */
+#define RING_ROWS (SCROLLBACK_MAX + TERM_ROWS)
+static char g_lines[RING_ROWS][TERM_COLS + 1];
+static Uint8 g_line_attr[RING_ROWS][TERM_COLS]; /* per-cell color index */
+static int g_screen_top = 0;                    /* ring row of screen row 0 */
+static int g_scrollback_count = 0;              /* number of history rows  */
+static Uint8 g_write_color = 0;                 /* current write color  */
 static int g_cursor_row = 0;
 static int g_cursor_col = 0;
+
+#define SCREEN_CHARS(row) g_lines[(g_screen_top + (row)) % RING_ROWS]
+#define SCREEN_ATTRS(row) g_line_attr[(g_screen_top + (row)) % RING_ROWS]
+
+/* Ring row of a line numbered from the oldest scrollback row (0) */
+static int ring_row(int abs_line)
+{
+    return (g_screen_top - g_scrollback_count + abs_line + RING_ROWS) % RING_ROWS;
+}
+
+/* Dirty tracking: screen rows changed since the last frame.
+   g_full_redraw forces every row (scroll, clear, color or view change). */
+static Uint8 g_row_dirty[TERM_ROWS];
+static int g_full_redraw = 1;
+
+static void mark_row_dirty(int row)
+{
+    if (row >= 0 && row < TERM_ROWS)
+        g_row_dirty[row] = 1;
+}
+
+static void mark_all_dirty(void)
+{
+    g_full_redraw = 1;
+}
+
+/* Set a single character cell, keeping its color */
+static void put_cell(int row, int col, char c)
+{
+    SCREEN_CHARS(row)[col] = c;
+    mark_row_dirty(row);
+}
+
 /* Monokai Pro (Filter Ristretto) palette
    bg: #2c2525  fg: #fff1f3 */
 static SDL_Color g_fg_color = {255, 241, 243, 255}; /* #fff1f3 warm white  */
@@ -48,47 +94,162 @@ static const SDL_Color g_palette[] = {
     {148, 138, 139, 255}, /* 6 COL_OPERATOR #948a8b muted grey  */
 };
 
+#define PALETTE_SIZE ((int)(sizeof(g_palette) / sizeof(g_palette[0])))
+
 /* ------------------------------------------------------------------ */
-/* Scrollback buffer                                                     */
+/* Glyph atlas                                                          */
 /* ------------------------------------------------------------------ */
-#define SCROLLBACK_MAX 2000
-#define SCROLLBAR_W_PX 20 /* native pixels for the scrollbar track */
-
-static char g_scrollback[SCROLLBACK_MAX][TERM_COLS + 1];
-static Uint8 g_scrollback_attr[SCROLLBACK_MAX][TERM_COLS];
-static int g_scrollback_start = 0; /* circular buffer head index          */
-static int g_scrollback_count = 0; /* number of valid entries             */
-static int g_scroll_offset = 0;    /* 0 = live view (bottom)              */
-static int g_scroll_line = -1;     /* highlighted row (-1 = none)         */
+/* One texture holding every printable ASCII glyph pre-rendered in each
+   palette color: column = glyph, row = color index. Built once per font
+   and cell size, so presenting a frame is only SDL_RenderCopy calls from
+   a single texture (which SDL batches) instead of a TTF render plus a
+   texture upload per cell. */
+#define GLYPH_FIRST 32
+#define GLYPH_LAST 126
+#define GLYPH_COUNT (GLYPH_LAST - GLYPH_FIRST + 1)
+
+static SDL_Texture *g_atlas = NULL;
+static TTF_Font *g_atlas_font = NULL;
+static int g_atlas_cell_w = 0;
+static int g_atlas_cell_h = 0;
+static int g_atlas_failed = 0; /* Building failed for this font and cell size */
+
+static void atlas_free(void)
+{
+    if (g_atlas)
+        SDL_DestroyTexture(g_atlas);
+    g_atlas = NULL;
+    g_atlas_font = NULL;
+    g_atlas_failed = 0;
+}
 
-/* Push g_screen row 0 into the scrollback ring before evicting it. */
-static void scrollback_push(void)
+/* Returns 1 if the atlas is ready for the current font and cell size. */
+static int atlas_ensure(void)
 {
-    int idx;
-    if (g_scrollback_count < SCROLLBACK_MAX)
-    {
-        idx = (g_scrollback_start + g_scrollback_count) % SCROLLBACK_MAX;
-        g_scrollback_count++;
-    }
-    else
+    if ((g_atlas || g_atlas_failed) && g_atlas_font == g_font &&
+        g_atlas_cell_w == g_char_width && g_atlas_cell_h == g_char_height)
+        return g_atlas != NULL;
+
+    atlas_free();
+
+    /* Record the font and cell size before building, so that a failure
+       sends later frames straight to the per-cell path instead of
+       rendering the whole sheet again */
+    g_atlas_font = g_font;
+    g_atlas_cell_w = g_char_width;
+    g_atlas_cell_h = g_char_height;
+    g_atlas_failed = 1;
+
+    SDL_Surface *sheet = SDL_CreateRGBSurfaceWithFormat(
+        0, GLYPH_COUNT * g_char_width, PALETTE_SIZE * g_char_height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!sheet)
+        return 0;
+
+    for (int ci = 0; ci < PALETTE_SIZE; ci++)
     {
-        /* Oldest entry overwritten — advance start */
-        idx = g_scrollback_start;
-        g_scrollback_start = (g_scrollback_start + 1) % SCROLLBACK_MAX;
+        for (int g = 0; g < GLYPH_COUNT; g++)
+        {
+            char text[2] = {(char)(GLYPH_FIRST + g), 0};
+            SDL_Surface *surf = TTF_RenderText_Blended(g_font, text, g_palette[ci]);
+            if (!surf)
+                continue;
+
+            /* Copy pixels including alpha; scale to the cell like the per-cell path did */
+            SDL_Rect dst = {g * g_char_width, ci * g_char_height, g_char_width, g_char_height};
+            SDL_SetSurfaceBlendMode(surf, SDL_BLENDMODE_NONE);
+            SDL_BlitScaled(surf, NULL, sheet, &dst);
+            SDL_FreeSurface(surf);
+        }
     }
-    memcpy(g_scrollback[idx], g_screen[0], TERM_COLS);
-    g_scrollback[idx][TERM_COLS] = '\0';
-    memcpy(g_scrollback_attr[idx], g_attr[0], TERM_COLS);
 
-    /* If user is viewing history, keep the view stable */
-    if (g_scroll_offset > 0)
+    g_atlas = SDL_CreateTextureFromSurface(g_renderer, sheet);
+    SDL_FreeSurface(sheet);
+    if (!g_atlas)
+        return 0;
+
+    SDL_SetTextureBlendMode(g_atlas, SDL_BLENDMODE_BLEND);
+    g_atlas_failed = 0;
+    return 1;
+}
+
+/* Draw one character cell; falls back to direct TTF rendering for
+   characters outside the atlas or when the atlas could not be built. */
+static void draw_glyph(char c, Uint8 ci, int row, int col, int have_atlas)
+{
+    if (ci >= PALETTE_SIZE)
+        ci = 0;
+
+    SDL_Rect rect = {col * g_char_width, row * g_char_height, g_char_width, g_char_height};
+    unsigned char uc = (unsigned char)c;
+
+    if (have_atlas && uc >= GLYPH_FIRST && uc <= GLYPH_LAST)
     {
-        g_scroll_offset++;
-        if (g_scroll_offset > g_scrollback_count)
-            g_scroll_offset = g_scrollback_count;
+        SDL_Rect src = {(uc - GLYPH_FIRST) * g_char_width, ci * g_char_height,
+                        g_char_width, g_char_height};
+        SDL_RenderCopy(g_renderer, g_atlas, &src, &rect);
+        return;
     }
+
+    char text[2] = {c, 0};
+    SDL_Surface *surf = TTF_RenderText_Blended(g_font, text, g_palette[ci]);
+    if (!surf)
+        return;
+    SDL_Texture *tex = SDL_CreateTextureFromSurface(g_renderer, surf);
+    SDL_RenderCopy(g_renderer, tex, NULL, &rect);
+    SDL_DestroyTexture(tex);
+    SDL_FreeSurface(surf);
+}
+
+/* ------------------------------------------------------------------ */
+/* Presentation                                                         */
+/* ------------------------------------------------------------------ */
+/* termio_present() only schedules a frame: updates are coalesced so the
+   window is redrawn at most once per display refresh interval, and a
+   deferred frame is drawn from termio_handle_events(). termio_flush()
+   draws immediately and is used before blocking for input or sleeping.
+   Rows are rendered into a persistent target texture and only dirty rows
+   are redrawn; scroll position, focus line and color changes redraw all. */
+
+static SDL_Texture *g_frame = NULL; /* persistent render target */
+static int g_frame_w = 0;
+static int g_frame_h = 0;
+static Uint32 g_frame_interval_ms = 1000 / 60;
+static Uint32 g_last_present_ms = 0;
+static int g_present_pending = 0;
+
+/* View state the current frame was rendered with */
+static int g_drawn_scroll_offset = -1;
+static int g_drawn_scroll_line = -1;
+static SDL_Color g_drawn_bg_color = {0, 0, 0, 0};
+
+static void frame_free(void)
+{
+    if (g_frame)
+        SDL_DestroyTexture(g_frame);
+    g_frame = NULL;
+    g_frame_w = 0;
+    g_frame_h = 0;
+}
+
+/* Cap presentation at the refresh rate of the window's display */
+static void update_frame_interval(void)
+{
+    SDL_DisplayMode mode;
+    int display = SDL_GetWindowDisplayIndex(g_window);
+    if (display >= 0 && SDL_GetCurrentDisplayMode(display, &mode) == 0 && mode.refresh_rate > 0)
+        g_frame_interval_ms = 1000 / (Uint32)mode.refresh_rate;
+    else
+        g_frame_interval_ms = 1000 / 60;
 }
 
+/* ------------------------------------------------------------------ */
+/* Scrollback buffer                                                     */
+/* ------------------------------------------------------------------ */
+#define SCROLLBAR_W_PX 20 /* native pixels for the scrollbar track */
+
+static int g_scroll_offset = 0;    /* 0 = live view (bottom)              */
+static int g_scroll_line = -1;     /* highlighted row (-1 = none)         */
+
 /* Adjust scroll offset; clamp to valid range. */
 static void scroll_by(int delta)
 {
@@ -345,13 +506,15 @@ int termio_init(int cols, int rows, int scale)
     /* Initialize screen buffer */
     for (int i = 0; i < TERM_ROWS; i++)
     {
-        memset(g_screen[i], ' ', TERM_COLS);
-        memset(g_attr[i], 0, TERM_COLS);
+        memset(SCREEN_CHARS(i), ' ', TERM_COLS);
+        memset(SCREEN_ATTRS(i), 0, TERM_COLS);
     }
 
     g_sdl_enabled = 1;
     g_cursor_row = 0;
     g_cursor_col = 0;
+    mark_all_dirty();
+    update_frame_interval();
 
     return 0;
 }
@@ -361,6 +524,8 @@ void termio_shutdown(void)
     if (!g_sdl_enabled)
         return;
 
+    atlas_free();
+    frame_free();
     if (g_font)
         TTF_CloseFont(g_font);
     if (g_renderer)
@@ -375,24 +540,25 @@ void termio_shutdown(void)
 
 void termio_clear(void)
 {
-    if (!g_sdl_enabled)
+    if (!g_sdl_enabled || g_sink_set)
         return;
 
     for (int i = 0; i < TERM_ROWS; i++)
     {
-        memset(g_screen[i], ' ', TERM_COLS);
-        memset(g_attr[i], 0, TERM_COLS);
+        memset(SCREEN_CHARS(i), ' ', TERM_COLS);
+        memset(SCREEN_ATTRS(i), 0, TERM_COLS);
     }
 
     g_cursor_row = 0;
     g_cursor_col = 0;
     g_scroll_offset = 0; /* jump to live view on clear */
     g_scroll_line = -1;
+    mark_all_dirty();
 }
 
 void termio_set_cursor(int row, int col)
 {
-    if (!g_sdl_enabled)
+    if (!g_sdl_enabled || g_sink_set)
         return;
 
     if (row < 0)
@@ -410,17 +576,65 @@ void termio_set_cursor(int row, int col)
 
 void termio_put_char_at(int row, int col, char c)
 {
+    if (g_sink_set)
+    {
+        termio_write_char(c);
+        return;
+    }
     if (!g_sdl_enabled)
         return;
 
+    limits_count_output(1);
+
     if (row < 0 || row >= TERM_ROWS || col < 0 || col >= TERM_COLS)
         return;
 
-    g_screen[row][col] = c;
+    put_cell(row, col, c);
+}
+
+/* Scroll the live screen up one row. The top row becomes the newest
+   scrollback row just by advancing the ring; once the history is full
+   the new bottom row reuses the oldest one. */
+static void scroll_screen_up(void)
+{
+    g_screen_top = (g_screen_top + 1) % RING_ROWS;
+    if (g_scrollback_count < SCROLLBACK_MAX)
+        g_scrollback_count++;
+
+    memset(SCREEN_CHARS(TERM_ROWS - 1), ' ', TERM_COLS);
+    memset(SCREEN_ATTRS(TERM_ROWS - 1), 0, TERM_COLS);
+    g_cursor_row = TERM_ROWS - 1;
+
+    /* If user is viewing history, keep the view stable */
+    if (g_scroll_offset > 0)
+    {
+        g_scroll_offset++;
+        if (g_scroll_offset > g_scrollback_count)
+            g_scroll_offset = g_scrollback_count;
+    }
+
+    mark_all_dirty();
+}
+
+/* Move the cursor to the start of the next row, scrolling if needed */
+static void new_row(void)
+{
+    g_cursor_row++;
+    g_cursor_col = 0;
+
+    if (g_cursor_row >= TERM_ROWS)
+        scroll_screen_up();
 }
 
 void termio_write_char(char c)
 {
+    limits_count_output(1);
+    if (g_sink_set)
+    {
+        if (g_sink.write)
+            g_sink.write(g_sink.user, &c, 1);
+        return;
+    }
     if (!g_sdl_enabled)
     {
         putchar(c);
@@ -429,22 +643,7 @@ void termio_write_char(char c)
 
     if (c == '\n')
     {
-        g_cursor_row++;
-        g_cursor_col = 0;
-
-        if (g_cursor_row >= TERM_ROWS)
-        {
-            /* Save top row to scrollback, then scroll up */
-            scrollback_push();
-            for (int i = 0; i < TERM_ROWS - 1; i++)
-            {
-                memcpy(g_screen[i], g_screen[i + 1], TERM_COLS);
-                memcpy(g_attr[i], g_attr[i + 1], TERM_COLS);
-            }
-            memset(g_screen[TERM_ROWS - 1], ' ', TERM_COLS);
-            memset(g_attr[TERM_ROWS - 1], 0, TERM_COLS);
-            g_cursor_row = TERM_ROWS - 1;
-        }
+        new_row();
     }
     else if (c == '\r')
     {
@@ -458,58 +657,93 @@ void termio_write_char(char c)
             next_stop = TERM_COLS;
         while (g_cursor_col < next_stop)
         {
-            g_screen[g_cursor_row][g_cursor_col] = ' ';
-            g_attr[g_cursor_row][g_cursor_col] = 0;
+            SCREEN_CHARS(g_cursor_row)[g_cursor_col] = ' ';
+            SCREEN_ATTRS(g_cursor_row)[g_cursor_col] = 0;
             g_cursor_col++;
         }
+        mark_row_dirty(g_cursor_row);
     }
     else
     {
         if (g_cursor_col >= TERM_COLS)
-        {
-            g_cursor_row++;
-            g_cursor_col = 0;
+            new_row();
 
-            if (g_cursor_row >= TERM_ROWS)
-            { /* Save top row to scrollback, then scroll up */
-                scrollback_push();
-                for (int i = 0; i < TERM_ROWS - 1; i++)
-                {
-                    memcpy(g_screen[i], g_screen[i + 1], TERM_COLS);
-                    memcpy(g_attr[i], g_attr[i + 1], TERM_COLS);
-                }
-                memset(g_screen[TERM_ROWS - 1], ' ', TERM_COLS);
-                memset(g_attr[TERM_ROWS - 1], 0, TERM_COLS);
-                g_cursor_row = TERM_ROWS - 1;
-            }
-        }
-
-        g_screen[g_cursor_row][g_cursor_col] = c;
-        g_attr[g_cursor_row][g_cursor_col] = g_write_color;
+        SCREEN_CHARS(g_cursor_row)[g_cursor_col] = c;
+        SCREEN_ATTRS(g_cursor_row)[g_cursor_col] = g_write_color;
+        mark_row_dirty(g_cursor_row);
         g_cursor_col++;
     }
 }
 
+/* Copy a run of printable characters into the screen a row segment at a
+   time, wrapping at the right edge like termio_write_char does. */
+static void write_span(const char *s, size_t len)
+{
+    while (len > 0)
+    {
+        if (g_cursor_col >= TERM_COLS)
+            new_row();
+
+        size_t n = (size_t)(TERM_COLS - g_cursor_col);
+        if (n > len)
+            n = len;
+
+        memcpy(SCREEN_CHARS(g_cursor_row) + g_cursor_col, s, n);
+        memset(SCREEN_ATTRS(g_cursor_row) + g_cursor_col, g_write_color, n);
+        mark_row_dirty(g_cursor_row);
+
+        g_cursor_col += (int)n;
+        s += n;
+        len -= n;
+    }
+}
+
 void termio_write(const char *str)
 {
+    if (g_sink_set)
+    {
+        size_t len = strlen(str);
+        limits_count_output(len);
+        if (g_sink.write)
+            g_sink.write(g_sink.user, str, len);
+        return;
+    }
     if (!g_sdl_enabled)
     {
+        limits_count_output(strlen(str));
         printf("%s", str);
         return;
     }
 
     while (*str)
-        termio_write_char(*str++);
+    {
+        /* Printable run up to the next control character */
+        size_t run = 0;
+        while ((unsigned char)str[run] >= 32)
+            run++;
+
+        if (run == 0)
+        {
+            termio_write_char(*str++);
+            continue;
+        }
+
+        limits_count_output(run);
+        write_span(str, run);
+        str += run;
+    }
 }
 
 void termio_printf(const char *fmt, ...)
 {
-    if (!g_sdl_enabled)
+    if (!g_sdl_enabled && !g_sink_set)
     {
         va_list args;
         va_start(args, fmt);
-        vprintf(fmt, args);
+        int written = vprintf(fmt, args);
         va_end(args);
+        if (written > 0)
+            limits_count_output((size_t)written);
         return;
     }
 
@@ -522,153 +756,123 @@ void termio_printf(const char *fmt, ...)
     termio_write(buf);
 }
 
-void termio_present(void)
+/* Draw one display row (background, focus highlight, indent guides, text) */
+static void render_row(int row, int first_line, int out_w, int have_atlas)
 {
-    if (!g_sdl_enabled || !g_renderer || !g_font)
-        return;
-
+    SDL_Rect bg = {0, row * g_char_height, out_w, g_char_height};
     SDL_SetRenderDrawColor(g_renderer, g_bg_color.r, g_bg_color.g, g_bg_color.b, 255);
-    SDL_RenderClear(g_renderer);
+    SDL_RenderFillRect(g_renderer, &bg);
 
     /* Focused-line highlight (drawn first, behind text) */
-    if (g_scroll_line >= 0 && g_scroll_offset > 0)
+    if (row == g_scroll_line && g_scroll_offset > 0)
     {
-        int out_w, out_h_tmp;
-        SDL_GetRendererOutputSize(g_renderer, &out_w, &out_h_tmp);
-        SDL_Rect hl = {0, g_scroll_line * g_char_height, out_w, g_char_height};
+        SDL_Rect hl = {0, row * g_char_height, out_w, g_char_height};
         SDL_SetRenderDrawBlendMode(g_renderer, SDL_BLENDMODE_BLEND);
         SDL_SetRenderDrawColor(g_renderer, 255, 241, 243, 28); /* faint warm white */
         SDL_RenderFillRect(g_renderer, &hl);
         /* Left-edge accent bar */
-        SDL_Rect bar = {0, g_scroll_line * g_char_height, (int)(3 * g_dpi_scale), g_char_height};
+        SDL_Rect bar = {0, row * g_char_height, (int)(3 * g_dpi_scale), g_char_height};
         SDL_SetRenderDrawColor(g_renderer, 253, 104, 131, 180); /* COL_KEYWORD pink */
         SDL_RenderFillRect(g_renderer, &bar);
         SDL_SetRenderDrawBlendMode(g_renderer, SDL_BLENDMODE_NONE);
     }
 
-    /* Determine first absolute line to display (scrollback + screen unified) */
-    int first_line = g_scrollback_count - g_scroll_offset;
+    int abs_line = first_line + row;
+    const char *chars;
+    const Uint8 *attrs;
+    char blank_chars[TERM_COLS + 1];
+    Uint8 blank_attrs[TERM_COLS];
 
-    for (int row = 0; row < TERM_ROWS; row++)
+    if (abs_line < 0)
     {
-        int abs_line = first_line + row;
-        const char *chars;
-        const Uint8 *attrs;
-        char blank_chars[TERM_COLS + 1];
-        Uint8 blank_attrs[TERM_COLS];
-
-        if (abs_line < 0)
-        {
-            /* Above all history — blank row */
-            memset(blank_chars, ' ', TERM_COLS);
-            blank_chars[TERM_COLS] = 0;
-            memset(blank_attrs, 0, TERM_COLS);
-            chars = blank_chars;
-            attrs = blank_attrs;
-        }
-        else if (abs_line < g_scrollback_count)
-        {
-            /* From scrollback ring  */
-            int sb_idx = (g_scrollback_start + abs_line) % SCROLLBACK_MAX;
-            chars = g_scrollback[sb_idx];
-            attrs = g_scrollback_attr[sb_idx];
-        }
-        else
-        {
-            /* From live screen */
-            int screen_row = abs_line - g_scrollback_count;
-            if (screen_row >= TERM_ROWS)
-                continue;
-            chars = g_screen[screen_row];
-            attrs = g_attr[screen_row];
-        }
+        /* Above all history — blank row */
+        memset(blank_chars, ' ', TERM_COLS);
+        blank_chars[TERM_COLS] = 0;
+        memset(blank_attrs, 0, TERM_COLS);
+        chars = blank_chars;
+        attrs = blank_attrs;
+    }
+    else
+    {
+        /* Scrollback and live screen share the ring */
+        if (abs_line >= g_scrollback_count + TERM_ROWS)
+            return;
+        int idx = ring_row(abs_line);
+        chars = g_lines[idx];
+        attrs = g_line_attr[idx];
+    }
 
-        /* Detect line-number gutter inline: skip right-aligned number + exactly 2 separator spaces */
-        int gutter = 0;
+    /* Detect line-number gutter inline: skip right-aligned number + exactly 2 separator spaces */
+    int gutter = 0;
+    {
+        int p = 0;
+        while (p < TERM_COLS && chars[p] == ' ')
+            p++;
+        if (p < TERM_COLS && chars[p] >= '0' && chars[p] <= '9')
         {
-            int p = 0;
-            while (p < TERM_COLS && chars[p] == ' ')
+            while (p < TERM_COLS && chars[p] >= '0' && chars[p] <= '9')
                 p++;
-            if (p < TERM_COLS && chars[p] >= '0' && chars[p] <= '9')
-            {
-                while (p < TERM_COLS && chars[p] >= '0' && chars[p] <= '9')
-                    p++;
-                /* Skip exactly the 2 separator spaces written after the number */
-                if (p + 1 < TERM_COLS && chars[p] == ' ' && chars[p + 1] == ' ')
-                    p += 2;
-                gutter = p;
-            }
+            /* Skip exactly the 2 separator spaces written after the number */
+            if (p + 1 < TERM_COLS && chars[p] == ' ' && chars[p + 1] == ' ')
+                p += 2;
+            gutter = p;
         }
+    }
 
-        /* Count leading spaces in the code area */
-        int indent = gutter;
-        while (indent < TERM_COLS && chars[indent] == ' ')
-            indent++;
-        int code_indent = indent - gutter;
-
-        /* Draw indent guides for indented code lines */
-        if (code_indent > 0 && indent < TERM_COLS && chars[indent] != ' ')
-        {
-            /* Monokai Pro comment grey #72696a — solid */
-            SDL_SetRenderDrawColor(g_renderer, 114, 105, 106, 255);
+    /* Count leading spaces in the code area */
+    int indent = gutter;
+    while (indent < TERM_COLS && chars[indent] == ' ')
+        indent++;
+    int code_indent = indent - gutter;
 
-            /* Vertical guide at column 0 of code (under first char of parent line) */
-            int x0 = gutter * g_char_width + g_char_width / 2;
-            SDL_RenderDrawLine(g_renderer, x0, row * g_char_height,
-                               x0, (row + 1) * g_char_height - 1);
+    /* Draw indent guides for indented code lines */
+    if (code_indent > 0 && indent < TERM_COLS && chars[indent] != ' ')
+    {
+        /* Monokai Pro comment grey #72696a — solid */
+        SDL_SetRenderDrawColor(g_renderer, 114, 105, 106, 255);
 
-            /* 2×2 dot centred in each indented column (skip tab-stop columns) */
-            for (int j = 1; j <= code_indent; j++)
-            {
-                if (j % 4 == 0)
-                    continue;
-                int x = (gutter + j) * g_char_width - g_char_width / 2;
-                int y = row * g_char_height + g_char_height / 2 - 1;
-                SDL_Rect dot = {x, y, 2, 2};
-                SDL_RenderFillRect(g_renderer, &dot);
-            }
+        /* Vertical guide at column 0 of code (under first char of parent line) */
+        int x0 = gutter * g_char_width + g_char_width / 2;
+        SDL_RenderDrawLine(g_renderer, x0, row * g_char_height,
+                           x0, (row + 1) * g_char_height - 1);
 
-            /* Vertical guide line centred in each 4-space tab-stop column */
-            for (int level = 4; level <= code_indent; level += 4)
-            {
-                int x = (gutter + level) * g_char_width - g_char_width / 2;
-                SDL_RenderDrawLine(g_renderer, x, row * g_char_height,
-                                   x, (row + 1) * g_char_height - 1);
-            }
+        /* 2×2 dot centred in each indented column (skip tab-stop columns) */
+        for (int j = 1; j <= code_indent; j++)
+        {
+            if (j % 4 == 0)
+                continue;
+            int x = (gutter + j) * g_char_width - g_char_width / 2;
+            int y = row * g_char_height + g_char_height / 2 - 1;
+            SDL_Rect dot = {x, y, 2, 2};
+            SDL_RenderFillRect(g_renderer, &dot);
         }
 
-        for (int col = 0; col < TERM_COLS; col++)
+        /* Vertical guide line centred in each 4-space tab-stop column */
+        for (int level = 4; level <= code_indent; level += 4)
         {
-            char c = chars[col];
-            if (c == '\0')
-                break;
-            if (c == ' ')
-                continue;
+            int x = (gutter + level) * g_char_width - g_char_width / 2;
+            SDL_RenderDrawLine(g_renderer, x, row * g_char_height,
+                               x, (row + 1) * g_char_height - 1);
+        }
+    }
 
-            char text[2] = {c, 0};
-            Uint8 ci = attrs[col];
-            SDL_Color cell_color = g_palette[ci < 7 ? ci : 0];
-            SDL_Surface *surf = TTF_RenderText_Blended(g_font, text, cell_color);
-            if (!surf)
-                continue;
+    for (int col = 0; col < TERM_COLS; col++)
+    {
+        char c = chars[col];
+        if (c == '\0')
+            break;
+        if (c == ' ')
+            continue;
 
-            SDL_Texture *tex = SDL_CreateTextureFromSurface(g_renderer, surf);
-            SDL_Rect rect = {
-                (int)(col * g_char_width),
-                (int)(row * g_char_height),
-                g_char_width,
-                g_char_height};
-            SDL_RenderCopy(g_renderer, tex, NULL, &rect);
-            SDL_DestroyTexture(tex);
-            SDL_FreeSurface(surf);
-        }
+        draw_glyph(c, attrs[col], row, col, have_atlas);
     }
+}
 
+static void render_scrollbar(int out_w, int out_h)
+{
     /* Draw scrollbar when there is scrollback content */
     if (g_scrollback_count > 0)
     {
-        int out_w, out_h;
-        SDL_GetRendererOutputSize(g_renderer, &out_w, &out_h);
         int sb_w = (int)(SCROLLBAR_W_PX * g_dpi_scale);
 
         /* Track */
@@ -694,12 +898,98 @@ void termio_present(void)
         SDL_RenderFillRect(g_renderer, &thumb);
         SDL_SetRenderDrawBlendMode(g_renderer, SDL_BLENDMODE_NONE);
     }
+}
+
+/* Render dirty rows (or everything) and put the frame on screen */
+static void present_frame(void)
+{
+    int out_w, out_h;
+    SDL_GetRendererOutputSize(g_renderer, &out_w, &out_h);
+    int have_atlas = atlas_ensure();
+
+    if (g_scroll_offset != g_drawn_scroll_offset || g_scroll_line != g_drawn_scroll_line ||
+        memcmp(&g_bg_color, &g_drawn_bg_color, sizeof(SDL_Color)) != 0)
+        mark_all_dirty();
+
+    if (!g_frame || g_frame_w != out_w || g_frame_h != out_h)
+    {
+        frame_free();
+        g_frame = SDL_CreateTexture(g_renderer, SDL_PIXELFORMAT_ARGB8888,
+                                    SDL_TEXTUREACCESS_TARGET, out_w, out_h);
+        g_frame_w = out_w;
+        g_frame_h = out_h;
+        mark_all_dirty();
+    }
+
+    /* Without a render target the back buffer has to be redrawn every frame */
+    int use_target = g_frame && SDL_SetRenderTarget(g_renderer, g_frame) == 0;
+    if (!use_target)
+        mark_all_dirty();
+
+    /* Determine first absolute line to display (scrollback + screen unified) */
+    int first_line = g_scrollback_count - g_scroll_offset;
+
+    if (g_full_redraw)
+    {
+        SDL_SetRenderDrawColor(g_renderer, g_bg_color.r, g_bg_color.g, g_bg_color.b, 255);
+        SDL_RenderClear(g_renderer);
+        for (int row = 0; row < TERM_ROWS; row++)
+            render_row(row, first_line, out_w, have_atlas);
+    }
+    else
+    {
+        /* Live screen row r is shown at display row r + scroll offset */
+        for (int row = g_scroll_offset; row < TERM_ROWS; row++)
+        {
+            if (g_row_dirty[row - g_scroll_offset])
+                render_row(row, first_line, out_w, have_atlas);
+        }
+    }
+
+    memset(g_row_dirty, 0, sizeof(g_row_dirty));
+    g_full_redraw = 0;
+    g_drawn_scroll_offset = g_scroll_offset;
+    g_drawn_scroll_line = g_scroll_line;
+    g_drawn_bg_color = g_bg_color;
+
+    if (use_target)
+    {
+        SDL_SetRenderTarget(g_renderer, NULL);
+        SDL_RenderCopy(g_renderer, g_frame, NULL, NULL);
+    }
+
+    render_scrollbar(out_w, out_h);
 
     SDL_RenderPresent(g_renderer);
+    g_last_present_ms = SDL_GetTicks();
+    g_present_pending = 0;
+}
+
+void termio_present(void)
+{
+    if (!g_sdl_enabled || g_sink_set || !g_renderer || !g_font)
+        return;
+
+    if (SDL_GetTicks() - g_last_present_ms < g_frame_interval_ms)
+    {
+        g_present_pending = 1;
+        return;
+    }
+    present_frame();
+}
+
+void termio_flush(void)
+{
+    if (!g_sdl_enabled || g_sink_set || !g_renderer || !g_font)
+        return;
+
+    present_frame();
 }
 
 void termio_set_colors(int fg, int bg)
 {
+    if (g_sink_set)
+        return;
     if (fg == 1 && bg == 0)
     {
         /* WOB: restore Ristretto defaults */
@@ -717,7 +1007,7 @@ void termio_set_colors(int fg, int bg)
 
 void termio_handle_events(void)
 {
-    if (!g_sdl_enabled)
+    if (!g_sdl_enabled || g_sink_set)
         return;
 
     SDL_Event event;
@@ -725,12 +1015,70 @@ void termio_handle_events(void)
     {
         if (event.type == SDL_QUIT)
             exit(0);
+        if (event.type == SDL_RENDER_TARGETS_RESET)
+            mark_all_dirty();
         handle_scroll_event(&event);
     }
+
+    /* Draw a frame that termio_present() deferred */
+    if (g_present_pending && SDL_GetTicks() - g_last_present_ms >= g_frame_interval_ms)
+        present_frame();
+}
+
+int termio_read_line_raw(char *buf, int maxlen)
+{
+    if (!buf || maxlen <= 0)
+        return -1;
+    if (g_sink_set)
+    {
+        int len = g_sink.read_line ? g_sink.read_line(g_sink.user, buf, maxlen) : -1;
+        if (len < 0)
+            return -1;
+        buf[len < maxlen ? len : maxlen - 1] = '\0';
+        return (int)strlen(buf);
+    }
+    /* Program input without a handle still comes from stdin */
+    if (fgets(buf, maxlen, stdin) == NULL)
+        return -1;
+    int len = strlen(buf);
+    while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r'))
+        buf[--len] = '\0';
+    return len;
+}
+
+void termio_write_error(const char *str)
+{
+    if (g_sink_set && g_sink.error)
+    {
+        g_sink.error(g_sink.user, str);
+        return;
+    }
+    fputs(str, stderr);
+}
+
+void termio_set_sink(const TermioSink *sink)
+{
+    if (sink)
+    {
+        g_sink = *sink;
+        g_sink_set = 1;
+    }
+    else
+    {
+        memset(&g_sink, 0, sizeof(g_sink));
+        g_sink_set = 0;
+    }
 }
 
 int termio_readline(char *buf, int maxlen)
 {
+    if (g_sink_set)
+    {
+        int len = termio_read_line_raw(buf, maxlen);
+        for (int i = 0; i < len; i++)
+            buf[i] = (char)toupper((unsigned char)buf[i]);
+        return len;
+    }
     if (!g_sdl_enabled)
     {
         if (fgets(buf, maxlen, stdin) == NULL)
@@ -755,16 +1103,18 @@ int termio_readline(char *buf, int maxlen)
         {
             blink_state = !blink_state;
             last_blink = now;
-            g_screen[cursor_row][cursor_col] = blink_state ? '_' : ' ';
+            put_cell(cursor_row, cursor_col, blink_state ? '_' : ' ');
         }
 
-        termio_present();
+        termio_flush();
 
         SDL_Event event;
         if (SDL_WaitEventTimeout(&event, 50))
         {
             if (event.type == SDL_QUIT)
                 exit(0);
+            if (event.type == SDL_RENDER_TARGETS_RESET)
+                mark_all_dirty();
 
             /* Scroll wheel / PgUp / PgDn scroll history without disrupting input */
             if (handle_scroll_event(&event))
@@ -775,7 +1125,7 @@ int termio_readline(char *buf, int maxlen)
                 if (event.key.keysym.sym == SDLK_RETURN)
                 {
                     /* Clear cursor before accepting */
-                    g_screen[cursor_row][cursor_col] = ' ';
+                    put_cell(cursor_row, cursor_col, ' ');
                     buf[pos] = 0;
                     termio_write_char('\n');
                     return pos;
@@ -783,7 +1133,7 @@ int termio_readline(char *buf, int maxlen)
                 else if (event.key.keysym.sym == SDLK_BACKSPACE && pos > 0)
                 {
                     /* Clear cursor, step back */
-                    g_screen[cursor_row][cursor_col] = ' ';
+                    put_cell(cursor_row, cursor_col, ' ');
                     pos--;
                     g_cursor_col--;
                     if (g_cursor_col < 0)
@@ -791,7 +1141,7 @@ int termio_readline(char *buf, int maxlen)
                         g_cursor_row--;
                         g_cursor_col = TERM_COLS - 1;
                     }
-                    g_screen[g_cursor_row][g_cursor_col] = ' ';
+                    put_cell(g_cursor_row, g_cursor_col, ' ');
                     cursor_row = g_cursor_row;
                     cursor_col = g_cursor_col;
                     blink_state = 1;
@@ -800,7 +1150,7 @@ int termio_readline(char *buf, int maxlen)
                 else if (event.key.keysym.sym == SDLK_c &&
                          (event.key.keysym.mod & KMOD_CTRL))
                 {
-                    g_screen[cursor_row][cursor_col] = ' ';
+                    put_cell(cursor_row, cursor_col, ' ');
                     buf[0] = 0;
                     termio_write_char('\n');
                     return -2; /* Signal Ctrl-C / interrupt */
@@ -819,7 +1169,7 @@ int termio_readline(char *buf, int maxlen)
                                 break; /* paste only first line */
                             if (pos < maxlen - 1 && c >= 32 && c < 127)
                             {
-                                g_screen[cursor_row][cursor_col] = ' ';
+                                put_cell(cursor_row, cursor_col, ' ');
                                 buf[pos++] = c;
                                 termio_write_char(c);
                                 cursor_row = g_cursor_row;
@@ -839,7 +1189,7 @@ int termio_readline(char *buf, int maxlen)
                 if (pos < maxlen - 1 && c >= 32 && c < 127)
                 {
                     /* Clear cursor cell before writing char */
-                    g_screen[cursor_row][cursor_col] = ' ';
+                    put_cell(cursor_row, cursor_col, ' ');
                     buf[pos++] = c;
                     termio_write_char(c);
                     cursor_row = g_cursor_row;
@@ -950,7 +1300,7 @@ void termio_show_welcome(const char *name, const char *version)
             last_blink_time = now;
         }
 
-        /* Render using SDL directly (bypass g_screen for UTF-8 support) */
+        /* Render using SDL directly (bypass the text buffer for UTF-8 support) */
         SDL_SetRenderDrawColor(g_renderer, g_bg_color.r, g_bg_color.g, g_bg_color.b, 255);
         SDL_RenderClear(g_renderer);
 
@@ -1077,7 +1427,7 @@ void termio_show_welcome(const char *name, const char *version)
 
 void termio_set_write_color(int color_idx)
 {
-    if (!g_sdl_enabled)
+    if (!g_sdl_enabled || g_sink_set)
         return;
     if (color_idx < 0 || color_idx > 6)
         color_idx = 0;
@@ -1190,8 +1540,7 @@ void termio_write_highlighted(const char *line)
             }
 
             termio_set_write_color(color);
-            for (const char *q = start; q < p; q++)
-                termio_write_char(*q);
+            write_span(start, (size_t)len);
             termio_set_write_color(COL_NORMAL);
             continue;
         }
@@ -0,0 +1,18 @@
+10 REM FILE CHANNELS ABOVE THE OLD 10-HANDLE LIMIT
+20 PRINT "HIGH CHANNELS"
+30 OPEN "channels.txt" FOR OUTPUT AS #12
+40 OPEN "channels2.txt" FOR OUTPUT AS #200
+50 PRINT #12, "Channel 12"
+60 PRINT #200, "Channel 200"
+70 CLOSE #12
+80 CLOSE #200
+90 OPEN "channels.txt" FOR INPUT AS #45
+100 OPEN "channels2.txt" FOR INPUT AS #3
+110 INPUT #45, A$
+120 INPUT #3, B$
+130 PRINT A$
+140 PRINT B$
+150 CLOSE #45
+160 CLOSE #3
+170 PRINT "OK"
+180 END
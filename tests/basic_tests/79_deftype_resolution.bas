@@ -0,0 +1,21 @@
+10 REM Variable types follow DEFxxx ranges and suffixes
+20 X = 2.5
+30 DEFINT I-K
+40 I = 7.9 : J = -3.2 : K% = 4
+50 PRINT I; " "; J; " "; K%; " "; X
+60 DEFSTR S
+70 S = "TEXT" : S1 = "MORE"
+80 PRINT S; " "; S1; " "; LEN(S1)
+90 N! = 1.5 : D# = 2.25 : N$ = "N"
+100 PRINT N!; " "; D#; " "; N$
+110 FOR I = 1 TO 3 : T = T + I * X : NEXT I
+120 PRINT T
+130 CLEAR
+140 PRINT I; " "; T; " ["; S; "]"
+150 I = 9.6 : S = "AGAIN"
+160 PRINT I; " "; S
+162 REM An array may be read above its DIM
+164 DEF FNE(Q) = E(Q) * 2
+166 DIM E(3), W$(2) : E(2) = 7 : W$(1) = "W"
+168 PRINT FNE(2); " "; W$(1) + "X"
+170 END
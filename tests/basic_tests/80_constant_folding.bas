@@ -0,0 +1,13 @@
+10 REM Folded and rewritten expressions give the unoptimized results
+20 R = 1.5
+30 PRINT (4.0 / 3.0) * 3.14159265358979 * R ^ 2
+40 PRINT R ^ 2; " "; R / 4; " "; R / 0.5; " "; R / 3
+50 PRINT -(-3); " "; NOT 0; " "; 7 MOD 2; " "; 2 ^ 0.5
+60 PRINT 1 = 1; " "; 2 < 1; " "; 3 AND 0; " "; 3 OR 0
+70 X = 2 : REM trailing comment
+80 FOR I = 1 TO 3 : REM loop body follows
+90 IF I = 2 THEN REM nothing to do
+100 X = X * 2 : REM doubled
+110 NEXT I
+120 PRINT X
+130 END
@@ -0,0 +1,59 @@
+10 REM Test 81: CASE dispatch over constant and computed WHEN values
+20 FOR I = 0 TO 6
+30   CASE I OF
+40   WHEN 1
+50     R$ = "ONE"
+60   WHEN 3
+70     R$ = "THREE"
+80   WHEN 3
+90     R$ = "DUPLICATE"
+100  WHEN 2 + 2
+110    R$ = "FOUR"
+120  WHEN 2.5
+130    R$ = "HALF"
+140  OTHERWISE
+150    R$ = "OTHER"
+160  ENDCASE
+170  PRINT R$; " ";
+180 NEXT I
+190 PRINT
+200 FOR I = 1 TO 3
+210   READ K
+220   CASE K OF
+230   WHEN 1000000
+240     PRINT "MILLION";
+250   WHEN -7
+260     PRINT "MINUS SEVEN";
+270   WHEN 42
+280     PRINT "ANSWER";
+290   ENDCASE
+300   PRINT " ";
+310 NEXT I
+320 PRINT
+330 DATA 42, -7, 1000000
+340 X = 5
+350 CASE 5 OF
+360 WHEN X
+370   PRINT "COMPUTED FIRST"
+380 WHEN 5
+390   PRINT "CONSTANT"
+400 ENDCASE
+410 CASE 2.5 + 0.0000000001 OF
+420 WHEN 2.5
+430   PRINT "NEAR ENOUGH"
+440 ENDCASE
+450 FOR I = 1 TO 3
+460   READ C$
+470   CASE C$ OF
+480   WHEN "RED"
+490     PRINT "STOP";
+500   WHEN "GREEN"
+510     PRINT "GO";
+520   OTHERWISE
+530     PRINT "WAIT";
+540   ENDCASE
+550   PRINT " ";
+560 NEXT I
+570 PRINT
+580 DATA "GREEN", "AMBER", "RED"
+590 END
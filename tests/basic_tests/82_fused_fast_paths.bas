@@ -0,0 +1,30 @@
+10 REM Test 82: fused counter loops, increments and comparisons
+20 FOR I = 5 TO 1: NEXT: PRINT "A"; I
+30 FOR I = 10 TO 1 STEP -3: NEXT I: PRINT "B"; I
+40 FOR I = 1 TO 3: FOR J = 1 TO 4: NEXT J: PRINT I; J;: NEXT I: PRINT
+50 FOR K = 1 TO 2.5 STEP 0.5
+60 NEXT K: PRINT "C"; K
+70 FOR K = 1 TO 3
+80 NEXT K
+90 PRINT "D"; K
+100 DEFINT N
+110 FOR N = 1 TO 7 STEP 2: NEXT N: PRINT "E"; N
+120 FOR A = 1 TO 3: FOR B = 1 TO 2: NEXT B, A: PRINT "F"; A; B
+130 FOR X = 1 TO 3: NEXT Y: PRINT "G"; X
+140 Q = 1: Q = Q + 2.5: Q = 10 - Q: Q = Q - 1: R = 3 + Q: PRINT "H"; Q; R
+150 DEFINT Z: Z = 1: Z = Z + 2.7: PRINT "I"; Z
+160 S$ = "5": S$ = S$ + "1": PRINT "J"; S$
+170 W = 2: IF W = 2 THEN PRINT "K1"
+180 IF W <> 2 THEN PRINT "K2"
+190 IF W < 3 THEN PRINT "K3"
+200 IF W >= 2.0000000001 THEN PRINT "K4"
+210 IF W = 2.0000000001 THEN PRINT "K5"
+220 WHILE W < 5: W = W + 1: WEND: PRINT "L"; W
+230 M = 0
+240 DO
+250 M = M + 1
+260 LOOP UNTIL M >= 4
+270 PRINT "M"; M
+280 REM PUTA and PUTB keep their register stores on the fused paths
+290 X = 4: PUTA = X + 1: PUTB = 2 + X: PRINT "N"; GETA(0); GETB(0)
+300 FOR PUTA = 1 TO 3: NEXT: PRINT "O"; GETA(0)
@@ -0,0 +1,15 @@
+10 REM Test 83: NEXT on an outer loop leaves the inner loops
+20 FOR I = 1 TO 3
+30 FOR J = 1 TO 5
+40 IF J = 2 THEN NEXT I
+50 PRINT "IN"; I; J
+60 NEXT J
+70 PRINT "AFTER J"
+80 NEXT I
+90 PRINT "OUT"; I; J
+100 DEFINT K
+110 FOR K = 1 TO 4
+120 FOR L = 10 TO 8 STEP -1
+130 NEXT L, K
+140 PRINT K; L
+150 END
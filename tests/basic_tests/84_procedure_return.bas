@@ -0,0 +1,36 @@
+REM RETURN ends a procedure from anywhere in its body
+PROCEDURE Classify(N)
+    IF N < 0 THEN RETURN -1
+    IF N = 0 THEN
+        RETURN 0
+    ENDIF
+    RETURN 1
+END PROCEDURE
+
+PROCEDURE Fact(N)
+    IF N <= 1 THEN RETURN 1
+    RETURN N * Fact(N - 1)
+END PROCEDURE
+
+PROCEDURE Fib(N)
+    IF N < 2 THEN RETURN N
+    RETURN Fib(N - 1) + Fib(N - 2)
+END PROCEDURE
+
+REM A procedure may read an array DIMmed below it
+PROCEDURE Show(I)
+    RETURN A(I)
+END PROCEDURE
+
+PRINT Classify(-5), Classify(0), Classify(7)
+PRINT Fact(10)
+PRINT Fib(15)
+DIM F(10)
+FOR I = 1 TO 10
+    F(I) = Fib(I)
+NEXT I
+PRINT F(1), F(5), F(10)
+DIM A(5)
+A(2) = 42
+PRINT Show(2)
+END
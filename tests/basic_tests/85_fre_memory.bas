@@ -0,0 +1,12 @@
+REM FRE reports MEMORY SIZE less what variables, arrays and strings hold
+A = FRE(0)
+DIM X(99)
+PRINT A - FRE(0)
+S$ = "HELLO"
+PRINT A - FRE(0)
+S$ = ""
+PRINT A - FRE("")
+DIM N$(9)
+N$(3) = "ABC"
+PRINT A - FRE(0)
+PRINT FRE(0) > 0, FRE(0) < 32768
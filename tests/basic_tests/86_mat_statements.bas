@@ -0,0 +1,45 @@
+REM MAT works on elements 1..bound of whole arrays
+DIM A(2,3), B(2,3), V(3)
+FOR I = 1 TO 2
+  FOR J = 1 TO 3
+    A(I,J) = I * 10 + J
+    B(I,J) = J - I
+  NEXT J
+NEXT I
+MAT C = A + B
+PRINT "A+B:"; C(1,1); ","; C(1,3); ","; C(2,2)
+MAT C = A - B
+PRINT "A-B:"; C(2,1); ","; C(2,3)
+MAT D = (2) * A
+PRINT "2*A:"; D(1,2); ","; D(2,3)
+MAT T = TRN(A)
+PRINT "TRN:"; T(3,1); ","; T(1,2); ","; T(3,2)
+MAT P = A * T
+PRINT "A*TRN(A):"; P(1,1); ","; P(1,2); ","; P(2,1); ","; P(2,2)
+FOR J = 1 TO 3
+  V(J) = J
+NEXT J
+MAT W = A * V
+PRINT "A*V:"; W(1); ","; W(2)
+DIM M(2,2)
+M(1,1) = 4: M(1,2) = 7: M(2,1) = 2: M(2,2) = 6
+MAT N = INV(M)
+PRINT "INV:"; N(1,1); ","; N(1,2); ","; N(2,1); ","; N(2,2)
+MAT Q = M * N
+PRINT "M*INV(M):"; Q(1,1); ","; Q(1,2); ","; Q(2,1); ","; Q(2,2)
+MAT E = IDN(3,3)
+PRINT "IDN:"; E(1,1); ","; E(2,2); ","; E(1,2); ","; E(3,3)
+MAT K = CON(2)
+PRINT "CON:"; K(1); ","; K(2)
+MAT K = ZER
+PRINT "ZER:"; K(1); ","; K(2)
+MAT A = A + A
+PRINT "A+A in place:"; A(2,3)
+DEF FNG(I) = G(I, I) * 3
+MAT G = IDN(2,2)
+PRINT "Read above MAT:"; FNG(2)
+MAT = 5
+PRINT "MAT as a variable:"; MAT
+DIM S(2,2)
+MAT X = INV(S)
+PRINT "not reached"
@@ -0,0 +1,29 @@
+REM PARALLEL FOR: private scalars, shared arrays, REDUCE
+DEF FNSQ(X) = X * X
+DIM A(1000), N$(12)
+PARALLEL FOR I = 1 TO 1000 REDUCE S = +, M = MAX
+  T = FNSQ(I)
+  A(I) = T
+  S = S + T
+  IF T > M THEN M = T
+NEXT I
+PRINT S; M; A(1000); I; T
+P = 1
+PARALLEL FOR I = 1 TO 10 REDUCE P = *, L = MIN
+  P = P * 2
+  L = 5 - I
+NEXT
+PRINT P; L; I
+PARALLEL FOR I = 12 TO 1 STEP -1
+  C = 0
+  K = I
+  WHILE K > 1
+    IF K / 2 = INT(K / 2) THEN K = K / 2 ELSE K = 3 * K + 1
+    C = C + 1
+  WEND
+  N$(I) = "N" + STR$(C)
+NEXT I
+FOR I = 1 TO 12: PRINT N$(I); " "; : NEXT I
+PRINT
+PARALLEL = 5
+PRINT PARALLEL
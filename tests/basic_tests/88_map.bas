@@ -0,0 +1,44 @@
+REM Associative arrays: DIM AS MAP, HASKEY, DELETE, FOR EACH
+DIM AGE AS MAP, CITY$ AS MAP
+AGE("BOB") = 42: AGE("ALICE") = 37: AGE("CAROL") = 51
+CITY$("BOB") = "LEEDS": CITY$("ALICE") = "YORK"
+AGE("BOB") = AGE("BOB") + 1
+PRINT AGE("BOB"); AGE("ALICE"); AGE("NOBODY"); "["; CITY$("CAROL"); "]"
+PRINT HASKEY(AGE, "CAROL"); HASKEY(AGE, "NOBODY"); HASKEY(CITY$, "BOB")
+K$ = "AL" + "ICE"
+PRINT AGE(K$); CITY$(K$)
+FOR EACH N$ IN AGE
+  PRINT N$; AGE(N$); " ";
+NEXT N$
+PRINT
+DELETE AGE("BOB")
+PRINT HASKEY(AGE, "BOB"); AGE("BOB")
+FOR I = 1 TO 50: AGE("K" + STR$(I)) = I: NEXT I
+S = 0: C = 0
+FOR EACH N$ IN AGE
+  IF LEFT$(N$, 1) = "K" THEN S = S + AGE(N$): C = C + 1
+NEXT
+PRINT C; S
+REM Deleting keys not yet reached skips them
+FOR EACH N$ IN CITY$
+  PRINT N$; " ";
+  DELETE CITY$("BOB")
+NEXT
+PRINT
+DIM E AS MAP
+FOR EACH N$ IN E
+  PRINT "NEVER"
+NEXT
+PRINT "EMPTY"
+READ W$, V, W$, V
+DATA "X", 1, "Y", 2
+AGE(W$) = V
+PRINT AGE("Y")
+EACH = 3
+FOR EACH = 1 TO EACH: PRINT EACH; : NEXT
+PRINT
+DIM AGE AS MAP
+PRINT HASKEY(AGE, "CAROL"); AGE("CAROL")
+CLEAR
+DIM CITY$ AS MAP
+PRINT HASKEY(CITY$, "ALICE"); "["; CITY$("ALICE"); "]"
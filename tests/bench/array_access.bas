@@ -0,0 +1,20 @@
+REM Array access: fill, sum and sweep a 1-D and a 2-D array
+DIM A(1000)
+DIM M(50, 50)
+FOR P = 1 TO 50
+    FOR I = 1 TO 1000
+        A(I) = I * P
+    NEXT I
+NEXT P
+S = 0
+FOR I = 1 TO 1000
+    S = S + A(I)
+NEXT I
+FOR P = 1 TO 10
+    FOR I = 1 TO 50
+        FOR J = 1 TO 50
+            M(I, J) = M(I, J) + I - J
+        NEXT J
+    NEXT I
+NEXT P
+PRINT S, M(50, 1)
@@ -0,0 +1,19 @@
+REM CLASS method calls: statement and expression forms
+CLASS Counter(Count, Stepsize)
+    PROCEDURE Bump()
+        Count = Count + Stepsize
+    END PROCEDURE
+    PROCEDURE Value()
+        RETURN Count
+    END PROCEDURE
+END CLASS
+
+C = NEW Counter(0, 2)
+FOR I = 1 TO 20000
+    C.Bump()
+NEXT I
+S = 0
+FOR I = 1 TO 20000
+    S = S + C.Value()
+NEXT I
+PRINT C.Value(), S
@@ -0,0 +1,22 @@
+REM Control flow: WHILE, DO/LOOP, IF chains and CASE dispatch
+N = 0 : K = 0
+WHILE N < 200000
+    N = N + 1
+    IF N MOD 3 = 0 THEN
+        K = K + 1
+    ELSE
+        K = K - 1
+    ENDIF
+    CASE N MOD 4 OF
+    WHEN 0
+        K = K + 2
+    WHEN 1
+        K = K - 2
+    OTHERWISE
+        K = K + 0
+    ENDCASE
+WEND
+DO
+    N = N - 1
+LOOP UNTIL N = 0
+PRINT K
@@ -0,0 +1,8 @@
+REM FOR/NEXT: nested counter loops with a body
+S = 0
+FOR I = 1 TO 2000
+    FOR J = 1 TO 500
+        S = S + J
+    NEXT J
+NEXT I
+PRINT S
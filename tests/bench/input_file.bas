@@ -0,0 +1,15 @@
+REM INPUT # parsing of numeric and string fields
+OPEN "bench_input.tmp" FOR OUTPUT AS #1
+FOR I = 1 TO 20000
+    PRINT #1, STR$(I) + ",name" + STR$(I) + "," + STR$(I / 4)
+NEXT I
+CLOSE #1
+S = 0 : L = 0
+OPEN "bench_input.tmp" FOR INPUT AS #1
+FOR I = 1 TO 20000
+    INPUT #1, A, B$, C
+    S = S + A + C
+    L = L + LEN(B$)
+NEXT I
+CLOSE #1
+PRINT S, L
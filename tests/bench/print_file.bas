@@ -0,0 +1,7 @@
+REM PRINT # to a sequential file
+OPEN "bench_print.tmp" FOR OUTPUT AS #1
+FOR I = 1 TO 50000
+    PRINT #1, I, I * 2, "row"
+NEXT I
+CLOSE #1
+PRINT "OK"
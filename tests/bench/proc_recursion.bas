@@ -0,0 +1,7 @@
+REM Procedure recursion: naive Fibonacci
+PROCEDURE FIB(N)
+    IF N < 2 THEN RETURN N
+    RETURN FIB(N - 1) + FIB(N - 2)
+END PROCEDURE
+
+PRINT FIB(22)
@@ -0,0 +1,172 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Usage: ./run_bench.sh [path-to-basic-binary] [bench-filter]
+#   bench-filter: optional; if set (e.g. for), run only <filter>*.bas
+#
+# Environment:
+#   RUNS       runs per benchmark (default 5)
+#   THRESHOLD  allowed slowdown against the baseline, in percent (default 15)
+#   BASELINE   baseline file (default: baseline.tsv next to this script)
+#   SAVE       if 1, write the results as the new baseline instead of comparing
+#
+# Each NAME.bas is checked against NAME.out on an untimed first run. Results
+# go to stdout as tab-separated lines, one per benchmark:
+#   bench  runs  median_ms  p95_ms  instructions  allocations
+# instructions is the median user-space instruction count from `perf stat`
+# and is "-" where perf is unavailable; allocations is the total of the
+# allocation counts in the interpreter's --stats report, or "-" if it has
+# none. Progress and the baseline comparison go to stderr.
+BASIC_BIN="${1:-../../build/bin/basicpp}"
+BENCH_FILTER="${2:-}"
+RUNS="${RUNS:-5}"
+THRESHOLD="${THRESHOLD:-15}"
+SAVE="${SAVE:-0}"
+
+if [[ ! -x "$BASIC_BIN" ]]; then
+  echo "basic binary not found/executable: $BASIC_BIN" >&2
+  exit 1
+fi
+if ! [[ "$RUNS" =~ ^[1-9][0-9]*$ ]]; then
+  echo "RUNS must be a positive integer: $RUNS" >&2
+  exit 1
+fi
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+BASIC_BIN="$(cd "$(dirname "$BASIC_BIN")" && pwd)/$(basename "$BASIC_BIN")"
+BASELINE="${BASELINE:-$SCRIPT_DIR/baseline.tsv}"
+
+shopt -s nullglob
+BAS_FILES=("$SCRIPT_DIR/${BENCH_FILTER}"*.bas)
+shopt -u nullglob
+if [[ ${#BAS_FILES[@]} -eq 0 ]]; then
+  echo "No benchmarks match: ${BENCH_FILTER}*.bas" >&2
+  exit 1
+fi
+
+HAVE_PERF=0
+if command -v perf >/dev/null 2>&1 &&
+   perf stat -x, -e instructions:u true >/dev/null 2>&1; then
+  HAVE_PERF=1
+fi
+
+# The interpreter runs a program from its own directory, so each benchmark
+# is copied to a scratch directory and the files it writes land there
+WORK_DIR="$(mktemp -d)"
+RESULTS="$WORK_DIR/results.tsv"
+trap 'rm -rf "$WORK_DIR"' EXIT
+cd "$WORK_DIR"
+
+# Run one program once; prints "<wall ms> <instructions or ->"
+run_once() {
+  perl -MTime::HiRes=time -e '
+    my ($perf, @cmd) = @ARGV;
+    my $stat = "perf.csv";
+    unshift @cmd, "perf", "stat", "-x,", "-e", "instructions:u", "-o", $stat if $perf;
+    open(my $report, ">&", \*STDOUT) or die;
+    open(STDOUT, ">", "/dev/null");
+    open(STDERR, ">", "/dev/null");
+    my $t0 = time;
+    my $rc = system(@cmd);
+    my $ms = (time - $t0) * 1000;
+    exit 1 if $rc != 0;
+    my $insns = "-";
+    if ($perf && open(my $fh, "<", $stat)) {
+      while (<$fh>) { $insns = $1 if /^(\d+),/; }
+    }
+    printf $report "%.3f %s\n", $ms, $insns;
+  ' "$HAVE_PERF" "$BASIC_BIN" "$1"
+}
+
+# Median and nearest-rank p95 of whitespace-separated numbers, or "-"
+summarize() {
+  perl -e '
+    my @v = sort { $a <=> $b } grep { /^[\d.]+$/ } @ARGV;
+    if (!@v) { print "- -\n"; exit; }
+    my $n = @v;
+    my $med = $n % 2 ? $v[$n / 2] : ($v[$n / 2 - 1] + $v[$n / 2]) / 2;
+    my $p95 = $v[int(0.95 * $n + 0.999999) - 1];
+    print "$med $p95\n";
+  ' "$@"
+}
+
+failed=0
+printf 'bench\truns\tmedian_ms\tp95_ms\tinstructions\tallocations\n' | tee "$RESULTS"
+for bas in "${BAS_FILES[@]}"; do
+  name="$(basename "${bas%.bas}")"
+  # Untimed warm-up run, checked against the expected output: the
+  # interpreter exits 0 after a BASIC error, so a broken benchmark would
+  # otherwise be timed as if it worked
+  prog="$WORK_DIR/$name.bas"
+  cp "$bas" "$prog"
+  got="$WORK_DIR/$name.got"
+  "$BASIC_BIN" "$prog" >"$got" 2>&1 </dev/null || true
+  perl -i -pe 's/ +$//' "$got"
+  if ! diff -u "${bas%.bas}.out" "$got" >&2; then
+    echo "FAIL $name (output differs from $name.out)" >&2
+    failed=1
+    continue
+  fi
+
+  # Allocation counts are deterministic, so one untimed run is enough
+  allocs="$("$BASIC_BIN" --stats "$prog" 2>&1 >/dev/null </dev/null | perl -ne '
+    $in = 1, next if /^Allocations/;
+    $in = 0 if /^\s*$/;
+    $sum += $1, $seen = 1 if $in && /^\s+\S.*?\s(\d+)\s+\d+$/;
+    END { print $seen ? $sum : "-" }')" || allocs="-"
+
+  times=()
+  insns=()
+  for ((i = 0; i < RUNS; i++)); do
+    if ! line="$(run_once "$prog")" || [[ -z "$line" ]]; then
+      echo "FAIL $name (run $((i + 1)) exited with an error)" >&2
+      failed=1
+      continue 2
+    fi
+    times+=("${line% *}")
+    insns+=("${line#* }")
+  done
+  read -r median p95 <<<"$(summarize "${times[@]}")"
+  read -r insn_median _ <<<"$(summarize "${insns[@]}")"
+  insn_median="${insn_median%.*}"
+  printf '%s\t%d\t%.2f\t%.2f\t%s\t%s\n' "$name" "$RUNS" "$median" "$p95" "$insn_median" "$allocs" |
+    tee -a "$RESULTS"
+  echo "DONE $name" >&2
+done
+
+if [[ "$SAVE" == "1" ]]; then
+  cp "$RESULTS" "$BASELINE"
+  echo "Baseline saved: $BASELINE" >&2
+elif [[ -f "$BASELINE" ]]; then
+  # Compare instruction counts when both sides have them, wall time otherwise
+  if ! perl -e '
+    my ($baseline, $results, $threshold) = @ARGV;
+    my %base;
+    open(my $b, "<", $baseline) or die "$baseline: $!\n";
+    while (<$b>) { chomp; my @f = split /\t/; $base{$f[0]} = \@f; }
+    open(my $r, "<", $results) or die "$results: $!\n";
+    my $regressions = 0;
+    while (<$r>) {
+      chomp;
+      my @f = split /\t/;
+      next if $f[0] eq "bench";
+      my $old = $base{$f[0]} or next;
+      my ($metric, $col) = ($old->[4] =~ /^\d+$/ && $f[4] =~ /^\d+$/)
+          ? ("instructions", 4) : ("median_ms", 2);
+      next unless $old->[$col] > 0;
+      my $change = ($f[$col] / $old->[$col] - 1) * 100;
+      my $verdict = $change > $threshold ? "REGRESSION" : "ok";
+      $regressions++ if $change > $threshold;
+      printf STDERR "%-10s %s %s %+.1f%% (%s -> %s)\n",
+          $verdict, $f[0], $metric, $change, $old->[$col], $f[$col];
+    }
+    exit($regressions ? 1 : 0);
+  ' "$BASELINE" "$RESULTS" "$THRESHOLD"; then
+    echo "Regressions above ${THRESHOLD}% against $BASELINE" >&2
+    failed=1
+  fi
+else
+  echo "No baseline at $BASELINE (run with SAVE=1 to create one)" >&2
+fi
+
+[[ $failed -eq 0 ]]
@@ -0,0 +1,11 @@
+REM String concatenation: grow a buffer, rebuild short strings
+T$ = ""
+FOR I = 1 TO 5000
+    T$ = T$ + CHR$(65 + I MOD 26)
+NEXT I
+L = 0
+FOR I = 1 TO 50000
+    A$ = "item" + STR$(I) + ";"
+    L = L + LEN(A$)
+NEXT I
+PRINT LEN(T$), L